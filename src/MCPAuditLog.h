@@ -6,7 +6,9 @@
  * session lifecycle, and custom audit events. Complements RBAC by
  * providing a tamper-evident trail of who did what.
  *
- * Memory-safe: fixed-capacity ring buffer evicts oldest entries.
+ * Memory-safe: fixed-capacity ring buffer evicts oldest entries, with
+ * actor/target strings interned and details in a bounded byte arena.
+ * Queries are views iterated in place over the ring.
  * Optional listener callback for real-time alerting / forwarding.
  *
  * Usage:
@@ -15,8 +17,8 @@
  *   audit.logAccessDenied("guest", "gpio_write");
  *   audit.logAuth("key-abc", true);
  *
- *   auto denied = audit.byAction(mcpd::AuditAction::AccessDenied);
- *   auto recent = audit.since(millis() - 60000);
+ *   for (const auto& e : audit.byAction(mcpd::AuditAction::AccessDenied)) ...
+ *   size_t recent = audit.since(millis() - 60000).size();
  *   String json = audit.toJSON();  // all entries as JSON array
  */
 
@@ -26,7 +28,7 @@
 #include <Arduino.h>
 #include <vector>
 #include <functional>
-#include <string>
+#include <memory>
 #include <cstring>
 
 namespace mcpd {
@@ -58,15 +60,40 @@ inline const char* auditActionToString(AuditAction a) {
     }
 }
 
+// ── Audit Text ──────────────────────────────────────────────────────
+
+/**
+ * Read-only view of a string stored by the log (an interned actor or
+ * target, or a detail in the arena). Valid until the entry is evicted.
+ */
+class AuditText {
+public:
+    AuditText(const char* s = "") : _s(s ? s : "") {}
+
+    const char* c_str() const { return _s; }
+    size_t length() const { return strlen(_s); }
+    bool isEmpty() const { return _s[0] == '\0'; }
+    operator String() const { return String(_s); }
+
+    bool operator==(const char* other) const { return strcmp(_s, other ? other : "") == 0; }
+    bool operator==(const String& other) const { return strcmp(_s, other.c_str()) == 0; }
+    bool operator!=(const char* other) const { return !(*this == other); }
+    bool operator!=(const String& other) const { return !(*this == other); }
+
+private:
+    const char* _s;
+};
+
 // ── Audit Entry ─────────────────────────────────────────────────────
 
+/** One logged event, as seen through a query or the listener. */
 struct AuditEntry {
     uint32_t    seq;           // Monotonic sequence number
     unsigned long timestamp;   // millis() at time of event
     AuditAction action;        // What happened
-    String      actor;         // Who did it (role, key, session id)
-    String      target;        // What was acted on (tool name, etc.)
-    String      detail;        // Additional context (params, reason)
+    AuditText   actor;         // Who did it (role, key, session id)
+    AuditText   target;        // What was acted on (tool name, etc.)
+    AuditText   detail;        // Additional context (params, reason)
     bool        success;       // Did it succeed?
 
     /** Serialize a single entry to JSON string. */
@@ -75,12 +102,12 @@ struct AuditEntry {
         json += "\"seq\":" + String(seq);
         json += ",\"time\":" + String(timestamp);
         json += ",\"action\":\"" + String(auditActionToString(action)) + "\"";
-        json += ",\"actor\":\"" + actor + "\"";
-        if (target.length() > 0) {
-            json += ",\"target\":\"" + target + "\"";
+        json += ",\"actor\":\"" + String(actor.c_str()) + "\"";
+        if (!target.isEmpty()) {
+            json += ",\"target\":\"" + String(target.c_str()) + "\"";
         }
-        if (detail.length() > 0) {
-            json += ",\"detail\":\"" + detail + "\"";
+        if (!detail.isEmpty()) {
+            json += ",\"detail\":\"" + String(detail.c_str()) + "\"";
         }
         json += ",\"success\":" + String(success ? "true" : "false");
         json += "}";
@@ -90,14 +117,54 @@ struct AuditEntry {
 
 // ── Audit Log ───────────────────────────────────────────────────────
 
+/**
+ * Entries live in a fixed ring of compact records (head index + count,
+ * so appending and evicting are O(1)). Actors and targets repeat a lot and
+ * are interned: a record holds a 16-bit id into a reference-counted string
+ * table. Details go into a byte arena used first-in first-out alongside
+ * the ring; when it is full the oldest entries are evicted to make room,
+ * and a detail longer than a quarter of the arena is truncated.
+ */
 class AuditLog {
 public:
     using Listener = std::function<void(const AuditEntry&)>;
 
-    /** Create an audit log with the given ring buffer capacity. */
-    explicit AuditLog(size_t capacity = 64)
-        : _capacity(capacity > 0 ? capacity : 1), _seq(0), _enabled(true) {
-        _entries.reserve(_capacity);
+    static constexpr size_t DETAIL_BYTES_PER_ENTRY = 32;
+    static constexpr size_t MAX_CAPACITY = 32767;   // Keeps name ids in 16 bits
+
+    /**
+     * Create an audit log with the given ring buffer capacity.
+     * @param detailBytes  detail arena size (default 32 bytes per entry)
+     */
+    explicit AuditLog(size_t capacity = 64, size_t detailBytes = 0)
+        : _seq(0), _enabled(true) {
+        _names.push_back(Name{String(), 0, 0});  // Id 0 is the empty string
+        _resize(capacity, detailBytes ? detailBytes : _defaultArena(capacity));
+    }
+
+    AuditLog(const AuditLog& other) : _seq(0), _enabled(true) { *this = other; }
+
+    AuditLog& operator=(const AuditLog& other) {
+        if (this == &other) return *this;
+        _ring.reset(new Record[other._capacity]);
+        memcpy(_ring.get(), other._ring.get(), other._capacity * sizeof(Record));
+        _arena.reset(new char[other._arenaSize]);
+        memcpy(_arena.get(), other._arena.get(), other._arenaSize);
+        _capacity = other._capacity;
+        _head = other._head;
+        _count = other._count;
+        _arenaSize = other._arenaSize;
+        _arenaHead = other._arenaHead;
+        _arenaTail = other._arenaTail;
+        _arenaWrap = other._arenaWrap;
+        _arenaUsed = other._arenaUsed;
+        _arenaDetails = other._arenaDetails;
+        _names = other._names;
+        _freeNames = other._freeNames;
+        _seq = other._seq;
+        _enabled = other._enabled;
+        _listener = other._listener;
+        return *this;
     }
 
     // ── Enable / Disable ────────────────────────────────────────────
@@ -108,17 +175,23 @@ public:
     // ── Capacity ────────────────────────────────────────────────────
 
     size_t capacity() const { return _capacity; }
-    size_t count() const { return _entries.size(); }
+    size_t count() const { return _count; }
 
     /** Resize the ring buffer. Entries beyond new capacity are evicted (oldest first). */
     void setCapacity(size_t cap) {
-        if (cap == 0) cap = 1;
-        _capacity = cap;
-        while (_entries.size() > _capacity) {
-            _entries.erase(_entries.begin());
-        }
+        _resize(cap, _arenaSize);
     }
 
+    /** Resize the detail arena. Entries whose details no longer fit are evicted. */
+    void setDetailBytes(size_t bytes) {
+        _resize(_capacity, bytes);
+    }
+    size_t detailBytes() const { return _arenaSize; }
+    /** Arena bytes held by buffered details */
+    size_t detailBytesUsed() const { return _arenaUsed; }
+    /** Distinct actor/target strings currently interned */
+    size_t internedNames() const { return _names.size() - 1 - _freeNames.size(); }
+
     // ── Convenience Logging Methods ─────────────────────────────────
 
     /** Log a tool call. */
@@ -168,90 +241,127 @@ public:
 
     // ── Query Methods ───────────────────────────────────────────────
 
-    /** Get all entries (oldest first). */
-    const std::vector<AuditEntry>& entries() const { return _entries; }
+    /**
+     * Filtered range over the ring (oldest first), iterated in place
+     * without copying entries. A view is valid until the next call that
+     * logs or clears.
+     *
+     *   for (const AuditEntry& e : audit.byActor("guest")) ...
+     */
+    class View {
+    public:
+        class iterator {
+        public:
+            const AuditEntry operator*() const { return _view->_log->_entry(_pos); }
+            iterator& operator++() {
+                _pos = _view->_next(_pos + 1);
+                return *this;
+            }
+            bool operator==(const iterator& o) const { return _pos == o._pos; }
+            bool operator!=(const iterator& o) const { return _pos != o._pos; }
+
+        private:
+            friend class View;
+            iterator(const View* view, size_t pos) : _view(view), _pos(pos) {}
+            const View* _view;
+            size_t _pos;  // Position from the oldest entry
+        };
+
+        iterator begin() const { return iterator(this, _next(_from)); }
+        iterator end() const { return iterator(this, _log->_count); }
+
+        /** Matching entries (walks the ring) */
+        size_t size() const {
+            size_t n = 0;
+            for (size_t p = _next(_from); p < _log->_count; p = _next(p + 1)) n++;
+            return n;
+        }
+        bool empty() const { return _next(_from) >= _log->_count; }
 
-    /** Get entries filtered by action type. */
-    std::vector<AuditEntry> byAction(AuditAction action) const {
-        std::vector<AuditEntry> result;
-        for (auto& e : _entries) {
-            if (e.action == action) result.push_back(e);
+        /** i-th matching entry (walks the ring) */
+        const AuditEntry operator[](size_t i) const {
+            size_t p = _next(_from);
+            while (i-- > 0 && p < _log->_count) p = _next(p + 1);
+            return _log->_entry(p);
         }
-        return result;
-    }
 
-    /** Get entries filtered by actor. */
-    std::vector<AuditEntry> byActor(const char* actor) const {
-        std::vector<AuditEntry> result;
-        String a(actor);
-        for (auto& e : _entries) {
-            if (e.actor == a) result.push_back(e);
+    private:
+        friend class AuditLog;
+        enum class Kind : uint8_t { All, Action, Actor, Target, Since, SinceSeq, Failures };
+
+        View(const AuditLog* log, Kind kind, uint32_t value = 0, size_t from = 0)
+            : _log(log), _kind(kind), _value(value), _from(from) {}
+
+        const AuditLog* _log;
+        Kind _kind;
+        uint32_t _value;  // Action, name id, timestamp or sequence number
+        size_t _from;     // First position considered
+
+        bool _matches(size_t pos) const {
+            const auto& r = _log->_record(pos);
+            switch (_kind) {
+                case Kind::All:      return true;
+                case Kind::Action:   return (uint32_t)r.action == _value;
+                case Kind::Actor:    return r.actor == _value;
+                case Kind::Target:   return r.target == _value;
+                case Kind::Since:    return r.timestamp >= _value;
+                case Kind::SinceSeq: return r.seq > _value;
+                case Kind::Failures: return !r.success;
+            }
+            return false;
         }
-        return result;
-    }
 
-    /** Get entries filtered by target (e.g. tool name). */
-    std::vector<AuditEntry> byTarget(const char* target) const {
-        std::vector<AuditEntry> result;
-        String t(target);
-        for (auto& e : _entries) {
-            if (e.target == t) result.push_back(e);
+        size_t _next(size_t pos) const {
+            while (pos < _log->_count && !_matches(pos)) pos++;
+            return pos;
         }
-        return result;
+    };
+
+    /** All entries (oldest first). */
+    View entries() const { return View(this, View::Kind::All); }
+
+    /** Entries filtered by action type. */
+    View byAction(AuditAction action) const {
+        return View(this, View::Kind::Action, (uint32_t)action);
     }
 
-    /** Get entries since a given timestamp (millis). */
-    std::vector<AuditEntry> since(unsigned long ts) const {
-        std::vector<AuditEntry> result;
-        for (auto& e : _entries) {
-            if (e.timestamp >= ts) result.push_back(e);
-        }
-        return result;
+    /** Entries filtered by actor. */
+    View byActor(const char* actor) const {
+        return View(this, View::Kind::Actor, _findName(actor));
     }
 
-    /** Get entries since a given sequence number (exclusive). */
-    std::vector<AuditEntry> sinceSeq(uint32_t afterSeq) const {
-        std::vector<AuditEntry> result;
-        for (auto& e : _entries) {
-            if (e.seq > afterSeq) result.push_back(e);
-        }
-        return result;
+    /** Entries filtered by target (e.g. tool name). */
+    View byTarget(const char* target) const {
+        return View(this, View::Kind::Target, _findName(target));
     }
 
-    /** Get only failed entries. */
-    std::vector<AuditEntry> failures() const {
-        std::vector<AuditEntry> result;
-        for (auto& e : _entries) {
-            if (!e.success) result.push_back(e);
-        }
-        return result;
+    /** Entries since a given timestamp (millis). */
+    View since(unsigned long ts) const {
+        return View(this, View::Kind::Since, (uint32_t)ts);
     }
 
-    /** Get the last N entries (most recent). */
-    std::vector<AuditEntry> last(size_t n) const {
-        if (n >= _entries.size()) return _entries;
-        return std::vector<AuditEntry>(_entries.end() - n, _entries.end());
+    /** Entries since a given sequence number (exclusive). */
+    View sinceSeq(uint32_t afterSeq) const {
+        return View(this, View::Kind::SinceSeq, afterSeq);
+    }
+
+    /** Only failed entries. */
+    View failures() const { return View(this, View::Kind::Failures); }
+
+    /** The last N entries (most recent). */
+    View last(size_t n) const {
+        return View(this, View::Kind::All, 0, n >= _count ? 0 : _count - n);
     }
 
     // ── Stats ───────────────────────────────────────────────────────
 
     /** Count entries matching an action type. */
     size_t countByAction(AuditAction action) const {
-        size_t c = 0;
-        for (auto& e : _entries) {
-            if (e.action == action) c++;
-        }
-        return c;
+        return byAction(action).size();
     }
 
     /** Count failed entries. */
-    size_t countFailures() const {
-        size_t c = 0;
-        for (auto& e : _entries) {
-            if (!e.success) c++;
-        }
-        return c;
-    }
+    size_t countFailures() const { return failures().size(); }
 
     /** Current sequence number (total events ever logged). */
     uint32_t currentSeq() const { return _seq; }
@@ -261,9 +371,11 @@ public:
     /** Serialize all entries to a JSON array string. */
     String toJSON() const {
         String json = "[";
-        for (size_t i = 0; i < _entries.size(); i++) {
-            if (i > 0) json += ",";
-            json += _entries[i].toJSON();
+        bool first = true;
+        for (const AuditEntry& e : entries()) {
+            if (!first) json += ",";
+            first = false;
+            json += e.toJSON();
         }
         json += "]";
         return json;
@@ -273,7 +385,7 @@ public:
     String statsJSON() const {
         String json = "{";
         json += "\"total\":" + String(_seq);
-        json += ",\"buffered\":" + String((unsigned long)_entries.size());
+        json += ",\"buffered\":" + String((unsigned long)_count);
         json += ",\"capacity\":" + String((unsigned long)_capacity);
         json += ",\"tool_calls\":" + String((unsigned long)countByAction(AuditAction::ToolCall));
         json += ",\"access_denied\":" + String((unsigned long)countByAction(AuditAction::AccessDenied));
@@ -295,43 +407,239 @@ public:
     // ── Clear ───────────────────────────────────────────────────────
 
     /** Clear all entries (sequence counter is NOT reset). */
-    void clear() { _entries.clear(); }
+    void clear() {
+        while (_count > 0) _evictOldest();
+    }
 
     /** Full reset including sequence counter. */
     void reset() {
-        _entries.clear();
+        clear();
         _seq = 0;
     }
 
 private:
+    static constexpr uint16_t NO_NAME = 0xFFFF;   // Matches no record
+
+    struct Record {
+        uint32_t seq;
+        uint32_t timestamp;
+        uint32_t detailOffset;
+        uint16_t detailLength;  // Without the NUL; 0 = no arena bytes used
+        uint16_t actor;         // Name ids
+        uint16_t target;
+        AuditAction action;
+        bool success;
+    };
+
+    struct Name {
+        String text;
+        uint32_t hash;
+        uint16_t refs;
+    };
+
+    // Ring: _count records starting at _head
+    std::unique_ptr<Record[]> _ring;
+    size_t _capacity = 0;
+    size_t _head = 0;
+    size_t _count = 0;
+
+    // Detail arena, used FIFO: live bytes run from _arenaHead to
+    // _arenaTail, wrapping at _arenaWrap
+    std::unique_ptr<char[]> _arena;
+    size_t _arenaSize = 0;
+    size_t _arenaHead = 0;
+    size_t _arenaTail = 0;
+    size_t _arenaWrap = 0;
+    size_t _arenaUsed = 0;   // Bytes of live details, NULs included
+    size_t _arenaDetails = 0;
+
+    std::vector<Name> _names;
+    std::vector<uint16_t> _freeNames;
+
+    uint32_t _seq;
+    bool _enabled;
+    Listener _listener;
+
+    static size_t _defaultArena(size_t capacity) {
+        return (capacity > 0 ? capacity : 1) * DETAIL_BYTES_PER_ENTRY;
+    }
+
+    const Record& _record(size_t pos) const {
+        return _ring[(_head + pos) % _capacity];
+    }
+
+    AuditEntry _entry(size_t pos) const {
+        const Record& r = _record(pos);
+        AuditEntry e;
+        e.seq = r.seq;
+        e.timestamp = r.timestamp;
+        e.action = r.action;
+        e.actor = AuditText(_names[r.actor].text.c_str());
+        e.target = AuditText(_names[r.target].text.c_str());
+        e.detail = AuditText(r.detailLength ? _arena.get() + r.detailOffset : "");
+        e.success = r.success;
+        return e;
+    }
+
+    // ── String table ────────────────────────────────────────────────
+
+    static uint32_t _hash(const char* s) {
+        uint32_t h = 2166136261u;  // FNV-1a
+        while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+        return h;
+    }
+
+    uint16_t _findName(const char* s) const {
+        if (!s || !*s) return 0;
+        uint32_t h = _hash(s);
+        for (size_t i = 1; i < _names.size(); i++) {
+            const Name& n = _names[i];
+            if (n.refs && n.hash == h && n.text == s) return (uint16_t)i;
+        }
+        return NO_NAME;
+    }
+
+    uint16_t _intern(const char* s) {
+        if (!s || !*s) return 0;
+        uint16_t id = _findName(s);
+        if (id == NO_NAME) {
+            if (!_freeNames.empty()) {
+                id = _freeNames.back();
+                _freeNames.pop_back();
+                _names[id].text = s;
+                _names[id].hash = _hash(s);
+            } else {
+                id = (uint16_t)_names.size();
+                _names.push_back(Name{String(s), _hash(s), 0});
+            }
+        }
+        _names[id].refs++;
+        return id;
+    }
+
+    void _release(uint16_t id) {
+        if (id == 0) return;
+        if (--_names[id].refs == 0) {
+            _names[id].text = String();  // Give the heap block back
+            _freeNames.push_back(id);
+        }
+    }
+
+    // ── Detail arena ────────────────────────────────────────────────
+
+    // Start of a free run of n bytes, evicting the oldest entries until
+    // one exists. n is at most a quarter of the arena.
+    size_t _allocDetail(size_t n) {
+        for (;;) {
+            if (_arenaDetails == 0) {
+                _arenaHead = _arenaTail = 0;
+                _arenaWrap = _arenaSize;
+            }
+            bool wrapped = _arenaTail < _arenaHead ||
+                           (_arenaDetails > 0 && _arenaTail == _arenaHead);
+            if (!wrapped) {
+                if (_arenaTail + n <= _arenaSize) return _take(_arenaTail, n);
+                if (n <= _arenaHead) {
+                    _arenaWrap = _arenaTail;
+                    return _take(0, n);
+                }
+            } else if (_arenaTail + n <= _arenaHead) {
+                return _take(_arenaTail, n);
+            }
+            _evictOldest();
+        }
+    }
+
+    size_t _take(size_t offset, size_t n) {
+        _arenaTail = offset + n;
+        _arenaUsed += n;
+        _arenaDetails++;
+        return offset;
+    }
+
+    void _freeDetail(const Record& r) {
+        _arenaUsed -= r.detailLength + 1;
+        _arenaDetails--;
+        _arenaHead = r.detailOffset + r.detailLength + 1;
+        if (_arenaHead >= _arenaWrap) {  // The next detail starts at 0
+            _arenaHead = 0;
+            _arenaWrap = _arenaSize;
+        }
+    }
+
+    // ── Ring ────────────────────────────────────────────────────────
+
+    void _evictOldest() {
+        Record& r = _ring[_head];
+        _release(r.actor);
+        _release(r.target);
+        if (r.detailLength) _freeDetail(r);
+        _head = (_head + 1) % _capacity;
+        _count--;
+    }
+
+    void _push(uint32_t seq, uint32_t timestamp, AuditAction action, const char* actor,
+               const char* target, const char* detail, bool success) {
+        if (_count == _capacity) _evictOldest();
+        size_t len = detail ? strlen(detail) : 0;
+        if (len > _arenaSize / 4) len = _arenaSize / 4;   // Truncate
+        if (len > 0xFFFF) len = 0xFFFF;
+        size_t offset = 0;
+        if (len) {
+            offset = _allocDetail(len + 1);
+            memcpy(_arena.get() + offset, detail, len);
+            _arena[offset + len] = '\0';
+        }
+        Record& r = _ring[(_head + _count) % _capacity];
+        r.seq = seq;
+        r.timestamp = timestamp;
+        r.detailOffset = (uint32_t)offset;
+        r.detailLength = (uint16_t)len;
+        r.actor = _intern(actor);
+        r.target = _intern(target);
+        r.action = action;
+        r.success = success;
+        _count++;
+    }
+
     void _append(AuditAction action, const char* actor, const char* target,
                  const char* detail, bool success) {
         if (!_enabled) return;
 
-        AuditEntry entry;
-        entry.seq = ++_seq;
-        entry.timestamp = millis();
-        entry.action = action;
-        entry.actor = actor ? actor : "";
-        entry.target = target ? target : "";
-        entry.detail = detail ? detail : "";
-        entry.success = success;
-
-        if (_entries.size() >= _capacity) {
-            _entries.erase(_entries.begin());
-        }
-        _entries.push_back(entry);
+        _push(++_seq, (uint32_t)millis(), action, actor, target, detail, success);
 
         if (_listener) {
-            _listener(entry);
+            _listener(_entry(_count - 1));
         }
     }
 
-    size_t _capacity;
-    uint32_t _seq;
-    bool _enabled;
-    std::vector<AuditEntry> _entries;
-    Listener _listener;
+    // Rebuilds ring and arena at new sizes, keeping the newest entries
+    // that fit
+    void _resize(size_t capacity, size_t arenaBytes) {
+        if (capacity == 0) capacity = 1;
+        if (capacity > MAX_CAPACITY) capacity = MAX_CAPACITY;
+        if (arenaBytes < 4) arenaBytes = 4;
+        std::unique_ptr<Record[]> oldRing = std::move(_ring);
+        std::unique_ptr<char[]> oldArena = std::move(_arena);
+        size_t oldCapacity = _capacity, oldHead = _head, oldCount = _count;
+
+        _ring.reset(new Record[capacity]);
+        _arena.reset(new char[arenaBytes]);
+        _capacity = capacity;
+        _arenaSize = arenaBytes;
+        _head = _count = 0;
+        _arenaUsed = _arenaDetails = 0;
+
+        for (size_t i = 0; i < oldCount; i++) {
+            const Record& r = oldRing[(oldHead + i) % oldCapacity];
+            String actor = _names[r.actor].text;
+            String target = _names[r.target].text;
+            const char* detail = r.detailLength ? oldArena.get() + r.detailOffset : "";
+            _release(r.actor);
+            _release(r.target);
+            _push(r.seq, r.timestamp, r.action, actor.c_str(), target.c_str(), detail, r.success);
+        }
+    }
 };
 
 }  // namespace mcpd
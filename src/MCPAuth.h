@@ -65,10 +65,11 @@ public:
      * Check if a request is authenticated.
      * Extracts token from Authorization header, X-API-Key header, or query param.
      *
-     * @param server  The WebServer instance to read headers from
+     * @param server  The WebServer (or kept-alive HttpConnection) to read headers from
      * @return true if authenticated (or auth is disabled)
      */
-    bool authenticate(WebServer& server) const {
+    template <typename TServer>
+    bool authenticate(TServer& server) const {
         if (!_enabled) return true;
 
         String token;
@@ -107,7 +108,8 @@ public:
     /**
      * Send a 401 Unauthorized response.
      */
-    static void sendUnauthorized(WebServer& server) {
+    template <typename TServer>
+    static void sendUnauthorized(TServer& server) {
         server.sendHeader("WWW-Authenticate", "Bearer realm=\"mcpd\"");
         server.send(401, "application/json",
                     "{\"jsonrpc\":\"2.0\",\"id\":null,\"error\":"
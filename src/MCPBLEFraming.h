@@ -0,0 +1,315 @@
+/**
+ * mcpd — BLE framing, flow control and reassembly
+ *
+ * The stack-independent half of BLETransport. It has no ESP32 BLE
+ * dependency, so it runs natively against a loopback BLELink.
+ *
+ * Frames carry the transport's 1-byte chunk header (SINGLE / FIRST /
+ * CONTINUE / FINAL) and are cut to the negotiated ATT MTU: a notification
+ * holds MTU - 3 bytes, the header included.
+ *
+ * BLEFramer queues outgoing messages and sends them in windows: up to
+ * `window` notifications per connection event, one event per connection
+ * interval. A notification the stack refuses (no buffer, congested link,
+ * notifications not yet enabled) stays at the head of the queue and is
+ * sent again at the next event. BLEReassembler joins incoming frames in
+ * one buffer allocated up front.
+ *
+ * Usage:
+ *   framer.setMtu(negotiatedMtu);
+ *   framer.enqueue(json, micros());
+ *   framer.pump(link, micros());        // from loop()
+ *
+ *   if (rx.feed(data, len) == BLEReassembler::Result::Complete) handle(rx.message());
+ */
+
+#ifndef MCPD_BLE_FRAMING_H
+#define MCPD_BLE_FRAMING_H
+
+#include <Arduino.h>
+#include <deque>
+#include <memory>
+
+namespace mcpd {
+
+// Chunk header bytes
+static constexpr uint8_t BLE_CHUNK_SINGLE   = 0x00;
+static constexpr uint8_t BLE_CHUNK_FIRST    = 0x01;
+static constexpr uint8_t BLE_CHUNK_CONTINUE = 0x02;
+static constexpr uint8_t BLE_CHUNK_FINAL    = 0x03;
+
+/** Where frames leave the device: the TX characteristic, or a test loopback. */
+class BLELink {
+public:
+    virtual ~BLELink() = default;
+
+    /** Send one notification. @return false if the stack cannot take it now */
+    virtual bool notify(const uint8_t* data, size_t len) = 0;
+};
+
+class BLEFramer {
+public:
+    static constexpr uint16_t ATT_HEADER = 3;          // Opcode + handle
+    static constexpr uint16_t MIN_MTU = 23;            // Before MTU exchange
+    static constexpr uint16_t MAX_MTU = 517;
+    static constexpr uint8_t DEFAULT_WINDOW = 1;
+    static constexpr unsigned long DEFAULT_INTERVAL_US = 20000;
+    static constexpr size_t DEFAULT_MAX_QUEUE_BYTES = 16384;
+
+    /** Negotiated ATT MTU (clamped to 23..517). */
+    void setMtu(uint16_t mtu) {
+        _mtu = mtu < MIN_MTU ? MIN_MTU : (mtu > MAX_MTU ? MAX_MTU : mtu);
+    }
+    uint16_t mtu() const { return _mtu; }
+
+    /** Message bytes per notification */
+    size_t framePayload() const { return _mtu - ATT_HEADER - 1; }
+
+    /**
+     * Notifications sent per connection event, and the time between
+     * events (the connection interval).
+     */
+    void setWindow(uint8_t frames, unsigned long intervalUs) {
+        _window = frames ? frames : 1;
+        _intervalUs = intervalUs;
+    }
+    uint8_t window() const { return _window; }
+    unsigned long intervalUs() const { return _intervalUs; }
+
+    /** Queued bytes beyond which new messages are dropped */
+    void setMaxQueueBytes(size_t bytes) { _maxQueueBytes = bytes; }
+
+    /**
+     * Queue a message.
+     * @return false if the queue is full (the message is dropped)
+     */
+    bool enqueue(const String& message, unsigned long nowUs) {
+        if (_queuedBytes + message.length() > _maxQueueBytes) {
+            _txDropped++;
+            return false;
+        }
+        if (_queue.empty()) _busySinceUs = nowUs;
+        _queue.push_back(Pending{message, nowUs});
+        _queuedBytes += message.length();
+        return true;
+    }
+
+    /**
+     * Send the frames the current connection event allows. A new event
+     * (with a full window) starts once the interval has passed.
+     * @return notifications sent
+     */
+    size_t pump(BLELink& link, unsigned long nowUs) {
+        if (_queue.empty()) return 0;
+        if (!_eventStarted || nowUs - _eventUs >= _intervalUs) {
+            _eventStarted = true;
+            _eventUs = nowUs;
+            _credits = _window;
+        }
+        size_t sent = 0;
+        while (_credits > 0 && !_queue.empty()) {
+            Pending& head = _queue.front();
+            size_t len = head.data.length();
+            size_t n = len - _offset;
+            if (n > framePayload()) n = framePayload();
+            bool first = _offset == 0;
+            bool last = _offset + n >= len;
+            _frame[0] = first && last ? BLE_CHUNK_SINGLE
+                      : first         ? BLE_CHUNK_FIRST
+                      : last          ? BLE_CHUNK_FINAL
+                                      : BLE_CHUNK_CONTINUE;
+            memcpy(_frame + 1, head.data.c_str() + _offset, n);
+            if (!link.notify(_frame, n + 1)) {
+                _txRefused++;
+                _credits = 0;  // Congested: wait for the next event
+                break;
+            }
+            _credits--;
+            sent++;
+            _txFrames++;
+            _offset += n;
+            if (last) {
+                unsigned long latency = nowUs - head.queuedUs;
+                _latencyLastUs = latency;
+                _latencyTotalUs += latency;
+                if (latency > _latencyMaxUs) _latencyMaxUs = latency;
+                _txMessages++;
+                _txBytes += len;
+                _queuedBytes -= len;
+                _queue.pop_front();
+                _offset = 0;
+                if (_queue.empty()) _busyUs += nowUs - _busySinceUs;
+            }
+        }
+        return sent;
+    }
+
+    /** Drop everything queued (disconnect). */
+    void clear() {
+        _queue.clear();
+        _queuedBytes = 0;
+        _offset = 0;
+        _eventStarted = false;
+    }
+
+    bool idle() const { return _queue.empty(); }
+    size_t queuedMessages() const { return _queue.size(); }
+    size_t queuedBytes() const { return _queuedBytes; }
+
+    // ── Counters ───────────────────────────────────────────────────────
+
+    unsigned long txMessages() const { return _txMessages; }
+    unsigned long txFrames() const { return _txFrames; }
+    /** Message bytes sent (without frame headers) */
+    unsigned long txBytes() const { return _txBytes; }
+    /** Notifications the stack refused and that were sent again later */
+    unsigned long txRefused() const { return _txRefused; }
+    /** Messages dropped because the queue was full */
+    unsigned long txDropped() const { return _txDropped; }
+
+    /** Message bytes per second while the queue was not empty */
+    float txBytesPerSecond() const {
+        return _busyUs ? (float)_txBytes * 1000000.0f / (float)_busyUs : 0.0f;
+    }
+
+    /** Queueing-to-last-frame latency of sent messages */
+    unsigned long latencyLastUs() const { return _latencyLastUs; }
+    unsigned long latencyMaxUs() const { return _latencyMaxUs; }
+    unsigned long latencyAvgUs() const {
+        return _txMessages ? (unsigned long)(_latencyTotalUs / _txMessages) : 0;
+    }
+
+private:
+    struct Pending {
+        String data;
+        unsigned long queuedUs;
+    };
+
+    std::deque<Pending> _queue;
+    size_t _queuedBytes = 0;
+    size_t _maxQueueBytes = DEFAULT_MAX_QUEUE_BYTES;
+    size_t _offset = 0;         // Bytes of the head message already sent
+    uint16_t _mtu = MIN_MTU;
+    uint8_t _window = DEFAULT_WINDOW;
+    uint8_t _credits = 0;
+    unsigned long _intervalUs = DEFAULT_INTERVAL_US;
+    unsigned long _eventUs = 0;
+    bool _eventStarted = false;
+    uint8_t _frame[MAX_MTU - ATT_HEADER];
+
+    unsigned long _txMessages = 0;
+    unsigned long _txFrames = 0;
+    unsigned long _txBytes = 0;
+    unsigned long _txRefused = 0;
+    unsigned long _txDropped = 0;
+    unsigned long _busySinceUs = 0;
+    unsigned long _busyUs = 0;
+    unsigned long _latencyLastUs = 0;
+    unsigned long _latencyMaxUs = 0;
+    uint64_t _latencyTotalUs = 0;
+};
+
+class BLEReassembler {
+public:
+    static constexpr size_t DEFAULT_MAX_MESSAGE = 8192;
+
+    enum class Result : uint8_t {
+        Partial,   // More frames to come
+        Complete,  // message() holds a whole message
+        Dropped,   // Oversized, out of sequence or unknown header
+    };
+
+    /** Allocate the receive buffer for messages up to maxMessage bytes. */
+    void reserve(size_t maxMessage) {
+        _max = maxMessage;
+        _buf.reset(new char[maxMessage + 1]);
+        reset();
+    }
+    size_t maxMessage() const { return _max; }
+
+    Result feed(const uint8_t* frame, size_t len) {
+        if (!_buf) reserve(_max);
+        if (len < 1) return Result::Partial;
+        _rxFrames++;
+        const uint8_t* payload = frame + 1;
+        size_t n = len - 1;
+        switch (frame[0]) {
+            case BLE_CHUNK_SINGLE:
+            case BLE_CHUNK_FIRST:
+                if (_assembling) _rxDropped++;  // Previous message cut short
+                _len = 0;
+                _overflow = false;
+                _append(payload, n);
+                _assembling = frame[0] == BLE_CHUNK_FIRST;
+                return _assembling ? Result::Partial : _finish();
+            case BLE_CHUNK_CONTINUE:
+            case BLE_CHUNK_FINAL:
+                if (!_assembling) return _drop();
+                _append(payload, n);
+                if (frame[0] == BLE_CHUNK_CONTINUE) return Result::Partial;
+                _assembling = false;
+                return _finish();
+            default:
+                return _drop();
+        }
+    }
+
+    /** The completed message, NUL-terminated; valid until the next feed() */
+    const char* message() const { return _buf.get(); }
+    size_t length() const { return _len; }
+
+    /** Forget a partly received message (disconnect). */
+    void reset() {
+        _len = 0;
+        _assembling = false;
+        _overflow = false;
+        if (_buf) _buf[0] = '\0';
+    }
+
+    unsigned long rxMessages() const { return _rxMessages; }
+    unsigned long rxFrames() const { return _rxFrames; }
+    unsigned long rxBytes() const { return _rxBytes; }
+    unsigned long rxDropped() const { return _rxDropped; }
+
+private:
+    std::unique_ptr<char[]> _buf;
+    size_t _max = DEFAULT_MAX_MESSAGE;
+    size_t _len = 0;
+    bool _assembling = false;
+    bool _overflow = false;
+
+    unsigned long _rxMessages = 0;
+    unsigned long _rxFrames = 0;
+    unsigned long _rxBytes = 0;
+    unsigned long _rxDropped = 0;
+
+    void _append(const uint8_t* data, size_t n) {
+        if (_overflow || _len + n > _max) {
+            _overflow = true;
+            return;
+        }
+        memcpy(_buf.get() + _len, data, n);
+        _len += n;
+    }
+
+    Result _finish() {
+        if (_overflow) {
+            _len = 0;
+            _buf[0] = '\0';
+            return _drop();
+        }
+        _buf[_len] = '\0';
+        _rxMessages++;
+        _rxBytes += _len;
+        return Result::Complete;
+    }
+
+    Result _drop() {
+        _rxDropped++;
+        return Result::Dropped;
+    }
+};
+
+} // namespace mcpd
+
+#endif // MCPD_BLE_FRAMING_H
@@ -0,0 +1,144 @@
+/**
+ * mcpd — JSON-RPC batch splitting
+ *
+ * A batch used to be deserialized into one document holding every request.
+ * BatchScanner walks the raw array instead and hands out one item at a
+ * time, so the server only parses (and, when the transport streams, only
+ * answers) a single request at once.
+ *
+ * The scan checks structure only: balanced and matching brackets,
+ * terminated strings, no empty items and nothing but whitespace after the
+ * closing ']'. Each item is still parsed by ArduinoJson on its own.
+ *
+ * Usage:
+ *   BatchScanner scan(body.c_str(), body.length());
+ *   int n = scan.count();          // -1 if malformed
+ *   const char* item; size_t len;
+ *   while (scan.next(item, len)) ...
+ */
+
+#ifndef MCPD_BATCH_H
+#define MCPD_BATCH_H
+
+#include <Arduino.h>
+
+namespace mcpd {
+
+class BatchScanner {
+public:
+    static constexpr size_t MAX_DEPTH = 32;  // Nesting inside one item
+
+    BatchScanner(const char* data, size_t len) : _pos(data), _end(data + len) {
+        _pos = _skipSpace(_pos);
+        if (_pos < _end && *_pos == '[') {
+            _pos++;
+        } else {
+            _failed = true;
+        }
+    }
+
+    /** True if the input starts with '[' (ignoring whitespace). */
+    static bool isBatch(const char* data, size_t len) {
+        const char* p = _skipSpace(data, data + len);
+        return p < data + len && *p == '[';
+    }
+
+    /**
+     * Validate the remaining array without consuming it.
+     * @return number of items, or -1 if the batch is malformed
+     */
+    int count() const {
+        BatchScanner scan = *this;
+        int n = 0;
+        const char* item;
+        size_t len;
+        while (scan.next(item, len)) n++;
+        return scan._failed ? -1 : n;
+    }
+
+    /**
+     * Span of the next item, without surrounding whitespace.
+     * @return false at the end of the array or on malformed input
+     */
+    bool next(const char*& item, size_t& len) {
+        if (_done || _failed) return false;
+        const char* start = _skipSpace(_pos);
+        const char* stop = _itemEnd(start, _end);
+        if (!stop) return _fail();
+        const char* last = stop;
+        while (last > start && _isSpace(last[-1])) last--;
+        if (last == start) {
+            // Only "[]" may have nothing before its ']'
+            if (*stop == ']' && _first) {
+                _done = true;
+                return _skipSpace(stop + 1) == _end ? false : _fail();
+            }
+            return _fail();
+        }
+        _first = false;
+        if (*stop == ']') {
+            _done = true;
+            if (_skipSpace(stop + 1) != _end) return _fail();
+        }
+        _pos = stop + 1;
+        item = start;
+        len = (size_t)(last - start);
+        return true;
+    }
+
+    bool failed() const { return _failed; }
+
+private:
+    const char* _pos;
+    const char* _end;
+    bool _first = true;
+    bool _done = false;
+    bool _failed = false;
+
+    bool _fail() {
+        _failed = true;
+        return false;
+    }
+
+    static bool _isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    const char* _skipSpace(const char* p) const { return _skipSpace(p, _end); }
+
+    static const char* _skipSpace(const char* p, const char* end) {
+        while (p < end && _isSpace(*p)) p++;
+        return p;
+    }
+
+    // The ',' or ']' ending the item that starts at p, or nullptr
+    static const char* _itemEnd(const char* p, const char* end) {
+        uint32_t objects = 0;  // One bit per open container, set for '{'
+        size_t depth = 0;
+        for (; p < end; p++) {
+            char c = *p;
+            if (c == '"') {
+                for (p++; p < end && *p != '"'; p++) {
+                    if (*p == '\\') p++;
+                }
+                if (p >= end) return nullptr;
+            } else if (c == '{' || c == '[') {
+                if (depth == MAX_DEPTH) return nullptr;
+                objects = (objects << 1) | (c == '{' ? 1u : 0u);
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (depth == 0) return c == ']' ? p : nullptr;
+                if ((objects & 1u) != (c == '}' ? 1u : 0u)) return nullptr;
+                objects >>= 1;
+                depth--;
+            } else if (c == ',' && depth == 0) {
+                return p;
+            }
+        }
+        return nullptr;  // Array never closed
+    }
+};
+
+} // namespace mcpd
+
+#endif // MCPD_BATCH_H
@@ -5,8 +5,11 @@
  * Ideal for sensor tools on MCU where hardware reads are expensive
  * (e.g., DHT sensor needs 2s between reads, I2C scans are slow).
  *
- * Cache keys are computed from tool name + serialized arguments,
- * so identical calls return cached results within the TTL window.
+ * Cache keys are computed from the tool name and a canonical digest of
+ * the arguments, so identical calls (in any key order) return cached
+ * results within the TTL window.
+ * Storage is a fixed-capacity hash table with LRU eviction and an
+ * optional byte budget.
  */
 
 #ifndef MCPD_CACHE_H
@@ -15,6 +18,7 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <map>
+#include <vector>
 
 namespace mcpd {
 
@@ -23,12 +27,19 @@ struct CacheEntry {
     unsigned long cachedAt; // millis() when cached
     unsigned long ttlMs;    // Time-to-live in milliseconds
     bool isError;           // Whether the cached result was an error
+    unsigned long staleMs = 0;  // Extra window in which the stale result may still be served
 
     bool isValid() const {
         if (ttlMs == 0) return false;
         return (millis() - cachedAt) < ttlMs;
     }
 
+    /** Fresh, or expired but still inside the stale-while-revalidate window */
+    bool isServable() const {
+        if (ttlMs == 0) return false;
+        return (millis() - cachedAt) < ttlMs + staleMs;
+    }
+
     unsigned long ageMs() const {
         return millis() - cachedAt;
     }
@@ -39,14 +50,185 @@ struct CacheEntry {
     }
 };
 
+/**
+ * 128-bit key for a tool's arguments: `hash` picks the table slot and
+ * `check` (an independent hash) verifies the match.
+ */
+struct ArgsDigest {
+    uint64_t hash = 0;
+    uint64_t check = 0;
+
+    bool operator==(const ArgsDigest& o) const { return hash == o.hash && check == o.check; }
+    bool operator!=(const ArgsDigest& o) const { return !(*this == o); }
+};
+
+/** Two independent 64-bit hashes fed with the same bytes. */
+struct ArgsDigestStream {
+    uint64_t a = 14695981039346656037ull;  // FNV-1a
+    uint64_t b = 0x9E3779B97F4A7C15ull;    // Rotate-xor-multiply
+
+    void byte(uint8_t c) {
+        a ^= c;
+        a *= 1099511628211ull;
+        b = ((b << 5) | (b >> 59)) ^ c;
+        b *= 0xFF51AFD7ED558CCDull;
+    }
+    void bytes(const char* p, size_t n) {
+        for (size_t i = 0; i < n; i++) byte((uint8_t)p[i]);
+    }
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; i++) byte((uint8_t)(v >> (i * 8)));
+    }
+};
+
+inline uint64_t _mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27; x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+inline void _digestValue(JsonVariant v, ArgsDigestStream& out);
+
+// Members are hashed separately and summed, so key order does not matter
+inline void _digestObject(JsonObject obj, ArgsDigestStream& out) {
+    out.byte('o');
+    out.u64(obj.size());
+    uint64_t sumA = 0, sumB = 0;
+    if (!obj.isNull()) {
+        for (auto kv : obj) {
+            ArgsDigestStream member;
+            const char* key = kv.key().c_str();
+            member.bytes(key, strlen(key));
+            member.byte(0);
+            _digestValue(kv.value(), member);
+            sumA += _mix64(member.a);
+            sumB += _mix64(member.b ^ 0x5851F42D4C957F2Dull);
+        }
+    }
+    out.u64(sumA);
+    out.u64(sumB);
+}
+
+/**
+ * Feed a canonical encoding of `v` into `out`: type tags, lengths for
+ * strings and containers, integers as int64 (so 1 and 1.0 agree), and
+ * object members combined with a commutative sum so key order does not
+ * matter.
+ */
+inline void _digestValue(JsonVariant v, ArgsDigestStream& out) {
+    if (v.is<JsonObject>()) {
+        _digestObject(v.as<JsonObject>(), out);
+    } else if (v.is<JsonArray>()) {
+        JsonArray arr = v.as<JsonArray>();
+        out.byte('a');
+        out.u64(arr.size());
+        for (JsonVariant item : arr) _digestValue(item, out);
+    } else if (v.is<const char*>()) {
+        const char* str = v.as<const char*>();
+        size_t len = strlen(str);
+        out.byte('s');
+        out.u64(len);
+        out.bytes(str, len);
+    } else if (v.is<bool>()) {
+        out.byte(v.as<bool>() ? 't' : 'f');
+    } else if (v.is<long>()) {
+        out.byte('i');
+        out.u64((uint64_t)(int64_t)v.as<long>());
+    } else if (v.is<double>()) {
+        double d = v.as<double>();
+        if (d >= -9.2e18 && d <= 9.2e18 && d == (double)(int64_t)d) {
+            out.byte('i');
+            out.u64((uint64_t)(int64_t)d);
+        } else {
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            out.byte('d');
+            out.u64(bits);
+        }
+    } else {
+        out.byte('n');
+    }
+}
+
+inline ArgsDigest _finishDigest(const ArgsDigestStream& s) {
+    ArgsDigest d;
+    d.hash = _mix64(s.a);
+    d.check = _mix64(s.b);
+    return d;
+}
+
+/**
+ * Canonical digest of a tool's arguments, computed straight from the
+ * parsed JSON (no copy, no serialization). Member order does not matter,
+ * and a missing arguments object digests like {}.
+ */
+inline ArgsDigest argsDigest(const JsonObject& args) {
+    ArgsDigestStream s;
+    _digestObject(args, s);
+    return _finishDigest(s);
+}
+
+/**
+ * Digest of serialized arguments. Parses the text so the result matches
+ * argsDigest(JsonObject) for the same arguments; text that is not valid
+ * JSON is digested byte for byte.
+ */
+inline ArgsDigest argsDigest(const String& argsJson) {
+    JsonDocument doc;
+    if (!deserializeJson(doc, argsJson)) {
+        if (doc.is<JsonObject>()) return argsDigest(doc.as<JsonObject>());
+        ArgsDigestStream s;
+        _digestValue(doc.as<JsonVariant>(), s);
+        return _finishDigest(s);
+    }
+    ArgsDigestStream s;
+    s.byte('r');
+    s.bytes(argsJson.c_str(), argsJson.length());
+    return _finishDigest(s);
+}
+
+/**
+ * Per-tool caching policy.
+ */
+struct ToolCachePolicy {
+    unsigned long ttlMs = 0;          // Fresh lifetime
+    unsigned long staleMs = 0;        // Serve stale this long after TTL while refreshing
+    uint8_t refreshAheadPercent = 0;  // Refresh once this much of the TTL has passed (0 = off)
+};
+
+/**
+ * Outcome of ToolResultCache::lookup().
+ */
+enum class CacheLookup : uint8_t {
+    Miss,          // Nothing servable; run the tool
+    Hit,           // Serve the cached result
+    HitRefresh,    // Serve the cached result and refresh it in the background
+};
+
 /**
  * Tool result cache with per-tool TTL and bounded size.
  *
+ * Entries live in a fixed array of slots sized by setMaxEntries(). A
+ * linear-probing index maps a 64-bit key hash to its slot, and an intrusive
+ * doubly linked list keeps slots in LRU order, so get/put/evict are O(1)
+ * and the table itself never reallocates after setMaxEntries(). Hash hits
+ * are verified against the stored tool name and a second, independent
+ * 64-bit argument hash, so colliding argument sets do not return each
+ * other's result.
+ *
  * Usage:
  *   mcp.cache().setToolTTL("temperature_read", 2000);  // cache for 2s
  *   mcp.cache().setToolTTL("gpio_read", 500);           // cache for 500ms
- *   mcp.cache().setMaxEntries(32);                      // limit memory usage
+ *   mcp.cache().setMaxEntries(32);                      // limit entry count
+ *   mcp.cache().setMaxBytes(16384);                     // limit stored bytes
  *   mcp.enableCache();                                  // activate caching
+ *
+ * Slow sensor tools can keep cache-hit latency when their entry expires:
+ *   mcp.cache().setStaleWhileRevalidate("dht_read", 10000);  // serve stale up to 10s
+ *   mcp.cache().setRefreshAhead("dht_read", 80);             // refresh at 80% of TTL
+ * The server then refreshes in the background (one refresh per entry, no
+ * matter how many callers hit it meanwhile).
  */
 class ToolResultCache {
 public:
@@ -60,114 +242,236 @@ public:
      */
     void setToolTTL(const char* toolName, unsigned long ttlMs) {
         if (ttlMs == 0) {
-            _toolTTLs.erase(String(toolName));
+            _policies.erase(String(toolName));
         } else {
-            _toolTTLs[String(toolName)] = ttlMs;
+            _policies[String(toolName)].ttlMs = ttlMs;
         }
+        _revision++;
+    }
+
+    /**
+     * Keep serving a tool's result for staleMs after its TTL expires while
+     * the server refreshes it in the background. The tool needs a TTL.
+     * @return false if the tool has no TTL configured
+     */
+    bool setStaleWhileRevalidate(const char* toolName, unsigned long staleMs) {
+        auto it = _policies.find(String(toolName));
+        if (it == _policies.end()) return false;
+        it->second.staleMs = staleMs;
+        return true;
+    }
+
+    /**
+     * Refresh a tool's result in the background once `percent` of its TTL
+     * has passed, so callers keep getting fresh hits. 0 disables.
+     * @return false if the tool has no TTL configured
+     */
+    bool setRefreshAhead(const char* toolName, uint8_t percent) {
+        auto it = _policies.find(String(toolName));
+        if (it == _policies.end()) return false;
+        it->second.refreshAheadPercent = percent > 99 ? 99 : percent;
+        return true;
+    }
+
+    /** Policy for a tool, or nullptr if it is not cached */
+    const ToolCachePolicy* getToolPolicy(const char* toolName) const {
+        auto it = _policies.find(String(toolName));
+        return (it != _policies.end()) ? &it->second : nullptr;
     }
 
+    /**
+     * Revision counter, bumped whenever a tool TTL changes.
+     * Lets the server mirror TTLs into its tool table.
+     */
+    uint32_t revision() const { return _revision; }
+
     /**
      * Get the configured TTL for a tool (0 = not cached).
      */
     unsigned long getToolTTL(const char* toolName) const {
-        auto it = _toolTTLs.find(String(toolName));
-        return (it != _toolTTLs.end()) ? it->second : 0;
+        auto it = _policies.find(String(toolName));
+        return (it != _policies.end()) ? it->second.ttlMs : 0;
     }
 
     /**
      * Check if a tool has caching configured.
      */
     bool isToolCached(const char* toolName) const {
-        return _toolTTLs.find(String(toolName)) != _toolTTLs.end();
+        return _policies.find(String(toolName)) != _policies.end();
     }
 
     /**
      * Look up a cached result. Returns true if a valid (non-expired) entry exists.
      * @param toolName  Tool name
-     * @param argsJson  Serialized arguments JSON
+     * @param args      Digest of the call arguments (see argsDigest())
      * @param[out] result  The cached result string
      * @param[out] isError Whether the cached result was an error
      * @return true if cache hit
      */
-    bool get(const char* toolName, const String& argsJson,
+    bool get(const char* toolName, const ArgsDigest& args,
              String& result, bool& isError) {
-        if (!_enabled) return false;
+        if (!_enabled || _slots.empty()) return false;
 
-        String key = _makeKey(toolName, argsJson);
-        auto it = _entries.find(key);
-        if (it == _entries.end()) return false;
+        int idx = _find(toolName, args);
+        if (idx < 0) return false;
 
-        if (!it->second.isValid()) {
-            _entries.erase(it);
+        Slot& slot = _slots[idx];
+        if (!slot.entry.isValid()) {
+            if (!slot.entry.isServable()) _remove((uint16_t)idx);
             return false;
         }
 
-        result = it->second.result;
-        isError = it->second.isError;
+        _touch((uint16_t)idx);
+        result = slot.entry.result;
+        isError = slot.entry.isError;
         _hits++;
         return true;
     }
 
+    /**
+     * Look up a result honoring the tool's stale-while-revalidate and
+     * refresh-ahead policy. HitRefresh is returned once per entry: the
+     * entry is then marked as refreshing, and later lookups are plain hits
+     * until put() replaces it or endRefresh() gives up.
+     */
+    CacheLookup lookup(const char* toolName, const ArgsDigest& args,
+                       String& result, bool& isError) {
+        if (!_enabled || _slots.empty()) return CacheLookup::Miss;
+
+        int idx = _find(toolName, args);
+        if (idx < 0) return CacheLookup::Miss;
+
+        Slot& slot = _slots[idx];
+        const CacheEntry& e = slot.entry;
+        unsigned long age = e.ageMs();
+        bool fresh = e.isValid();
+        if (!fresh && !e.isServable()) {
+            _remove((uint16_t)idx);
+            return CacheLookup::Miss;
+        }
+
+        _touch((uint16_t)idx);
+        result = e.result;
+        isError = e.isError;
+        _hits++;
+        if (!fresh) _staleHits++;
+
+        bool due = !fresh || (slot.refreshAheadPercent > 0 &&
+                              (uint64_t)age * 100 >= (uint64_t)e.ttlMs * slot.refreshAheadPercent);
+        if (!due) return CacheLookup::Hit;
+        if (slot.refreshing) {
+            _coalesced++;
+            return CacheLookup::Hit;
+        }
+        slot.refreshing = true;
+        _refreshes++;
+        return CacheLookup::HitRefresh;
+    }
+
+    /** Clear the refreshing mark of an entry (refresh abandoned). */
+    void endRefresh(const char* toolName, const ArgsDigest& args) {
+        if (_slots.empty()) return;
+        int idx = _find(toolName, args);
+        if (idx >= 0) _slots[idx].refreshing = false;
+    }
+
+    /** Look up by serialized arguments JSON. */
+    bool get(const char* toolName, const String& argsJson,
+             String& result, bool& isError) {
+        if (!_enabled || _slots.empty()) return false;
+        return get(toolName, argsDigest(argsJson), result, isError);
+    }
+
     /**
      * Store a result in the cache.
-     * Only stores if the tool has a configured TTL.
+     * Only stores if the tool has a configured TTL. Results larger than the
+     * byte budget are not stored.
      */
-    void put(const char* toolName, const String& argsJson,
+    void put(const char* toolName, const ArgsDigest& args,
              const String& result, bool isError = false) {
         if (!_enabled) return;
 
-        unsigned long ttl = getToolTTL(toolName);
-        if (ttl == 0) return;
+        const ToolCachePolicy* policy = getToolPolicy(toolName);
+        if (!policy) return;
 
-        // Evict expired entries if at capacity
-        if (_entries.size() >= _maxEntries) {
-            _evictExpired();
-        }
-        // If still at capacity, evict oldest
-        if (_entries.size() >= _maxEntries) {
-            _evictOldest();
+        _ensureTable();
+        _misses++;
+
+        size_t cost = _cost(toolName, result);
+        int idx = _find(toolName, args);
+        if (idx >= 0) _remove((uint16_t)idx);
+        if (_maxBytes > 0 && cost > _maxBytes) return;
+
+        // Make room: entry count first, then byte budget (LRU order)
+        if (_freeHead == NIL) _evictLru();
+        while (_maxBytes > 0 && _bytes + cost > _maxBytes && _lruTail != NIL) {
+            _evictLru();
         }
 
-        String key = _makeKey(toolName, argsJson);
-        CacheEntry entry;
-        entry.result = result;
-        entry.cachedAt = millis();
-        entry.ttlMs = ttl;
-        entry.isError = isError;
-        _entries[key] = entry;
-        _misses++;
+        uint16_t si = _freeHead;
+        Slot& slot = _slots[si];
+        _freeHead = slot.next;
+
+        slot.hash = _keyHash(toolName, args);
+        slot.check = args.check;
+        slot.tool = toolName;
+        slot.entry.result = result;
+        slot.entry.cachedAt = millis();
+        slot.entry.ttlMs = policy->ttlMs;
+        slot.entry.staleMs = policy->staleMs;
+        slot.entry.isError = isError;
+        slot.refreshAheadPercent = policy->refreshAheadPercent;
+        slot.refreshing = false;
+        slot.used = true;
+        _bytes += cost;
+        _count++;
+
+        _indexInsert(si);
+        _linkFront(si);
+    }
+
+    /** Store by serialized arguments JSON. */
+    void put(const char* toolName, const String& argsJson,
+             const String& result, bool isError = false) {
+        if (!_enabled) return;
+        put(toolName, argsDigest(argsJson), result, isError);
     }
 
     /**
      * Invalidate all cached results for a specific tool.
      */
     void invalidateTool(const char* toolName) {
-        String prefix = String(toolName) + ":";
-        auto it = _entries.begin();
-        while (it != _entries.end()) {
-            if (it->first.startsWith(prefix)) {
-                it = _entries.erase(it);
-            } else {
-                ++it;
-            }
+        for (uint16_t i = 0; i < _slots.size(); i++) {
+            if (_slots[i].used && _slots[i].tool == toolName) _remove(i);
         }
     }
 
     /**
      * Invalidate a specific cached result.
      */
+    void invalidate(const char* toolName, const ArgsDigest& args) {
+        if (_slots.empty()) return;
+        int idx = _find(toolName, args);
+        if (idx >= 0) _remove((uint16_t)idx);
+    }
+
     void invalidate(const char* toolName, const String& argsJson) {
-        String key = _makeKey(toolName, argsJson);
-        _entries.erase(key);
+        if (_slots.empty()) return;
+        invalidate(toolName, argsDigest(argsJson));
     }
 
     /**
      * Clear the entire cache.
      */
     void clear() {
-        _entries.clear();
+        for (uint16_t i = 0; i < _slots.size(); i++) {
+            if (_slots[i].used) _remove(i);
+        }
         _hits = 0;
         _misses = 0;
+        _staleHits = 0;
+        _refreshes = 0;
+        _coalesced = 0;
     }
 
     /**
@@ -178,17 +482,43 @@ public:
 
     /**
      * Set maximum number of cache entries (default: 32).
-     * Keeps memory usage bounded on MCU.
+     * Preallocates the slot array and index; existing entries are dropped,
+     * so call this during setup.
      */
-    void setMaxEntries(size_t max) { _maxEntries = max; }
+    void setMaxEntries(size_t max) {
+        if (max == 0) max = 1;
+        if (max > MAX_ENTRIES_LIMIT) max = MAX_ENTRIES_LIMIT;
+        _maxEntries = max;
+        _slots.clear();
+        _index.clear();
+        _ensureTable();
+    }
     size_t getMaxEntries() const { return _maxEntries; }
 
+    /**
+     * Set a budget for stored bytes (tool name + result, summed over all
+     * entries). Least recently used entries are evicted
+     * to stay under it. 0 = no byte limit (default).
+     */
+    void setMaxBytes(size_t maxBytes) {
+        _maxBytes = maxBytes;
+        while (_maxBytes > 0 && _bytes > _maxBytes && _lruTail != NIL) {
+            _evictLru();
+        }
+    }
+    size_t getMaxBytes() const { return _maxBytes; }
+
     /**
      * Get cache statistics.
      */
-    size_t size() const { return _entries.size(); }
+    size_t size() const { return _count; }
+    size_t bytes() const { return _bytes; }
     unsigned long hits() const { return _hits; }
     unsigned long misses() const { return _misses; }
+    unsigned long evictions() const { return _evictions; }
+    unsigned long staleHits() const { return _staleHits; }    // Hits served after TTL
+    unsigned long refreshes() const { return _refreshes; }    // Background refreshes requested
+    unsigned long coalesced() const { return _coalesced; }    // Hits that joined a pending refresh
     float hitRate() const {
         unsigned long total = _hits + _misses;
         return (total > 0) ? (float)_hits / (float)total : 0.0f;
@@ -200,63 +530,170 @@ public:
     String statsJson() const {
         JsonDocument doc;
         doc["enabled"] = _enabled;
-        doc["entries"] = _entries.size();
+        doc["entries"] = _count;
         doc["maxEntries"] = _maxEntries;
+        doc["bytes"] = _bytes;
+        doc["maxBytes"] = _maxBytes;
         doc["hits"] = _hits;
         doc["misses"] = _misses;
+        doc["evictions"] = _evictions;
         doc["hitRate"] = hitRate();
-        doc["toolCount"] = _toolTTLs.size();
+        doc["staleHits"] = _staleHits;
+        doc["refreshes"] = _refreshes;
+        doc["coalesced"] = _coalesced;
+        doc["toolCount"] = _policies.size();
         String out;
         serializeJson(doc, out);
         return out;
     }
 
+    /** Slot indices are 16-bit; one value is reserved as "none" */
+    static constexpr size_t MAX_ENTRIES_LIMIT = 0xFFFE;
+
 private:
+    static constexpr uint16_t NIL = 0xFFFF;
+
+    struct Slot {
+        uint64_t hash = 0;   // Index hash of (tool, args)
+        uint64_t check = 0;  // ArgsDigest::check, verified on every match
+        String tool;
+        CacheEntry entry{};
+        uint16_t prev = NIL;  // LRU neighbours while used, free-list link otherwise
+        uint16_t next = NIL;
+        uint8_t refreshAheadPercent = 0;
+        bool refreshing = false;  // A background refresh is pending
+        bool used = false;
+    };
+
     bool _enabled = false;
     size_t _maxEntries = 32;
+    size_t _maxBytes = 0;
+    size_t _bytes = 0;
+    size_t _count = 0;
     unsigned long _hits = 0;
     unsigned long _misses = 0;
+    unsigned long _evictions = 0;
+    unsigned long _staleHits = 0;
+    unsigned long _refreshes = 0;
+    unsigned long _coalesced = 0;
+    uint32_t _revision = 0;
+
+    std::map<String, ToolCachePolicy> _policies;  // tool name → TTL / refresh policy
+
+    std::vector<Slot> _slots;       // Fixed at _maxEntries once allocated
+    std::vector<uint16_t> _index;   // Power-of-two probe table of slot indices (NIL = empty)
+    uint16_t _lruHead = NIL;        // Most recently used
+    uint16_t _lruTail = NIL;        // Least recently used
+    uint16_t _freeHead = NIL;
+
+    static size_t _cost(const char* toolName, const String& result) {
+        return strlen(toolName) + result.length();
+    }
 
-    std::map<String, unsigned long> _toolTTLs;  // tool name → TTL in ms
-    std::map<String, CacheEntry> _entries;       // key → entry
+    static uint64_t _keyHash(const char* toolName, const ArgsDigest& args) {
+        uint64_t h = 14695981039346656037ull;  // FNV-1a of the tool name
+        for (const char* p = toolName; *p; p++) {
+            h ^= (uint8_t)*p;
+            h *= 1099511628211ull;
+        }
+        return _mix64(h ^ args.hash);
+    }
 
-    /**
-     * Build a cache key from tool name and arguments.
-     * Key format: "toolName:argsHash" where argsHash is a simple
-     * string hash to keep keys short on MCU.
-     */
-    String _makeKey(const char* toolName, const String& argsJson) const {
-        // Simple DJB2 hash of the arguments
-        unsigned long hash = 5381;
-        for (size_t i = 0; i < argsJson.length(); i++) {
-            hash = ((hash << 5) + hash) + (unsigned char)argsJson[i];
+    void _ensureTable() {
+        if (!_slots.empty()) return;
+        _slots.resize(_maxEntries);
+        size_t cap = 8;
+        while (cap < _maxEntries * 2) cap <<= 1;  // Load factor <= 0.5
+        _index.assign(cap, NIL);
+        for (size_t i = 0; i < _maxEntries; i++) {
+            _slots[i].next = (i + 1 < _maxEntries) ? (uint16_t)(i + 1) : NIL;
         }
-        return String(toolName) + ":" + String(hash);
+        _freeHead = 0;
+        _lruHead = _lruTail = NIL;
+        _count = 0;
+        _bytes = 0;
     }
 
-    void _evictExpired() {
-        auto it = _entries.begin();
-        while (it != _entries.end()) {
-            if (!it->second.isValid()) {
-                it = _entries.erase(it);
-            } else {
-                ++it;
+    size_t _mask() const { return _index.size() - 1; }
+
+    int _find(const char* toolName, const ArgsDigest& args) const {
+        uint64_t h = _keyHash(toolName, args);
+        for (size_t pos = (size_t)h & _mask();; pos = (pos + 1) & _mask()) {
+            uint16_t si = _index[pos];
+            if (si == NIL) return -1;
+            const Slot& slot = _slots[si];
+            if (slot.hash == h && slot.check == args.check && slot.tool == toolName) {
+                return si;
             }
         }
     }
 
-    void _evictOldest() {
-        if (_entries.empty()) return;
-        auto oldest = _entries.begin();
-        unsigned long oldestAge = 0;
-        for (auto it = _entries.begin(); it != _entries.end(); ++it) {
-            unsigned long age = it->second.ageMs();
-            if (age > oldestAge) {
-                oldestAge = age;
-                oldest = it;
+    void _indexInsert(uint16_t si) {
+        size_t pos = (size_t)_slots[si].hash & _mask();
+        while (_index[pos] != NIL) pos = (pos + 1) & _mask();
+        _index[pos] = si;
+    }
+
+    // Linear-probing delete with backward shift (no tombstones)
+    void _indexErase(uint16_t si) {
+        size_t pos = (size_t)_slots[si].hash & _mask();
+        while (_index[pos] != si) pos = (pos + 1) & _mask();
+        size_t hole = pos;
+        for (size_t next = (hole + 1) & _mask(); _index[next] != NIL; next = (next + 1) & _mask()) {
+            size_t home = (size_t)_slots[_index[next]].hash & _mask();
+            // Move the entry back if its home is not in (hole, next]
+            bool between = (hole <= next) ? (home > hole && home <= next)
+                                          : (home > hole || home <= next);
+            if (!between) {
+                _index[hole] = _index[next];
+                hole = next;
             }
         }
-        _entries.erase(oldest);
+        _index[hole] = NIL;
+    }
+
+    void _linkFront(uint16_t si) {
+        Slot& slot = _slots[si];
+        slot.prev = NIL;
+        slot.next = _lruHead;
+        if (_lruHead != NIL) _slots[_lruHead].prev = si;
+        _lruHead = si;
+        if (_lruTail == NIL) _lruTail = si;
+    }
+
+    void _unlink(uint16_t si) {
+        Slot& slot = _slots[si];
+        if (slot.prev != NIL) _slots[slot.prev].next = slot.next;
+        else _lruHead = slot.next;
+        if (slot.next != NIL) _slots[slot.next].prev = slot.prev;
+        else _lruTail = slot.prev;
+    }
+
+    void _touch(uint16_t si) {
+        if (_lruHead == si) return;
+        _unlink(si);
+        _linkFront(si);
+    }
+
+    void _remove(uint16_t si) {
+        if (si == NIL) return;
+        Slot& slot = _slots[si];
+        if (!slot.used) return;
+        _indexErase(si);
+        _unlink(si);
+        _bytes -= _cost(slot.tool.c_str(), slot.entry.result);
+        _count--;
+        slot.used = false;
+        slot.entry.result = String();  // Release large payloads right away
+        slot.next = _freeHead;
+        slot.prev = NIL;
+        _freeHead = si;
+    }
+
+    void _evictLru() {
+        if (_lruTail == NIL) return;
+        _remove(_lruTail);
+        _evictions++;
     }
 };
 
@@ -0,0 +1,476 @@
+/**
+ * mcpd — Raw DEFLATE for WebSocket permessage-deflate (RFC 7692)
+ *
+ * DeflateEncoder compresses one message at a time into raw DEFLATE
+ * (RFC 1951): LZ77 over a small sliding window (1 KB by default) and the
+ * fixed Huffman code, ended with a sync flush whose trailing 00 00 FF FF
+ * is stripped, as permessage-deflate expects. With context takeover the
+ * window carries over to the next message, so repeated JSON (tool schemas,
+ * buffered readings) compresses against what was already sent.
+ *
+ * DeflateDecoder inflates a message sent with client_no_context_takeover:
+ * back-references only reach into the same message, so the output buffer
+ * is the window and no per-client history is kept. Stored, fixed and
+ * dynamic Huffman blocks are accepted.
+ *
+ * Memory: the encoder keeps 2^windowBits bytes of history per connection
+ * (none without context takeover) and allocates about 4 KB of match tables
+ * plus a copy of the message while compressing.
+ */
+
+#ifndef MCPD_DEFLATE_H
+#define MCPD_DEFLATE_H
+
+#include <Arduino.h>
+#include <vector>
+
+namespace mcpd {
+
+namespace deflate_tables {
+
+static const uint16_t LEN_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LEN_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+} // namespace deflate_tables
+
+/**
+ * Per-connection compressor for outgoing messages.
+ */
+class DeflateEncoder {
+public:
+    static constexpr uint8_t MIN_WINDOW_BITS = 8;
+    static constexpr uint8_t MAX_WINDOW_BITS = 15;
+    static constexpr uint8_t DEFAULT_WINDOW_BITS = 10;
+    static constexpr size_t MAX_CHAIN = 32;        // Candidates tried per position
+
+    explicit DeflateEncoder(uint8_t windowBits = DEFAULT_WINDOW_BITS,
+                            bool contextTakeover = true) {
+        configure(windowBits, contextTakeover);
+    }
+
+    /** Set window size and context takeover; drops the history. */
+    void configure(uint8_t windowBits, bool contextTakeover) {
+        if (windowBits < MIN_WINDOW_BITS) windowBits = MIN_WINDOW_BITS;
+        if (windowBits > MAX_WINDOW_BITS) windowBits = MAX_WINDOW_BITS;
+        _windowBits = windowBits;
+        _contextTakeover = contextTakeover;
+        reset();
+    }
+
+    /** Forget the history of earlier messages. */
+    void reset() { _history = String(); }
+
+    uint8_t windowBits() const { return _windowBits; }
+    bool contextTakeover() const { return _contextTakeover; }
+    size_t historyBytes() const { return _history.length(); }
+
+    /**
+     * Compress one message. On success `out` holds the frame payload and,
+     * with context takeover, the message joins the window.
+     * @return false if compressing would not make the message smaller
+     *         (send it uncompressed; the history is left untouched)
+     */
+    bool compress(const uint8_t* data, size_t len, String& out) {
+        out = String();
+        if (len == 0) return false;
+
+        const size_t window = (size_t)1 << _windowBits;
+        const size_t hist = _history.length();
+        const size_t total = hist + len;
+
+        std::vector<uint8_t> buf(total);
+        if (hist > 0) memcpy(buf.data(), _history.c_str(), hist);
+        memcpy(buf.data() + hist, data, len);
+
+        std::vector<int32_t> head(HASH_SIZE, -1);
+        std::vector<uint16_t> prev(window, 0);  // Distance to the previous candidate
+        for (size_t p = 0; p + 2 < hist; p++) _insert(buf.data(), p, head, prev, window);
+
+        out.reserve(len / 2 + 16);
+        _BitWriter w{out};
+        w.put(0, 1);  // BFINAL = 0
+        w.put(1, 2);  // BTYPE = 01 (fixed Huffman)
+
+        size_t pos = hist;
+        while (pos < total) {
+            size_t bestLen = 0, bestDist = 0;
+            if (total - pos >= MIN_MATCH) {
+                const size_t maxLen = total - pos < MAX_MATCH ? total - pos : MAX_MATCH;
+                int32_t cand = head[_hash(buf.data() + pos)];
+                size_t chain = MAX_CHAIN;
+                while (cand >= 0 && chain-- > 0) {
+                    size_t dist = pos - (size_t)cand;
+                    if (dist > window) break;
+                    const uint8_t* a = buf.data() + cand;
+                    const uint8_t* b = buf.data() + pos;
+                    if (a[bestLen] == b[bestLen]) {
+                        size_t l = 0;
+                        while (l < maxLen && a[l] == b[l]) l++;
+                        if (l > bestLen) {
+                            bestLen = l;
+                            bestDist = dist;
+                            if (l == maxLen) break;
+                        }
+                    }
+                    uint16_t delta = prev[(size_t)cand & (window - 1)];
+                    if (delta == 0) break;
+                    cand -= delta;
+                }
+            }
+
+            if (bestLen >= MIN_MATCH) {
+                _putLength(w, bestLen);
+                _putDistance(w, bestDist);
+                for (size_t i = 0; i < bestLen; i++, pos++) {
+                    if (pos + 2 < total) _insert(buf.data(), pos, head, prev, window);
+                }
+            } else {
+                _putSymbol(w, buf[pos]);
+                if (pos + 2 < total) _insert(buf.data(), pos, head, prev, window);
+                pos++;
+            }
+        }
+
+        _putSymbol(w, 256);  // End of block
+        // Sync flush: empty stored block, byte-aligned. Its LEN/NLEN
+        // (00 00 FF FF) is left off, as RFC 7692 section 7.2.1 requires
+        w.put(0, 1);
+        w.put(0, 2);
+        w.align();
+
+        if (out.length() >= len) {
+            out = String();
+            return false;
+        }
+
+        if (_contextTakeover) {
+            size_t keep = total < window ? total : window;
+            String next;
+            next.reserve(keep);
+            next.concat((const char*)buf.data() + total - keep, (unsigned)keep);
+            _history = next;
+        }
+        return true;
+    }
+
+#ifdef MCPD_TEST
+public:  // Allow test access to internals
+#else
+private:
+#endif
+    static constexpr size_t MIN_MATCH = 3;
+    static constexpr size_t MAX_MATCH = 258;
+    static constexpr size_t HASH_BITS = 9;
+    static constexpr size_t HASH_SIZE = (size_t)1 << HASH_BITS;
+
+    uint8_t _windowBits = DEFAULT_WINDOW_BITS;
+    bool _contextTakeover = true;
+    String _history;   // Last 2^windowBits bytes sent compressed
+
+    struct _BitWriter {
+        String& out;
+        uint32_t bits = 0;
+        uint8_t count = 0;
+
+        void put(uint32_t value, uint8_t n) {
+            bits |= value << count;
+            count += n;
+            while (count >= 8) {
+                out += (char)(bits & 0xFF);
+                bits >>= 8;
+                count -= 8;
+            }
+        }
+        void align() {
+            if (count > 0) out += (char)(bits & 0xFF);
+            bits = 0;
+            count = 0;
+        }
+    };
+
+    static size_t _hash(const uint8_t* p) {
+        return (((size_t)p[0] << 10) ^ ((size_t)p[1] << 5) ^ p[2]) & (HASH_SIZE - 1);
+    }
+
+    static void _insert(const uint8_t* buf, size_t pos, std::vector<int32_t>& head,
+                        std::vector<uint16_t>& prev, size_t window) {
+        size_t h = _hash(buf + pos);
+        int32_t last = head[h];
+        size_t delta = last >= 0 ? pos - (size_t)last : 0;
+        prev[pos & (window - 1)] = delta <= window ? (uint16_t)delta : 0;
+        head[h] = (int32_t)pos;
+    }
+
+    // Huffman codes are packed starting with their most significant bit
+    static uint32_t _reverse(uint32_t code, uint8_t len) {
+        uint32_t r = 0;
+        for (uint8_t i = 0; i < len; i++) {
+            r = (r << 1) | (code & 1);
+            code >>= 1;
+        }
+        return r;
+    }
+
+    // Fixed literal/length code (RFC 1951 section 3.2.6)
+    static void _putSymbol(_BitWriter& w, uint16_t sym) {
+        if (sym < 144)      w.put(_reverse(0x30 + sym, 8), 8);
+        else if (sym < 256) w.put(_reverse(0x190 + sym - 144, 9), 9);
+        else if (sym < 280) w.put(_reverse(sym - 256, 7), 7);
+        else                w.put(_reverse(0xC0 + sym - 280, 8), 8);
+    }
+
+    static void _putLength(_BitWriter& w, size_t len) {
+        using namespace deflate_tables;
+        int code = 28;
+        while (LEN_BASE[code] > len) code--;
+        _putSymbol(w, (uint16_t)(257 + code));
+        if (LEN_EXTRA[code]) w.put((uint32_t)(len - LEN_BASE[code]), LEN_EXTRA[code]);
+    }
+
+    static void _putDistance(_BitWriter& w, size_t dist) {
+        using namespace deflate_tables;
+        int code = 29;
+        while (DIST_BASE[code] > dist) code--;
+        w.put(_reverse((uint32_t)code, 5), 5);
+        if (DIST_EXTRA[code]) w.put((uint32_t)(dist - DIST_BASE[code]), DIST_EXTRA[code]);
+    }
+};
+
+/**
+ * Inflates permessage-deflate payloads sent without context takeover.
+ */
+class DeflateDecoder {
+public:
+    /**
+     * Inflate one message payload (the 00 00 FF FF tail is implied).
+     * @param maxOutput  fail once the message would inflate past this
+     * @return false on malformed data or when maxOutput is exceeded
+     */
+    bool inflate(const uint8_t* data, size_t len, String& out, size_t maxOutput) {
+        out = String();
+        _in.assign(data, data + len);
+        static const uint8_t TAIL[4] = {0x00, 0x00, 0xFF, 0xFF};
+        _in.insert(_in.end(), TAIL, TAIL + 4);
+        _pos = 0;
+        _bitBuf = 0;
+        _bitCount = 0;
+        _error = false;
+        _overflow = false;
+        _out = &out;
+        _maxOutput = maxOutput;
+
+        bool last = false;
+        while (!last) {
+            if (_pos >= _in.size() && _bitCount == 0) break;  // After the sync flush
+            last = _bits(1) != 0;
+            int type = _bits(2);
+            if (_error) return false;
+            bool ok;
+            switch (type) {
+                case 0: ok = _stored(); break;
+                case 1: ok = _fixed(); break;
+                case 2: ok = _dynamic(); break;
+                default: ok = false; break;
+            }
+            if (!ok || _error) return false;
+        }
+        _in.clear();
+        return true;
+    }
+
+    /** The last inflate() failed because the output passed maxOutput */
+    bool overflowed() const { return _overflow; }
+
+#ifdef MCPD_TEST
+public:  // Allow test access to internals
+#else
+private:
+#endif
+    static constexpr int MAX_BITS = 15;
+
+    struct _Huffman {
+        uint16_t count[MAX_BITS + 1];
+        uint16_t symbol[288];
+    };
+
+    std::vector<uint8_t> _in;
+    size_t _pos = 0;
+    uint32_t _bitBuf = 0;
+    int _bitCount = 0;
+    bool _error = false;
+    bool _overflow = false;
+    String* _out = nullptr;
+    size_t _maxOutput = 0;
+
+    int _bits(int need) {
+        while (_bitCount < need) {
+            if (_pos >= _in.size()) {
+                _error = true;
+                return 0;
+            }
+            _bitBuf |= (uint32_t)_in[_pos++] << _bitCount;
+            _bitCount += 8;
+        }
+        int value = (int)(_bitBuf & ((1u << need) - 1));
+        _bitBuf >>= need;
+        _bitCount -= need;
+        return value;
+    }
+
+    bool _overflowed() {
+        _overflow = true;
+        return false;
+    }
+
+    bool _emit(char c) {
+        if (_out->length() >= _maxOutput) return _overflowed();
+        *_out += c;
+        return true;
+    }
+
+    bool _stored() {
+        _bitBuf = 0;
+        _bitCount = 0;
+        if (_pos + 4 > _in.size()) return false;
+        size_t len = _in[_pos] | ((size_t)_in[_pos + 1] << 8);
+        size_t nlen = _in[_pos + 2] | ((size_t)_in[_pos + 3] << 8);
+        _pos += 4;
+        if (len != (~nlen & 0xFFFF) || _pos + len > _in.size()) return false;
+        if (_out->length() + len > _maxOutput) return _overflowed();
+        _out->concat((const char*)_in.data() + _pos, (unsigned)len);
+        _pos += len;
+        return true;
+    }
+
+    // Canonical code from code lengths; incomplete codes are allowed
+    static bool _build(_Huffman& h, const uint8_t* lengths, int n) {
+        memset(h.count, 0, sizeof(h.count));
+        for (int s = 0; s < n; s++) h.count[lengths[s]]++;
+        int left = 1;
+        for (int len = 1; len <= MAX_BITS; len++) {
+            left <<= 1;
+            left -= h.count[len];
+            if (left < 0) return false;  // Over-subscribed
+        }
+        uint16_t offs[MAX_BITS + 1];
+        offs[1] = 0;
+        for (int len = 1; len < MAX_BITS; len++) offs[len + 1] = offs[len] + h.count[len];
+        for (int s = 0; s < n; s++) {
+            if (lengths[s]) h.symbol[offs[lengths[s]]++] = (uint16_t)s;
+        }
+        return true;
+    }
+
+    int _decode(const _Huffman& h) {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= MAX_BITS; len++) {
+            code |= _bits(1);
+            if (_error) return -1;
+            int count = h.count[len];
+            if (code - count < first) return h.symbol[index + (code - first)];
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    bool _codes(const _Huffman& lencode, const _Huffman& distcode) {
+        using namespace deflate_tables;
+        for (;;) {
+            int sym = _decode(lencode);
+            if (sym < 0) return false;
+            if (sym < 256) {
+                if (!_emit((char)sym)) return false;
+            } else if (sym == 256) {
+                return true;
+            } else {
+                sym -= 257;
+                if (sym >= 29) return false;
+                size_t len = LEN_BASE[sym] + _bits(LEN_EXTRA[sym]);
+                int dsym = _decode(distcode);
+                if (dsym < 0 || dsym >= 30) return false;
+                size_t dist = DIST_BASE[dsym] + _bits(DIST_EXTRA[dsym]);
+                if (_error || dist > _out->length()) return false;
+                if (_out->length() + len > _maxOutput) return _overflowed();
+                // Byte by byte: the copy may overlap what it produces
+                for (size_t i = 0; i < len; i++) {
+                    *_out += (*_out)[_out->length() - dist];
+                }
+            }
+        }
+    }
+
+    bool _fixed() {
+        _Huffman lencode, distcode;
+        uint8_t lengths[288];
+        int s = 0;
+        for (; s < 144; s++) lengths[s] = 8;
+        for (; s < 256; s++) lengths[s] = 9;
+        for (; s < 280; s++) lengths[s] = 7;
+        for (; s < 288; s++) lengths[s] = 8;
+        _build(lencode, lengths, 288);
+        for (s = 0; s < 30; s++) lengths[s] = 5;
+        _build(distcode, lengths, 30);
+        return _codes(lencode, distcode);
+    }
+
+    bool _dynamic() {
+        static const uint8_t ORDER[19] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        int nlen = _bits(5) + 257;
+        int ndist = _bits(5) + 1;
+        int ncode = _bits(4) + 4;
+        if (_error || nlen > 286 || ndist > 30) return false;
+
+        uint8_t lengths[286 + 30];
+        int i = 0;
+        for (; i < ncode; i++) lengths[ORDER[i]] = (uint8_t)_bits(3);
+        for (; i < 19; i++) lengths[ORDER[i]] = 0;
+        _Huffman lencode, distcode;
+        if (_error || !_build(lencode, lengths, 19)) return false;
+
+        i = 0;
+        while (i < nlen + ndist) {
+            int sym = _decode(lencode);
+            if (sym < 0) return false;
+            if (sym < 16) {
+                lengths[i++] = (uint8_t)sym;
+                continue;
+            }
+            uint8_t len = 0;
+            int repeat;
+            if (sym == 16) {
+                if (i == 0) return false;
+                len = lengths[i - 1];
+                repeat = 3 + _bits(2);
+            } else if (sym == 17) {
+                repeat = 3 + _bits(3);
+            } else {
+                repeat = 11 + _bits(7);
+            }
+            if (_error || i + repeat > nlen + ndist) return false;
+            while (repeat-- > 0) lengths[i++] = len;
+        }
+        if (lengths[256] == 0) return false;  // No end-of-block code
+
+        if (!_build(lencode, lengths, nlen)) return false;
+        if (!_build(distcode, lengths + nlen, ndist)) return false;
+        return _codes(lencode, distcode);
+    }
+};
+
+} // namespace mcpd
+
+#endif // MCPD_DEFLATE_H
@@ -17,6 +17,15 @@
  *   auto recent = events.since(millis() - 60000);  // last 60s
  *   auto temps  = events.byTag("temperature");
  *   String json = events.toJSON();                  // all events as JSON array
+ *
+ * The vector-returning queries copy every match. For polling, use a cursor
+ * instead: filters are applied lazily while walking the ring, and the JSON
+ * writer streams straight to any writer with write(const uint8_t*, size_t)
+ * (a ResponseWriter, a WiFiClient, Serial):
+ *
+ *   events.select().sinceSeq(lastSeen).tag("gpio").limit(20).writeJSON(writer);
+ *   events.select().minSeverity(EventSeverity::Error).forEach(
+ *       [](const Event& e) { Serial.println(e.data); return true; });
  */
 
 #ifndef MCPD_EVENT_STORE_H
@@ -30,6 +39,10 @@
 
 #include <vector>
 #include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 namespace mcpd {
 
@@ -62,10 +75,122 @@ inline EventSeverity severityFromString(const char* s) {
     return EventSeverity::Info;
 }
 
+/**
+ * Interned event tag: a 1-byte id into a process-wide, reference-counted
+ * table. Every EventStore shares the table, so a copied Event keeps its
+ * tag readable after the store has moved on. Id 0 is the empty tag; once
+ * MAX_TAGS distinct tags are in use, new ones are stored as empty.
+ */
+class EventTag {
+public:
+    static constexpr size_t MAX_TAGS = 255;
+
+    EventTag() : _id(0) {}
+    EventTag(const char* text) : _id(_intern(text)) {}
+    EventTag(const String& text) : _id(_intern(text.c_str())) {}
+    EventTag(const EventTag& other) : _id(other._id) { _retain(_id); }
+    EventTag& operator=(const EventTag& other) {
+        _retain(other._id);
+        _release(_id);
+        _id = other._id;
+        return *this;
+    }
+    ~EventTag() { _release(_id); }
+
+    uint8_t id() const { return _id; }
+    const char* c_str() const { return _id ? _table()[_id].text : ""; }
+    size_t length() const { return strlen(c_str()); }
+    bool isEmpty() const { return _id == 0; }
+    operator String() const { return String(c_str()); }
+
+    bool operator==(const EventTag& other) const { return _id == other._id; }
+    bool operator==(const char* other) const { return strcmp(c_str(), other ? other : "") == 0; }
+    bool operator==(const String& other) const { return strcmp(c_str(), other.c_str()) == 0; }
+    bool operator!=(const EventTag& other) const { return _id != other._id; }
+    bool operator!=(const char* other) const { return !(*this == other); }
+    bool operator!=(const String& other) const { return !(*this == other); }
+
+    /**
+     * Id of an interned tag, without interning it.
+     * @return -1 if no live tag has this text
+     */
+    static int find(const char* text) {
+        if (!text || !*text) return 0;
+        auto& t = _table();
+        for (size_t i = 1; i < t.size(); i++) {
+            if (t[i].refs && strcmp(t[i].text, text) == 0) return (int)i;
+        }
+        return -1;
+    }
+
+    /** Distinct non-empty tags currently interned. */
+    static size_t internedCount() {
+        size_t n = 0;
+        for (auto& e : _table()) n += e.refs ? 1 : 0;
+        return n;
+    }
+
+    /** Tags stored as empty because the table was full. */
+    static uint32_t& overflows() {
+        static uint32_t n = 0;
+        return n;
+    }
+
+private:
+    struct Entry {
+        char* text;      // Heap copy; stays put when the table grows
+        uint32_t refs;
+    };
+
+    uint8_t _id;
+
+    // Never destroyed, so stores with static storage can release their
+    // tags at exit
+    static std::vector<Entry>& _table() {
+        static std::vector<Entry>* t = new std::vector<Entry>(1, Entry{nullptr, 0});
+        return *t;
+    }
+
+    static uint8_t _intern(const char* text) {
+        int id = find(text);
+        if (id < 0) {
+            auto& t = _table();
+            size_t slot = 1;
+            while (slot < t.size() && t[slot].refs) slot++;
+            if (slot > MAX_TAGS - 1) {
+                overflows()++;
+                return 0;
+            }
+            size_t len = strlen(text);
+            char* copy = (char*)malloc(len + 1);
+            if (!copy) return 0;
+            memcpy(copy, text, len + 1);
+            if (slot == t.size()) t.push_back(Entry{copy, 0});
+            else t[slot].text = copy;
+            id = (int)slot;
+        }
+        _retain((uint8_t)id);
+        return (uint8_t)id;
+    }
+
+    static void _retain(uint8_t id) {
+        if (id) _table()[id].refs++;
+    }
+
+    static void _release(uint8_t id) {
+        if (!id) return;
+        Entry& e = _table()[id];
+        if (--e.refs == 0) {
+            free(e.text);
+            e.text = nullptr;
+        }
+    }
+};
+
 struct Event {
     uint32_t seq;              ///< Monotonic sequence number
     unsigned long timestampMs; ///< millis() when emitted
-    String tag;                ///< Category/type tag (e.g. "temperature", "gpio")
+    EventTag tag;              ///< Category/type tag (e.g. "temperature", "gpio")
     String data;               ///< Payload (typically JSON)
     EventSeverity severity;    ///< Severity level
 };
@@ -78,13 +203,18 @@ using EventListener = std::function<void(const Event&)>;
 
 class EventStore {
 public:
+    static constexpr size_t MAX_CAPACITY = 65534;   // Ring links are 16-bit
+
     /**
      * @param capacity Maximum number of events to retain (ring buffer size).
      *                 Must be >= 1; clamped to 1 if 0.
      */
     explicit EventStore(size_t capacity = 64)
-        : _capacity(capacity < 1 ? 1 : capacity), _seq(0), _count(0), _head(0) {
+        : _capacity(capacity < 1 ? 1 : (capacity > MAX_CAPACITY ? MAX_CAPACITY : capacity)),
+          _seq(0), _count(0), _head(0) {
         _events.resize(_capacity);
+        _nextSameTag.assign(_capacity, NO_SLOT);
+        for (auto& bits : _severityBits) bits.assign((_capacity + 31) / 32, 0);
     }
 
     /**
@@ -98,9 +228,16 @@ public:
                   EventSeverity severity = EventSeverity::Info) {
         uint32_t s = _seq++;
         size_t idx = _head;
-        _events[idx] = Event{s, millis(), tag, data, severity};
+        if (_count == _capacity) _unlinkOldest();
+        Event& e = _events[idx];
+        e.seq = s;
+        e.timestampMs = millis();
+        e.tag = EventTag(tag);
+        e.data = data;
+        e.severity = severity;
+        _link(idx);
         _head = (_head + 1) % _capacity;
-        if (_count < _capacity) _count++;
+        _count++;
 
         // Notify listeners
         for (auto& listener : _listeners) {
@@ -110,52 +247,257 @@ public:
         return s;
     }
 
+    /**
+     * Lazy, allocation-free query over the ring. Filters are set fluently
+     * and combined; forEach(), count() and writeJSON() each walk the ring
+     * from the start, and next()/event() step through it.
+     *
+     * A tag filter follows that tag's chain through the ring, and a
+     * severity filter scans the severity bitmaps a word at a time, so
+     * neither touches events that cannot match.
+     *
+     * A cursor reads the store in place: it is valid until the next emit()
+     * or clear().
+     */
+    class Cursor {
+    public:
+        /** Only events with this tag. */
+        Cursor& tag(const char* tag) {
+            _tagId = EventTag::find(tag);
+            _tagFilter = true;
+            return _reset();
+        }
+        Cursor& tag(const String& tag) { return this->tag(tag.c_str()); }
+
+        /** Only events with severity >= minSeverity. */
+        Cursor& minSeverity(EventSeverity minSeverity) {
+            _minSeverity = static_cast<uint8_t>(minSeverity);
+            return _reset();
+        }
+
+        /** Only events emitted at or after this millis() timestamp. */
+        Cursor& since(unsigned long sinceMs) {
+            _sinceMs = sinceMs;
+            return _reset();
+        }
+
+        /** Only events with sequence number >= sinceSeq (seeks directly). */
+        Cursor& sinceSeq(uint32_t sinceSeq) {
+            _sinceSeq = sinceSeq;
+            return _reset();
+        }
+
+        /** Only the newest n stored events (before the other filters). */
+        Cursor& last(size_t n) {
+            _last = n;
+            return _reset();
+        }
+
+        /** Skip the first n matches. */
+        Cursor& offset(size_t n) {
+            _offset = n;
+            return _reset();
+        }
+
+        /** Stop after n matches. */
+        Cursor& limit(size_t n) {
+            _limit = n;
+            return _reset();
+        }
+
+        /**
+         * Call fn(const Event&) for each match, oldest first. fn returns
+         * false to stop early.
+         * @return Number of events visited
+         */
+        template <typename Fn>
+        size_t forEach(Fn fn) const {
+            Cursor c = *this;
+            c._reset();
+            while (c.next()) {
+                if (!fn(c.event())) break;
+            }
+            return c._visited;
+        }
+
+        /** Number of matches (after offset, up to limit). */
+        size_t count() const {
+            return forEach([](const Event&) { return true; });
+        }
+
+        /**
+         * Advance to the next match.
+         * @return false once there are no more
+         */
+        bool next() {
+            size_t count = _store->_count;
+            while (_visited < _limit) {
+                size_t pos = _advance();
+                if (pos >= count) break;
+                const Event& e = _store->_at(pos);
+                if (!_matches(e)) continue;
+                if (_skipped < _offset) {
+                    _skipped++;
+                    continue;
+                }
+                _visited++;
+                return true;
+            }
+            _pos = count;
+            _done = true;
+            return false;
+        }
+
+        /** The event next() stopped at. */
+        const Event& event() const { return _store->_at(_pos); }
+        const Event* operator->() const { return &event(); }
+
+        /** Start next() over from the first match. */
+        Cursor& rewind() { return _reset(); }
+
+        /**
+         * Serialize the matches as a JSON array (same format as toJSON())
+         * straight to out.write(const uint8_t*, size_t).
+         * @return Bytes written
+         */
+        template <typename Writer>
+        size_t writeJSON(Writer& out) const {
+            size_t bytes = 0;
+            auto put = [&out, &bytes](const char* s, size_t len) {
+                out.write(reinterpret_cast<const uint8_t*>(s), len);
+                bytes += len;
+            };
+            put("[", 1);
+            bool first = true;
+            forEach([&](const Event& e) {
+                if (!first) put(",", 1);
+                first = false;
+                _writeEvent(put, e);
+                return true;
+            });
+            put("]", 1);
+            return bytes;
+        }
+
+    private:
+        friend class EventStore;
+        explicit Cursor(const EventStore* store) : _store(store) {}
+
+        const EventStore* _store;
+        bool _tagFilter = false;
+        int _tagId = -1;         // -1: tag not interned, nothing matches
+        uint8_t _minSeverity = 0;
+        unsigned long _sinceMs = 0;
+        uint32_t _sinceSeq = 0;
+        size_t _last = SIZE_MAX;
+        size_t _offset = 0;
+        size_t _limit = SIZE_MAX;
+
+        // next() state
+        size_t _pos = 0;         // Ring position (0 = oldest)
+        size_t _slot = NO_SLOT;  // Ring index of _pos while following a tag chain
+        size_t _skipped = 0;
+        size_t _visited = 0;
+        bool _started = false;
+        bool _done = false;
+
+        Cursor& _reset() {
+            _pos = _skipped = _visited = 0;
+            _slot = NO_SLOT;
+            _started = _done = false;
+            return *this;
+        }
+
+        // Next candidate position, or the event count when exhausted
+        size_t _advance() {
+            const EventStore& st = *_store;
+            if (_done) return st._count;
+            size_t first = _first();
+            if (_tagFilter) {
+                if (_tagId < 0) return st._count;
+                if (!_started) {
+                    const TagChain* chain = st._chain((uint8_t)_tagId);
+                    _slot = chain ? chain->oldest : NO_SLOT;
+                } else {
+                    _slot = st._nextSameTag[_slot];
+                }
+                _started = true;
+                for (; _slot != NO_SLOT; _slot = st._nextSameTag[_slot]) {
+                    _pos = st._position(_slot);
+                    if (_pos >= first) return _pos;
+                }
+                return st._count;
+            }
+            size_t pos = _started ? _pos + 1 : first;
+            _started = true;
+            if (pos < first) pos = first;
+            _pos = _minSeverity > 0 ? st._nextWithSeverity(pos, _minSeverity) : pos;
+            return _pos;
+        }
+
+        // Ring position (0 = oldest) of the first candidate. Sequence
+        // numbers are contiguous in the ring, so sinceSeq is a seek.
+        size_t _first() const {
+            size_t count = _store->_count;
+            size_t first = _last < count ? count - _last : 0;
+            uint32_t oldest = _store->_seq - (uint32_t)count;
+            if (_sinceSeq > oldest) {
+                size_t bySeq = _sinceSeq - oldest;
+                if (bySeq > first) first = bySeq < count ? bySeq : count;
+            }
+            return first;
+        }
+
+        bool _matches(const Event& e) const {
+            if (static_cast<uint8_t>(e.severity) < _minSeverity) return false;
+            if (_sinceMs > 0 && e.timestampMs < _sinceMs) return false;
+            return true;
+        }
+    };
+
+    /** Start a cursor over all stored events. */
+    Cursor select() const { return Cursor(this); }
+
     /**
      * Get all stored events (oldest first).
      */
     std::vector<Event> all() const {
-        return _collect([](const Event&) { return true; });
+        return _collect(select());
     }
 
     /**
      * Get events matching a specific tag.
      */
     std::vector<Event> byTag(const String& tag) const {
-        return _collect([&tag](const Event& e) { return e.tag == tag; });
+        return _collect(select().tag(tag));
     }
 
     /**
      * Get events with severity >= minSeverity.
      */
     std::vector<Event> bySeverity(EventSeverity minSeverity) const {
-        return _collect([minSeverity](const Event& e) {
-            return static_cast<uint8_t>(e.severity) >= static_cast<uint8_t>(minSeverity);
-        });
+        return _collect(select().minSeverity(minSeverity));
     }
 
     /**
      * Get events emitted since a given millis() timestamp.
      */
     std::vector<Event> since(unsigned long sinceMs) const {
-        return _collect([sinceMs](const Event& e) { return e.timestampMs >= sinceMs; });
+        return _collect(select().since(sinceMs));
     }
 
     /**
      * Get events with sequence number >= sinceSeq.
      */
     std::vector<Event> sinceSeq(uint32_t sinceSeq) const {
-        return _collect([sinceSeq](const Event& e) { return e.seq >= sinceSeq; });
+        return _collect(select().sinceSeq(sinceSeq));
     }
 
     /**
      * Get the last N events (oldest first).
      */
     std::vector<Event> last(size_t n) const {
-        auto result = all();
-        if (result.size() > n) {
-            result.erase(result.begin(), result.begin() + (result.size() - n));
-        }
-        return result;
+        return _collect(select().last(n));
     }
 
     /**
@@ -164,41 +506,60 @@ public:
     std::vector<Event> query(const String& tag = "",
                              EventSeverity minSeverity = EventSeverity::Debug,
                              unsigned long sinceMs = 0) const {
-        return _collect([&](const Event& e) {
-            if (tag.length() > 0 && e.tag != tag) return false;
-            if (static_cast<uint8_t>(e.severity) < static_cast<uint8_t>(minSeverity)) return false;
-            if (sinceMs > 0 && e.timestampMs < sinceMs) return false;
-            return true;
-        });
+        Cursor c = select().minSeverity(minSeverity).since(sinceMs);
+        if (tag.length() > 0) c.tag(tag);
+        return _collect(c);
     }
 
     /**
      * Serialize all stored events to a JSON array string.
      */
     String toJSON() const {
-        return _toJSON(all());
+        return toJSON(select());
     }
 
     /**
      * Serialize a filtered set to JSON.
      */
     String toJSON(const std::vector<Event>& events) const {
-        return _toJSON(events);
+        String json;
+        StringWriter out{json};
+        auto put = [&out](const char* s, size_t len) {
+            out.write(reinterpret_cast<const uint8_t*>(s), len);
+        };
+        put("[", 1);
+        for (size_t i = 0; i < events.size(); i++) {
+            if (i > 0) put(",", 1);
+            _writeEvent(put, events[i]);
+        }
+        put("]", 1);
+        return json;
+    }
+
+    /**
+     * Serialize a cursor's matches to JSON without copying events.
+     */
+    String toJSON(const Cursor& cursor) const {
+        String json;
+        StringWriter out{json};
+        cursor.writeJSON(out);
+        return json;
     }
 
     /**
      * Get distinct tags currently in the store.
      */
     std::vector<String> tags() const {
-        std::vector<String> result;
-        auto events = all();
-        for (auto& e : events) {
-            bool found = false;
-            for (auto& t : result) {
-                if (t == e.tag) { found = true; break; }
-            }
-            if (!found) result.push_back(e.tag);
+        // The chain list is small; order it by each tag's oldest event
+        std::vector<const TagChain*> chains;
+        for (auto& c : _chains) {
+            size_t pos = _position(c.oldest);
+            auto at = chains.begin();
+            while (at != chains.end() && _position((*at)->oldest) < pos) ++at;
+            chains.insert(at, &c);
         }
+        std::vector<String> result;
+        for (const TagChain* c : chains) result.push_back(_events[c->oldest].tag);
         return result;
     }
 
@@ -225,7 +586,11 @@ public:
         _seq = 0;
         for (size_t i = 0; i < _capacity; i++) {
             _events[i] = Event{};
+            _nextSameTag[i] = NO_SLOT;
         }
+        _chains.clear();
+        for (auto& bits : _severityBits) std::fill(bits.begin(), bits.end(), 0);
+        for (auto& n : _severityCounts) n = 0;
     }
 
     /** Number of events currently stored. */
@@ -256,12 +621,7 @@ public:
         s += String(_seq > _capacity ? _seq - _capacity : 0);
 
         // Count per severity
-        size_t counts[5] = {0, 0, 0, 0, 0};
-        auto events = all();
-        for (auto& e : events) {
-            uint8_t idx = static_cast<uint8_t>(e.severity);
-            if (idx < 5) counts[idx]++;
-        }
+        const size_t* counts = _severityCounts;
         s += ",\"bySeverity\":{";
         s += "\"debug\":" + String(counts[0]);
         s += ",\"info\":" + String(counts[1]);
@@ -280,48 +640,155 @@ private:
     std::vector<Event> _events;
     std::vector<EventListener> _listeners;
 
-    /** Collect events matching a predicate, oldest first. */
-    std::vector<Event> _collect(std::function<bool(const Event&)> pred) const {
-        std::vector<Event> result;
-        if (_count == 0) return result;
+    static constexpr size_t SEVERITIES = 5;
+    static constexpr uint16_t NO_SLOT = 0xFFFF;
+
+    // Per-tag list through the ring, oldest to newest
+    struct TagChain {
+        uint8_t id;
+        uint16_t oldest;
+        uint16_t newest;
+        uint16_t count;
+    };
+
+    std::vector<TagChain> _chains;            // One per tag in the ring
+    std::vector<uint16_t> _nextSameTag;       // Ring index -> next newer event with its tag
+    std::vector<uint32_t> _severityBits[SEVERITIES];  // Ring index bitmap per severity
+    size_t _severityCounts[SEVERITIES] = {0, 0, 0, 0, 0};
+
+    static uint8_t _severityIndex(EventSeverity s) {
+        uint8_t i = static_cast<uint8_t>(s);
+        return i < SEVERITIES ? i : SEVERITIES - 1;
+    }
 
-        // Start from oldest event
+    /** Ring position (0 = oldest) of ring index idx. */
+    size_t _position(size_t idx) const {
         size_t start = (_count < _capacity) ? 0 : _head;
-        for (size_t i = 0; i < _count; i++) {
-            size_t idx = (start + i) % _capacity;
-            if (pred(_events[idx])) {
-                result.push_back(_events[idx]);
-            }
+        return (idx + _capacity - start) % _capacity;
+    }
+
+    const TagChain* _chain(uint8_t id) const {
+        for (auto& c : _chains) {
+            if (c.id == id) return &c;
         }
-        return result;
+        return nullptr;
     }
 
-    static String _toJSON(const std::vector<Event>& events) {
-        String json = "[";
-        for (size_t i = 0; i < events.size(); i++) {
-            if (i > 0) json += ",";
-            json += "{\"seq\":";
-            json += String(events[i].seq);
-            json += ",\"ts\":";
-            json += String(events[i].timestampMs);
-            json += ",\"tag\":\"";
-            json += events[i].tag;
-            json += "\",\"severity\":\"";
-            json += severityToString(events[i].severity);
-            json += "\",\"data\":";
-            // If data looks like JSON object/array, include raw; otherwise quote it
-            if (events[i].data.length() > 0 &&
-                (events[i].data[0] == '{' || events[i].data[0] == '[')) {
-                json += events[i].data;
+    TagChain* _chain(uint8_t id) {
+        return const_cast<TagChain*>(static_cast<const EventStore*>(this)->_chain(id));
+    }
+
+    // Add the event at idx to its tag chain and severity bitmap
+    void _link(size_t idx) {
+        const Event& e = _events[idx];
+        _nextSameTag[idx] = NO_SLOT;
+        TagChain* c = _chain(e.tag.id());
+        if (c) {
+            _nextSameTag[c->newest] = (uint16_t)idx;
+            c->newest = (uint16_t)idx;
+            c->count++;
+        } else {
+            _chains.push_back(TagChain{e.tag.id(), (uint16_t)idx, (uint16_t)idx, 1});
+        }
+        uint8_t sev = _severityIndex(e.severity);
+        _severityBits[sev][idx / 32] |= 1u << (idx % 32);
+        _severityCounts[sev]++;
+    }
+
+    // Drop the oldest event (at _head, the ring being full) from the indexes
+    void _unlinkOldest() {
+        size_t idx = _head;
+        const Event& e = _events[idx];
+        for (size_t i = 0; i < _chains.size(); i++) {
+            TagChain& c = _chains[i];
+            if (c.id != e.tag.id()) continue;
+            if (--c.count == 0) {
+                _chains.erase(_chains.begin() + i);
             } else {
-                json += "\"";
-                json += events[i].data;
-                json += "\"";
+                c.oldest = _nextSameTag[idx];
             }
-            json += "}";
+            break;
         }
-        json += "]";
-        return json;
+        uint8_t sev = _severityIndex(e.severity);
+        _severityBits[sev][idx / 32] &= ~(1u << (idx % 32));
+        _severityCounts[sev]--;
+        _count--;
+    }
+
+    // First position >= pos whose event has severity >= minSeverity, or
+    // _count. Skips 32 slots at a time where no bit is set.
+    size_t _nextWithSeverity(size_t pos, uint8_t minSeverity) const {
+        size_t start = (_count < _capacity) ? 0 : _head;
+        while (pos < _count) {
+            size_t idx = (start + pos) % _capacity;
+            size_t word = idx / 32;
+            uint32_t bits = 0;
+            for (uint8_t s = minSeverity; s < SEVERITIES; s++) bits |= _severityBits[s][word];
+            bits >>= idx % 32;
+            if (bits & 1) return pos;
+            size_t skip = bits ? _lowestBit(bits) : 32 - idx % 32;
+            if (idx + skip > _capacity) skip = _capacity - idx;  // Wrap at the ring end
+            pos += skip;
+        }
+        return _count;
+    }
+
+    static size_t _lowestBit(uint32_t v) {
+        size_t n = 0;
+        while (!(v & 1)) {
+            v >>= 1;
+            n++;
+        }
+        return n;
+    }
+
+    /** Appends to a String; lets toJSON() share the streaming writer. */
+    struct StringWriter {
+        String& s;
+        size_t write(const uint8_t* data, size_t len) {
+            s.concat(reinterpret_cast<const char*>(data), len);
+            return len;
+        }
+    };
+
+    /** Event at ring position pos (0 = oldest). */
+    const Event& _at(size_t pos) const {
+        size_t start = (_count < _capacity) ? 0 : _head;
+        return _events[(start + pos) % _capacity];
+    }
+
+    /** Copy a cursor's matches, oldest first. */
+    std::vector<Event> _collect(const Cursor& cursor) const {
+        std::vector<Event> result;
+        cursor.forEach([&result](const Event& e) {
+            result.push_back(e);
+            return true;
+        });
+        return result;
+    }
+
+    template <typename Put>
+    static void _writeEvent(Put& put, const Event& e) {
+        auto text = [&put](const char* s) { put(s, strlen(s)); };
+        char num[24];
+        text("{\"seq\":");
+        put(num, snprintf(num, sizeof(num), "%lu", (unsigned long)e.seq));
+        text(",\"ts\":");
+        put(num, snprintf(num, sizeof(num), "%lu", e.timestampMs));
+        text(",\"tag\":\"");
+        put(e.tag.c_str(), e.tag.length());
+        text("\",\"severity\":\"");
+        text(severityToString(e.severity));
+        text("\",\"data\":");
+        // If data looks like JSON object/array, include raw; otherwise quote it
+        if (e.data.length() > 0 && (e.data[0] == '{' || e.data[0] == '[')) {
+            put(e.data.c_str(), e.data.length());
+        } else {
+            text("\"");
+            put(e.data.c_str(), e.data.length());
+            text("\"");
+        }
+        text("}");
     }
 };
 
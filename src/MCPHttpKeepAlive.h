@@ -0,0 +1,531 @@
+/**
+ * mcpd — HTTP/1.1 Keep-Alive for the Streamable HTTP transport
+ *
+ * The Arduino WebServer answers one request per connection and closes the
+ * socket, so every JSON-RPC call pays a TCP handshake (plus TLS, behind a
+ * proxy). With keep-alive enabled the server adopts the socket of a POST to
+ * the MCP endpoint, the same way SSE takes over the socket of a GET, and
+ * serves the requests that follow on it from loop().
+ *
+ * HttpConnection parses requests straight from the socket and offers the
+ * subset of the WebServer API the endpoint handlers use (header(), arg(),
+ * sendHeader(), send(), setContentLength(), sendContent()), so one handler
+ * serves both. Pipelined requests are answered in order; reading stops
+ * while a connection has more than MAX_PENDING_OUTPUT bytes unsent, so a
+ * client that never reads cannot grow the heap.
+ *
+ * HttpKeepAlive is the bounded pool: at most maxConnections sockets, each
+ * closed after idleTimeoutMs without a request or after maxRequests.
+ */
+
+#ifndef MCPD_HTTP_KEEPALIVE_H
+#define MCPD_HTTP_KEEPALIVE_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <WiFiClient.h>
+#include <vector>
+#include "MCPIOLoop.h"
+
+namespace mcpd {
+
+/**
+ * One persistent HTTP/1.1 connection.
+ */
+class HttpConnection {
+public:
+    static constexpr size_t MAX_REQUEST_BYTES = 8192;   // Headers + body
+    static constexpr size_t MAX_PENDING_OUTPUT = 2048;  // Stop reading above this
+
+    enum class Parse : uint8_t {
+        Incomplete,  // Wait for more bytes
+        Ready,       // A request is loaded
+        Invalid,     // Malformed; answer 400 and close
+        TooLarge,    // Over MAX_REQUEST_BYTES; answer 413 and close
+    };
+
+    HttpConnection() = default;
+    explicit HttpConnection(WiFiClient client) : _client(client), _lastActivity(millis()) {}
+
+    // ── WebServer API subset ───────────────────────────────────────────
+
+    WiFiClient client() { return _client; }
+    int method() const { return _method; }
+    const String& uri() const { return _path; }
+
+    String header(const char* name) const {
+        for (const auto& h : _headers) {
+            if (h.first.equalsIgnoreCase(name)) return h.second;
+        }
+        return String();
+    }
+
+    /** "plain" is the request body, anything else a query parameter. */
+    String arg(const char* name) const {
+        if (strcmp(name, "plain") == 0) return _body;
+        for (const auto& a : _args) {
+            if (a.first == name) return a.second;
+        }
+        return String();
+    }
+
+    void sendHeader(const char* name, const String& value) {
+        _responseHeaders += name;
+        _responseHeaders += ": ";
+        _responseHeaders += value;
+        _responseHeaders += "\r\n";
+    }
+
+    void setContentLength(size_t len) { _contentLength = len; }
+
+    void send(int code) { send(code, nullptr, String()); }
+
+    void send(int code, const char* contentType, const String& body) {
+        _chunked = _contentLength == CONTENT_LENGTH_UNKNOWN;
+        _writeHead(code, contentType, _chunked ? 0 : body.length());
+        if (_chunked) {
+            if (body.length() > 0) sendContent(body.c_str(), body.length());
+        } else {
+            _out += body;
+        }
+        _contentLength = 0;
+    }
+
+    /** A chunk of a chunked response; a zero-length chunk ends it. */
+    void sendContent(const char* data, size_t len) {
+        if (!_chunked) {
+            _out.concat(data, len);
+            return;
+        }
+        char size[12];
+        snprintf(size, sizeof(size), "%x\r\n", (unsigned)len);
+        _out += size;
+        _out.concat(data, len);
+        _out += "\r\n";
+        if (len == 0) _chunked = false;
+    }
+
+    void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+
+    // ── Requests ───────────────────────────────────────────────────────
+
+    /** Load a request the WebServer has already parsed (the adopting one). */
+    template <typename TServer>
+    void loadRequest(TServer& http, int method, const char* path) {
+        static const char* const kHeaders[] = {
+            "Mcp-Session-Id", "Accept", "Last-Event-ID", "Authorization", "X-API-Key",
+            "Connection",
+        };
+        _reset();
+        _method = method;
+        _path = path;
+        for (const char* name : kHeaders) {
+            String value = http.header(name);
+            if (!value.isEmpty()) _headers.emplace_back(name, value);
+        }
+        String key = http.arg("key");
+        if (!key.isEmpty()) _args.emplace_back("key", key);
+        _body = http.arg("plain");
+    }
+
+    /**
+     * Take the next complete request off the input buffer. Call again after
+     * Ready: pipelined requests are returned one at a time, in order.
+     */
+    Parse parse() {
+        int headEnd = _in.indexOf("\r\n\r\n");
+        if (headEnd < 0) {
+            return _in.length() > MAX_REQUEST_BYTES ? Parse::TooLarge : Parse::Incomplete;
+        }
+        const char* p = _in.c_str();
+        const char* end = p + headEnd + 2;  // Keep the CRLF of the last header
+
+        // Request line: METHOD SP target SP HTTP/1.x
+        const char* sp1 = strchr(p, ' ');
+        const char* eol = strstr(p, "\r\n");
+        const char* sp2 = sp1 ? strchr(sp1 + 1, ' ') : nullptr;
+        if (!sp1 || !sp2 || sp2 > eol || strncmp(sp2 + 1, "HTTP/1.", 7) != 0) {
+            return Parse::Invalid;
+        }
+
+        size_t contentLength = 0;
+        std::vector<std::pair<String, String>> headers;
+        for (const char* line = eol + 2; line < end;) {
+            const char* next = strstr(line, "\r\n");
+            const char* colon = (const char*)memchr(line, ':', next - line);
+            if (!colon || colon == line) return Parse::Invalid;
+            const char* v = colon + 1;
+            while (v < next && (*v == ' ' || *v == '\t')) v++;
+            const char* vEnd = next;
+            while (vEnd > v && (vEnd[-1] == ' ' || vEnd[-1] == '\t')) vEnd--;
+            headers.emplace_back(_str(line, colon), _str(v, vEnd));
+            if (headers.back().first.equalsIgnoreCase("Content-Length")) {
+                contentLength = strtoul(headers.back().second.c_str(), nullptr, 10);
+            } else if (headers.back().first.equalsIgnoreCase("Transfer-Encoding")) {
+                return Parse::Invalid;  // Chunked request bodies are not supported
+            }
+            line = next + 2;
+        }
+
+        size_t headLen = headEnd + 4;
+        if (headLen + contentLength > MAX_REQUEST_BYTES) return Parse::TooLarge;
+        if (_in.length() < headLen + contentLength) return Parse::Incomplete;
+
+        _reset();
+        _method = _methodOf(p, sp1 - p);
+        _http10 = sp2[8] == '0';
+        const char* query = (const char*)memchr(sp1 + 1, '?', sp2 - sp1 - 1);
+        _path = _str(sp1 + 1, query ? query : sp2);
+        if (query) _parseQuery(query + 1, sp2);
+        _headers = std::move(headers);
+        _body = _in.substring(headLen, headLen + contentLength);
+        _in.remove(0, headLen + contentLength);
+        return Parse::Ready;
+    }
+
+    /** The client asked to close after this request. */
+    bool wantsClose() const {
+        String connection = header("Connection");
+        if (_hasToken(connection, "close")) return true;
+        return _http10 && !_hasToken(connection, "keep-alive");
+    }
+
+    static bool isCloseRequested(const String& connectionHeader) {
+        return _hasToken(connectionHeader, "close");
+    }
+
+    // ── Socket I/O ─────────────────────────────────────────────────────
+
+    /** Read what the socket has into the input buffer. @return bytes read */
+    size_t receive() {
+        size_t total = 0;
+        uint8_t buf[256];
+        while (_in.length() <= MAX_REQUEST_BYTES) {
+            int avail = _client.available();
+            if (avail <= 0) break;
+            int n = _client.read(buf, avail < (int)sizeof(buf) ? avail : sizeof(buf));
+            if (n <= 0) break;
+            _in.concat((const char*)buf, n);
+            total += n;
+        }
+        return total;
+    }
+
+    /** Write as much pending output as the socket takes. @return true when empty */
+    bool flush() {
+        size_t left = _out.length() - _outPos;
+        if (left > 0) {
+            size_t n = _client.write((const uint8_t*)_out.c_str() + _outPos, left);
+            _outPos += n;
+            left -= n;
+        }
+        if (left == 0 && _outPos > 0) {
+            _out = String();
+            _outPos = 0;
+        }
+        return left == 0;
+    }
+
+    size_t pendingOutput() const { return _out.length() - _outPos; }
+    bool hasBufferedInput() const { return _in.length() > 0; }
+    bool isConnected() const { return !_released && _client.connected(); }
+    void stop() { if (!_released) _client.stop(); }
+
+    // ── Pool bookkeeping ───────────────────────────────────────────────
+
+    /** Sent with every response: "Connection: close" once set */
+    bool closing = false;
+    /** Keep-Alive header values for the responses */
+    unsigned long timeoutSec = 0;
+    uint16_t remaining = 0;
+    uint16_t served = 0;
+
+    unsigned long lastActivity() const { return _lastActivity; }
+    void touch(unsigned long now) { _lastActivity = now; }
+
+    int ioSlot = -1;  // IOPoller slot for the current pass
+
+#ifdef MCPD_TEST
+public:  // Allow test access to internals
+#else
+private:
+#endif
+    WiFiClient _client;
+    bool _released = false;  // Socket now owned by someone else (SSE)
+    unsigned long _lastActivity = 0;
+    String _in;
+    String _out;
+    size_t _outPos = 0;
+
+    // Current request
+    int _method = 0;
+    bool _http10 = false;
+    String _path;
+    String _body;
+    std::vector<std::pair<String, String>> _headers;
+    std::vector<std::pair<String, String>> _args;
+
+    // Current response
+    String _responseHeaders;
+    size_t _contentLength = 0;
+    bool _chunked = false;
+
+    void _reset() {
+        _method = 0;
+        _http10 = false;
+        _path = String();
+        _body = String();
+        _headers.clear();
+        _args.clear();
+    }
+
+    void _writeHead(int code, const char* contentType, size_t length) {
+        char line[80];
+        snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", code, _reason(code));
+        _out += line;
+        if (contentType) {
+            _out += "Content-Type: ";
+            _out += contentType;
+            _out += "\r\n";
+        }
+        if (_chunked) {
+            _out += "Transfer-Encoding: chunked\r\n";
+        } else {
+            snprintf(line, sizeof(line), "Content-Length: %u\r\n", (unsigned)length);
+            _out += line;
+        }
+        if (closing) {
+            _out += "Connection: close\r\n";
+        } else {
+            snprintf(line, sizeof(line), "Connection: keep-alive\r\nKeep-Alive: timeout=%lu, max=%u\r\n",
+                     timeoutSec, (unsigned)remaining);
+            _out += line;
+        }
+        _out += _responseHeaders;
+        _out += "\r\n";
+        _responseHeaders = String();
+    }
+
+    void _parseQuery(const char* p, const char* end) {
+        while (p < end) {
+            const char* amp = (const char*)memchr(p, '&', end - p);
+            if (!amp) amp = end;
+            const char* eq = (const char*)memchr(p, '=', amp - p);
+            if (eq) _args.emplace_back(_decode(p, eq), _decode(eq + 1, amp));
+            p = amp + 1;
+        }
+    }
+
+    static String _str(const char* begin, const char* end) {
+        String s;
+        s.concat(begin, end - begin);
+        return s;
+    }
+
+    static String _decode(const char* p, const char* end) {
+        String s;
+        for (; p < end; p++) {
+            if (*p == '+') {
+                s += ' ';
+            } else if (*p == '%' && end - p > 2 && isxdigit(p[1]) && isxdigit(p[2])) {
+                char hex[3] = {p[1], p[2], 0};
+                s += (char)strtoul(hex, nullptr, 16);
+                p += 2;
+            } else {
+                s += *p;
+            }
+        }
+        return s;
+    }
+
+    static int _methodOf(const char* m, size_t len) {
+        if (len == 4 && strncmp(m, "POST", 4) == 0) return HTTP_POST;
+        if (len == 3 && strncmp(m, "GET", 3) == 0) return HTTP_GET;
+        if (len == 6 && strncmp(m, "DELETE", 6) == 0) return HTTP_DELETE;
+        if (len == 7 && strncmp(m, "OPTIONS", 7) == 0) return HTTP_OPTIONS;
+        return 0;
+    }
+
+    /** Case-insensitive search for a comma-separated token */
+    static bool _hasToken(const String& value, const char* token) {
+        size_t n = strlen(token);
+        const char* p = value.c_str();
+        while (*p) {
+            while (*p == ' ' || *p == ',') p++;
+            const char* end = p;
+            while (*end && *end != ',') end++;
+            const char* tEnd = end;
+            while (tEnd > p && tEnd[-1] == ' ') tEnd--;
+            if ((size_t)(tEnd - p) == n && strncasecmp(p, token, n) == 0) return true;
+            p = end;
+        }
+        return false;
+    }
+
+    static const char* _reason(int code) {
+        switch (code) {
+            case 200: return "OK";
+            case 202: return "Accepted";
+            case 204: return "No Content";
+            case 400: return "Bad Request";
+            case 401: return "Unauthorized";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 413: return "Payload Too Large";
+            case 429: return "Too Many Requests";
+            case 503: return "Service Unavailable";
+            default:  return code < 400 ? "OK" : "Error";
+        }
+    }
+};
+
+/**
+ * Bounded pool of kept-alive connections.
+ */
+class HttpKeepAlive {
+public:
+    static constexpr size_t DEFAULT_MAX_CONNECTIONS = 2;
+    static constexpr unsigned long DEFAULT_IDLE_TIMEOUT_MS = 5000;
+    static constexpr uint16_t DEFAULT_MAX_REQUESTS = 100;
+
+    void setEnabled(bool enabled) {
+        _enabled = enabled;
+        if (!enabled) closeAll();
+    }
+    bool isEnabled() const { return _enabled; }
+
+    void setMaxConnections(size_t n) { _maxConnections = n; }
+    void setIdleTimeout(unsigned long ms) { _idleTimeoutMs = ms; }
+    /** Requests per connection before it is closed (spreads long-lived clients) */
+    void setMaxRequests(uint16_t n) { _maxRequests = n > 0 ? n : 1; }
+
+    size_t maxConnections() const { return _maxConnections; }
+    unsigned long idleTimeout() const { return _idleTimeoutMs; }
+    uint16_t maxRequests() const { return _maxRequests; }
+
+    /**
+     * Whether a request that arrived through WebServer should have its
+     * socket adopted.
+     */
+    bool canAdopt(const String& connectionHeader) {
+        if (!_enabled || _maxRequests < 2) return false;
+        _prune();
+        return _connections.size() < _maxConnections &&
+               !HttpConnection::isCloseRequested(connectionHeader);
+    }
+
+    /**
+     * Adopt a socket. Its first request still has to be loaded (loadRequest)
+     * and answered by the caller. The reference is valid until loop().
+     */
+    HttpConnection& adopt(WiFiClient client) {
+        _connections.emplace_back(client);
+        HttpConnection& conn = _connections.back();
+        _prepare(conn);
+        _accepted++;
+        return conn;
+    }
+
+    /** Add every connection to a readiness pass (writes wanted while output is queued). */
+    void registerIO(IOPoller& io) {
+        for (auto& conn : _connections) {
+            conn.ioSlot = io.add(conn._client, conn.pendingOutput() > 0
+                                                   ? IOPoller::READ | IOPoller::WRITE
+                                                   : IOPoller::READ);
+        }
+    }
+
+    /**
+     * Read from every connection and answer each complete request with
+     * serve(HttpConnection&); close idle, finished and dropped ones. With a
+     * poller, only readable connections are read and only writable ones
+     * written; the rest just have their idle timer checked.
+     */
+    template <typename F>
+    void loop(F serve, const IOPoller* io = nullptr) {
+        unsigned long now = millis();
+        for (auto& conn : _connections) {
+            if (!conn.isConnected()) continue;
+            bool readable = !io || io->readable(conn.ioSlot);
+            bool writable = !io || io->writable(conn.ioSlot);
+            if (readable && conn.receive() > 0) conn.touch(now);
+
+            while (!conn.closing && conn.pendingOutput() < HttpConnection::MAX_PENDING_OUTPUT) {
+                HttpConnection::Parse result = conn.parse();
+                if (result == HttpConnection::Parse::Incomplete) break;
+                if (result != HttpConnection::Parse::Ready) {
+                    conn.closing = true;
+                    conn.send(result == HttpConnection::Parse::TooLarge ? 413 : 400);
+                    break;
+                }
+                _prepare(conn);
+                if (conn.wantsClose()) conn.closing = true;
+                serve(conn);
+                _reused++;
+                conn.touch(now);
+                if (writable) conn.flush();
+            }
+
+            if (writable) conn.flush();
+            if (conn.pendingOutput() > 0 || !conn.isConnected()) continue;
+            if (conn.closing) {
+                conn.stop();
+            } else if (now - conn.lastActivity() >= _idleTimeoutMs && !conn.hasBufferedInput()) {
+                conn.stop();
+                _idleClosed++;
+            }
+        }
+        _prune();
+    }
+
+    /** Remove a connection from the pool without closing it (handed to SSE). */
+    void release(HttpConnection& conn) { conn._released = true; }
+
+    void closeAll() {
+        for (auto& conn : _connections) {
+            conn.flush();
+            conn.stop();
+        }
+        _connections.clear();
+    }
+
+    size_t connectionCount() const { return _connections.size(); }
+    /** Sockets adopted from WebServer */
+    unsigned long acceptedConnections() const { return _accepted; }
+    /** Requests answered on an already open connection (handshakes saved) */
+    unsigned long reusedRequests() const { return _reused; }
+    /** Connections closed after idleTimeoutMs without a request */
+    unsigned long idleClosed() const { return _idleClosed; }
+
+#ifdef MCPD_TEST
+public:  // Allow test access to internals
+#else
+private:
+#endif
+    std::vector<HttpConnection> _connections;
+    bool _enabled = false;
+    size_t _maxConnections = DEFAULT_MAX_CONNECTIONS;
+    unsigned long _idleTimeoutMs = DEFAULT_IDLE_TIMEOUT_MS;
+    uint16_t _maxRequests = DEFAULT_MAX_REQUESTS;
+    unsigned long _accepted = 0;
+    unsigned long _reused = 0;
+    unsigned long _idleClosed = 0;
+
+    /** Count the request about to be served and set its Keep-Alive values */
+    void _prepare(HttpConnection& conn) {
+        conn.served++;
+        conn.timeoutSec = (_idleTimeoutMs + 999) / 1000;
+        conn.remaining = conn.served < _maxRequests ? _maxRequests - conn.served : 0;
+        if (conn.remaining == 0) conn.closing = true;
+    }
+
+    void _prune() {
+        for (auto it = _connections.begin(); it != _connections.end();) {
+            it = it->isConnected() ? it + 1 : _connections.erase(it);
+        }
+    }
+};
+
+} // namespace mcpd
+
+#endif // MCPD_HTTP_KEEPALIVE_H
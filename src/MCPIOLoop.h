@@ -0,0 +1,154 @@
+/**
+ * mcpd — Connection readiness poller
+ *
+ * Server::loop() used to let every transport probe each of its sockets in
+ * turn. IOPoller gathers the open connections of all transports (kept-alive
+ * HTTP, SSE streams, WebSocket clients), checks them in one pass and lets
+ * each transport touch only the sockets that can make progress: readable
+ * ones (data, or a hang-up) are read, writable ones with queued output are
+ * written. An idle pass is one select() with a zero timeout.
+ *
+ * On ESP32 the pass is an lwIP select() over WiFiClient::fd(). Elsewhere,
+ * and for clients without a socket descriptor, readiness is probed with
+ * available() / connected().
+ *
+ * Usage (per loop):
+ *   io.reset();
+ *   conn.ioSlot = io.add(conn.client, IOPoller::READ | IOPoller::WRITE);
+ *   io.poll();
+ *   if (io.readable(conn.ioSlot)) ...
+ */
+
+#ifndef MCPD_IO_LOOP_H
+#define MCPD_IO_LOOP_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#ifdef ESP32
+#include <lwip/sockets.h>
+#endif
+
+namespace mcpd {
+
+class IOPoller {
+public:
+    static constexpr size_t MAX_ENTRIES = 16;  // 4 SSE + 4 WS + keep-alive, with room
+
+    enum : uint8_t {
+        READ = 1,
+        WRITE = 2,
+    };
+
+    /** Start collecting interest for a new pass. */
+    void reset() { _count = 0; }
+
+    /**
+     * Register a socket for this pass.
+     * @return slot for readable()/writable(), or -1 when the table is full
+     *         (the socket is then treated as always ready)
+     */
+    int add(WiFiClient& client, uint8_t interest) {
+        if (_count >= MAX_ENTRIES) return -1;
+        _entries[_count] = Entry{&client, interest, 0};
+        return (int)_count++;
+    }
+
+    /**
+     * One non-blocking readiness pass over the registered sockets.
+     * @return number of sockets with an event
+     */
+    size_t poll() {
+        _passes++;
+        size_t ready = 0;
+#ifdef ESP32
+        fd_set readSet, writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        int maxFd = -1;
+        for (size_t i = 0; i < _count; i++) {
+            int fd = _entries[i].client->fd();
+            if (fd < 0) continue;
+            if (_entries[i].interest & READ) FD_SET(fd, &readSet);
+            if (_entries[i].interest & WRITE) FD_SET(fd, &writeSet);
+            if (fd > maxFd) maxFd = fd;
+        }
+        if (maxFd >= 0) {
+            struct timeval zero = {0, 0};
+            if (select(maxFd + 1, &readSet, &writeSet, nullptr, &zero) < 0) {
+                FD_ZERO(&readSet);
+                FD_ZERO(&writeSet);
+            }
+        }
+#endif
+        for (size_t i = 0; i < _count; i++) {
+            Entry& e = _entries[i];
+            e.ready = 0;
+#ifdef ESP32
+            int fd = e.client->fd();
+            if (fd >= 0) {
+                if (FD_ISSET(fd, &readSet)) e.ready |= READ;
+                if (FD_ISSET(fd, &writeSet)) e.ready |= WRITE;
+            } else {
+                e.ready = _probe(e);
+            }
+#else
+            e.ready = _probe(e);
+#endif
+            if (e.ready) ready++;
+        }
+        _events += ready;
+        if (ready == 0) _idlePasses++;
+        return ready;
+    }
+
+    /**
+     * readable(): data (or a hang-up) is waiting. writable(): the socket
+     * takes more output. Both are only false when the pass asked about that
+     * event and did not see it, so output queued after registration is
+     * still attempted (writes never block).
+     */
+    bool readable(int slot) const { return _ready(slot, READ); }
+    bool writable(int slot) const { return _ready(slot, WRITE); }
+
+    size_t size() const { return _count; }
+    /** poll() calls */
+    unsigned long passes() const { return _passes; }
+    /** poll() calls that found nothing to do */
+    unsigned long idlePasses() const { return _idlePasses; }
+    /** Socket events seen over all passes */
+    unsigned long events() const { return _events; }
+
+private:
+    struct Entry {
+        WiFiClient* client;
+        uint8_t interest;
+        uint8_t ready;
+    };
+
+    Entry _entries[MAX_ENTRIES];
+    size_t _count = 0;
+    unsigned long _passes = 0;
+    unsigned long _idlePasses = 0;
+    unsigned long _events = 0;
+
+    // A slot of -1 (connections opened after the pass) or an event that
+    // was not asked for counts as ready, so nothing waits a loop for it
+    bool _ready(int slot, uint8_t what) const {
+        if (slot < 0 || (size_t)slot >= _count) return true;
+        const Entry& e = _entries[slot];
+        return !(e.interest & what) || (e.ready & what);
+    }
+
+    static uint8_t _probe(Entry& e) {
+        uint8_t ready = 0;
+        bool connected = e.client->connected();
+        if ((e.interest & READ) && (e.client->available() > 0 || !connected)) ready |= READ;
+        if ((e.interest & WRITE) && connected) ready |= WRITE;
+        return ready;
+    }
+};
+
+} // namespace mcpd
+
+#endif // MCPD_IO_LOOP_H
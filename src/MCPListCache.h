@@ -0,0 +1,159 @@
+/**
+ * mcpd — List Response Cache
+ *
+ * tools/list, resources/list, resources/templates/list and prompts/list only
+ * change when something is registered, removed, enabled or disabled, but
+ * clients ask for them after every reconnect and every list_changed
+ * notification. The cache keeps the serialized "result" object of recent
+ * pages, keyed by (generation, cursor, pageSize), so a repeated request is
+ * answered with a copy of the stored text instead of rebuilding and
+ * re-serializing every entry.
+ *
+ * Each list has its own generation counter. The server bumps it from every
+ * mutating API (add/remove/enable, group toggles, notify*Changed()), which
+ * drops that list's stored pages at once.
+ *
+ * Usage (inside the server):
+ *   const String* page = cache.find(ListKind::Tools, cursor, pageSize);
+ *   if (!page) page = &cache.store(ListKind::Tools, cursor, pageSize, body);
+ */
+
+#ifndef MCPD_LIST_CACHE_H
+#define MCPD_LIST_CACHE_H
+
+#include <Arduino.h>
+
+namespace mcpd {
+
+enum class ListKind : uint8_t {
+    Tools = 0,
+    Resources,
+    ResourceTemplates,
+    Prompts,
+};
+
+class ListCache {
+public:
+    static constexpr size_t LIST_COUNT = 4;
+    static constexpr size_t PAGES_PER_LIST = 4;
+
+    /** Enable/disable caching. Disabling frees all stored pages. */
+    void setEnabled(bool enabled) {
+        _enabled = enabled;
+        if (!enabled) clear();
+    }
+    bool isEnabled() const { return _enabled; }
+
+    /**
+     * Look up a stored page for the current generation of a list.
+     * @return the serialized result object, or nullptr on a miss
+     */
+    const String* find(ListKind kind, size_t cursor, size_t pageSize) {
+        if (!_enabled) return nullptr;
+        List& list = _lists[(size_t)kind];
+        for (auto& page : list.pages) {
+            if (page.valid && page.generation == list.generation &&
+                page.cursor == cursor && page.pageSize == pageSize) {
+                page.lastUse = ++_clock;
+                _hits++;
+                return &page.body;
+            }
+        }
+        _misses++;
+        return nullptr;
+    }
+
+    /**
+     * Store a freshly built page, replacing the least recently used one.
+     * Returns the stored copy (the argument itself while disabled).
+     */
+    const String& store(ListKind kind, size_t cursor, size_t pageSize, const String& body) {
+        if (!_enabled) return body;
+        List& list = _lists[(size_t)kind];
+        Page* victim = &list.pages[0];
+        for (auto& page : list.pages) {
+            if (!page.valid) { victim = &page; break; }
+            if (page.lastUse < victim->lastUse) victim = &page;
+        }
+        victim->valid = true;
+        victim->generation = list.generation;
+        victim->cursor = cursor;
+        victim->pageSize = pageSize;
+        victim->lastUse = ++_clock;
+        victim->body = body;
+        return victim->body;
+    }
+
+    /** Start a new generation of one list and free its stored pages. */
+    void invalidate(ListKind kind) {
+        List& list = _lists[(size_t)kind];
+        list.generation++;
+        for (auto& page : list.pages) page.release();
+        _invalidations++;
+    }
+
+    /** Drop every stored page (generations are kept). */
+    void clear() {
+        for (auto& list : _lists) {
+            for (auto& page : list.pages) page.release();
+        }
+    }
+
+    uint32_t generation(ListKind kind) const { return _lists[(size_t)kind].generation; }
+
+    // Statistics
+    unsigned long hits() const { return _hits; }
+    unsigned long misses() const { return _misses; }
+    unsigned long invalidations() const { return _invalidations; }
+
+    /** Number of pages currently stored */
+    size_t entries() const {
+        size_t n = 0;
+        for (const auto& list : _lists) {
+            for (const auto& page : list.pages) if (page.valid) n++;
+        }
+        return n;
+    }
+
+    /** Bytes of serialized JSON currently stored */
+    size_t bytes() const {
+        size_t n = 0;
+        for (const auto& list : _lists) {
+            for (const auto& page : list.pages) if (page.valid) n += page.body.length();
+        }
+        return n;
+    }
+
+    void resetStats() { _hits = 0; _misses = 0; _invalidations = 0; }
+
+private:
+    struct Page {
+        bool valid = false;
+        uint32_t generation = 0;
+        size_t cursor = 0;
+        size_t pageSize = 0;
+        uint32_t lastUse = 0;
+        String body;
+
+        void release() {
+            valid = false;
+            body = String();
+        }
+    };
+
+    struct List {
+        uint32_t generation = 0;
+        Page pages[PAGES_PER_LIST];
+    };
+
+    List _lists[LIST_COUNT];
+    bool _enabled = true;
+    uint32_t _clock = 0;
+    unsigned long _hits = 0;
+    unsigned long _misses = 0;
+    unsigned long _invalidations = 0;
+};
+
+} // namespace mcpd
+
+#endif // MCPD_LIST_CACHE_H
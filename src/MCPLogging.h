@@ -92,6 +92,7 @@ public:
      * Set the notification sink — how log messages are delivered to the client.
      */
     void setSink(LogNotificationSink sink) { _sink = std::move(sink); }
+    bool hasSink() const { return (bool)_sink; }
 
     /**
      * Emit a log message if it meets the current level threshold.
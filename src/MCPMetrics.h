@@ -2,13 +2,25 @@
  * mcpd — Prometheus Metrics
  *
  * Exposes a /metrics endpoint in Prometheus exposition format.
- * Tracks request count, latency, uptime, free heap, and SSE connections.
+ * Tracks request count, latency, uptime, free heap, SSE connections and
+ * list-cache effectiveness.
+ *
+ * Latency is also kept as fixed-bucket microsecond histograms per JSON-RPC
+ * method and per (tool, outcome), exported as Prometheus histograms
+ * (_bucket/_sum/_count). All series live in preallocated slot tables, so
+ * recording never touches the heap; once a table is full, new labels are
+ * counted under "_other".
+ *
+ * GET /metrics is streamed through a ResponseWriter as HTTP chunks, with
+ * numbers formatted on the stack, so a scrape makes no heap allocations.
  *
  * Usage:
  *   mcpd::Metrics metrics;
  *   metrics.begin(server);  // pass your WebServer
  *   // On each request:
- *   metrics.recordRequest(method, durationMs);
+ *   metrics.recordRequestMicros(method, durationUs);
+ *   // On each tools/call:
+ *   metrics.recordToolCall(tool, ToolCallOutcome::Ok, durationUs);
  */
 
 #ifndef MCPD_METRICS_H
@@ -16,12 +28,172 @@
 
 #include <Arduino.h>
 #include <WebServer.h>
-#include <map>
+#include "MCPResponseWriter.h"
 
 namespace mcpd {
 
+/**
+ * Log-linear latency histogram (1-2.5-5 steps from 50 µs to 10 s, plus
+ * +Inf). Counts are per bucket; the exporter makes them cumulative.
+ */
+class LatencyHistogram {
+public:
+    /** Number of finite buckets; bucket BUCKETS is +Inf */
+    static constexpr size_t BUCKETS = 17;
+    static constexpr uint32_t BOUNDS_US[BUCKETS] = {
+        50, 100, 250, 500,
+        1000, 2500, 5000, 10000, 25000, 50000,
+        100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+    };
+
+    void record(uint32_t us) {
+        size_t i = 0;
+        while (i < BUCKETS && us > BOUNDS_US[i]) i++;
+        _counts[i]++;
+        _count++;
+        _sumUs += us;
+    }
+
+    uint32_t count() const { return _count; }
+    uint64_t sumUs() const { return _sumUs; }
+
+    /** Observations in bucket i alone (i == BUCKETS is the +Inf bucket) */
+    uint32_t bucketCount(size_t i) const { return i <= BUCKETS ? _counts[i] : 0; }
+
+    /**
+     * Estimate a quantile (0..1) by linear interpolation inside the bucket
+     * that holds it. Values in the +Inf bucket report the largest bound.
+     */
+    uint32_t quantileUs(double q) const {
+        if (_count == 0) return 0;
+        if (q < 0) q = 0;
+        if (q > 1) q = 1;
+        double rank = q * _count;
+        uint32_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (_counts[i] == 0) continue;
+            if (seen + _counts[i] >= rank) {
+                uint32_t lo = i > 0 ? BOUNDS_US[i - 1] : 0;
+                double frac = (rank - seen) / _counts[i];
+                return lo + (uint32_t)((BOUNDS_US[i] - lo) * frac);
+            }
+            seen += _counts[i];
+        }
+        return BOUNDS_US[BUCKETS - 1];
+    }
+
+    void reset() { *this = LatencyHistogram(); }
+
+private:
+    uint32_t _counts[BUCKETS + 1] = {};
+    uint32_t _count = 0;
+    uint64_t _sumUs = 0;
+};
+
+/**
+ * Fixed table of histograms keyed by (label, variant). Labels are copied
+ * into the slot (truncated to MAX_LABEL - 1 chars), so callers may pass
+ * temporaries. The extra last slot collects everything that did not fit.
+ */
+template <size_t N>
+class HistogramTable {
+public:
+    static constexpr size_t MAX_LABEL = 32;
+
+    struct Slot {
+        uint32_t hash = 0;
+        uint8_t variant = 0;
+        char label[MAX_LABEL] = {};
+        LatencyHistogram histogram;
+    };
+
+    /** Histogram for (label, variant), claiming a free slot if needed */
+    LatencyHistogram& at(const char* label, uint8_t variant = 0) {
+        uint32_t h = _hash(label, variant);
+        for (size_t i = 0; i < _used; i++) {
+            if (_slots[i].hash == h && _matches(_slots[i], label, variant)) {
+                return _slots[i].histogram;
+            }
+        }
+        if (_used == N) {
+            Slot& other = _slots[N];
+            if (other.label[0] == '\0') strcpy(other.label, "_other");
+            return other.histogram;
+        }
+        Slot& slot = _slots[_used++];
+        slot.hash = h;
+        slot.variant = variant;
+        strncpy(slot.label, label, MAX_LABEL - 1);
+        slot.label[MAX_LABEL - 1] = '\0';
+        return slot.histogram;
+    }
+
+    /** Existing histogram for (label, variant), or nullptr */
+    const LatencyHistogram* find(const char* label, uint8_t variant = 0) const {
+        uint32_t h = _hash(label, variant);
+        for (size_t i = 0; i < _used; i++) {
+            if (_slots[i].hash == h && _matches(_slots[i], label, variant)) {
+                return &_slots[i].histogram;
+            }
+        }
+        return nullptr;
+    }
+
+    /** Slots in use, including the overflow slot once it has data */
+    size_t size() const { return _used + (_slots[N].histogram.count() > 0 ? 1 : 0); }
+    const Slot& slot(size_t i) const { return i < _used ? _slots[i] : _slots[N]; }
+
+    void clear() {
+        for (auto& slot : _slots) slot = Slot();
+        _used = 0;
+    }
+
+private:
+    Slot _slots[N + 1];
+    size_t _used = 0;
+
+    // FNV-1a over the (truncated) label, then the variant
+    static uint32_t _hash(const char* label, uint8_t variant) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; label[i] && i < MAX_LABEL - 1; i++) {
+            h = (h ^ (uint8_t)label[i]) * 16777619u;
+        }
+        return (h ^ variant) * 16777619u;
+    }
+
+    static bool _matches(const Slot& slot, const char* label, uint8_t variant) {
+        return slot.variant == variant &&
+               strncmp(slot.label, label, MAX_LABEL - 1) == 0;
+    }
+};
+
+/** How a tools/call was answered, for the per-tool latency histograms */
+enum class ToolCallOutcome : uint8_t {
+    Ok = 0,      // Handler ran, result not an error
+    Error,       // Handler ran (or arguments were rejected), isError result
+    CacheHit,    // Served from ToolResultCache
+    Task,        // Task-augmented call (time to create the task)
+};
+
+inline const char* toolCallOutcomeName(ToolCallOutcome outcome) {
+    switch (outcome) {
+        case ToolCallOutcome::Ok:       return "ok";
+        case ToolCallOutcome::Error:    return "error";
+        case ToolCallOutcome::CacheHit: return "cache_hit";
+        case ToolCallOutcome::Task:     return "task";
+    }
+    return "unknown";
+}
+
 class Metrics {
 public:
+    /** Distinct methods with their own histogram (20 are built in) */
+    static constexpr size_t MAX_METHOD_SERIES = 32;
+    /** Distinct (tool, outcome) pairs with their own histogram */
+    static constexpr size_t MAX_TOOL_SERIES = 32;
+
+    static constexpr const char* CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
     Metrics() : _startTime(0) {}
 
     /**
@@ -30,8 +202,12 @@ public:
     void begin(WebServer& server) {
         _startTime = millis();
         server.on("/metrics", HTTP_GET, [this, &server]() {
-            server.send(200, "text/plain; version=0.0.4; charset=utf-8",
-                        _render());
+            // Streamed as HTTP chunks through the writer's fixed buffer,
+            // so a scrape does not allocate
+            HttpChunkedSink sink(server, 200, CONTENT_TYPE);
+            ResponseWriter writer(sink);
+            renderTo(writer);
+            writer.end();
         });
         Serial.println("[mcpd] Prometheus metrics enabled at /metrics");
     }
@@ -41,9 +217,25 @@ public:
      * @param method  JSON-RPC method name (e.g., "tools/call")
      * @param durationMs  Request processing time in milliseconds
      */
+    void recordRequest(const char* method, unsigned long durationMs) {
+        recordRequestMicros(method, durationMs > 4294967UL ? UINT32_MAX
+                                                          : (uint32_t)(durationMs * 1000));
+    }
+
     void recordRequest(const String& method, unsigned long durationMs) {
+        recordRequest(method.c_str(), durationMs);
+    }
+
+    /**
+     * Record a completed request with microsecond resolution.
+     * @param method  JSON-RPC method name
+     * @param durationUs  Request processing time in microseconds
+     */
+    void recordRequestMicros(const char* method, uint32_t durationUs) {
         _totalRequests++;
-        _methodCounts[method]++;
+        _methodLatency.at(method).record(durationUs);
+
+        unsigned long durationMs = durationUs / 1000;
         _totalLatencyMs += durationMs;
 
         // Track max latency
@@ -52,16 +244,82 @@ public:
         }
     }
 
+    /**
+     * Record one tools/call by tool name and outcome.
+     * @param durationUs  Time from resolving the tool to building the result
+     */
+    void recordToolCall(const char* tool, ToolCallOutcome outcome, uint32_t durationUs) {
+        _toolLatency.at(tool, (uint8_t)outcome).record(durationUs);
+    }
+
     /** Record an error */
     void recordError() { _totalErrors++; }
 
     /** Set current SSE client count (called by server) */
     void setSSEClients(size_t count) { _sseClients = count; }
 
+    /** Set SSE resumability counters (called by server) */
+    void setSSEReplayStats(unsigned long replayed, unsigned long dropped) {
+        _sseReplayed = replayed;
+        _sseDropped = dropped;
+    }
+
+    /** Set SSE outbound queue depth and backpressure counters (called by server) */
+    void setSSEQueueStats(size_t queuedBytes, size_t queuedFrames, unsigned long shed,
+                          unsigned long coalesced, unsigned long slowDisconnects) {
+        _sseQueuedBytes = queuedBytes;
+        _sseQueuedFrames = queuedFrames;
+        _sseShed = shed;
+        _sseCoalesced = coalesced;
+        _sseSlowDisconnects = slowDisconnects;
+    }
+
+    /** Set list-response cache counters (called by server) */
+    void setListCacheStats(unsigned long hits, unsigned long misses, size_t bytes) {
+        _listCacheHits = hits;
+        _listCacheMisses = misses;
+        _listCacheBytes = bytes;
+    }
+
     // Getters
     unsigned long totalRequests() const { return _totalRequests; }
     unsigned long totalErrors() const { return _totalErrors; }
     unsigned long uptimeSeconds() const { return (millis() - _startTime) / 1000; }
+    unsigned long listCacheHits() const { return _listCacheHits; }
+    unsigned long listCacheMisses() const { return _listCacheMisses; }
+    unsigned long sseReplayedEvents() const { return _sseReplayed; }
+    unsigned long sseDroppedEvents() const { return _sseDropped; }
+    size_t sseQueuedBytes() const { return _sseQueuedBytes; }
+    unsigned long sseSlowDisconnects() const { return _sseSlowDisconnects; }
+
+    /** Latency histogram of one method, or nullptr if never recorded */
+    const LatencyHistogram* methodLatency(const char* method) const {
+        return _methodLatency.find(method);
+    }
+
+    /** Latency histogram of one (tool, outcome), or nullptr if never recorded */
+    const LatencyHistogram* toolLatency(const char* tool, ToolCallOutcome outcome) const {
+        return _toolLatency.find(tool, (uint8_t)outcome);
+    }
+
+    /**
+     * Write the Prometheus exposition to any writer with
+     * write(const uint8_t*, size_t) (e.g. ResponseWriter). Numbers are
+     * formatted in a stack buffer; nothing is allocated.
+     */
+    template <typename TWriter>
+    void renderTo(TWriter& writer) {
+        _Exposition<TWriter> out(writer);
+        _render(out);
+    }
+
+    /** Prometheus exposition text as a String (what GET /metrics returns) */
+    String render() {
+        String text;
+        _StringWriter writer{text};
+        renderTo(writer);
+        return text;
+    }
 
 private:
     unsigned long _startTime;
@@ -70,70 +328,203 @@ private:
     unsigned long _totalLatencyMs = 0;
     unsigned long _maxLatencyMs = 0;
     size_t _sseClients = 0;
-    std::map<String, unsigned long> _methodCounts;
+    unsigned long _sseReplayed = 0;
+    unsigned long _sseDropped = 0;
+    size_t _sseQueuedBytes = 0;
+    size_t _sseQueuedFrames = 0;
+    unsigned long _sseShed = 0;
+    unsigned long _sseCoalesced = 0;
+    unsigned long _sseSlowDisconnects = 0;
+    unsigned long _listCacheHits = 0;
+    unsigned long _listCacheMisses = 0;
+    size_t _listCacheBytes = 0;
+    HistogramTable<MAX_METHOD_SERIES> _methodLatency;
+    HistogramTable<MAX_TOOL_SERIES> _toolLatency;
 
-    String _render() {
-        String out;
-        out.reserve(1024);
+    // Writes formatted exposition text to any writer with
+    // write(const uint8_t*, size_t); numbers go through a stack buffer
+    template <typename TWriter>
+    class _Exposition {
+    public:
+        explicit _Exposition(TWriter& w) : _w(w) {}
 
-        // Uptime
-        out += "# HELP mcpd_uptime_seconds Time since server start\n";
-        out += "# TYPE mcpd_uptime_seconds gauge\n";
-        out += "mcpd_uptime_seconds " + String(uptimeSeconds()) + "\n\n";
+        void text(const char* s) { _w.write((const uint8_t*)s, strlen(s)); }
 
-        // Free heap
-        out += "# HELP mcpd_free_heap_bytes Free heap memory in bytes\n";
-        out += "# TYPE mcpd_free_heap_bytes gauge\n";
-        out += "mcpd_free_heap_bytes " + String(ESP.getFreeHeap()) + "\n\n";
+        void number(unsigned long long v) {
+            char num[24];
+            int n = snprintf(num, sizeof(num), "%llu", v);
+            _w.write((const uint8_t*)num, (size_t)n);
+        }
 
-        // Min free heap (since boot)
-        out += "# HELP mcpd_min_free_heap_bytes Minimum free heap since boot\n";
-        out += "# TYPE mcpd_min_free_heap_bytes gauge\n";
-        out += "mcpd_min_free_heap_bytes " + String(ESP.getMinFreeHeap()) + "\n\n";
+        void number(long v) {
+            char num[24];
+            int n = snprintf(num, sizeof(num), "%ld", v);
+            _w.write((const uint8_t*)num, (size_t)n);
+        }
 
-        // Total requests
-        out += "# HELP mcpd_requests_total Total JSON-RPC requests processed\n";
-        out += "# TYPE mcpd_requests_total counter\n";
-        out += "mcpd_requests_total " + String(_totalRequests) + "\n\n";
+        // Label values escape backslash, double quote and newline
+        void labelValue(const char* value) {
+            const char* run = value;
+            for (const char* p = value; *p; p++) {
+                const char* esc = *p == '\\' ? "\\\\" : *p == '"' ? "\\\"" : *p == '\n' ? "\\n" : nullptr;
+                if (!esc) continue;
+                _w.write((const uint8_t*)run, (size_t)(p - run));
+                text(esc);
+                run = p + 1;
+            }
+            text(run);
+        }
+
+        /** HELP and TYPE lines */
+        void header(const char* name, const char* type, const char* help) {
+            text("# HELP "); text(name); text(" "); text(help);
+            text("\n# TYPE "); text(name); text(" "); text(type); text("\n");
+        }
+
+        /** Single unlabelled sample followed by a blank line */
+        void metric(const char* name, const char* type, const char* help,
+                    unsigned long long value, bool last = false) {
+            header(name, type, help);
+            text(name); text(" "); number(value); text(last ? "\n" : "\n\n");
+        }
+
+        void metric(const char* name, const char* type, const char* help, long value,
+                    bool last = false) {
+            header(name, type, help);
+            text(name); text(" "); number(value); text(last ? "\n" : "\n\n");
+        }
+
+        /** {key="value"[,key2="value2"] without the closing brace */
+        void openLabels(const char* key, const char* value,
+                        const char* key2 = nullptr, const char* value2 = nullptr) {
+            text("{"); text(key); text("=\""); labelValue(value); text("\"");
+            if (key2) { text(","); text(key2); text("=\""); labelValue(value2); text("\""); }
+        }
+
+        // Cumulative _bucket series, then _sum and _count
+        void histogram(const char* name, const LatencyHistogram& h,
+                       const char* key, const char* value,
+                       const char* key2 = nullptr, const char* value2 = nullptr) {
+            unsigned long long cumulative = 0;
+            for (size_t b = 0; b <= LatencyHistogram::BUCKETS; b++) {
+                cumulative += h.bucketCount(b);
+                text(name); text("_bucket");
+                openLabels(key, value, key2, value2);
+                text(",le=\"");
+                if (b < LatencyHistogram::BUCKETS) number((unsigned long long)LatencyHistogram::BOUNDS_US[b]);
+                else text("+Inf");
+                text("\"} "); number(cumulative); text("\n");
+            }
+            text(name); text("_sum"); openLabels(key, value, key2, value2);
+            text("} "); number((unsigned long long)h.sumUs()); text("\n");
+            text(name); text("_count"); openLabels(key, value, key2, value2);
+            text("} "); number((unsigned long long)h.count()); text("\n");
+        }
+
+    private:
+        TWriter& _w;
+    };
+
+    // Collects output in a String (for render())
+    struct _StringWriter {
+        String& out;
+        size_t write(const uint8_t* data, size_t len) {
+            for (size_t i = 0; i < len; i++) out += (char)data[i];
+            return len;
+        }
+    };
+
+    template <typename TExposition>
+    void _render(TExposition& out) {
+        out.metric("mcpd_uptime_seconds", "gauge", "Time since server start",
+                   (unsigned long long)uptimeSeconds());
+        out.metric("mcpd_free_heap_bytes", "gauge", "Free heap memory in bytes",
+                   (unsigned long long)ESP.getFreeHeap());
+        out.metric("mcpd_min_free_heap_bytes", "gauge", "Minimum free heap since boot",
+                   (unsigned long long)ESP.getMinFreeHeap());
+        out.metric("mcpd_requests_total", "counter", "Total JSON-RPC requests processed",
+                   (unsigned long long)_totalRequests);
 
         // Requests by method
-        if (!_methodCounts.empty()) {
-            out += "# HELP mcpd_requests_by_method_total Requests by JSON-RPC method\n";
-            out += "# TYPE mcpd_requests_by_method_total counter\n";
-            for (const auto& kv : _methodCounts) {
-                out += "mcpd_requests_by_method_total{method=\"" + kv.first + "\"} "
-                       + String(kv.second) + "\n";
+        if (_methodLatency.size() > 0) {
+            out.header("mcpd_requests_by_method_total", "counter", "Requests by JSON-RPC method");
+            for (size_t i = 0; i < _methodLatency.size(); i++) {
+                const auto& slot = _methodLatency.slot(i);
+                out.text("mcpd_requests_by_method_total");
+                out.openLabels("method", slot.label);
+                out.text("} ");
+                out.number((unsigned long long)slot.histogram.count());
+                out.text("\n");
             }
-            out += "\n";
+            out.text("\n");
         }
 
-        // Errors
-        out += "# HELP mcpd_errors_total Total error responses\n";
-        out += "# TYPE mcpd_errors_total counter\n";
-        out += "mcpd_errors_total " + String(_totalErrors) + "\n\n";
+        out.metric("mcpd_errors_total", "counter", "Total error responses",
+                   (unsigned long long)_totalErrors);
 
         // Latency
-        out += "# HELP mcpd_request_latency_ms_avg Average request latency in ms\n";
-        out += "# TYPE mcpd_request_latency_ms_avg gauge\n";
         unsigned long avgLatency = _totalRequests > 0
                                        ? _totalLatencyMs / _totalRequests : 0;
-        out += "mcpd_request_latency_ms_avg " + String(avgLatency) + "\n\n";
+        out.metric("mcpd_request_latency_ms_avg", "gauge", "Average request latency in ms",
+                   (unsigned long long)avgLatency);
+        out.metric("mcpd_request_latency_ms_max", "gauge", "Maximum request latency in ms",
+                   (unsigned long long)_maxLatencyMs);
+
+        if (_methodLatency.size() > 0) {
+            out.header("mcpd_request_duration_microseconds", "histogram",
+                       "JSON-RPC request latency by method");
+            for (size_t i = 0; i < _methodLatency.size(); i++) {
+                const auto& slot = _methodLatency.slot(i);
+                out.histogram("mcpd_request_duration_microseconds", slot.histogram,
+                              "method", slot.label);
+            }
+            out.text("\n");
+        }
 
-        out += "# HELP mcpd_request_latency_ms_max Maximum request latency in ms\n";
-        out += "# TYPE mcpd_request_latency_ms_max gauge\n";
-        out += "mcpd_request_latency_ms_max " + String(_maxLatencyMs) + "\n\n";
+        if (_toolLatency.size() > 0) {
+            out.header("mcpd_tool_call_duration_microseconds", "histogram",
+                       "tools/call latency by tool and outcome");
+            for (size_t i = 0; i < _toolLatency.size(); i++) {
+                const auto& slot = _toolLatency.slot(i);
+                out.histogram("mcpd_tool_call_duration_microseconds", slot.histogram,
+                              "tool", slot.label,
+                              "outcome", toolCallOutcomeName((ToolCallOutcome)slot.variant));
+            }
+            out.text("\n");
+        }
 
-        // SSE clients
-        out += "# HELP mcpd_sse_clients Active SSE connections\n";
-        out += "# TYPE mcpd_sse_clients gauge\n";
-        out += "mcpd_sse_clients " + String(_sseClients) + "\n\n";
+        out.metric("mcpd_sse_clients", "gauge", "Active SSE connections",
+                   (unsigned long long)_sseClients);
+        out.metric("mcpd_sse_replayed_events_total", "counter",
+                   "SSE events re-sent after a Last-Event-ID reconnect",
+                   (unsigned long long)_sseReplayed);
+        out.metric("mcpd_sse_dropped_events_total", "counter",
+                   "SSE events that fell out of the replay buffer",
+                   (unsigned long long)_sseDropped);
+        out.metric("mcpd_sse_queue_bytes", "gauge", "Bytes waiting in SSE client queues",
+                   (unsigned long long)_sseQueuedBytes);
+        out.metric("mcpd_sse_queue_events", "gauge", "Events waiting in SSE client queues",
+                   (unsigned long long)_sseQueuedFrames);
+        out.metric("mcpd_sse_coalesced_events_total", "counter",
+                   "Low-priority SSE events replaced by a newer one",
+                   (unsigned long long)_sseCoalesced);
+        out.metric("mcpd_sse_shed_events_total", "counter",
+                   "Low-priority SSE events dropped at the high-water mark",
+                   (unsigned long long)_sseShed);
+        out.metric("mcpd_sse_slow_disconnects_total", "counter",
+                   "SSE clients disconnected for not keeping up",
+                   (unsigned long long)_sseSlowDisconnects);
 
-        // WiFi RSSI
-        out += "# HELP mcpd_wifi_rssi_dbm WiFi signal strength\n";
-        out += "# TYPE mcpd_wifi_rssi_dbm gauge\n";
-        out += "mcpd_wifi_rssi_dbm " + String(WiFi.RSSI()) + "\n";
+        // List response cache
+        out.metric("mcpd_list_cache_hits_total", "counter", "List requests served from the cache",
+                   (unsigned long long)_listCacheHits);
+        out.metric("mcpd_list_cache_misses_total", "counter", "List requests that rebuilt the page",
+                   (unsigned long long)_listCacheMisses);
+        out.metric("mcpd_list_cache_bytes", "gauge", "Serialized list pages held in RAM",
+                   (unsigned long long)_listCacheBytes);
 
-        return out;
+        out.metric("mcpd_wifi_rssi_dbm", "gauge", "WiFi signal strength",
+                   (long)WiFi.RSSI(), true);
     }
 };
 
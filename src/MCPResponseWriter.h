@@ -0,0 +1,206 @@
+/**
+ * mcpd — Streaming Response Writer
+ *
+ * Lets JSON-RPC responses be serialized straight onto the wire instead of
+ * into a String first. Output goes through a small fixed buffer and is
+ * handed to a ResponseSink in pieces, so the serialized form of a large
+ * result (tools/list, camera images, resources/read) never has to exist
+ * in heap as a whole.
+ *
+ * Sinks:
+ *   - HttpChunkedSink:  HTTP/1.1 chunked transfer via WebServer::sendContent()
+ *                       (BasicHttpChunkedSink for a kept-alive HttpConnection)
+ *   - SSEFrameSink:     wraps another sink in an SSE "data:" event
+ *
+ * ResponseWriter implements write(uint8_t) / write(const uint8_t*, size_t),
+ * so it can be passed to serializeJson() directly.
+ */
+
+#ifndef MCPD_RESPONSE_WRITER_H
+#define MCPD_RESPONSE_WRITER_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+namespace mcpd {
+
+/**
+ * Destination for streamed output. begin() is called once, right before
+ * the first data is written, so a sink can still decide on headers late.
+ */
+class ResponseSink {
+public:
+    virtual ~ResponseSink() = default;
+    virtual void begin() {}
+    virtual void write(const char* data, size_t len) = 0;
+    virtual void end() {}
+};
+
+/**
+ * Buffered writer in front of a ResponseSink.
+ */
+class ResponseWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 512;
+
+    explicit ResponseWriter(ResponseSink& sink) : _sink(&sink) {}
+
+    ResponseWriter(const ResponseWriter&) = delete;
+    ResponseWriter& operator=(const ResponseWriter&) = delete;
+
+    size_t write(uint8_t c) {
+        if (_len == BUFFER_SIZE) flush();
+        _buf[_len++] = (char)c;
+        _total++;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t len) {
+        size_t remaining = len;
+        while (remaining > 0) {
+            if (_len == BUFFER_SIZE) flush();
+            size_t n = BUFFER_SIZE - _len;
+            if (n > remaining) n = remaining;
+            memcpy(_buf + _len, data, n);
+            _len += n;
+            data += n;
+            remaining -= n;
+        }
+        _total += len;
+        return len;
+    }
+
+    size_t print(const char* s) {
+        return s ? write((const uint8_t*)s, strlen(s)) : 0;
+    }
+
+    size_t print(const String& s) {
+        return write((const uint8_t*)s.c_str(), s.length());
+    }
+
+    /** Hand buffered bytes to the sink (starting it if needed). */
+    void flush() {
+        if (_len == 0) return;
+        _start();
+        _sink->write(_buf, _len);
+        _len = 0;
+    }
+
+    /** Flush and finish the response. Safe to call more than once. */
+    void end() {
+        if (_ended) return;
+        flush();
+        _start();
+        _sink->end();
+        _ended = true;
+    }
+
+    /** True once any data has reached the sink (or end() was called). */
+    bool started() const { return _started; }
+    bool ended() const { return _ended; }
+
+    /** Total bytes written through this writer */
+    size_t bytesWritten() const { return _total; }
+
+private:
+    ResponseSink* _sink;
+    char _buf[BUFFER_SIZE];
+    size_t _len = 0;
+    size_t _total = 0;
+    bool _started = false;
+    bool _ended = false;
+
+    void _start() {
+        if (_started) return;
+        _started = true;
+        _sink->begin();
+    }
+};
+
+/**
+ * HTTP/1.1 chunked response through the Arduino WebServer, or anything
+ * with the same send()/sendContent() API.
+ * Headers (status, content type, any sendHeader() calls made before the
+ * first chunk) go out on begin().
+ */
+template <typename TServer>
+class BasicHttpChunkedSink : public ResponseSink {
+public:
+    BasicHttpChunkedSink(TServer& server, int code, const char* contentType)
+        : _server(server), _code(code), _contentType(contentType) {}
+
+    /**
+     * Send a header with the status line. The value is read when the
+     * response starts, so it may still change while the result is built
+     * (e.g. the session id assigned by initialize). Empty values are skipped.
+     */
+    void addHeader(const char* name, const String& value) {
+        _headerName = name;
+        _headerValue = &value;
+    }
+
+    void begin() override {
+        if (_headerName && !_headerValue->isEmpty()) {
+            _server.sendHeader(_headerName, *_headerValue);
+        }
+        _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        _server.send(_code, _contentType, "");
+    }
+
+    void write(const char* data, size_t len) override {
+        _server.sendContent(data, len);
+    }
+
+    void end() override {
+        _server.sendContent("", 0);  // Terminating zero-length chunk
+    }
+
+private:
+    TServer& _server;
+    int _code;
+    const char* _contentType;
+    const char* _headerName = nullptr;
+    const String* _headerValue = nullptr;
+};
+
+using HttpChunkedSink = BasicHttpChunkedSink<WebServer>;
+
+/**
+ * Frames everything written as one Server-Sent Event:
+ *   event: message\n
+ *   data: <payload>\n
+ *   \n
+ * The payload must not contain newlines (compact JSON never does).
+ */
+class SSEFrameSink : public ResponseSink {
+public:
+    explicit SSEFrameSink(ResponseSink& inner, const char* eventName = "message")
+        : _inner(inner), _eventName(eventName) {}
+
+    void begin() override {
+        _inner.begin();
+        char header[48];
+        int n = _eventName
+            ? snprintf(header, sizeof(header), "event: %s\ndata: ", _eventName)
+            : snprintf(header, sizeof(header), "data: ");
+        if (n > (int)sizeof(header) - 1) n = sizeof(header) - 1;
+        _inner.write(header, (size_t)n);
+    }
+
+    void write(const char* data, size_t len) override {
+        _inner.write(data, len);
+    }
+
+    void end() override {
+        _inner.write("\n\n", 2);
+        _inner.end();
+    }
+
+private:
+    ResponseSink& _inner;
+    const char* _eventName;
+};
+
+} // namespace mcpd
+
+#endif // MCPD_RESPONSE_WRITER_H
@@ -128,14 +128,15 @@ public:
         int executed = 0;
 
         for (size_t i = 0; i < _tasks.size(); i++) {
-            auto& task = _tasks[i];
-            if (!task.active || task.paused) continue;
+            if (!_tasks[i].active || _tasks[i].paused) continue;
 
-            if (now >= task.nextRunMs) {
-                // Execute
-                if (task.callback) {
-                    task.callback();
+            if (now >= _tasks[i].nextRunMs) {
+                // Execute (the callback may add tasks, so re-fetch the entry after)
+                if (_tasks[i].callback) {
+                    auto callback = _tasks[i].callback;
+                    callback();
                 }
+                auto& task = _tasks[i];
                 task.lastRunMs = now;
                 task.execCount++;
                 executed++;
@@ -16,16 +16,23 @@
 #include <map>
 #include <vector>
 #include <functional>
+#include "MCPLogging.h"
 
 namespace mcpd {
 
 struct Session {
+    static constexpr size_t MAX_PENDING = 32;  // Queued while no SSE stream is open
+
     String id;
     String clientName;
     unsigned long createdAt;     // millis()
     unsigned long lastActivity;  // millis()
     bool initialized;
 
+    // Per-client protocol state
+    LogLevel logLevel = LogLevel::WARNING;  // Set by logging/setLevel
+    std::vector<String> pending;            // Notifications not yet on a stream
+
     Session() : createdAt(0), lastActivity(0), initialized(false) {}
     Session(const String& sid, const String& client)
         : id(sid), clientName(client),
@@ -35,6 +42,12 @@ struct Session {
     unsigned long ageMs() const { return millis() - createdAt; }
     unsigned long idleMs() const { return millis() - lastActivity; }
     void touch() { lastActivity = millis(); }
+
+    /** Queue a notification, dropping the oldest beyond MAX_PENDING */
+    void queue(const String& notification) {
+        if (pending.size() >= MAX_PENDING) pending.erase(pending.begin());
+        pending.push_back(notification);
+    }
 };
 
 /**
@@ -90,6 +103,12 @@ public:
         return _sessions.erase(id) > 0;
     }
 
+    /** Remove every session (server stop). */
+    void clear() {
+        for (const auto& kv : _sessions) _ended.push_back(kv.first);
+        _sessions.clear();
+    }
+
     /**
      * Get session info. Returns nullptr if not found.
      */
@@ -97,6 +116,26 @@ public:
         auto it = _sessions.find(id);
         return (it != _sessions.end()) ? &it->second : nullptr;
     }
+    Session* getSession(const String& id) {
+        auto it = _sessions.find(id);
+        return (it != _sessions.end()) ? &it->second : nullptr;
+    }
+
+    /** Call fn(Session&) for every active session. */
+    template <typename F>
+    void forEach(F fn) {
+        for (auto& kv : _sessions) fn(kv.second);
+    }
+
+    /**
+     * IDs of sessions that expired, were evicted or cleared since the last
+     * call, so their SSE streams and replay history can be released.
+     */
+    std::vector<String> takeEnded() {
+        std::vector<String> ended;
+        ended.swap(_ended);
+        return ended;
+    }
 
     /**
      * Prune expired/idle sessions.
@@ -113,6 +152,7 @@ public:
             Serial.printf("[mcpd] Session expired (idle %lums): %s\n",
                           _sessions[id].idleMs(), id.c_str());
             _sessions.erase(id);
+            _ended.push_back(id);
         }
     }
 
@@ -143,6 +183,7 @@ public:
 
 private:
     std::map<String, Session> _sessions;
+    std::vector<String> _ended;
     size_t _maxSessions = 4;
     unsigned long _idleTimeoutMs = 30UL * 60 * 1000;  // 30 minutes
 
@@ -160,6 +201,7 @@ private:
             Serial.printf("[mcpd] Evicting oldest session: %s (idle %lums)\n",
                           oldestId.c_str(), maxIdle);
             _sessions.erase(oldestId);
+            _ended.push_back(oldestId);
             return true;
         }
         return false;
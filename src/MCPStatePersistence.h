@@ -0,0 +1,542 @@
+/**
+ * mcpd — StateStore persistence in a log-structured flash region
+ *
+ * Keeps a StateStore across reboots and brownouts without rewriting it as
+ * a whole. The region is split into two halves. The active half starts
+ * with a header (magic, epoch, CRC) followed by an append-only log:
+ *
+ *   type(1) keyLen(1) valueLen(2) crc32(4) key value
+ *
+ * 'S' records set a key, 'D' records remove one, and an erased byte (0xFF)
+ * where a record would start ends the log. Every change to a key queues
+ * it; loop() appends one record per queued key until its time budget is
+ * spent, so a burst of changes to the same key costs one write.
+ *
+ * When the log is full, or has passed the compaction threshold and doubled
+ * since the last compaction, the other half is erased one sector per step,
+ * the live keys are copied into it, and its header is written last. Until
+ * that header is on flash the old half stays valid, so power loss at any
+ * point leaves one complete copy.
+ *
+ * begin() replays the half with the highest valid epoch. Replay stops at
+ * the first record whose CRC does not match (a write torn by power loss);
+ * the records before it are kept, and the half is compacted before
+ * anything else is appended.
+ *
+ * Keys set with a TTL are not persisted. Keys longer than 255 bytes,
+ * values longer than 65535 bytes, and live state that does not fit in
+ * half the region are skipped and counted in skipped().
+ *
+ * Usage:
+ *   mcpd::StateStore state(128);
+ *   mcpd::PartitionStateStorage flash("mcpd_state");   // ESP32 data partition
+ *   mcpd::StatePersistence persist(state, flash);
+ *   persist.begin();                  // replays the saved state
+ *
+ *   persist.loop();                   // from loop(): up to ~2 ms of flash work
+ *   persist.flush();                  // before deep sleep
+ */
+
+#ifndef MCPD_STATE_PERSISTENCE_H
+#define MCPD_STATE_PERSISTENCE_H
+
+#include <Arduino.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "MCPStateStore.h"
+
+#ifdef ESP32
+#include <esp_partition.h>
+#endif
+
+namespace mcpd {
+
+/**
+ * Flash region behind StatePersistence. Offsets are relative to the start
+ * of the region. As on NOR flash, write() is only ever given erased (0xFF)
+ * bytes to program, and erase() resets one sector to 0xFF.
+ */
+class StateStorage {
+public:
+    virtual ~StateStorage() = default;
+    virtual size_t sectorSize() const = 0;
+    virtual size_t sectorCount() const = 0;
+    virtual bool read(size_t offset, uint8_t* data, size_t len) = 0;
+    virtual bool write(size_t offset, const uint8_t* data, size_t len) = 0;
+    virtual bool erase(size_t sector) = 0;
+};
+
+#ifdef ESP32
+/** A data partition from the partition table, found by label. */
+class PartitionStateStorage : public StateStorage {
+public:
+    explicit PartitionStateStorage(const char* label)
+        : _part(esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label)) {}
+
+    bool found() const { return _part != nullptr; }
+
+    size_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+    size_t sectorCount() const override { return _part ? _part->size / SPI_FLASH_SEC_SIZE : 0; }
+
+    bool read(size_t offset, uint8_t* data, size_t len) override {
+        return _part && esp_partition_read(_part, offset, data, len) == ESP_OK;
+    }
+
+    bool write(size_t offset, const uint8_t* data, size_t len) override {
+        return _part && esp_partition_write(_part, offset, data, len) == ESP_OK;
+    }
+
+    bool erase(size_t sector) override {
+        return _part && esp_partition_erase_range(_part, sector * SPI_FLASH_SEC_SIZE,
+                                                  SPI_FLASH_SEC_SIZE) == ESP_OK;
+    }
+
+private:
+    const esp_partition_t* _part;
+};
+#endif
+
+class StatePersistence {
+public:
+    static constexpr uint32_t MAGIC = 0x4C53434D;            // "MCSL"
+    static constexpr size_t HEADER_BYTES = 12;               // Magic, epoch, CRC
+    static constexpr size_t RECORD_HEADER_BYTES = 8;
+    static constexpr uint8_t RECORD_SET = 'S';
+    static constexpr uint8_t RECORD_REMOVE = 'D';
+    static constexpr size_t MAX_KEY_BYTES = 255;
+    static constexpr size_t MAX_VALUE_BYTES = 65535;
+    static constexpr unsigned long DEFAULT_BUDGET_US = 2000;
+    static constexpr uint8_t DEFAULT_COMPACT_PERCENT = 75;
+
+    StatePersistence(StateStore& state, StateStorage& storage)
+        : _state(&state), _storage(&storage) {}
+
+    ~StatePersistence() {
+        if (_mounted) _state->removeListener(_listenerId);
+    }
+
+    StatePersistence(const StatePersistence&) = delete;
+    StatePersistence& operator=(const StatePersistence&) = delete;
+
+    /**
+     * Mount the region and replay the saved state into the store. A region
+     * with no valid half is formatted. Keys still dirty afterwards (set
+     * before begin() and not in the log) are queued, and from here on every
+     * change to the store is.
+     * @return false if the region is too small or cannot be formatted
+     */
+    bool begin() {
+        if (_mounted) return true;
+        _sectorSize = _storage->sectorSize();
+        _halfSectors = _storage->sectorCount() / 2;
+        _halfBytes = _sectorSize * _halfSectors;
+        if (_halfSectors == 0 || _halfBytes <= HEADER_BYTES + RECORD_HEADER_BYTES) return false;
+
+        uint32_t epoch0 = 0, epoch1 = 0;
+        bool valid0 = _readHeader(0, epoch0);
+        bool valid1 = _readHeader(1, epoch1);
+        if (!valid0 && !valid1) {
+            if (!_format()) return false;
+        } else {
+            _active = (valid0 && (!valid1 || epoch0 > epoch1)) ? 0 : 1;
+            _epoch = _active == 0 ? epoch0 : epoch1;
+            _replay();
+        }
+        _baseBytes = _writePos;
+
+        // Changes made before begin() that the log did not overwrite
+        for (const String& key : _state->dirtyKeys()) _pending.insert(std::string(key.c_str()));
+        _listenerId = _state->onChange([this](const char* key, const char*, const char*) {
+            const StateEntry* e = _state->entry(key);
+            if (e && e->ttlMs > 0) return;
+            _pending.insert(std::string(key));
+        });
+        _mounted = true;
+        if (_tailDirty) _startCompaction();
+        return true;
+    }
+
+    /**
+     * Write queued changes and advance compaction until budgetUs has
+     * passed. At least one step runs per call, so a slow sector erase
+     * still makes progress.
+     * @return Number of steps (records written, sectors erased) run
+     */
+    size_t loop(unsigned long budgetUs = DEFAULT_BUDGET_US) {
+        if (!_mounted) return 0;
+        unsigned long start = micros();
+        size_t steps = 0;
+        while (_step()) {
+            steps++;
+            if (micros() - start >= budgetUs) break;
+        }
+        return steps;
+    }
+
+    /**
+     * Write everything queued, finishing any compaction, without a budget.
+     * @return false if a flash operation failed
+     */
+    bool flush() {
+        if (!_mounted) return false;
+        uint32_t errors = _writeErrors;
+        while (_step()) {
+            if (_writeErrors != errors) return false;
+        }
+        return true;
+    }
+
+    /** Start a compaction now (runs from loop()/flush()). */
+    void compact() {
+        if (_mounted && _phase == Phase::Idle) _startCompaction();
+    }
+
+    /**
+     * Compact once the log fills this share of its half (and has doubled
+     * since the last compaction). 100 = only when full.
+     */
+    void setCompactThreshold(uint8_t percent) {
+        _compactPercent = percent == 0 ? 1 : (percent > 100 ? 100 : percent);
+    }
+    uint8_t compactThreshold() const { return _compactPercent; }
+
+    bool mounted() const { return _mounted; }
+    bool compacting() const { return _phase != Phase::Idle; }
+    size_t pending() const { return _pending.size(); }
+    uint32_t epoch() const { return _epoch; }
+    uint8_t activeHalf() const { return _active; }
+    size_t bytesUsed() const { return _writePos; }
+    size_t capacityBytes() const { return _halfBytes; }
+    uint32_t replayed() const { return _replayed; }
+    uint32_t recordsWritten() const { return _recordsWritten; }
+    uint32_t compactions() const { return _compactions; }
+    uint32_t tornRecords() const { return _tornRecords; }
+    uint32_t writeErrors() const { return _writeErrors; }
+    uint32_t skipped() const { return _skipped; }
+
+    String statsJSON() const {
+        String json = "{\"mounted\":";
+        json += _mounted ? "true" : "false";
+        json += ",\"epoch\":";
+        json += String((unsigned long)_epoch);
+        json += ",\"bytesUsed\":";
+        json += String((unsigned long)_writePos);
+        json += ",\"capacityBytes\":";
+        json += String((unsigned long)_halfBytes);
+        json += ",\"pending\":";
+        json += String((unsigned long)_pending.size());
+        json += ",\"compacting\":";
+        json += compacting() ? "true" : "false";
+        json += ",\"records\":";
+        json += String((unsigned long)_recordsWritten);
+        json += ",\"replayed\":";
+        json += String((unsigned long)_replayed);
+        json += ",\"compactions\":";
+        json += String((unsigned long)_compactions);
+        json += ",\"tornRecords\":";
+        json += String((unsigned long)_tornRecords);
+        json += ",\"writeErrors\":";
+        json += String((unsigned long)_writeErrors);
+        json += ",\"skipped\":";
+        json += String((unsigned long)_skipped);
+        json += "}";
+        return json;
+    }
+
+    /** CRC-32 (IEEE 802.3), continued from crc (0 to start). */
+    static uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0) {
+        crc = ~crc;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; b++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320UL : crc >> 1;
+            }
+        }
+        return ~crc;
+    }
+
+private:
+    enum class Phase : uint8_t { Idle, Erasing, Copying, Committing };
+
+    StateStore* _state;
+    StateStorage* _storage;
+    size_t _listenerId = 0;
+    bool _mounted = false;
+
+    size_t _sectorSize = 0;
+    size_t _halfSectors = 0;
+    size_t _halfBytes = 0;
+    uint8_t _active = 0;
+    uint32_t _epoch = 0;
+    size_t _writePos = 0;
+    size_t _baseBytes = 0;                 // Log size after the last compaction
+    bool _tailDirty = false;               // Torn or failed write: compact before appending
+    uint8_t _compactPercent = DEFAULT_COMPACT_PERCENT;
+
+    std::set<std::string> _pending;
+    std::vector<uint8_t> _buf;
+
+    Phase _phase = Phase::Idle;
+    uint8_t _target = 0;
+    size_t _eraseNext = 0;
+    std::vector<String> _copyKeys;
+    size_t _copyIndex = 0;
+    size_t _copyPos = 0;
+
+    uint32_t _replayed = 0;
+    uint32_t _recordsWritten = 0;
+    uint32_t _compactions = 0;
+    uint32_t _tornRecords = 0;
+    uint32_t _writeErrors = 0;
+    uint32_t _skipped = 0;
+
+    static void _put32(uint8_t* p, uint32_t v) {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+
+    static uint32_t _get32(const uint8_t* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    size_t _halfOffset(uint8_t half) const { return half * _halfBytes; }
+
+    bool _readHeader(uint8_t half, uint32_t& epoch) {
+        uint8_t h[HEADER_BYTES];
+        if (!_storage->read(_halfOffset(half), h, HEADER_BYTES)) return false;
+        if (_get32(h) != MAGIC || _get32(h + 8) != crc32(h, 8)) return false;
+        epoch = _get32(h + 4);
+        return true;
+    }
+
+    bool _writeHeader(uint8_t half, uint32_t epoch) {
+        uint8_t h[HEADER_BYTES];
+        _put32(h, MAGIC);
+        _put32(h + 4, epoch);
+        _put32(h + 8, crc32(h, 8));
+        return _storage->write(_halfOffset(half), h, HEADER_BYTES);
+    }
+
+    bool _format() {
+        for (size_t s = 0; s < _halfSectors; s++) {
+            if (!_storage->erase(s)) return false;
+        }
+        if (!_writeHeader(0, 1)) return false;
+        _active = 0;
+        _epoch = 1;
+        _writePos = HEADER_BYTES;
+        return true;
+    }
+
+    bool _erasedFrom(size_t pos) {
+        uint8_t chunk[32];
+        while (pos < _halfBytes) {
+            size_t n = _halfBytes - pos < sizeof(chunk) ? _halfBytes - pos : sizeof(chunk);
+            if (!_storage->read(_halfOffset(_active) + pos, chunk, n)) return false;
+            for (size_t i = 0; i < n; i++) {
+                if (chunk[i] != 0xFF) return false;
+            }
+            pos += n;
+        }
+        return true;
+    }
+
+    void _replay() {
+        size_t base = _halfOffset(_active);
+        size_t pos = HEADER_BYTES;
+        uint8_t h[RECORD_HEADER_BYTES];
+        while (pos + RECORD_HEADER_BYTES <= _halfBytes) {
+            if (!_storage->read(base + pos, h, RECORD_HEADER_BYTES) || h[0] == 0xFF) break;
+            size_t keyLen = h[1];
+            size_t valueLen = h[2] | ((size_t)h[3] << 8);
+            size_t total = RECORD_HEADER_BYTES + keyLen + valueLen;
+            if ((h[0] != RECORD_SET && h[0] != RECORD_REMOVE) || keyLen == 0 ||
+                pos + total > _halfBytes) {
+                _tornRecords++;
+                break;
+            }
+
+            // Key and value, each NUL-terminated
+            _buf.resize(keyLen + valueLen + 2);
+            char* key = (char*)_buf.data();
+            char* value = key + keyLen + 1;
+            if (!_storage->read(base + pos + RECORD_HEADER_BYTES, (uint8_t*)key, keyLen) ||
+                !_storage->read(base + pos + RECORD_HEADER_BYTES + keyLen, (uint8_t*)value, valueLen)) {
+                break;
+            }
+            uint32_t crc = crc32(h, 4);
+            crc = crc32((const uint8_t*)key, keyLen, crc);
+            crc = crc32((const uint8_t*)value, valueLen, crc);
+            if (crc != _get32(h + 4)) {
+                _tornRecords++;
+                break;
+            }
+            key[keyLen] = '\0';
+            value[valueLen] = '\0';
+
+            if (h[0] == RECORD_SET) {
+                _state->set(key, value);
+                _state->clearDirty(key);
+            } else {
+                _state->remove(key);
+            }
+            _replayed++;
+            pos += total;
+        }
+        _writePos = pos;
+        if (!_erasedFrom(pos)) _tailDirty = true;
+    }
+
+    static size_t _recordSize(size_t keyLen, const StateEntry* e) {
+        return RECORD_HEADER_BYTES + keyLen + (e ? e->value.length() : 0);
+    }
+
+    bool _fits(size_t keyLen, const StateEntry* e) const {
+        return keyLen > 0 && keyLen <= MAX_KEY_BYTES &&
+               (!e || e->value.length() <= MAX_VALUE_BYTES) &&
+               _recordSize(keyLen, e) <= _halfBytes - HEADER_BYTES;
+    }
+
+    /** Write a set record (e != nullptr) or a remove record for key. */
+    bool _writeRecord(uint8_t half, size_t pos, const char* key, size_t keyLen, const StateEntry* e) {
+        size_t valueLen = e ? e->value.length() : 0;
+        _buf.resize(RECORD_HEADER_BYTES + keyLen + valueLen);
+        uint8_t* p = _buf.data();
+        p[0] = e ? RECORD_SET : RECORD_REMOVE;
+        p[1] = (uint8_t)keyLen;
+        p[2] = (uint8_t)valueLen;
+        p[3] = (uint8_t)(valueLen >> 8);
+        memcpy(p + RECORD_HEADER_BYTES, key, keyLen);
+        if (valueLen) memcpy(p + RECORD_HEADER_BYTES + keyLen, e->value.c_str(), valueLen);
+        uint32_t crc = crc32(p, 4);
+        _put32(p + 4, crc32(p + RECORD_HEADER_BYTES, keyLen + valueLen, crc));
+        if (!_storage->write(_halfOffset(half) + pos, p, _buf.size())) {
+            _writeErrors++;
+            return false;
+        }
+        _recordsWritten++;
+        return true;
+    }
+
+    bool _shouldCompact() const {
+        return _writePos * 100 >= _halfBytes * _compactPercent &&
+               _writePos - HEADER_BYTES >= 2 * (_baseBytes - HEADER_BYTES);
+    }
+
+    void _startCompaction() {
+        _phase = Phase::Erasing;
+        _target = 1 - _active;
+        _eraseNext = 0;
+        _copyKeys.clear();
+        _copyIndex = 0;
+        _copyPos = HEADER_BYTES;
+    }
+
+    /** One unit of work. @return false when there is nothing to do */
+    bool _step() {
+        if (_phase != Phase::Idle) {
+            _compactStep();
+            return true;
+        }
+        if (_tailDirty) {
+            _startCompaction();
+            return true;
+        }
+        if (_pending.empty()) return false;
+
+        auto it = _pending.begin();
+        const StateEntry* e = _state->entry(it->c_str());
+        if (e && e->ttlMs > 0) {
+            _pending.erase(it);
+            return true;
+        }
+        if (!_fits(it->size(), e)) {
+            _skipped++;
+            _pending.erase(it);
+            return true;
+        }
+        size_t size = _recordSize(it->size(), e);
+        if (_writePos + size > _halfBytes) {
+            _startCompaction();
+            return true;
+        }
+        if (!_writeRecord(_active, _writePos, it->c_str(), it->size(), e)) {
+            _tailDirty = true;                 // Part of the record may be on flash
+            return true;
+        }
+        _writePos += size;
+        if (e) _state->clearDirty(it->c_str());
+        _pending.erase(it);
+        if (_shouldCompact()) _startCompaction();
+        return true;
+    }
+
+    void _compactStep() {
+        switch (_phase) {
+            case Phase::Erasing:
+                // The header sector goes first, so the half is invalid from here on
+                if (!_storage->erase(_target * _halfSectors + _eraseNext)) {
+                    _writeErrors++;
+                    return;
+                }
+                if (++_eraseNext == _halfSectors) {
+                    // Everything present now is copied; queued keys were removed
+                    // or will be, and later changes queue again
+                    _copyKeys = _state->keys();
+                    _pending.clear();
+                    _phase = Phase::Copying;
+                }
+                return;
+
+            case Phase::Copying: {
+                if (_copyIndex == _copyKeys.size()) {
+                    _phase = Phase::Committing;
+                    return;
+                }
+                const String& key = _copyKeys[_copyIndex++];
+                const StateEntry* e = _state->entry(key.c_str());
+                if (!e || e->ttlMs > 0) return;
+                size_t size = _recordSize(key.length(), e);
+                if (!_fits(key.length(), e) || _copyPos + size > _halfBytes) {
+                    _skipped++;
+                    return;
+                }
+                if (!_writeRecord(_target, _copyPos, key.c_str(), key.length(), e)) {
+                    _startCompaction();
+                    return;
+                }
+                _copyPos += size;
+                _state->clearDirty(key.c_str());
+                _pending.erase(std::string(key.c_str()));
+                return;
+            }
+
+            case Phase::Committing:
+                if (!_writeHeader(_target, _epoch + 1)) {
+                    _writeErrors++;
+                    _startCompaction();
+                    return;
+                }
+                _active = _target;
+                _epoch++;
+                _writePos = _copyPos;
+                _baseBytes = _copyPos;
+                _tailDirty = false;
+                _compactions++;
+                _copyKeys.clear();
+                _copyKeys.shrink_to_fit();
+                _phase = Phase::Idle;
+                return;
+
+            case Phase::Idle:
+                return;
+        }
+    }
+};
+
+} // namespace mcpd
+
+#endif // MCPD_STATE_PERSISTENCE_H
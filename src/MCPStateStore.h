@@ -10,7 +10,7 @@
  * Features:
  *   - Namespaced keys (e.g. "sensor.calibration.offset")
  *   - Change listeners with old/new value
- *   - Dirty tracking for efficient persistence
+ *   - Dirty tracking for efficient persistence (see MCPStatePersistence.h)
  *   - Bounded size (max entries, evicts oldest-accessed on overflow)
  *   - Snapshot export/import (JSON)
  *   - TTL support (optional per-key expiry)
@@ -102,6 +102,16 @@ public:
         return it->second.value;
     }
 
+    /**
+     * Entry for a key, without updating its access time or checking TTL.
+     * @return nullptr if the key is not present
+     */
+    const StateEntry* entry(const char* key) const {
+        if (!key) return nullptr;
+        auto it = _entries.find(std::string(key));
+        return it == _entries.end() ? nullptr : &it->second;
+    }
+
     /**
      * Check if a key exists (and is not expired).
      */
@@ -245,6 +255,15 @@ public:
         }
     }
 
+    /**
+     * Clear the dirty flag of one key (e.g. once it has been persisted).
+     */
+    void clearDirty(const char* key) {
+        if (!key) return;
+        auto it = _entries.find(std::string(key));
+        if (it != _entries.end()) it->second.dirty = false;
+    }
+
     // ── Transactions ───────────────────────────────────────────────
 
     /**
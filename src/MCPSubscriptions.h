@@ -0,0 +1,297 @@
+/**
+ * mcpd — Resource Subscription Index
+ *
+ * Maps each subscribed resource URI, or resource-template pattern such as
+ * "sensor://{id}/reading", to a bitmask of subscribers. Every session (and
+ * the session-less WebSocket/BLE side, subscriber "") owns one bit, so
+ * notifyResourceUpdated() finds everyone interested in a URI with one map
+ * lookup plus a scan of the patterns, serializes the notification once and
+ * queues it only for the sessions whose bit is set.
+ *
+ * UpdateCoalescer limits how often one URI is announced: an update inside
+ * the window of the previous one is folded into a single notification sent
+ * when the window ends.
+ */
+
+#ifndef MCPD_SUBSCRIPTIONS_H
+#define MCPD_SUBSCRIPTIONS_H
+
+#include <Arduino.h>
+#include <iterator>
+#include <map>
+#include <vector>
+
+namespace mcpd {
+
+/**
+ * Match a concrete URI against an RFC 6570 Level 1 template without
+ * allocating. A variable matches a non-empty run up to the literal text
+ * that follows it (the rest of the URI when it ends the template, one path
+ * segment when another variable follows directly).
+ */
+inline bool uriTemplateMatches(const char* tpl, const char* uri) {
+    while (*tpl) {
+        if (*tpl != '{') {
+            if (*tpl++ != *uri++) return false;
+            continue;
+        }
+        const char* close = strchr(tpl, '}');
+        if (!close) return false;
+        tpl = close + 1;
+
+        const char* end;
+        size_t literal = strcspn(tpl, "{");
+        if (*tpl == '\0') {
+            end = uri + strlen(uri);
+        } else if (literal == 0) {
+            end = strchr(uri, '/');
+            if (!end) end = uri + strlen(uri);
+        } else {
+            end = nullptr;
+            for (const char* p = uri; *p; p++) {
+                if (strncmp(p, tpl, literal) == 0) { end = p; break; }
+            }
+            if (!end) return false;
+        }
+        if (end == uri) return false;  // Empty value
+        uri = end;
+    }
+    return *uri == '\0';
+}
+
+class SubscriptionIndex {
+public:
+    using Mask = uint32_t;
+    static constexpr size_t MAX_SUBSCRIBERS = 32;  // One bit each
+
+    /**
+     * Subscribe to a URI or, when it contains "{...}", a template pattern.
+     * @return false if every subscriber slot is taken
+     */
+    bool subscribe(const String& subscriber, const String& uri) {
+        int slot = _slot(subscriber);
+        if (slot < 0) slot = _allocSlot(subscriber);
+        if (slot < 0) return false;
+        Mask bit = (Mask)1 << slot;
+        if (_isPattern(uri)) {
+            for (auto& p : _patterns) {
+                if (p.pattern == uri) { p.mask |= bit; return true; }
+            }
+            _patterns.push_back({uri, bit});
+        } else {
+            _exact[uri] |= bit;
+        }
+        return true;
+    }
+
+    /** @return true if the subscriber was subscribed to this URI/pattern */
+    bool unsubscribe(const String& subscriber, const String& uri) {
+        int slot = _slot(subscriber);
+        if (slot < 0) return false;
+        Mask bit = (Mask)1 << slot;
+        bool found = false;
+        if (_isPattern(uri)) {
+            for (auto it = _patterns.begin(); it != _patterns.end(); ++it) {
+                if (it->pattern == uri && (it->mask & bit)) {
+                    it->mask &= ~bit;
+                    if (!it->mask) _patterns.erase(it);
+                    found = true;
+                    break;
+                }
+            }
+        } else {
+            auto it = _exact.find(uri);
+            if (it != _exact.end() && (it->second & bit)) {
+                it->second &= ~bit;
+                if (!it->second) _exact.erase(it);
+                found = true;
+            }
+        }
+        if (found && subscriptionCount(subscriber) == 0) _freeSlot(slot);
+        return found;
+    }
+
+    /** Drop all of a subscriber's subscriptions (session ended). */
+    void removeSubscriber(const String& subscriber) {
+        int slot = _slot(subscriber);
+        if (slot < 0) return;
+        Mask bit = (Mask)1 << slot;
+        for (auto it = _exact.begin(); it != _exact.end();) {
+            it->second &= ~bit;
+            it = it->second ? std::next(it) : _exact.erase(it);
+        }
+        for (auto it = _patterns.begin(); it != _patterns.end();) {
+            it->mask &= ~bit;
+            it = it->mask ? std::next(it) : _patterns.erase(it);
+        }
+        _freeSlot(slot);
+    }
+
+    /** Subscribers interested in a concrete URI (exact and pattern matches). */
+    Mask match(const String& uri) const {
+        Mask mask = 0;
+        auto it = _exact.find(uri);
+        if (it != _exact.end()) mask = it->second;
+        for (const auto& p : _patterns) {
+            if ((mask | p.mask) != mask && uriTemplateMatches(p.pattern.c_str(), uri.c_str())) {
+                mask |= p.mask;
+            }
+        }
+        return mask;
+    }
+
+    /** Whether a subscriber would be notified for this URI. */
+    bool isSubscribed(const String& subscriber, const String& uri) const {
+        int slot = _slot(subscriber);
+        return slot >= 0 && (match(uri) & ((Mask)1 << slot));
+    }
+
+    /** Call fn(subscriber) for every subscriber in a mask. */
+    template <typename F>
+    void forEachSubscriber(Mask mask, F fn) const {
+        mask &= _used;
+        for (size_t i = 0; mask; i++, mask >>= 1) {
+            if (mask & 1) fn(_subscribers[i]);
+        }
+    }
+
+    /** URIs and patterns one subscriber holds. */
+    size_t subscriptionCount(const String& subscriber) const {
+        int slot = _slot(subscriber);
+        if (slot < 0) return 0;
+        Mask bit = (Mask)1 << slot;
+        size_t n = 0;
+        for (const auto& kv : _exact) if (kv.second & bit) n++;
+        for (const auto& p : _patterns) if (p.mask & bit) n++;
+        return n;
+    }
+
+    size_t uriCount() const { return _exact.size(); }
+    size_t patternCount() const { return _patterns.size(); }
+
+    size_t subscriberCount() const {
+        size_t n = 0;
+        for (Mask m = _used; m; m &= m - 1) n++;
+        return n;
+    }
+
+    void clear() {
+        _exact.clear();
+        _patterns.clear();
+        for (auto& s : _subscribers) s = String();
+        _used = 0;
+    }
+
+private:
+    struct Pattern {
+        String pattern;
+        Mask mask;
+    };
+
+    std::map<String, Mask> _exact;
+    std::vector<Pattern> _patterns;
+    String _subscribers[MAX_SUBSCRIBERS];
+    Mask _used = 0;
+
+    static bool _isPattern(const String& uri) {
+        int open = uri.indexOf('{');
+        return open >= 0 && uri.indexOf('}', open) > open;
+    }
+
+    int _slot(const String& subscriber) const {
+        for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+            if ((_used & ((Mask)1 << i)) && _subscribers[i] == subscriber) return (int)i;
+        }
+        return -1;
+    }
+
+    int _allocSlot(const String& subscriber) {
+        for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+            if (!(_used & ((Mask)1 << i))) {
+                _used |= (Mask)1 << i;
+                _subscribers[i] = subscriber;
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    void _freeSlot(int slot) {
+        _used &= ~((Mask)1 << slot);
+        _subscribers[slot] = String();
+    }
+};
+
+/**
+ * Per-URI rate limit for resources/updated. The first update of a URI is
+ * sent at once; later ones inside the window only mark it dirty, and
+ * flush() sends one notification for them when the window has passed.
+ */
+class UpdateCoalescer {
+public:
+    /** Window in ms (0 = send every update immediately, the default). */
+    void setWindow(unsigned long windowMs) {
+        _windowMs = windowMs;
+        if (windowMs == 0) _entries.clear();
+    }
+    unsigned long window() const { return _windowMs; }
+
+    /**
+     * @return true if the update should be sent now, false if it was
+     *         folded into a pending one
+     */
+    bool admit(const String& uri, unsigned long now) {
+        if (_windowMs == 0) return true;
+        auto it = _entries.find(uri);
+        if (it != _entries.end() && now - it->second.sentAt < _windowMs) {
+            if (it->second.dirty) _coalesced++;
+            it->second.dirty = true;
+            return false;
+        }
+        _entries[uri] = Entry{now, false};
+        return true;
+    }
+
+    /**
+     * Send the pending updates whose window has ended via send(uri) and
+     * forget idle URIs.
+     * @return number of updates sent
+     */
+    template <typename F>
+    size_t flush(unsigned long now, F send) {
+        size_t sent = 0;
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            if (now - it->second.sentAt < _windowMs) { ++it; continue; }
+            if (!it->second.dirty) { it = _entries.erase(it); continue; }
+            it->second = Entry{now, false};
+            send(it->first);
+            sent++;
+            ++it;
+        }
+        return sent;
+    }
+
+    /** Updates absorbed into another notification */
+    unsigned long coalesced() const { return _coalesced; }
+
+    /** URIs with an update waiting for flush() */
+    size_t pending() const {
+        size_t n = 0;
+        for (const auto& kv : _entries) if (kv.second.dirty) n++;
+        return n;
+    }
+
+private:
+    struct Entry {
+        unsigned long sentAt;
+        bool dirty;
+    };
+
+    std::map<String, Entry> _entries;
+    unsigned long _windowMs = 0;
+    unsigned long _coalesced = 0;
+};
+
+} // namespace mcpd
+
+#endif // MCPD_SUBSCRIPTIONS_H
@@ -0,0 +1,629 @@
+/**
+ * mcpd — Time-Series Store
+ *
+ * Typed, compressed storage for sensor readings. Logging a float through
+ * EventStore costs a String per reading (~80 bytes); here a series keeps
+ * (timestamp, value) pairs in fixed-size blocks of a bit stream:
+ *
+ *   - timestamps as delta-of-delta (a steady 1 Hz stream costs 1 bit)
+ *   - float values XORed with the previous value (Gorilla encoding: an
+ *     unchanged reading costs 1 bit, a small change ~10-20 bits)
+ *   - int values as deltas with the same variable-length buckets
+ *
+ * Every block starts with a raw point, so blocks decode independently and
+ * the oldest block is dropped whole when the series is full.
+ *
+ * Rollups (min/max/avg/count per time bucket) are kept in small rings and
+ * updated on every append, so a one-minute or one-hour view can outlive
+ * the raw points it was built from.
+ *
+ * Timestamps are uint32 milliseconds (millis() by default) and must not
+ * decrease within a series.
+ *
+ * Usage:
+ *   mcpd::TimeSeriesStore series;
+ *   auto& temp = series.add("temperature", 8192, mcpd::SeriesType::Float, "C");
+ *   temp.addRollup(60000, 60);          // Per minute, last hour
+ *   temp.addRollup(3600000, 48);        // Per hour, last two days
+ *   temp.record(22.5f);                 // Stamped with millis()
+ *
+ *   temp.forEach(from, to, [](uint32_t ts, double v) { ...; return true; });
+ *   temp.rollup(60000, from, to, [](const SeriesBucket& b) { ...; return true; });
+ */
+
+#ifndef MCPD_TIME_SERIES_H
+#define MCPD_TIME_SERIES_H
+
+#include <Arduino.h>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace mcpd {
+
+enum class SeriesType : uint8_t {
+    Float = 0,
+    Int = 1
+};
+
+inline const char* seriesTypeToString(SeriesType t) {
+    return t == SeriesType::Int ? "int" : "float";
+}
+
+/** Aggregate of the points in [startMs, startMs + bucketMs). */
+struct SeriesBucket {
+    uint32_t startMs = 0;
+    uint32_t count = 0;
+    float min = 0;
+    float max = 0;
+    double sum = 0;
+
+    double avg() const { return count ? sum / count : 0; }
+
+    void add(double v) {
+        if (count == 0 || v < min) min = (float)v;
+        if (count == 0 || v > max) max = (float)v;
+        sum += v;
+        count++;
+    }
+};
+
+/** MSB-first bit stream over a caller-owned buffer. */
+class BitWriter {
+public:
+    BitWriter(uint8_t* buf, size_t bitPos, size_t bitLimit)
+        : _buf(buf), _pos(bitPos), _limit(bitLimit) {}
+
+    /** Append the low n bits of v (n <= 32). Past the limit, bits are dropped. */
+    void write(uint32_t v, uint8_t n) {
+        while (n > 0) {
+            if (_pos >= _limit) {
+                _overflow = true;
+                return;
+            }
+            n--;
+            uint8_t mask = (uint8_t)(0x80 >> (_pos & 7));
+            if ((v >> n) & 1) _buf[_pos >> 3] |= mask;
+            else _buf[_pos >> 3] &= (uint8_t)~mask;
+            _pos++;
+        }
+    }
+
+    size_t position() const { return _pos; }
+    bool overflow() const { return _overflow; }
+
+private:
+    uint8_t* _buf;
+    size_t _pos;
+    size_t _limit;
+    bool _overflow = false;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* buf, size_t bitPos = 0) : _buf(buf), _pos(bitPos) {}
+
+    uint32_t read(uint8_t n) {
+        uint32_t v = 0;
+        while (n-- > 0) {
+            v = (v << 1) | ((_buf[_pos >> 3] >> (7 - (_pos & 7))) & 1);
+            _pos++;
+        }
+        return v;
+    }
+
+    size_t position() const { return _pos; }
+
+private:
+    const uint8_t* _buf;
+    size_t _pos;
+};
+
+class TimeSeries {
+public:
+    static constexpr size_t DEFAULT_CAPACITY_BYTES = 4096;
+    static constexpr size_t BLOCK_BYTES = 128;
+    static constexpr size_t MAX_ROLLUPS = 4;
+
+    /**
+     * @param name           Series name (used in resource URIs and queries)
+     * @param capacityBytes  Compressed point storage, split into
+     *                       BLOCK_BYTES blocks (at least two)
+     * @param type           Float (XOR-compressed) or Int (delta-compressed)
+     * @param unit           Optional unit label ("C", "%", "mV")
+     */
+    explicit TimeSeries(const char* name, size_t capacityBytes = DEFAULT_CAPACITY_BYTES,
+                        SeriesType type = SeriesType::Float, const char* unit = "")
+        : _name(name), _unit(unit ? unit : ""), _type(type) {
+        _blockCapacity = capacityBytes / BLOCK_BYTES;
+        if (_blockCapacity < 2) _blockCapacity = 2;
+        _data.reset(new uint8_t[_blockCapacity * BLOCK_BYTES]);
+        _blocks.reset(new Block[_blockCapacity]);
+    }
+
+    TimeSeries(const TimeSeries&) = delete;
+    TimeSeries& operator=(const TimeSeries&) = delete;
+
+    const String& name() const { return _name; }
+    const String& unit() const { return _unit; }
+    SeriesType type() const { return _type; }
+
+    // ── Rollups ────────────────────────────────────────────────────────
+
+    /**
+     * Keep min/max/avg/count for the last `buckets` buckets of bucketMs,
+     * updated on every append. Returns false if MAX_ROLLUPS are already
+     * configured. Points appended before the call are not included.
+     */
+    bool addRollup(uint32_t bucketMs, size_t buckets) {
+        if (_rollups.size() >= MAX_ROLLUPS || bucketMs == 0 || buckets == 0) return false;
+        Rollup r;
+        r.bucketMs = bucketMs;
+        r.capacity = buckets;
+        r.buckets.reset(new SeriesBucket[buckets]);
+        _rollups.push_back(std::move(r));
+        return true;
+    }
+
+    size_t rollupCount() const { return _rollups.size(); }
+    uint32_t rollupBucketMs(size_t i) const { return _rollups[i].bucketMs; }
+
+    // ── Append ─────────────────────────────────────────────────────────
+
+    /**
+     * Append a reading. Int series round the value.
+     * @return false if ts is older than the last point (the point is dropped)
+     */
+    bool append(uint32_t ts, double value) {
+        if (_total > 0 && ts < _lastTs) {
+            _outOfOrder++;
+            return false;
+        }
+        uint32_t bits = _type == SeriesType::Int ? (uint32_t)(int32_t)lround(value)
+                                                 : _floatBits((float)value);
+        if (_blockCount == 0 || !_encode(_blocks[_newest()], ts, bits)) {
+            _startBlock(ts, bits);
+        }
+        _lastTs = ts;
+        _lastBits = bits;
+        _total++;
+
+        double stored = _decodeValue(bits);
+        for (Rollup& r : _rollups) _addToRollup(r, ts, stored);
+        return true;
+    }
+
+    /** Append a reading stamped with millis(). */
+    bool record(double value) { return append((uint32_t)millis(), value); }
+
+    // ── Queries ────────────────────────────────────────────────────────
+
+    /**
+     * Call fn(uint32_t ts, double value) for each stored point with
+     * fromMs <= ts <= toMs, oldest first. fn returns false to stop.
+     * @return Points visited
+     */
+    template <typename Fn>
+    size_t forEach(uint32_t fromMs, uint32_t toMs, Fn fn) const {
+        size_t visited = 0;
+        for (size_t i = 0; i < _blockCount; i++) {
+            const Block& b = _blocks[(_oldest + i) % _blockCapacity];
+            if (b.lastTs < fromMs) continue;
+            if (b.firstTs > toMs) break;
+            Decoder d(*this, b);
+            uint32_t ts;
+            uint32_t bits;
+            while (d.next(ts, bits)) {
+                if (ts > toMs) return visited;
+                if (ts < fromMs) continue;
+                visited++;
+                if (!fn(ts, _decodeValue(bits))) return visited;
+            }
+        }
+        return visited;
+    }
+
+    /** All stored points, oldest first. */
+    template <typename Fn>
+    size_t forEach(Fn fn) const { return forEach(0, UINT32_MAX, fn); }
+
+    /**
+     * Call fn(const SeriesBucket&) for each non-empty bucketMs bucket
+     * overlapping [fromMs, toMs], oldest first. Served from a rollup with
+     * that bucket size when there is one, else computed from the stored
+     * points. fn returns false to stop.
+     * @return Buckets visited
+     */
+    template <typename Fn>
+    size_t rollup(uint32_t bucketMs, uint32_t fromMs, uint32_t toMs, Fn fn) const {
+        if (bucketMs == 0) return 0;
+        for (const Rollup& r : _rollups) {
+            if (r.bucketMs != bucketMs) continue;
+            size_t visited = 0;
+            for (size_t i = 0; i < r.count; i++) {
+                const SeriesBucket& b = r.buckets[(r.oldest + i) % r.capacity];
+                if (b.count == 0) continue;
+                if (b.startMs > toMs) break;
+                if (b.startMs + (bucketMs - 1) < fromMs) continue;
+                visited++;
+                if (!fn(b)) break;
+            }
+            return visited;
+        }
+
+        size_t visited = 0;
+        bool stopped = false;
+        SeriesBucket cur;
+        forEach(fromMs, toMs, [&](uint32_t ts, double v) {
+            uint32_t start = ts - ts % bucketMs;
+            if (cur.count > 0 && start != cur.startMs) {
+                visited++;
+                if (!fn(cur)) {
+                    stopped = true;
+                    return false;
+                }
+                cur = SeriesBucket();
+            }
+            cur.startMs = start;
+            cur.add(v);
+            return true;
+        });
+        if (!stopped && cur.count > 0) {
+            visited++;
+            fn(cur);
+        }
+        return visited;
+    }
+
+    /** True if rollup(bucketMs, ...) is served from a maintained rollup. */
+    bool hasRollup(uint32_t bucketMs) const {
+        for (const Rollup& r : _rollups) {
+            if (r.bucketMs == bucketMs) return true;
+        }
+        return false;
+    }
+
+    // ── Stats ──────────────────────────────────────────────────────────
+
+    /** Points currently stored. */
+    size_t count() const { return _stored; }
+    /** Points ever appended (including evicted ones). */
+    uint32_t totalAppended() const { return _total; }
+    /** Points dropped because their timestamp went backwards. */
+    uint32_t outOfOrder() const { return _outOfOrder; }
+
+    bool empty() const { return _stored == 0; }
+    uint32_t firstTimestamp() const { return _blockCount ? _blocks[_oldest].firstTs : 0; }
+    uint32_t lastTimestamp() const { return _lastTs; }
+    double lastValue() const { return _decodeValue(_lastBits); }
+
+    /** Bytes of point storage allocated. */
+    size_t capacityBytes() const { return _blockCapacity * BLOCK_BYTES; }
+
+    /** Bytes of encoded points (rounded up per block). */
+    size_t bytesUsed() const {
+        size_t bytes = 0;
+        for (size_t i = 0; i < _blockCount; i++) {
+            bytes += (_blocks[(_oldest + i) % _blockCapacity].bits + 7) / 8;
+        }
+        return bytes;
+    }
+
+    /** Average encoded size per stored point, in bits. */
+    float bitsPerPoint() const {
+        size_t bits = 0;
+        for (size_t i = 0; i < _blockCount; i++) {
+            bits += _blocks[(_oldest + i) % _blockCapacity].bits;
+        }
+        return _stored ? (float)bits / (float)_stored : 0.0f;
+    }
+
+    /** Drop all points and rollup buckets. */
+    void clear() {
+        _blockCount = 0;
+        _oldest = 0;
+        _stored = 0;
+        _lastTs = 0;
+        _lastBits = 0;
+        _total = 0;
+        for (Rollup& r : _rollups) {
+            r.count = 0;
+            r.oldest = 0;
+        }
+    }
+
+private:
+    // A block is self-contained: a raw first point, then encoded points.
+    struct Block {
+        uint32_t firstTs = 0;
+        uint32_t lastTs = 0;
+        uint16_t bits = 0;    // Bits written
+        uint16_t count = 0;   // Points in the block
+        // Encoder state after the last point
+        uint32_t prevDelta = 0;
+        uint32_t prevBits = 0;
+        uint8_t prevLeading = 0xFF;  // 0xFF = no XOR window yet
+        uint8_t prevTrailing = 0;
+    };
+
+    struct Rollup {
+        uint32_t bucketMs = 0;
+        size_t capacity = 0;
+        size_t oldest = 0;
+        size_t count = 0;
+        std::unique_ptr<SeriesBucket[]> buckets;
+    };
+
+    String _name;
+    String _unit;
+    SeriesType _type;
+
+    std::unique_ptr<uint8_t[]> _data;
+    std::unique_ptr<Block[]> _blocks;
+    size_t _blockCapacity = 0;
+    size_t _oldest = 0;
+    size_t _blockCount = 0;
+    size_t _stored = 0;
+
+    uint32_t _lastTs = 0;
+    uint32_t _lastBits = 0;
+    uint32_t _total = 0;
+    uint32_t _outOfOrder = 0;
+
+    std::vector<Rollup> _rollups;
+
+    size_t _newest() const { return (_oldest + _blockCount - 1) % _blockCapacity; }
+    uint8_t* _blockData(const Block& b) const {
+        return _data.get() + (size_t)(&b - _blocks.get()) * BLOCK_BYTES;
+    }
+
+    static uint32_t _floatBits(float f) {
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+
+    double _decodeValue(uint32_t bits) const {
+        if (_type == SeriesType::Int) return (double)(int32_t)bits;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    static uint8_t _leadingZeros(uint32_t v) {
+        uint8_t n = 0;
+        for (uint32_t m = 0x80000000u; m && !(v & m); m >>= 1) n++;
+        return n;
+    }
+
+    static uint8_t _trailingZeros(uint32_t v) {
+        uint8_t n = 0;
+        for (; n < 32 && !(v & 1); v >>= 1) n++;
+        return n;
+    }
+
+    // Signed value in variable-length buckets:
+    //   '0' = 0, '10' + 7 bits, '110' + 9 bits, '1110' + 12 bits, '1111' + 32 bits
+    static void _writeSigned(BitWriter& w, int32_t v) {
+        if (v == 0) {
+            w.write(0, 1);
+        } else if (v >= -63 && v <= 64) {
+            w.write(0x2, 2);
+            w.write((uint32_t)(v + 63), 7);
+        } else if (v >= -255 && v <= 256) {
+            w.write(0x6, 3);
+            w.write((uint32_t)(v + 255), 9);
+        } else if (v >= -2047 && v <= 2048) {
+            w.write(0xE, 4);
+            w.write((uint32_t)(v + 2047), 12);
+        } else {
+            w.write(0xF, 4);
+            w.write((uint32_t)v, 32);
+        }
+    }
+
+    static int32_t _readSigned(BitReader& r) {
+        if (r.read(1) == 0) return 0;
+        if (r.read(1) == 0) return (int32_t)r.read(7) - 63;
+        if (r.read(1) == 0) return (int32_t)r.read(9) - 255;
+        if (r.read(1) == 0) return (int32_t)r.read(12) - 2047;
+        return (int32_t)r.read(32);
+    }
+
+    // Encode a point after the block's last one; on overflow the block is
+    // left as it was and false is returned
+    bool _encode(Block& b, uint32_t ts, uint32_t bits) {
+        BitWriter w(_blockData(b), b.bits, BLOCK_BYTES * 8);
+        uint32_t delta = ts - b.lastTs;
+        _writeSigned(w, (int32_t)(delta - b.prevDelta));
+
+        uint8_t leading = b.prevLeading;
+        uint8_t trailing = b.prevTrailing;
+        if (_type == SeriesType::Int) {
+            _writeSigned(w, (int32_t)(bits - b.prevBits));
+        } else {
+            uint32_t x = bits ^ b.prevBits;
+            if (x == 0) {
+                w.write(0, 1);
+            } else {
+                w.write(1, 1);
+                uint8_t lz = _leadingZeros(x);
+                uint8_t tz = _trailingZeros(x);
+                if (b.prevLeading != 0xFF && lz >= b.prevLeading && tz >= b.prevTrailing) {
+                    // Fits the previous window
+                    w.write(0, 1);
+                    w.write(x >> b.prevTrailing, 32 - b.prevLeading - b.prevTrailing);
+                } else {
+                    uint8_t len = 32 - lz - tz;
+                    w.write(1, 1);
+                    w.write(lz, 5);
+                    w.write(len - 1, 5);
+                    w.write(x >> tz, len);
+                    leading = lz;
+                    trailing = tz;
+                }
+            }
+        }
+        if (w.overflow()) return false;
+
+        b.bits = (uint16_t)w.position();
+        b.count++;
+        b.lastTs = ts;
+        b.prevDelta = delta;
+        b.prevBits = bits;
+        b.prevLeading = leading;
+        b.prevTrailing = trailing;
+        _stored++;
+        return true;
+    }
+
+    void _startBlock(uint32_t ts, uint32_t bits) {
+        if (_blockCount == _blockCapacity) {
+            _stored -= _blocks[_oldest].count;
+            _oldest = (_oldest + 1) % _blockCapacity;
+            _blockCount--;
+        }
+        _blockCount++;
+        Block& b = _blocks[_newest()];
+        b = Block();
+        BitWriter w(_blockData(b), 0, BLOCK_BYTES * 8);
+        w.write(ts, 32);
+        w.write(bits, 32);
+        b.bits = (uint16_t)w.position();
+        b.count = 1;
+        b.firstTs = b.lastTs = ts;
+        b.prevBits = bits;
+        _stored++;
+    }
+
+    // Replays a block's encoder
+    class Decoder {
+    public:
+        Decoder(const TimeSeries& s, const Block& b)
+            : _series(s), _block(b), _r(s._blockData(b)) {}
+
+        bool next(uint32_t& ts, uint32_t& bits) {
+            if (_index == _block.count) return false;
+            if (_index == 0) {
+                _ts = _r.read(32);
+                _bits = _r.read(32);
+            } else {
+                _delta += (uint32_t)_readSigned(_r);
+                _ts += _delta;
+                if (_series._type == SeriesType::Int) {
+                    _bits += (uint32_t)_readSigned(_r);
+                } else if (_r.read(1)) {
+                    if (_r.read(1)) {
+                        _leading = (uint8_t)_r.read(5);
+                        uint8_t len = (uint8_t)(_r.read(5) + 1);
+                        _trailing = 32 - _leading - len;
+                    }
+                    uint8_t len = 32 - _leading - _trailing;
+                    _bits ^= _r.read(len) << _trailing;
+                }
+            }
+            _index++;
+            ts = _ts;
+            bits = _bits;
+            return true;
+        }
+
+    private:
+        const TimeSeries& _series;
+        const Block& _block;
+        BitReader _r;
+        uint16_t _index = 0;
+        uint32_t _ts = 0;
+        uint32_t _delta = 0;
+        uint32_t _bits = 0;
+        uint8_t _leading = 0;
+        uint8_t _trailing = 0;
+    };
+
+    static void _addToRollup(Rollup& r, uint32_t ts, double v) {
+        uint32_t start = ts - ts % r.bucketMs;
+        if (r.count == 0) {
+            r.oldest = 0;
+            r.count = 1;
+            r.buckets[0] = SeriesBucket();
+            r.buckets[0].startMs = start;
+        } else {
+            size_t newest = (r.oldest + r.count - 1) % r.capacity;
+            uint32_t newestStart = r.buckets[newest].startMs;
+            if (start != newestStart) {
+                // Open empty buckets up to the new one; a long gap only
+                // needs the last `capacity` of them
+                uint32_t steps = (start - newestStart) / r.bucketMs;
+                if (steps > r.capacity) steps = (uint32_t)r.capacity;
+                for (uint32_t i = steps; i > 0; i--) {
+                    if (r.count == r.capacity) {
+                        r.oldest = (r.oldest + 1) % r.capacity;
+                        r.count--;
+                    }
+                    size_t slot = (r.oldest + r.count) % r.capacity;
+                    r.buckets[slot] = SeriesBucket();
+                    r.buckets[slot].startMs = start - (i - 1) * r.bucketMs;
+                    r.count++;
+                }
+            }
+        }
+        r.buckets[(r.oldest + r.count - 1) % r.capacity].add(v);
+    }
+};
+
+/**
+ * Named collection of series.
+ */
+class TimeSeriesStore {
+public:
+    /**
+     * Add a series, or return the existing one with that name.
+     */
+    TimeSeries& add(const char* name, size_t capacityBytes = TimeSeries::DEFAULT_CAPACITY_BYTES,
+                    SeriesType type = SeriesType::Float, const char* unit = "") {
+        if (TimeSeries* s = find(name)) return *s;
+        _series.emplace_back(new TimeSeries(name, capacityBytes, type, unit));
+        return *_series.back();
+    }
+
+    /** @return nullptr if no series has this name */
+    TimeSeries* find(const char* name) {
+        for (auto& s : _series) {
+            if (s->name() == name) return s.get();
+        }
+        return nullptr;
+    }
+    const TimeSeries* find(const char* name) const {
+        return const_cast<TimeSeriesStore*>(this)->find(name);
+    }
+
+    /** Append to a named series. @return false if unknown or out of order */
+    bool append(const char* name, uint32_t ts, double value) {
+        TimeSeries* s = find(name);
+        return s && s->append(ts, value);
+    }
+
+    /** Append to a named series, stamped with millis(). */
+    bool record(const char* name, double value) {
+        return append(name, (uint32_t)millis(), value);
+    }
+
+    size_t size() const { return _series.size(); }
+    TimeSeries& at(size_t i) { return *_series[i]; }
+    const TimeSeries& at(size_t i) const { return *_series[i]; }
+
+    /** Point storage allocated across all series. */
+    size_t capacityBytes() const {
+        size_t n = 0;
+        for (auto& s : _series) n += s->capacityBytes();
+        return n;
+    }
+
+private:
+    std::vector<std::unique_ptr<TimeSeries>> _series;
+};
+
+} // namespace mcpd
+
+#endif // MCPD_TIME_SERIES_H
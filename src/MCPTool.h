@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "MCPIcon.h"
+#include "MCPValidation.h"
 
 namespace mcpd {
 
@@ -60,6 +61,11 @@ struct MCPTool {
     MCPToolAnnotations annotations;
     std::vector<MCPIcon> icons; // Optional: icons for UI display (MCP 2025-11-25)
 
+    // Pre-parsed schemas used by input/output validation. Filled in by the
+    // server at registration (or when validation is enabled).
+    CompiledSchema compiledInputSchema;
+    CompiledSchema compiledOutputSchema;
+
     MCPTool() = default;
 
     MCPTool(const char* name, const char* description,
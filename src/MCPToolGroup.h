@@ -52,6 +52,7 @@ public:
         String key(name);
         if (_groups.count(key)) return false;
         _groups[key] = ToolGroup(name, description);
+        _revision++;
         return true;
     }
 
@@ -72,6 +73,7 @@ public:
             }
         }
         _groups.erase(it);
+        _revision++;
         return true;
     }
 
@@ -89,6 +91,7 @@ public:
         bool inserted = _groups[gKey].tools.insert(tKey).second;
         if (inserted) {
             _toolToGroups[tKey].insert(gKey);
+            _revision++;
         }
         return inserted;
     }
@@ -109,6 +112,7 @@ public:
                 tit->second.erase(gKey);
                 if (tit->second.empty()) _toolToGroups.erase(tit);
             }
+            _revision++;
         }
         return erased;
     }
@@ -121,7 +125,10 @@ public:
         String key(name);
         auto it = _groups.find(key);
         if (it == _groups.end()) return false;
-        it->second.enabled = enabled;
+        if (it->second.enabled != enabled) {
+            it->second.enabled = enabled;
+            _revision++;
+        }
         return true;
     }
 
@@ -204,6 +211,12 @@ public:
         return &it->second;
     }
 
+    /**
+     * Revision counter, bumped on every change that can affect
+     * isToolGroupDisabled(). Lets callers cache per-tool results.
+     */
+    uint32_t revision() const { return _revision; }
+
     /**
      * Get total number of groups.
      */
@@ -241,6 +254,7 @@ public:
 private:
     std::map<String, ToolGroup> _groups;
     std::map<String, std::set<String>> _toolToGroups;  // reverse index: tool → groups
+    uint32_t _revision = 0;
 };
 
 } // namespace mcpd
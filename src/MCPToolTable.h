@@ -0,0 +1,166 @@
+/**
+ * mcpd — Tool Table
+ *
+ * Hash index over the server's registered tools. Every tools/call used to
+ * walk the tool vector comparing names, walk the rich-handler list, and then
+ * do two more map lookups for task support. The table keeps one compact slot
+ * per tool (parallel to Server::_tools) holding everything a call needs, and
+ * resolves a name to its slot with a single open-addressing probe.
+ *
+ * Group membership and cache TTLs are owned by ToolGroupManager and
+ * ToolResultCache. Their effective values are mirrored into the slots and
+ * refreshed lazily whenever either manager's revision counter changes.
+ */
+
+#ifndef MCPD_TOOL_TABLE_H
+#define MCPD_TOOL_TABLE_H
+
+#include <Arduino.h>
+#include <vector>
+
+#include "MCPTool.h"
+#include "MCPContent.h"
+#include "MCPTask.h"
+
+namespace mcpd {
+
+/**
+ * FNV-1a hash of a tool name. Precomputed once at registration.
+ */
+inline uint32_t toolNameHash(const char* name) {
+    uint32_t h = 2166136261u;
+    if (!name) return h;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Per-tool dispatch state. Slot i describes Server::_tools[i].
+ */
+struct ToolSlot {
+    uint32_t hash = 0;
+    TaskSupport taskSupport = TaskSupport::Forbidden;
+    bool enabled = true;           // Explicit enableTool()/disableTool() state
+    bool groupDisabled = false;    // Mirrored from ToolGroupManager
+    unsigned long cacheTtlMs = 0;  // Mirrored from ToolResultCache (0 = not cached)
+    MCPRichToolHandler richHandler;
+    MCPTaskToolHandler taskHandler;
+
+    /** Effective visibility: hidden if disabled individually or by group. */
+    bool isCallable() const { return enabled && !groupDisabled; }
+};
+
+/**
+ * Open-addressing (linear probe) name index with one ToolSlot per tool.
+ *
+ * The table does not own tool names; callers pass the tool vector and
+ * candidates are verified against it, so each name is stored exactly once.
+ * When several tools share a name the first registered one wins, matching
+ * the previous linear-scan behaviour.
+ */
+class ToolTable {
+public:
+    static constexpr uint16_t EMPTY = 0xFFFF;
+
+    /**
+     * Register the most recently appended tool (tools.back()).
+     * @return index of the slot that owns this name (the existing one
+     *         for duplicate names)
+     */
+    size_t add(const std::vector<MCPTool>& tools) {
+        size_t idx = tools.size() - 1;
+        ToolSlot slot;
+        slot.hash = toolNameHash(tools[idx].name.c_str());
+        _slots.push_back(slot);
+
+        if ((_slots.size() * 4) > (_index.size() * 3)) {
+            _rehash(_index.empty() ? 16 : _index.size() * 2, tools);
+            int primary = find(tools[idx].name.c_str(), tools);
+            return primary >= 0 ? (size_t)primary : idx;
+        }
+        int existing = find(tools[idx].name.c_str(), tools);
+        if (existing >= 0) return (size_t)existing;
+        _insert(idx);
+        return idx;
+    }
+
+    /**
+     * Remove the slot at a tool index. Call after erasing the tool from
+     * the vector. Indices shift, so the name index is rebuilt.
+     */
+    void removeAt(size_t idx, const std::vector<MCPTool>& tools) {
+        if (idx >= _slots.size()) return;
+        _slots.erase(_slots.begin() + idx);
+        _rehash(_index.size(), tools);
+    }
+
+    /**
+     * Look up a tool by name.
+     * @return index into the tool vector / slot array, or -1 if not found
+     */
+    int find(const char* name, const std::vector<MCPTool>& tools) const {
+        if (!name || _index.empty()) return -1;
+        uint32_t h = toolNameHash(name);
+        size_t mask = _index.size() - 1;
+        for (size_t i = h & mask, probes = 0; probes < _index.size();
+             i = (i + 1) & mask, probes++) {
+            uint16_t idx = _index[i];
+            if (idx == EMPTY) return -1;
+            if (_slots[idx].hash == h && tools[idx].name == name) return idx;
+        }
+        return -1;
+    }
+
+    ToolSlot& slot(size_t idx) { return _slots[idx]; }
+    const ToolSlot& slot(size_t idx) const { return _slots[idx]; }
+
+    /** Slot for a tool name, or nullptr. */
+    ToolSlot* findSlot(const char* name, const std::vector<MCPTool>& tools) {
+        int idx = find(name, tools);
+        return idx >= 0 ? &_slots[idx] : nullptr;
+    }
+    const ToolSlot* findSlot(const char* name, const std::vector<MCPTool>& tools) const {
+        int idx = find(name, tools);
+        return idx >= 0 ? &_slots[idx] : nullptr;
+    }
+
+    size_t size() const { return _slots.size(); }
+    size_t capacity() const { return _index.size(); }
+
+    /**
+     * Revision stamps of the group/cache state mirrored into the slots.
+     * The server compares these with the owners' revisions to decide when
+     * a refresh is needed.
+     */
+    uint32_t groupRevision = 0;
+    uint32_t cacheRevision = 0;
+
+private:
+    std::vector<ToolSlot> _slots;
+    std::vector<uint16_t> _index;  // power-of-two sized, EMPTY = free
+
+    void _insert(size_t idx) {
+        size_t mask = _index.size() - 1;
+        size_t i = _slots[idx].hash & mask;
+        while (_index[i] != EMPTY) i = (i + 1) & mask;
+        _index[i] = (uint16_t)idx;
+    }
+
+    void _rehash(size_t capacity, const std::vector<MCPTool>& tools) {
+        size_t cap = 16;
+        while (cap < capacity || (_slots.size() * 4) > (cap * 3)) cap *= 2;
+        _index.assign(cap, EMPTY);
+        for (size_t idx = 0; idx < _slots.size(); idx++) {
+            // Keep the first registration of a duplicate name
+            if (find(tools[idx].name.c_str(), tools) >= 0) continue;
+            _insert(idx);
+        }
+    }
+};
+
+} // namespace mcpd
+
+#endif // MCPD_TOOL_TABLE_H
@@ -23,9 +23,12 @@ constexpr const char* CONTENT_TYPE_SSE = "text/event-stream";
 constexpr const char* HEADER_SESSION_ID = "Mcp-Session-Id";
 constexpr const char* HEADER_ACCEPT = "Accept";
 constexpr const char* HEADER_CONTENT_TYPE = "Content-Type";
+constexpr const char* HEADER_LAST_EVENT_ID = "Last-Event-ID";
+constexpr const char* HEADER_CONNECTION = "Connection";
 
 // CORS headers for browser-based clients
-inline void setCORSHeaders(WebServer& server) {
+template <typename TServer>
+inline void setCORSHeaders(TServer& server) {
     server.sendHeader("Access-Control-Allow-Origin", "*");
     server.sendHeader("Access-Control-Allow-Methods", "POST, GET, DELETE, OPTIONS");
     server.sendHeader("Access-Control-Allow-Headers",
@@ -5,17 +5,24 @@
  * Clients write JSON-RPC requests to the RX characteristic and receive responses
  * via notifications on the TX characteristic.
  *
- * BLE MTU is small (~512 bytes negotiated), so large messages are chunked
- * automatically with a simple framing protocol:
+ * Messages are larger than a notification, so they are chunked with a
+ * simple framing protocol:
  *   - Each chunk is prefixed with a 1-byte header:
  *     0x00 = single complete message
  *     0x01 = first chunk (more follow)
  *     0x02 = continuation chunk
  *     0x03 = final chunk
  *   - Receiver reassembles before processing.
+ * Chunks are cut to the MTU negotiated with the client and sent a window at
+ * a time from loop() (see MCPBLEFraming.h).
+ *
+ * Throughput mode additionally asks the controller for the 2M PHY (on
+ * BLE 5 chips), 251-byte data length extension and a 7.5-15 ms connection
+ * interval, and sends several notifications per connection event.
  *
  * Usage:
  *   server.enableBLE("my-device-ble");  // call before begin()
+ *   server.enableBLEThroughputMode();   // optional
  *
  * Requires: ESP32 with BLE support (ESP-IDF BLE stack).
  */
@@ -27,7 +34,8 @@
 
 #include <Arduino.h>
 #include <functional>
-#include <vector>
+
+#include "MCPBLEFraming.h"
 
 // Forward-declare ESP32 BLE classes (user must include BLE libs)
 class BLEServer;
@@ -45,12 +53,6 @@ namespace mcpd {
 #define MCP_BLE_CHAR_TX_UUID        "4d435002-0001-1000-8000-00805f9b34fb"
 #define MCP_BLE_CHAR_STATUS_UUID    "4d435003-0001-1000-8000-00805f9b34fb"
 
-// Chunk header bytes
-static constexpr uint8_t BLE_CHUNK_SINGLE   = 0x00;
-static constexpr uint8_t BLE_CHUNK_FIRST    = 0x01;
-static constexpr uint8_t BLE_CHUNK_CONTINUE = 0x02;
-static constexpr uint8_t BLE_CHUNK_FINAL    = 0x03;
-
 using BLEMessageCallback = std::function<String(const String&)>;
 using BLEConnectionCallback = std::function<void(bool connected)>;
 
@@ -62,8 +64,14 @@ using BLEConnectionCallback = std::function<void(bool connected)>;
  *   - TX characteristic: server sends responses via notify
  *   - Status characteristic: readable connection state
  */
-class BLETransport {
+class BLETransport : public BLELink {
 public:
+    static constexpr uint8_t THROUGHPUT_WINDOW = 4;
+    // Requested connection interval in throughput mode, in 1.25 ms units
+    static constexpr uint16_t THROUGHPUT_MIN_INTERVAL = 6;   // 7.5 ms
+    static constexpr uint16_t THROUGHPUT_MAX_INTERVAL = 12;  // 15 ms
+    static constexpr uint16_t MAX_DATA_LENGTH = 251;         // LE data length extension
+
     explicit BLETransport(const char* deviceName, uint16_t mtu = 512);
     ~BLETransport();
 
@@ -91,10 +99,33 @@ public:
     /** Send a notification message to the connected client (server-push) */
     void sendNotification(const String& json);
 
+    /**
+     * Request 2M PHY, data length extension and a short connection
+     * interval on connect, and send up to `window` notifications per
+     * connection event. Call before begin().
+     */
+    void enableThroughputMode(uint8_t window = THROUGHPUT_WINDOW);
+    bool throughputMode() const { return _throughput; }
+
+    /** Largest incoming message (default 8 KB), allocated in begin() */
+    void setMaxMessageSize(size_t bytes) { _maxMessage = bytes; }
+
+    /** Outgoing frames and counters (txBytesPerSecond(), latency...) */
+    const BLEFramer& tx() const { return _tx; }
+    /** Incoming reassembly and counters */
+    const BLEReassembler& rx() const { return _rx; }
+
+    /** BLELink: one notification on the TX characteristic */
+    bool notify(const uint8_t* data, size_t len) override;
+
     // ── Internal callbacks (called by BLE stack) ───────────────────────
-    void _onConnect();
+    void _onConnect(const uint8_t* peerAddress);
     void _onDisconnect();
     void _onWrite(const uint8_t* data, size_t len);
+    void _onMtu(uint16_t mtu) { _tx.setMtu(mtu); }
+    void _onConnectionInterval(uint16_t interval);  // 1.25 ms units
+    void _onCongestion(bool congested) { _congested = congested; }
+    void _onNotifyStatus(bool ok) { _notifyOk = ok; }
 
 private:
     const char* _deviceName;
@@ -111,15 +142,17 @@ private:
     BLEMessageCallback _messageCallback;
     BLEConnectionCallback _connectionCallback;
 
-    // Reassembly buffer for chunked incoming messages
-    String _rxBuffer;
-    bool _rxAssembling = false;
+    bool _throughput = false;
+    uint8_t _window = BLEFramer::DEFAULT_WINDOW;
+    size_t _maxMessage = BLEReassembler::DEFAULT_MAX_MESSAGE;
 
-    // Outgoing queue (responses + notifications)
-    std::vector<String> _txQueue;
+    // Outgoing queue (responses + notifications), sent from loop()
+    BLEFramer _tx;
+    bool _congested = false;   // Controller out of buffers
+    bool _notifyOk = false;    // Status of the last notify()
 
-    /** Send data with chunking if needed */
-    void _sendChunked(const String& data);
+    // Reassembly buffer for chunked incoming messages
+    BLEReassembler _rx;
 
     /** Update the status characteristic */
     void _updateStatus();
@@ -138,15 +171,49 @@ private:
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
+#include <esp_gap_ble_api.h>
+#include <esp_gatts_api.h>
 
 class MCPBLEServerCallbacks : public BLEServerCallbacks {
     BLETransport* _transport;
 public:
     MCPBLEServerCallbacks(BLETransport* t) : _transport(t) {}
-    void onConnect(BLEServer* s) override { _transport->_onConnect(); }
+    void onConnect(BLEServer* s, esp_ble_gatts_cb_param_t* param) override {
+        _transport->_onConnect(param->connect.remote_bda);
+    }
     void onDisconnect(BLEServer* s) override { _transport->_onDisconnect(); }
+    void onMtuChanged(BLEServer* s, esp_ble_gatts_cb_param_t* param) override {
+        _transport->_onMtu(param->mtu.mtu);
+    }
 };
 
+class MCPBLETxCallbacks : public BLECharacteristicCallbacks {
+    BLETransport* _transport;
+public:
+    MCPBLETxCallbacks(BLETransport* t) : _transport(t) {}
+    // Called from inside notify(): anything but success leaves the frame queued
+    void onStatus(BLECharacteristic* c, Status s, uint32_t code) override {
+        _transport->_onNotifyStatus(s == Status::SUCCESS_NOTIFY);
+    }
+};
+
+// The Arduino BLE classes do not surface congestion or connection
+// parameter updates, so they are taken from the raw stack events
+static BLETransport* s_bleTransport = nullptr;
+
+static void mcpdBleGattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t, esp_ble_gatts_cb_param_t* param) {
+    if (s_bleTransport && event == ESP_GATTS_CONGEST_EVT) {
+        s_bleTransport->_onCongestion(param->congest.congested);
+    }
+}
+
+static void mcpdBleGapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+    if (s_bleTransport && event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT &&
+        param->update_conn_params.status == ESP_BT_STATUS_SUCCESS) {
+        s_bleTransport->_onConnectionInterval(param->update_conn_params.conn_int);
+    }
+}
+
 class MCPBLERxCallbacks : public BLECharacteristicCallbacks {
     BLETransport* _transport;
 public:
@@ -166,8 +233,18 @@ BLETransport::~BLETransport() {
     stop();
 }
 
+void BLETransport::enableThroughputMode(uint8_t window) {
+    _throughput = true;
+    _window = window;
+}
+
 void BLETransport::begin() {
+    _rx.reserve(_maxMessage);
+    _tx.setWindow(_window, BLEFramer::DEFAULT_INTERVAL_US);
 #ifndef MCPD_TEST
+    s_bleTransport = this;
+    BLEDevice::setCustomGattsHandler(mcpdBleGattsHandler);
+    BLEDevice::setCustomGapHandler(mcpdBleGapHandler);
     BLEDevice::init(_deviceName);
     BLEDevice::setMTU(_mtu);
 
@@ -189,6 +266,7 @@ void BLETransport::begin() {
         BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_READ
     );
     _txChar->addDescriptor(new BLE2902());
+    _txChar->setCallbacks(new MCPBLETxCallbacks(this));
 
     // Status: readable connection state
     _statusChar = _service->createCharacteristic(
@@ -211,12 +289,9 @@ void BLETransport::begin() {
 }
 
 void BLETransport::loop() {
-    // Send queued messages
-    if (_connected && !_txQueue.empty()) {
-        for (const auto& msg : _txQueue) {
-            _sendChunked(msg);
-        }
-        _txQueue.clear();
+    // Send the frames the current connection event allows
+    if (_connected) {
+        _tx.pump(*this, micros());
     }
 }
 
@@ -229,29 +304,71 @@ void BLETransport::stop() {
         _rxChar = nullptr;
         _txChar = nullptr;
         _statusChar = nullptr;
+        s_bleTransport = nullptr;
     }
 #endif
     _connected = false;
     _clientCount = 0;
+    _tx.clear();
+    _rx.reset();
 }
 
 void BLETransport::sendNotification(const String& json) {
-    _txQueue.push_back(json);
+    _tx.enqueue(json, micros());
+}
+
+bool BLETransport::notify(const uint8_t* data, size_t len) {
+#ifndef MCPD_TEST
+    if (!_txChar || !_connected || _congested) return false;
+    _notifyOk = false;
+    _txChar->setValue(const_cast<uint8_t*>(data), len);
+    _txChar->notify();
+    return _notifyOk;
+#else
+    return false;
+#endif
 }
 
-void BLETransport::_onConnect() {
+void BLETransport::_onConnect(const uint8_t* peerAddress) {
     _connected = true;
     _clientCount++;
+    _congested = false;
+    // Frames stay at 20 bytes until the client exchanges MTUs
+    _tx.setMtu(BLEFramer::MIN_MTU);
+    _tx.setWindow(_window, BLEFramer::DEFAULT_INTERVAL_US);
     _updateStatus();
     Serial.println("[mcpd] BLE client connected");
+
+#ifndef MCPD_TEST
+    if (_throughput) {
+        esp_bd_addr_t addr;
+        memcpy(addr, peerAddress, sizeof(addr));
+        esp_ble_gap_set_pkt_data_len(addr, MAX_DATA_LENGTH);
+#ifdef CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+        esp_ble_gap_set_preferred_phy(addr, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF,
+                                      ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                      ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                      ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+        _server->updateConnParams(addr, THROUGHPUT_MIN_INTERVAL, THROUGHPUT_MAX_INTERVAL,
+                                  0, 400);  // No slave latency, 4 s supervision timeout
+    }
+#endif
+
     if (_connectionCallback) _connectionCallback(true);
 }
 
+void BLETransport::_onConnectionInterval(uint16_t interval) {
+    if (interval > 0) _tx.setWindow(_window, (unsigned long)interval * 1250UL);
+}
+
 void BLETransport::_onDisconnect() {
     _clientCount--;
     if (_clientCount <= 0) {
         _clientCount = 0;
         _connected = false;
+        _tx.clear();
+        _rx.reset();
     }
     _updateStatus();
     Serial.println("[mcpd] BLE client disconnected");
@@ -264,42 +381,14 @@ void BLETransport::_onDisconnect() {
 }
 
 void BLETransport::_onWrite(const uint8_t* data, size_t len) {
-    if (len < 1) return;
-
-    uint8_t header = data[0];
-    String chunk;
-    for (size_t i = 1; i < len; i++) {
-        chunk += (char)data[i];
-    }
-
-    switch (header) {
-        case BLE_CHUNK_SINGLE:
-            // Complete message in one chunk
-            _processMessage(chunk);
+    switch (_rx.feed(data, len)) {
+        case BLEReassembler::Result::Complete:
+            _processMessage(String(_rx.message()));
             break;
-
-        case BLE_CHUNK_FIRST:
-            _rxBuffer = chunk;
-            _rxAssembling = true;
-            break;
-
-        case BLE_CHUNK_CONTINUE:
-            if (_rxAssembling) {
-                _rxBuffer += chunk;
-            }
+        case BLEReassembler::Result::Dropped:
+            Serial.printf("[mcpd] BLE frame dropped (header 0x%02x)\n", len ? data[0] : 0);
             break;
-
-        case BLE_CHUNK_FINAL:
-            if (_rxAssembling) {
-                _rxBuffer += chunk;
-                _rxAssembling = false;
-                _processMessage(_rxBuffer);
-                _rxBuffer = "";
-            }
-            break;
-
-        default:
-            Serial.printf("[mcpd] BLE unknown chunk header: 0x%02x\n", header);
+        case BLEReassembler::Result::Partial:
             break;
     }
 }
@@ -309,53 +398,10 @@ void BLETransport::_processMessage(const String& message) {
 
     String response = _messageCallback(message);
     if (!response.isEmpty()) {
-        _txQueue.push_back(response);
+        _tx.enqueue(response, micros());
     }
 }
 
-void BLETransport::_sendChunked(const String& data) {
-#ifndef MCPD_TEST
-    if (!_txChar || !_connected) return;
-
-    // Effective payload per chunk = MTU - 3 (ATT overhead) - 1 (our header)
-    size_t chunkPayload = _mtu - 4;
-    if (chunkPayload < 20) chunkPayload = 20;
-
-    if (data.length() <= chunkPayload) {
-        // Single chunk
-        uint8_t buf[data.length() + 1];
-        buf[0] = BLE_CHUNK_SINGLE;
-        memcpy(buf + 1, data.c_str(), data.length());
-        _txChar->setValue(buf, data.length() + 1);
-        _txChar->notify();
-        return;
-    }
-
-    // Multi-chunk
-    size_t offset = 0;
-    bool first = true;
-    while (offset < data.length()) {
-        size_t remaining = data.length() - offset;
-        size_t thisChunk = remaining > chunkPayload ? chunkPayload : remaining;
-        bool last = (offset + thisChunk >= data.length());
-
-        uint8_t header;
-        if (first) { header = BLE_CHUNK_FIRST; first = false; }
-        else if (last) { header = BLE_CHUNK_FINAL; }
-        else { header = BLE_CHUNK_CONTINUE; }
-
-        uint8_t buf[thisChunk + 1];
-        buf[0] = header;
-        memcpy(buf + 1, data.c_str() + offset, thisChunk);
-        _txChar->setValue(buf, thisChunk + 1);
-        _txChar->notify();
-
-        offset += thisChunk;
-        delay(20);  // BLE needs time between notifications
-    }
-#endif
-}
-
 void BLETransport::_updateStatus() {
 #ifndef MCPD_TEST
     if (!_statusChar) return;
@@ -8,6 +8,18 @@
  *   - Client sends GET to /mcp with Accept: text/event-stream
  *   - Server holds connection open, sends events as they occur
  *   - Client sends POST to /mcp with JSON-RPC, server can respond via SSE
+ *
+ * Resumability: every event with an id is also kept in a bounded per-session
+ * replay buffer. A client that reconnects with a Last-Event-ID header gets
+ * the events it missed before new ones, so a WiFi blip does not lose
+ * notifications.
+ *
+ * Backpressure: events are queued per client and written from loop() in
+ * slices of at most WRITE_SLICE_BYTES, so a slow client never holds up the
+ * rest of the device. Above the high-water mark, low-priority notifications
+ * (progress, logging, list_changed, resources/updated) are coalesced or
+ * shed; a client that still cannot keep up is disconnected and can resume
+ * with Last-Event-ID.
  */
 
 #ifndef MCPD_TRANSPORT_SSE_H
@@ -15,11 +27,19 @@
 
 #include <Arduino.h>
 #include <WiFiClient.h>
+#include <deque>
+#include "MCPIOLoop.h"
 #include <functional>
 #include <vector>
 
 namespace mcpd {
 
+/** Low-priority events may be coalesced or shed under backpressure. */
+enum class SSEPriority : uint8_t {
+    Normal = 0,
+    Low,
+};
+
 /**
  * Represents an active SSE connection from a client.
  */
@@ -41,11 +61,30 @@ struct SSEClient {
      */
     bool sendEvent(const char* event, const String& data, unsigned long id = 0) {
         if (!client.connected()) return false;
+        return sendFrame(formatEvent(event, data, id), id);
+    }
 
+    /**
+     * Send an already formatted event (see formatEvent()).
+     */
+    bool sendFrame(const String& frame, unsigned long id = 0) {
+        if (!client.connected()) return false;
+        if (id > 0) lastEventId = id;
+        size_t written = client.print(frame);
+        client.flush();
+        return written == frame.length();
+    }
+
+    /**
+     * Format an SSE event as it goes on the wire.
+     * @param event  Event type, or nullptr/"" for none
+     * @param data   Event data (split on newlines)
+     * @param id     Event ID, 0 for none
+     */
+    static String formatEvent(const char* event, const String& data, unsigned long id = 0) {
         String msg;
         if (id > 0) {
             msg += "id: " + String(id) + "\n";
-            lastEventId = id;
         }
         if (event && strlen(event) > 0) {
             msg += "event: " + String(event) + "\n";
@@ -60,10 +99,7 @@ struct SSEClient {
             }
         }
         msg += "\n"; // Empty line terminates the event
-
-        size_t written = client.print(msg);
-        client.flush();
-        return written == msg.length();
+        return msg;
     }
 
     /**
@@ -72,8 +108,259 @@ struct SSEClient {
     bool sendJsonRpc(const String& jsonResponse, unsigned long eventId = 0) {
         return sendEvent("message", jsonResponse, eventId);
     }
+
+    // ── Outbound queue (drained by SSEManager::loop) ───────────────────
+
+    struct Outbound {
+        String frame;
+        SSEPriority priority = SSEPriority::Normal;
+        String coalesceKey;
+    };
+
+    std::deque<Outbound> outbound;
+    size_t outboundBytes = 0;        // Unsent bytes in the queue
+    size_t frontOffset = 0;          // Bytes of outbound.front() already written
+    unsigned long lastProgressAt = 0;
+    int ioSlot = -1;                 // IOPoller slot for the current pass
+
+    bool hasPending() const { return !outbound.empty(); }
+
+    void queueFrame(const String& frame, SSEPriority priority = SSEPriority::Normal,
+                    const String& coalesceKey = String()) {
+        if (outbound.empty()) lastProgressAt = millis();
+        outbound.push_back({frame, priority, coalesceKey});
+        outboundBytes += frame.length();
+    }
+
+    /**
+     * Write up to maxBytes of queued frames. Stops early on a short write
+     * (socket buffer full), so it never waits for the client.
+     * @return bytes written
+     */
+    size_t drain(size_t maxBytes) {
+        size_t total = 0;
+        while (!outbound.empty() && total < maxBytes && client.connected()) {
+            const String& frame = outbound.front().frame;
+            size_t want = frame.length() - frontOffset;
+            if (want > maxBytes - total) want = maxBytes - total;
+            size_t n = client.write((const uint8_t*)frame.c_str() + frontOffset, want);
+            frontOffset += n;
+            outboundBytes -= n;
+            total += n;
+            if (frontOffset == frame.length()) {
+                outbound.pop_front();
+                frontOffset = 0;
+            }
+            if (n < want) break;
+        }
+        if (total > 0) lastProgressAt = millis();
+        return total;
+    }
+
+    /** Drop a not-yet-started queued frame with this key; true if found */
+    bool removeQueued(const String& coalesceKey) {
+        for (size_t i = frontOffset > 0 ? 1 : 0; i < outbound.size(); i++) {
+            if (outbound[i].coalesceKey == coalesceKey) {
+                outboundBytes -= outbound[i].frame.length();
+                outbound.erase(outbound.begin() + i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Shed not-yet-started low-priority frames, oldest first, until
+     * bytesToFree bytes are released or none are left.
+     * @return frames dropped
+     */
+    size_t dropLowPriority(size_t bytesToFree) {
+        size_t dropped = 0;
+        size_t freed = 0;
+        for (size_t i = frontOffset > 0 ? 1 : 0; i < outbound.size() && freed < bytesToFree;) {
+            if (outbound[i].priority == SSEPriority::Low) {
+                freed += outbound[i].frame.length();
+                outboundBytes -= outbound[i].frame.length();
+                outbound.erase(outbound.begin() + i);
+                dropped++;
+            } else {
+                i++;
+            }
+        }
+        return dropped;
+    }
 };
 
+/**
+ * Bounded history of one session's outbound SSE events, replayed after a
+ * reconnect. Events are stored as their wire frames in a ring arena that is
+ * allocated once; each record is a 4-byte id, a 2-byte length and the frame.
+ * When a new event does not fit, the oldest events are dropped.
+ */
+class SSEReplayBuffer {
+public:
+    static constexpr size_t RECORD_HEADER = 6;
+
+    /** Bind to a session and clear; the arena is only reallocated if its size changes. */
+    void reset(const String& sessionId, size_t capacity) {
+        _sessionId = sessionId;
+        if (_arena.size() != capacity) {
+            _arena.assign(capacity, 0);
+            _arena.shrink_to_fit();
+        }
+        clear();
+    }
+
+    void clear() {
+        _head = 0;
+        _used = 0;
+        _count = 0;
+        _newestId = 0;
+    }
+
+    /**
+     * Store an event frame. Frames larger than the arena (or 64 KB) are not
+     * stored and count as dropped.
+     */
+    bool append(unsigned long id, const String& frame) {
+        size_t len = frame.length();
+        size_t need = RECORD_HEADER + len;
+        if (len > 0xFFFF || need > _arena.size()) {
+            _dropped++;
+            return false;
+        }
+        while (_arena.size() - _used < need) _dropOldest();
+
+        uint8_t header[RECORD_HEADER] = {
+            (uint8_t)(id >> 24), (uint8_t)(id >> 16), (uint8_t)(id >> 8), (uint8_t)id,
+            (uint8_t)(len >> 8), (uint8_t)len,
+        };
+        size_t tail = (_head + _used) % _arena.size();
+        _copyIn(tail, header, RECORD_HEADER);
+        _copyIn((tail + RECORD_HEADER) % _arena.size(), (const uint8_t*)frame.c_str(), len);
+        _used += need;
+        _count++;
+        _newestId = id;
+        return true;
+    }
+
+    /**
+     * Write every stored frame with an id greater than afterId to a client
+     * (anything with write(const uint8_t*, size_t)).
+     * @return number of events written
+     */
+    template <typename TClient>
+    size_t replay(unsigned long afterId, TClient& client) const {
+        size_t sent = 0;
+        size_t pos = _head;
+        for (size_t i = 0; i < _count; i++) {
+            unsigned long id;
+            size_t len;
+            _readHeader(pos, id, len);
+            size_t data = (pos + RECORD_HEADER) % _arena.size();
+            if (id > afterId) {
+                size_t first = _arena.size() - data;
+                if (first > len) first = len;
+                client.write(_arena.data() + data, first);
+                if (first < len) client.write(_arena.data(), len - first);
+                sent++;
+            }
+            pos = (data + len) % _arena.size();
+        }
+        return sent;
+    }
+
+    const String& sessionId() const { return _sessionId; }
+    size_t count() const { return _count; }
+    size_t bytes() const { return _used; }
+    size_t capacity() const { return _arena.size(); }
+    unsigned long newestId() const { return _newestId; }
+
+    /** Id of the oldest stored event (0 if empty) */
+    unsigned long oldestId() const {
+        if (_count == 0) return 0;
+        unsigned long id;
+        size_t len;
+        _readHeader(_head, id, len);
+        return id;
+    }
+
+    /** Events dropped to make room, or because they were too large */
+    unsigned long dropped() const { return _dropped; }
+
+private:
+    String _sessionId;
+    std::vector<uint8_t> _arena;
+    size_t _head = 0;
+    size_t _used = 0;
+    size_t _count = 0;
+    unsigned long _newestId = 0;
+    unsigned long _dropped = 0;
+
+    void _readHeader(size_t pos, unsigned long& id, size_t& len) const {
+        uint8_t h[RECORD_HEADER];
+        for (size_t i = 0; i < RECORD_HEADER; i++) h[i] = _arena[(pos + i) % _arena.size()];
+        id = ((unsigned long)h[0] << 24) | ((unsigned long)h[1] << 16) |
+             ((unsigned long)h[2] << 8) | h[3];
+        len = ((size_t)h[4] << 8) | h[5];
+    }
+
+    void _dropOldest() {
+        unsigned long id;
+        size_t len;
+        _readHeader(_head, id, len);
+        _head = (_head + RECORD_HEADER + len) % _arena.size();
+        _used -= RECORD_HEADER + len;
+        _count--;
+        _dropped++;
+    }
+
+    void _copyIn(size_t pos, const uint8_t* src, size_t n) {
+        size_t first = _arena.size() - pos;
+        if (first > n) first = n;
+        memcpy(_arena.data() + pos, src, first);
+        if (first < n) memcpy(_arena.data(), src + first, n - first);
+    }
+};
+
+/**
+ * Classify an outgoing JSON-RPC message for backpressure handling, based on
+ * the server's own notification format ({"jsonrpc":"2.0","method":...).
+ * Notifications that only describe current state are low priority; ones
+ * where only the latest matters get a coalesce key:
+ *   - resources/updated:  one per params object (i.e. per URI)
+ *   - progress:           one per progressToken
+ *   - list_changed:       one per method
+ * Responses and server requests (sampling, elicitation) are Normal.
+ */
+inline SSEPriority _sseClassify(const String& json, String& coalesceKey) {
+    static const char PREFIX[] = "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/";
+    coalesceKey = String();
+    if (!json.startsWith(PREFIX)) return SSEPriority::Normal;
+    int start = sizeof(PREFIX) - 1;
+    int end = json.indexOf('"', start);
+    if (end < 0) return SSEPriority::Normal;
+    String method = json.substring(start, end);
+
+    if (method == "resources/updated") {
+        int params = json.indexOf("\"params\":", end);
+        if (params >= 0) coalesceKey = "updated:" + json.substring(params);
+        return SSEPriority::Low;
+    }
+    if (method == "progress") {
+        int token = json.indexOf("\"progressToken\":", end);
+        int next = token >= 0 ? json.indexOf(",\"progress\":", token) : -1;
+        if (next > token) coalesceKey = "progress:" + json.substring(token, next);
+        return SSEPriority::Low;
+    }
+    if (method.endsWith("/list_changed")) {
+        coalesceKey = method;
+        return SSEPriority::Low;
+    }
+    if (method == "message") return SSEPriority::Low;  // Logging
+    return SSEPriority::Normal;
+}
+
 /**
  * Manages SSE connections for the MCP server.
  */
@@ -82,6 +369,11 @@ public:
     static constexpr size_t MAX_SSE_CLIENTS = 4;
     static constexpr unsigned long KEEPALIVE_INTERVAL_MS = 30000;
     static constexpr unsigned long CONNECTION_TIMEOUT_MS = 300000; // 5 min
+    static constexpr size_t REPLAY_SESSIONS = MAX_SSE_CLIENTS;
+    static constexpr size_t DEFAULT_REPLAY_BYTES = 2048;  // Per session
+    static constexpr size_t WRITE_SLICE_BYTES = 512;      // Per client per loop()
+    static constexpr size_t DEFAULT_HIGH_WATER_BYTES = 4096;
+    static constexpr unsigned long STALL_TIMEOUT_MS = 10000;
 
     SSEManager() = default;
 
@@ -92,9 +384,12 @@ public:
      * @param client     The WiFiClient from the HTTP server
      * @param sessionId  The MCP session ID
      * @param endpoint   The MCP endpoint path (e.g., "/mcp")
+     * @param lastEventId  Last-Event-ID sent by a reconnecting client (0 if
+     *                     none); stored events after it are replayed
      * @return true if connection was accepted
      */
-    bool addClient(WiFiClient client, const String& sessionId, const char* endpoint) {
+    bool addClient(WiFiClient client, const String& sessionId, const char* endpoint,
+                   unsigned long lastEventId = 0) {
         // Clean up disconnected clients first
         pruneDisconnected();
 
@@ -117,8 +412,21 @@ public:
         sse.connectedAt = millis();
 
         // Send the endpoint event per MCP spec
-        sse.sendEvent("endpoint", String(endpoint));
+        sse.queueFrame(SSEClient::formatEvent("endpoint", String(endpoint)));
 
+        // Resume: resend what the client missed, oldest first
+        if (lastEventId > 0) {
+            const SSEReplayBuffer* history = _findReplay(sessionId);
+            if (history) {
+                String missed;
+                _StringAppender out{missed};
+                _replayed += history->replay(lastEventId, out);
+                if (!missed.isEmpty()) sse.queueFrame(missed);
+                if (history->newestId() > lastEventId) sse.lastEventId = history->newestId();
+            }
+        }
+
+        sse.drain(WRITE_SLICE_BYTES);
         _clients.push_back(sse);
         Serial.printf("[mcpd] SSE client connected (total: %d)\n", _clients.size());
         return true;
@@ -129,12 +437,7 @@ public:
      * with the matching session ID.
      */
     void broadcast(const String& sessionId, const String& jsonResponse) {
-        _eventCounter++;
-        for (auto& c : _clients) {
-            if (c.sessionId == sessionId && c.isConnected()) {
-                c.sendJsonRpc(jsonResponse, _eventCounter);
-            }
-        }
+        _send(sessionId, "message", jsonResponse);
     }
 
     /**
@@ -142,19 +445,75 @@ public:
      */
     void sendToSession(const String& sessionId, const String& event,
                        const String& data) {
-        _eventCounter++;
+        _send(sessionId, event.c_str(), data);
+    }
+
+    /**
+     * Per-session replay budget in bytes (default DEFAULT_REPLAY_BYTES);
+     * 0 disables replay. Clears stored events.
+     */
+    void setReplayBudget(size_t bytesPerSession) {
+        _droppedRecycled = droppedEvents();
+        _replayBytes = bytesPerSession;
+        _replay.clear();
+        _replayLastUse.clear();
+    }
+    size_t replayBudget() const { return _replayBytes; }
+
+    /** Forget a session's stored events (e.g. on DELETE) */
+    void clearSession(const String& sessionId) {
+        for (auto& buf : _replay) {
+            if (buf.sessionId() == sessionId) buf.reset(String(), buf.capacity());
+        }
+    }
+
+    /** Disconnect a session's streams and forget its events (session ended) */
+    void closeSession(const String& sessionId) {
         for (auto& c : _clients) {
-            if (c.sessionId == sessionId && c.isConnected()) {
-                c.sendEvent(event.c_str(), data, _eventCounter);
-            }
+            if (c.sessionId == sessionId) c.client.stop();
+        }
+        pruneDisconnected();
+        clearSession(sessionId);
+    }
+
+    /** Replay history of a session, or nullptr */
+    const SSEReplayBuffer* replayBuffer(const String& sessionId) const {
+        return _findReplay(sessionId);
+    }
+
+    /** Events re-sent to reconnecting clients */
+    unsigned long replayedEvents() const { return _replayed; }
+
+    /** Events that fell out of (or never fit in) a replay buffer */
+    unsigned long droppedEvents() const {
+        unsigned long n = _droppedRecycled;
+        for (const auto& buf : _replay) n += buf.dropped();
+        return n;
+    }
+
+    /** Add every stream to a readiness pass (writes wanted while queued). */
+    void registerIO(IOPoller& io) {
+        for (auto& c : _clients) {
+            c.ioSlot = io.add(c.client, c.hasPending() ? IOPoller::READ | IOPoller::WRITE
+                                                       : IOPoller::READ);
         }
     }
 
     /**
-     * Call periodically to send keepalive comments and prune dead connections.
+     * Call periodically: writes the next slice of each client's queue,
+     * disconnects stalled clients, sends keepalive comments and prunes
+     * dead connections. With a poller, only writable clients are written.
      */
-    void loop() {
+    void loop(const IOPoller* io = nullptr) {
         unsigned long now = millis();
+        for (auto& c : _clients) {
+            if (!c.isConnected() || !c.hasPending()) continue;
+            if (!io || io->writable(c.ioSlot)) c.drain(WRITE_SLICE_BYTES);
+            if (c.hasPending() && millis() - c.lastProgressAt > _stallTimeoutMs) {
+                _disconnectSlow(c);
+            }
+        }
+
         if (now - _lastKeepalive >= KEEPALIVE_INTERVAL_MS) {
             _lastKeepalive = now;
             for (auto it = _clients.begin(); it != _clients.end();) {
@@ -162,15 +521,44 @@ public:
                     (now - it->connectedAt > CONNECTION_TIMEOUT_MS)) {
                     it = _clients.erase(it);
                 } else {
-                    // Send SSE comment as keepalive
-                    it->client.println(": keepalive\n");
-                    it->client.flush();
+                    // Send SSE comment as keepalive (one at most per queue)
+                    _enqueue(*it, ": keepalive\n\n", SSEPriority::Low, ":keepalive");
                     ++it;
                 }
             }
         }
     }
 
+    /**
+     * Per-client queue limit in bytes (default DEFAULT_HIGH_WATER_BYTES).
+     * Above it low-priority events are shed; if normal traffic still does
+     * not fit, the client is disconnected.
+     */
+    void setHighWaterMark(size_t bytes) { _highWater = bytes; }
+    size_t highWaterMark() const { return _highWater; }
+
+    /** Disconnect a client whose queue made no progress for this long */
+    void setStallTimeout(unsigned long ms) { _stallTimeoutMs = ms; }
+
+    /** Bytes / frames waiting in all client queues */
+    size_t queuedBytes() const {
+        size_t n = 0;
+        for (const auto& c : _clients) n += c.outboundBytes;
+        return n;
+    }
+    size_t queuedFrames() const {
+        size_t n = 0;
+        for (const auto& c : _clients) n += c.outbound.size();
+        return n;
+    }
+
+    /** Low-priority events replaced by a newer one with the same key */
+    unsigned long coalescedEvents() const { return _coalesced; }
+    /** Low-priority events dropped at the high-water mark */
+    unsigned long shedEvents() const { return _shed; }
+    /** Clients disconnected for not keeping up */
+    unsigned long slowDisconnects() const { return _slowDisconnects; }
+
     /** Number of active SSE clients */
     size_t clientCount() const { return _clients.size(); }
 
@@ -182,10 +570,119 @@ public:
         return false;
     }
 
+#ifdef MCPD_TEST
+public:  // Allow test access to internals
+#else
 private:
+#endif
     std::vector<SSEClient> _clients;
     unsigned long _lastKeepalive = 0;
     unsigned long _eventCounter = 0;
+    std::vector<SSEReplayBuffer> _replay;  // At most REPLAY_SESSIONS
+    size_t _replayBytes = DEFAULT_REPLAY_BYTES;
+    unsigned long _replayed = 0;
+    unsigned long _droppedRecycled = 0;
+    unsigned long _replayClock = 0;
+    std::vector<unsigned long> _replayLastUse;
+    size_t _highWater = DEFAULT_HIGH_WATER_BYTES;
+    unsigned long _stallTimeoutMs = STALL_TIMEOUT_MS;
+    unsigned long _coalesced = 0;
+    unsigned long _shed = 0;
+    unsigned long _slowDisconnects = 0;
+
+    struct _StringAppender {
+        String& out;
+        size_t write(const uint8_t* data, size_t len) {
+            for (size_t i = 0; i < len; i++) out += (char)data[i];
+            return len;
+        }
+    };
+
+    // Assign the next event id, remember the frame and queue it for the
+    // session's connected clients
+    void _send(const String& sessionId, const char* event, const String& data) {
+        unsigned long id = ++_eventCounter;
+        String frame = SSEClient::formatEvent(event, data, id);
+        if (SSEReplayBuffer* history = _replayFor(sessionId)) {
+            history->append(id, frame);
+        }
+        String key;
+        SSEPriority priority = strcmp(event, "message") == 0
+            ? _sseClassify(data, key) : SSEPriority::Normal;
+        for (auto& c : _clients) {
+            if (c.sessionId == sessionId && c.isConnected()) {
+                c.lastEventId = id;
+                if (_enqueue(c, frame, priority, key)) c.drain(WRITE_SLICE_BYTES);
+            }
+        }
+    }
+
+    // Apply the queue policy; false if the frame was not queued
+    bool _enqueue(SSEClient& c, const String& frame, SSEPriority priority,
+                  const String& key) {
+        if (!key.isEmpty() && c.removeQueued(key)) _coalesced++;
+        size_t len = frame.length();
+        if (c.outboundBytes > 0 && c.outboundBytes + len > _highWater) {
+            _shed += c.dropLowPriority(c.outboundBytes + len - _highWater);
+            if (c.outboundBytes > 0 && c.outboundBytes + len > _highWater) {
+                if (priority == SSEPriority::Low) {
+                    _shed++;
+                } else {
+                    _disconnectSlow(c);
+                }
+                return false;
+            }
+        }
+        c.queueFrame(frame, priority, key);
+        return true;
+    }
+
+    void _disconnectSlow(SSEClient& c) {
+        Serial.println("[mcpd] SSE client too slow, disconnecting");
+        c.client.stop();
+        c.outbound.clear();
+        c.outboundBytes = 0;
+        c.frontOffset = 0;
+        _slowDisconnects++;
+    }
+
+    const SSEReplayBuffer* _findReplay(const String& sessionId) const {
+        for (const auto& buf : _replay) {
+            if (buf.sessionId() == sessionId) return &buf;
+        }
+        return nullptr;
+    }
+
+    // Buffer for a session, taking a free slot or recycling the least
+    // recently written one
+    SSEReplayBuffer* _replayFor(const String& sessionId) {
+        if (_replayBytes == 0 || sessionId.isEmpty()) return nullptr;
+        for (size_t i = 0; i < _replay.size(); i++) {
+            if (_replay[i].sessionId() == sessionId) {
+                _replayLastUse[i] = ++_replayClock;
+                return &_replay[i];
+            }
+        }
+        size_t victim = _replay.size();
+        for (size_t i = 0; i < _replay.size(); i++) {
+            if (_replay[i].sessionId().isEmpty()) { victim = i; break; }
+        }
+        if (victim == _replay.size()) {
+            if (_replay.size() < REPLAY_SESSIONS) {
+                _replay.emplace_back();
+                _replayLastUse.push_back(0);
+            } else {
+                victim = 0;
+                for (size_t i = 1; i < _replay.size(); i++) {
+                    if (_replayLastUse[i] < _replayLastUse[victim]) victim = i;
+                }
+            }
+        }
+        _droppedRecycled += _replay[victim].count();
+        _replay[victim].reset(sessionId, _replayBytes);
+        _replayLastUse[victim] = ++_replayClock;
+        return &_replay[victim];
+    }
 
     void pruneDisconnected() {
         _clients.erase(
@@ -10,6 +10,20 @@
  * Requires: ArduinoWebsockets or similar library.
  * This implementation uses a minimal built-in WebSocket server over WiFiServer.
  *
+ * Sockets are never waited on: the upgrade request is collected across
+ * loop() calls, and frames are queued per client and written as the socket
+ * takes them, so a slow or half-open client cannot stall the others.
+ * Incoming frames go through an incremental parser (WSReceiver): however
+ * the bytes are split across reads, payloads are read from the socket
+ * straight into the client's message buffer and unmasked in place, and
+ * fragmented messages are reassembled there, up to setMaxMessageSize().
+ *
+ * With enableCompression(), clients that offer permessage-deflate
+ * (RFC 7692) get compressed text frames: a 1 KB server window, and
+ * client_no_context_takeover so incoming messages inflate without a
+ * per-client window. Messages under MIN_COMPRESS_BYTES, or that would not
+ * shrink, are sent as plain frames.
+ *
  * Usage:
  *   mcpd::WebSocketTransport ws(8080);
  *   ws.onMessage([](const String& msg) -> String { return processJsonRpc(msg); });
@@ -25,6 +39,8 @@
 #include <WiFiClient.h>
 #include <functional>
 #include <vector>
+#include "MCPIOLoop.h"
+#include "MCPDeflate.h"
 
 namespace mcpd {
 
@@ -33,17 +49,57 @@ namespace mcpd {
  */
 using WSMessageHandler = std::function<String(const String& message)>;
 
+/** Close status codes sent when the server ends a connection (RFC 6455 7.4.1) */
+enum class WSCloseCode : uint16_t {
+    Normal = 1000,
+    ProtocolError = 1002,
+    UnsupportedData = 1003,   // Binary messages: MCP is JSON text
+    InvalidPayload = 1007,    // Not UTF-8, or compressed data that does not inflate
+    MessageTooBig = 1009,
+};
+
+/**
+ * Incremental frame parser state. The header is collected until complete;
+ * payload bytes then go from the socket into `message` (data frames, so
+ * continuation frames append in place) or `control` (ping/pong/close,
+ * which may arrive between fragments), and are unmasked where they land.
+ */
+struct WSReceiver {
+    uint8_t header[14];
+    uint8_t headerLen = 0;
+    bool inPayload = false;
+    bool fin = false;
+    uint8_t opcode = 0;
+    uint8_t mask[4] = {0, 0, 0, 0};
+    size_t frameLen = 0;
+    size_t frameRead = 0;
+    size_t frameStart = 0;           // Offset of this frame's payload in message
+
+    uint8_t messageOpcode = 0;       // Text/binary message being assembled (0 = none)
+    bool messageCompressed = false;
+    std::vector<uint8_t> message;
+    uint8_t control[125];
+};
+
 /**
  * Represents a connected WebSocket client.
  */
 struct WSClient {
     WiFiClient tcp;
     bool handshakeDone = false;
-    String buffer;
+    String buffer;                   // Upgrade request collected so far
     unsigned long connectedAt = 0;
     unsigned long lastActivity = 0;
+    unsigned long lastPingAt = 0;
+    String outbox;                   // Frames not yet taken by the socket
+    size_t outPos = 0;
+    int ioSlot = -1;                 // IOPoller slot for the current pass
+    bool deflate = false;            // permessage-deflate negotiated
+    DeflateEncoder encoder;
+    WSReceiver rx;
 
     bool connected() const { return tcp.connected(); }
+    size_t pendingOutput() const { return outbox.length() - outPos; }
 };
 
 /**
@@ -57,6 +113,13 @@ public:
     static constexpr size_t MAX_WS_CLIENTS = 4;
     static constexpr unsigned long PING_INTERVAL_MS = 30000;
     static constexpr unsigned long TIMEOUT_MS = 300000; // 5 min idle
+    static constexpr unsigned long HANDSHAKE_TIMEOUT_MS = 5000;
+    static constexpr size_t MAX_HANDSHAKE_BYTES = 2048;
+    static constexpr size_t MAX_OUTBOX_BYTES = 8192;   // Then the client is dropped
+    static constexpr size_t DEFAULT_MAX_MESSAGE_BYTES = 16384;
+    static constexpr size_t RX_RETAIN_BYTES = 1024;    // Receive buffer kept between messages
+    static constexpr uint8_t DEFLATE_WINDOW_BITS = 10;
+    static constexpr size_t MIN_COMPRESS_BYTES = 64;
 
     explicit WebSocketTransport(uint16_t port = 8080)
         : _port(port), _server(nullptr) {}
@@ -68,6 +131,29 @@ public:
     /** Set the message handler */
     void onMessage(WSMessageHandler handler) { _handler = handler; }
 
+    /**
+     * Accept permessage-deflate from clients that offer it. Call before
+     * clients connect.
+     * @param contextTakeover  keep the window between messages (better
+     *        ratio, 2^DEFLATE_WINDOW_BITS bytes of RAM per client)
+     */
+    void enableCompression(bool contextTakeover = true) {
+        _deflateEnabled = true;
+        _contextTakeover = contextTakeover;
+    }
+
+    void disableCompression() { _deflateEnabled = false; }
+    bool compressionEnabled() const { return _deflateEnabled; }
+
+    /**
+     * Largest message accepted, after reassembling fragments and inflating
+     * (default DEFAULT_MAX_MESSAGE_BYTES). Bigger messages close the
+     * connection with 1009. Raise it for large tool arguments (audio,
+     * file contents); the buffer is only held while such a message arrives.
+     */
+    void setMaxMessageSize(size_t bytes) { _maxMessage = bytes; }
+    size_t maxMessageSize() const { return _maxMessage; }
+
     /** Start the WebSocket server */
     void begin() {
         _server = new WiFiServer(_port);
@@ -75,8 +161,19 @@ public:
         Serial.printf("[mcpd] WebSocket server started on port %d\n", _port);
     }
 
-    /** Process connections and messages — call in loop() */
-    void loop() {
+    /** Add every client to a readiness pass (writes wanted while queued). */
+    void registerIO(IOPoller& io) {
+        for (auto& c : _clients) {
+            c.ioSlot = io.add(c.tcp, c.pendingOutput() > 0 ? IOPoller::READ | IOPoller::WRITE
+                                                           : IOPoller::READ);
+        }
+    }
+
+    /**
+     * Process connections and messages — call in loop(). With a poller,
+     * only readable clients are read and only writable ones written.
+     */
+    void loop(const IOPoller* io = nullptr) {
         if (!_server) return;
 
         // Accept new connections
@@ -97,22 +194,31 @@ public:
 
         // Process existing clients
         for (auto it = _clients.begin(); it != _clients.end();) {
-            if (!it->connected() || (now - it->lastActivity > TIMEOUT_MS)) {
+            if (!it->connected() || (now - it->lastActivity > TIMEOUT_MS) ||
+                (!it->handshakeDone && now - it->connectedAt > HANDSHAKE_TIMEOUT_MS)) {
+                it->tcp.stop();
                 it = _clients.erase(it);
                 continue;
             }
 
-            if (!it->handshakeDone) {
-                _handleHandshake(*it);
-            } else {
-                _handleFrames(*it);
+            if (!io || io->readable(it->ioSlot)) {
+                if (!it->handshakeDone) {
+                    _handleHandshake(*it);
+                } else {
+                    _handleFrames(*it);
+                }
             }
 
-            // Send ping periodically
-            if (it->handshakeDone && now - it->lastActivity > PING_INTERVAL_MS) {
+            // Send ping periodically (once per interval while idle)
+            unsigned long t = millis();
+            if (it->handshakeDone && t - it->lastActivity > PING_INTERVAL_MS &&
+                t - it->lastPingAt > PING_INTERVAL_MS) {
+                it->lastPingAt = t;
                 _sendPing(*it);
             }
 
+            if (!io || io->writable(it->ioSlot)) _drain(*it);
+
             ++it;
         }
     }
@@ -142,26 +248,63 @@ public:
     /** Number of connected clients */
     size_t clientCount() const { return _clients.size(); }
 
+    /** Bytes queued for all clients */
+    size_t queuedBytes() const {
+        size_t n = 0;
+        for (const auto& c : _clients) n += c.pendingOutput();
+        return n;
+    }
+
+    /** Clients dropped for letting MAX_OUTBOX_BYTES pile up */
+    unsigned long slowDisconnects() const { return _slowDisconnects; }
+
+    /** Connections closed by the server for a protocol violation */
+    unsigned long protocolErrors() const { return _protocolErrors; }
+
+    /** Messages sent compressed, and their size before / after */
+    unsigned long compressedMessages() const { return _compressedMessages; }
+    unsigned long compressionInputBytes() const { return _compressionIn; }
+    unsigned long compressionOutputBytes() const { return _compressionOut; }
+
     uint16_t port() const { return _port; }
 
+#ifdef MCPD_TEST
+public:  // Allow test access to internals
+#else
 private:
+#endif
     uint16_t _port;
     WiFiServer* _server;
     std::vector<WSClient> _clients;
     WSMessageHandler _handler;
+    unsigned long _slowDisconnects = 0;
+    unsigned long _protocolErrors = 0;
+    size_t _maxMessage = DEFAULT_MAX_MESSAGE_BYTES;
+    bool _deflateEnabled = false;
+    bool _contextTakeover = true;
+    DeflateDecoder _inflater;
+    unsigned long _compressedMessages = 0;
+    unsigned long _compressionIn = 0;
+    unsigned long _compressionOut = 0;
 
     /**
-     * Handle the WebSocket upgrade handshake (HTTP → WS).
+     * Handle the WebSocket upgrade handshake (HTTP → WS). The request may
+     * arrive over several calls; it is answered once the blank line is in.
      */
     void _handleHandshake(WSClient& client) {
-        if (!client.tcp.available()) return;
-
-        String request = "";
-        unsigned long start = millis();
-        while (client.tcp.available() && millis() - start < 1000) {
-            request += (char)client.tcp.read();
-            if (request.endsWith("\r\n\r\n")) break;
+        if (client.buffer.length() == 0) client.buffer.reserve(256);
+        while (client.tcp.available() > 0 && client.buffer.length() < MAX_HANDSHAKE_BYTES) {
+            int c = client.tcp.read();
+            if (c < 0) break;
+            client.buffer += (char)c;
+            if (client.buffer.endsWith("\r\n\r\n")) break;
+        }
+        if (!client.buffer.endsWith("\r\n\r\n")) {
+            if (client.buffer.length() >= MAX_HANDSHAKE_BYTES) client.tcp.stop();
+            return;
         }
+        String request = client.buffer;
+        client.buffer = "";
 
         // Find the Sec-WebSocket-Key
         int keyStart = request.indexOf("Sec-WebSocket-Key: ");
@@ -176,14 +319,19 @@ private:
         // Compute accept hash: SHA1(key + magic) → base64
         String acceptKey = _computeAcceptKey(key);
 
+        String extensions = _deflateEnabled ? _negotiateDeflate(request, client) : String();
+
         // Send upgrade response
-        client.tcp.print(
+        String response = String(
             "HTTP/1.1 101 Switching Protocols\r\n"
             "Upgrade: websocket\r\n"
             "Connection: Upgrade\r\n"
-            "Sec-WebSocket-Accept: " + acceptKey + "\r\n"
-            "\r\n"
-        );
+            "Sec-WebSocket-Accept: ") + acceptKey + "\r\n";
+        if (extensions.length() > 0) {
+            response += "Sec-WebSocket-Extensions: " + extensions + "\r\n";
+        }
+        response += "\r\n";
+        _queue(client, response);
 
         client.handshakeDone = true;
         client.lastActivity = millis();
@@ -191,116 +339,361 @@ private:
     }
 
     /**
-     * Read and process WebSocket frames.
+     * Feed whatever the socket has to the frame parser; complete messages
+     * are handed to the handler. Stops early once the connection is closed.
      */
     void _handleFrames(WSClient& client) {
-        if (!client.tcp.available()) return;
-        client.lastActivity = millis();
+        WSReceiver& rx = client.rx;
+        while (client.connected() && client.tcp.available() > 0) {
+            client.lastActivity = millis();
+            if (!rx.inPayload) {
+                size_t need = rx.headerLen < 2 ? 2 : _headerSize(rx.header);
+                int n = client.tcp.read(rx.header + rx.headerLen, need - rx.headerLen);
+                if (n <= 0) return;
+                rx.headerLen += (uint8_t)n;
+                if (rx.headerLen < 2 || rx.headerLen < _headerSize(rx.header)) continue;
+                if (!_beginFrame(client)) return;
+            } else {
+                uint8_t* dest = (rx.opcode & 0x8) ? rx.control + rx.frameRead
+                                                  : rx.message.data() + rx.frameStart + rx.frameRead;
+                int n = client.tcp.read(dest, rx.frameLen - rx.frameRead);
+                if (n <= 0) return;
+                for (int i = 0; i < n; i++) dest[i] ^= rx.mask[(rx.frameRead + i) & 3];
+                rx.frameRead += n;
+            }
+            if (rx.frameRead == rx.frameLen && !_endFrame(client)) return;
+        }
+    }
 
-        // Read frame header
-        uint8_t b0 = client.tcp.read();
-        uint8_t b1 = client.tcp.read();
+    static size_t _headerSize(const uint8_t* h) {
+        size_t n = 2;
+        uint8_t len = h[1] & 0x7F;
+        if (len == 126) n += 2;
+        else if (len == 127) n += 8;
+        if (h[1] & 0x80) n += 4;
+        return n;
+    }
+
+    /** Validate a complete header and set up where its payload goes. */
+    bool _beginFrame(WSClient& client) {
+        WSReceiver& rx = client.rx;
+        const uint8_t* h = rx.header;
+        rx.headerLen = 0;
+        rx.fin = h[0] & 0x80;
+        rx.opcode = h[0] & 0x0F;
+        bool rsv1 = h[0] & 0x40;
+        bool masked = h[1] & 0x80;
+
+        uint64_t len = h[1] & 0x7F;
+        size_t p = 2;
+        if (len == 126) {
+            len = ((uint64_t)h[2] << 8) | h[3];
+            p = 4;
+        } else if (len == 127) {
+            len = 0;
+            for (int i = 0; i < 8; i++) len = (len << 8) | h[2 + i];
+            p = 10;
+        }
+        if (masked) memcpy(rx.mask, h + p, 4);
 
-        uint8_t opcode = b0 & 0x0F;
-        bool masked = b1 & 0x80;
-        uint64_t payloadLen = b1 & 0x7F;
+        // Clients must mask; RSV2/RSV3 have no meaning without an extension
+        if (!masked || (h[0] & 0x30)) return _fail(client, WSCloseCode::ProtocolError);
 
-        if (payloadLen == 126) {
-            payloadLen = ((uint64_t)client.tcp.read() << 8) | client.tcp.read();
-        } else if (payloadLen == 127) {
-            payloadLen = 0;
-            for (int i = 0; i < 8; i++) {
-                payloadLen = (payloadLen << 8) | client.tcp.read();
+        if (rx.opcode & 0x8) {
+            if (rx.opcode > 0xA || !rx.fin || len > sizeof(rx.control) || rsv1) {
+                return _fail(client, WSCloseCode::ProtocolError);
             }
+        } else if (rx.opcode == 0x0) {
+            if (!rx.messageOpcode || rsv1) return _fail(client, WSCloseCode::ProtocolError);
+        } else if (rx.opcode == 0x1 || rx.opcode == 0x2) {
+            if (rx.messageOpcode || (rsv1 && !client.deflate)) {
+                return _fail(client, WSCloseCode::ProtocolError);
+            }
+            if (rx.opcode == 0x2) return _fail(client, WSCloseCode::UnsupportedData);
+            rx.messageOpcode = rx.opcode;
+            rx.messageCompressed = rsv1;
+        } else {
+            return _fail(client, WSCloseCode::ProtocolError);
         }
 
-        uint8_t mask[4] = {0};
-        if (masked) {
-            for (int i = 0; i < 4; i++) mask[i] = client.tcp.read();
+        if (!(rx.opcode & 0x8)) {
+            if (len > _maxMessage - rx.message.size()) {
+                return _fail(client, WSCloseCode::MessageTooBig);
+            }
+            rx.frameStart = rx.message.size();
+            rx.message.resize(rx.frameStart + (size_t)len);
         }
+        rx.frameLen = (size_t)len;
+        rx.frameRead = 0;
+        rx.inPayload = true;
+        return true;
+    }
 
-        // Read payload (limit to reasonable size for MCU)
-        if (payloadLen > 16384) {
-            client.tcp.stop();
-            return;
+    /** A frame's payload is in: answer control frames, deliver messages. */
+    bool _endFrame(WSClient& client) {
+        WSReceiver& rx = client.rx;
+        rx.inPayload = false;
+
+        switch (rx.opcode) {
+            case 0x8: return _handleClose(client);
+            case 0x9: _sendPongFrame(client, rx.control, rx.frameLen); return true;
+            case 0xA: return true;  // Pong — just update activity
         }
+        if (!rx.fin) return true;   // More fragments to come
 
         String payload;
-        payload.reserve(payloadLen);
-        for (uint64_t i = 0; i < payloadLen; i++) {
-            uint8_t byte = client.tcp.read();
-            if (masked) byte ^= mask[i % 4];
-            payload += (char)byte;
+        if (rx.messageCompressed) {
+            if (!_inflater.inflate(rx.message.data(), rx.message.size(), payload, _maxMessage)) {
+                _resetMessage(rx);
+                return _fail(client, _inflater.overflowed() ? WSCloseCode::MessageTooBig
+                                                            : WSCloseCode::InvalidPayload);
+            }
+        } else {
+            payload.concat((const char*)rx.message.data(), (unsigned)rx.message.size());
+        }
+        _resetMessage(rx);
+        if (!_validUtf8((const uint8_t*)payload.c_str(), payload.length())) {
+            return _fail(client, WSCloseCode::InvalidPayload);
         }
 
-        switch (opcode) {
-            case 0x1: // Text frame
-                if (_handler) {
-                    String response = _handler(payload);
-                    if (response.length() > 0) {
-                        _sendTextFrame(client, response);
-                    }
-                }
-                break;
+        if (_handler) {
+            String response = _handler(payload);
+            if (response.length() > 0) {
+                _sendTextFrame(client, response);
+            }
+        }
+        return client.connected();
+    }
 
-            case 0x8: // Close
-                _sendCloseFrame(client);
-                client.tcp.stop();
-                break;
+    void _resetMessage(WSReceiver& rx) {
+        rx.messageOpcode = 0;
+        rx.messageCompressed = false;
+        rx.message.clear();
+        if (rx.message.capacity() > RX_RETAIN_BYTES) std::vector<uint8_t>().swap(rx.message);
+    }
 
-            case 0x9: // Ping
-                _sendPongFrame(client, payload);
-                break;
+    /** Echo the peer's close code (RFC 6455 5.5.1) and drop the connection. */
+    bool _handleClose(WSClient& client) {
+        WSReceiver& rx = client.rx;
+        uint16_t code = 0;
+        if (rx.frameLen == 1) return _fail(client, WSCloseCode::ProtocolError);
+        if (rx.frameLen >= 2) {
+            code = ((uint16_t)rx.control[0] << 8) | rx.control[1];
+            bool valid = (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) ||
+                         (code >= 3000 && code <= 4999);
+            if (!valid) return _fail(client, WSCloseCode::ProtocolError);
+        }
+        _sendCloseFrame(client, code);
+        client.tcp.stop();
+        return false;
+    }
 
-            case 0xA: // Pong — just update activity
-                break;
+    /** Close with a status code after a protocol violation. */
+    bool _fail(WSClient& client, WSCloseCode code) {
+        _protocolErrors++;
+        _sendCloseFrame(client, (uint16_t)code);
+        client.tcp.stop();
+        return false;
+    }
+
+    static bool _validUtf8(const uint8_t* s, size_t len) {
+        size_t i = 0;
+        while (i < len) {
+            uint8_t c = s[i];
+            if (c < 0x80) { i++; continue; }
+            size_t n;
+            uint32_t cp;
+            if ((c & 0xE0) == 0xC0)      { n = 1; cp = c & 0x1F; }
+            else if ((c & 0xF0) == 0xE0) { n = 2; cp = c & 0x0F; }
+            else if ((c & 0xF8) == 0xF0) { n = 3; cp = c & 0x07; }
+            else return false;
+            if (i + n >= len) return false;  // Truncated sequence
+            for (size_t k = 1; k <= n; k++) {
+                if ((s[i + k] & 0xC0) != 0x80) return false;
+                cp = (cp << 6) | (s[i + k] & 0x3F);
+            }
+            // Overlong forms, UTF-16 surrogates, beyond U+10FFFF
+            static const uint32_t MIN_CP[4] = {0, 0x80, 0x800, 0x10000};
+            if (cp < MIN_CP[n] || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) return false;
+            i += n + 1;
         }
+        return true;
     }
 
     void _sendTextFrame(WSClient& client, const String& data) {
-        size_t len = data.length();
-
-        // FIN + text opcode
-        client.tcp.write((uint8_t)0x81);
+        const String* payload = &data;
+        String compressed;
+        uint8_t first = 0x81;  // FIN + text opcode
+        if (client.deflate && data.length() >= MIN_COMPRESS_BYTES &&
+            client.encoder.compress((const uint8_t*)data.c_str(), data.length(), compressed)) {
+            first |= 0x40;     // RSV1: compressed message
+            payload = &compressed;
+            _compressedMessages++;
+            _compressionIn += data.length();
+            _compressionOut += compressed.length();
+        }
+        size_t len = payload->length();
 
         // Payload length (server→client: no mask)
+        uint8_t header[10];
+        size_t n = 0;
+        header[n++] = first;
         if (len < 126) {
-            client.tcp.write((uint8_t)len);
+            header[n++] = (uint8_t)len;
         } else if (len < 65536) {
-            client.tcp.write((uint8_t)126);
-            client.tcp.write((uint8_t)(len >> 8));
-            client.tcp.write((uint8_t)(len & 0xFF));
+            header[n++] = 126;
+            header[n++] = (uint8_t)(len >> 8);
+            header[n++] = (uint8_t)(len & 0xFF);
         } else {
-            client.tcp.write((uint8_t)127);
+            header[n++] = 127;
             for (int i = 7; i >= 0; i--) {
-                client.tcp.write((uint8_t)((len >> (i * 8)) & 0xFF));
+                header[n++] = (uint8_t)(((uint64_t)len >> (i * 8)) & 0xFF);
             }
         }
 
-        client.tcp.write((const uint8_t*)data.c_str(), len);
-        client.tcp.flush();
+        _queue(client, (const char*)header, n);
+        _queue(client, payload->c_str(), len);
+        _drain(client);
     }
 
     void _sendPing(WSClient& client) {
-        client.tcp.write((uint8_t)0x89); // FIN + ping
-        client.tcp.write((uint8_t)0x00); // no payload
-        client.tcp.flush();
+        static const char ping[] = {(char)0x89, 0x00};  // FIN + ping, no payload
+        _queue(client, ping, sizeof(ping));
+        _drain(client);
     }
 
-    void _sendPongFrame(WSClient& client, const String& data) {
-        client.tcp.write((uint8_t)0x8A); // FIN + pong
-        uint8_t len = data.length();
-        client.tcp.write(len);
-        if (len > 0) {
-            client.tcp.write((const uint8_t*)data.c_str(), len);
+    void _sendPongFrame(WSClient& client, const uint8_t* data, size_t len) {
+        char header[2] = {(char)0x8A, (char)(uint8_t)len};  // FIN + pong
+        _queue(client, header, sizeof(header));
+        _queue(client, (const char*)data, len);
+        _drain(client);
+    }
+
+    void _sendCloseFrame(WSClient& client, uint16_t code = 0) {
+        // FIN + close, with the status code when there is one
+        char frame[4] = {(char)0x88, 0x00, (char)(code >> 8), (char)(code & 0xFF)};
+        if (code) frame[1] = 2;
+        _queue(client, frame, code ? 4 : 2);
+        _drain(client);
+    }
+
+    void _queue(WSClient& client, const char* data, size_t len) {
+        client.outbox.concat(data, len);
+    }
+
+    void _queue(WSClient& client, const String& data) {
+        _queue(client, data.c_str(), data.length());
+    }
+
+    /**
+     * Write as much queued output as the socket takes without waiting.
+     * A client that lets MAX_OUTBOX_BYTES pile up is disconnected.
+     */
+    void _drain(WSClient& client) {
+        size_t left = client.pendingOutput();
+        if (left > 0 && client.connected()) {
+            size_t n = client.tcp.write((const uint8_t*)client.outbox.c_str() + client.outPos, left);
+            client.outPos += n;
+            left -= n;
+        }
+        if (left == 0) {
+            client.outbox = String();
+            client.outPos = 0;
+        } else if (left > MAX_OUTBOX_BYTES) {
+            Serial.println("[mcpd] WebSocket client too slow, disconnecting");
+            client.tcp.stop();
+            client.outbox = String();
+            client.outPos = 0;
+            _slowDisconnects++;
         }
-        client.tcp.flush();
     }
 
-    void _sendCloseFrame(WSClient& client) {
-        client.tcp.write((uint8_t)0x88); // FIN + close
-        client.tcp.write((uint8_t)0x00);
-        client.tcp.flush();
+    /**
+     * Pick the first permessage-deflate offer in Sec-WebSocket-Extensions
+     * that we can honour and set up the client's encoder.
+     * @return response extension value, or "" to run uncompressed
+     */
+    String _negotiateDeflate(const String& request, WSClient& client) {
+        // Header names are case-insensitive; repeated headers are joined
+        String lower = request;
+        lower.toLowerCase();
+        String offers;
+        static const char NAME[] = "\r\nsec-websocket-extensions:";
+        int at = lower.indexOf(NAME);
+        while (at >= 0) {
+            int start = at + (int)sizeof(NAME) - 1;
+            int end = lower.indexOf("\r\n", start);
+            if (offers.length() > 0) offers += ",";
+            offers += lower.substring(start, end);
+            at = lower.indexOf(NAME, end);
+        }
+
+        int offerStart = 0;
+        while (offerStart <= (int)offers.length()) {
+            int offerEnd = offers.indexOf(',', offerStart);
+            if (offerEnd < 0) offerEnd = offers.length();
+            String offer = offers.substring(offerStart, offerEnd);
+            offerStart = offerEnd + 1;
+
+            uint8_t windowBits = DEFLATE_WINDOW_BITS;
+            bool noTakeover = !_contextTakeover;
+            uint8_t seen = 0;
+            bool usable = true;
+            int paramStart = 0;
+            for (int i = 0; usable && paramStart <= (int)offer.length(); i++) {
+                int paramEnd = offer.indexOf(';', paramStart);
+                if (paramEnd < 0) paramEnd = offer.length();
+                String param = offer.substring(paramStart, paramEnd);
+                paramStart = paramEnd + 1;
+                param.trim();
+
+                String value;
+                int eq = param.indexOf('=');
+                if (eq >= 0) {
+                    value = param.substring(eq + 1);
+                    value.trim();
+                    value.replace("\"", "");
+                    param = param.substring(0, eq);
+                    param.trim();
+                }
+
+                uint8_t bit;
+                if (i == 0) {
+                    usable = param == "permessage-deflate";
+                    continue;
+                } else if (param == "server_no_context_takeover") {
+                    bit = 1;
+                    noTakeover = true;
+                    usable = eq < 0;
+                } else if (param == "client_no_context_takeover") {
+                    bit = 2;
+                    usable = eq < 0;
+                } else if (param == "server_max_window_bits") {
+                    bit = 4;
+                    int bits = value.toInt();
+                    usable = bits >= 8 && bits <= 15;
+                    if (usable && bits < windowBits) windowBits = (uint8_t)bits;
+                } else if (param == "client_max_window_bits") {
+                    // Irrelevant: we ask for client_no_context_takeover
+                    bit = 8;
+                    usable = eq < 0 || (value.toInt() >= 8 && value.toInt() <= 15);
+                } else {
+                    usable = false;
+                    break;
+                }
+                if (seen & bit) usable = false;  // Duplicate parameter
+                seen |= bit;
+            }
+            if (!usable) continue;
+
+            client.deflate = true;
+            client.encoder.configure(windowBits, !noTakeover);
+            String response = "permessage-deflate; server_max_window_bits=" +
+                              String((int)windowBits) + "; client_no_context_takeover";
+            if (noTakeover) response += "; server_no_context_takeover";
+            return response;
+        }
+        return String();
     }
 
     /**
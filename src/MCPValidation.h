@@ -379,6 +379,442 @@ inline ValidationResult validateValue(JsonVariant value, JsonObject schema,
     return result;
 }
 
+// ════════════════════════════════════════════════════════════════════════
+// Compiled schemas
+// ════════════════════════════════════════════════════════════════════════
+
+/** JSON Schema "type" keyword, resolved once at compile time. */
+enum class SchemaType : uint8_t {
+    Any = 0,  // No type keyword (or an unsupported one) — not checked
+    String,
+    Number,
+    Integer,
+    Boolean,
+    Array,
+    Object,
+    Null
+};
+
+inline const char* schemaTypeName(SchemaType t) {
+    switch (t) {
+        case SchemaType::String:  return "string";
+        case SchemaType::Number:  return "number";
+        case SchemaType::Integer: return "integer";
+        case SchemaType::Boolean: return "boolean";
+        case SchemaType::Array:   return "array";
+        case SchemaType::Object:  return "object";
+        case SchemaType::Null:    return "null";
+        default:                  return "any";
+    }
+}
+
+inline SchemaType parseSchemaType(const char* type) {
+    if (!type) return SchemaType::Any;
+    if (strcmp(type, "string") == 0)  return SchemaType::String;
+    if (strcmp(type, "number") == 0)  return SchemaType::Number;
+    if (strcmp(type, "integer") == 0) return SchemaType::Integer;
+    if (strcmp(type, "boolean") == 0) return SchemaType::Boolean;
+    if (strcmp(type, "array") == 0)   return SchemaType::Array;
+    if (strcmp(type, "object") == 0)  return SchemaType::Object;
+    if (strcmp(type, "null") == 0)    return SchemaType::Null;
+    return SchemaType::Any;
+}
+
+/** Same checks as validateType(value, const char*), without string compares. */
+inline bool validateType(JsonVariant value, SchemaType type) {
+    switch (type) {
+        case SchemaType::String:  return value.is<const char*>();
+        case SchemaType::Number:  return value.is<float>() || value.is<double>() || value.is<int>() || value.is<long>();
+        case SchemaType::Integer: return value.is<int>() || value.is<long>();
+        case SchemaType::Boolean: return value.is<bool>();
+        case SchemaType::Array:   return value.is<JsonArray>();
+        case SchemaType::Object:  return value.is<JsonObject>();
+        case SchemaType::Null:    return value.isNull();
+        default:                  return true;
+    }
+}
+
+/**
+ * One schema node: the root schema or a property of an object schema.
+ * Children of an object rule are stored contiguously.
+ */
+struct SchemaRule {
+    enum Flags : uint8_t {
+        HAS_MINIMUM    = 1 << 0,
+        HAS_MAXIMUM    = 1 << 1,
+        HAS_MIN_LENGTH = 1 << 2,
+        HAS_MAX_LENGTH = 1 << 3,
+        HAS_MIN_ITEMS  = 1 << 4,
+        HAS_MAX_ITEMS  = 1 << 5,
+        HAS_PROPERTIES = 1 << 6,  // Nested object validation applies
+        REQUIRED_ONLY  = 1 << 7   // Listed in "required" but not in "properties"
+    };
+
+    uint16_t name = 0;            // Offset of the property name in the string pool
+    uint16_t parent = 0xFFFF;     // Parent rule (0xFFFF for the root)
+    uint16_t firstChild = 0;
+    uint16_t childCount = 0;
+    uint16_t firstRequired = 0;   // Into CompiledSchema required list
+    uint16_t requiredCount = 0;
+    uint16_t firstEnum = 0;       // Into CompiledSchema enum values
+    uint16_t enumCount = 0;
+    SchemaType type = SchemaType::Any;
+    uint8_t flags = 0;
+    bool hasEnum = false;
+    double minimum = 0;
+    double maximum = 0;
+    size_t minLength = 0;
+    size_t maxLength = 0;
+    size_t minItems = 0;
+    size_t maxItems = 0;
+};
+
+/** A literal from an "enum" keyword, with the type tests it satisfies. */
+struct SchemaEnumValue {
+    uint16_t str = 0xFFFF;  // Pool offset if the literal is a string
+    bool isInt = false;
+    bool isDouble = false;
+    bool isBool = false;
+    long intValue = 0;
+    double doubleValue = 0;
+    bool boolValue = false;
+};
+
+/**
+ * Flat, pre-parsed form of a JSON Schema for the validation subset above.
+ *
+ * Built once from the schema JSON (e.g. at tool registration); the
+ * validateArguments()/validateValue() overloads taking a CompiledSchema
+ * then walk the rule array without parsing or allocating. Heap is only
+ * touched when an error has to be reported.
+ *
+ *   CompiledSchema schema;
+ *   schema.compile(R"({"type":"object","required":["pin"], ...})");
+ *   ValidationResult vr = validateArguments(args, schema);
+ */
+class CompiledSchema {
+public:
+    static constexpr uint16_t NO_RULE = 0xFFFF;
+
+    /**
+     * Compile a schema from its JSON text.
+     * @return false if the text is not a JSON object (the schema is then empty)
+     */
+    bool compile(const char* schemaJson) {
+        clear();
+        if (!schemaJson || !*schemaJson) return false;
+        JsonDocument doc;
+        if (deserializeJson(doc, schemaJson) || !doc.is<JsonObject>()) return false;
+        return compile(doc.as<JsonObject>());
+    }
+
+    bool compile(const String& schemaJson) { return compile(schemaJson.c_str()); }
+
+    /** Compile an already parsed schema object. */
+    bool compile(JsonObject schema) {
+        clear();
+        _pool.push_back('\0');  // Offset 0 = empty name (root)
+        _rules.emplace_back();
+        _compileRule(0, schema);
+        _rules[0].flags |= SchemaRule::HAS_PROPERTIES;
+        _compileChildren(0, schema);
+        return true;
+    }
+
+    /** Drop all rules and release their memory. */
+    void clear() {
+        std::vector<SchemaRule>().swap(_rules);
+        std::vector<uint16_t>().swap(_required);
+        std::vector<SchemaEnumValue>().swap(_enums);
+        std::vector<char>().swap(_pool);
+    }
+
+    bool isCompiled() const { return !_rules.empty(); }
+    size_t ruleCount() const { return _rules.size(); }
+
+    const SchemaRule& rule(size_t idx) const { return _rules[idx]; }
+    const SchemaEnumValue& enumValue(size_t idx) const { return _enums[idx]; }
+    uint16_t requiredRule(size_t idx) const { return _required[idx]; }
+    const char* str(uint16_t offset) const { return &_pool[offset]; }
+    const char* name(const SchemaRule& r) const { return &_pool[r.name]; }
+
+    /** Dotted field path of a rule (e.g. "config.mode"), "" for the root. */
+    String path(uint16_t idx) const {
+        if (idx == 0 || idx >= _rules.size()) return String("");
+        String parentPath = path(_rules[idx].parent);
+        if (parentPath.isEmpty()) return String(name(_rules[idx]));
+        return parentPath + "." + name(_rules[idx]);
+    }
+
+    /** Approximate heap footprint, for diagnostics. */
+    size_t memoryUsage() const {
+        return _rules.capacity() * sizeof(SchemaRule)
+             + _required.capacity() * sizeof(uint16_t)
+             + _enums.capacity() * sizeof(SchemaEnumValue)
+             + _pool.capacity();
+    }
+
+private:
+    std::vector<SchemaRule> _rules;       // [0] is the root
+    std::vector<uint16_t> _required;      // Child rule indices in "required" order
+    std::vector<SchemaEnumValue> _enums;
+    std::vector<char> _pool;              // NUL-terminated names and enum strings
+
+    uint16_t _intern(const char* s) {
+        uint16_t offset = (uint16_t)_pool.size();
+        if (s) _pool.insert(_pool.end(), s, s + strlen(s));
+        _pool.push_back('\0');
+        return offset;
+    }
+
+    /** Fill in the keyword constraints of one rule. */
+    void _compileRule(uint16_t idx, JsonObject schema) {
+        SchemaRule r = _rules[idx];
+        if (schema.containsKey("type")) r.type = parseSchemaType(schema["type"].as<const char*>());
+        if (schema.containsKey("minimum")) { r.flags |= SchemaRule::HAS_MINIMUM; r.minimum = schema["minimum"].as<double>(); }
+        if (schema.containsKey("maximum")) { r.flags |= SchemaRule::HAS_MAXIMUM; r.maximum = schema["maximum"].as<double>(); }
+        if (schema.containsKey("minLength")) { r.flags |= SchemaRule::HAS_MIN_LENGTH; r.minLength = schema["minLength"].as<size_t>(); }
+        if (schema.containsKey("maxLength")) { r.flags |= SchemaRule::HAS_MAX_LENGTH; r.maxLength = schema["maxLength"].as<size_t>(); }
+        if (schema.containsKey("minItems")) { r.flags |= SchemaRule::HAS_MIN_ITEMS; r.minItems = schema["minItems"].as<size_t>(); }
+        if (schema.containsKey("maxItems")) { r.flags |= SchemaRule::HAS_MAX_ITEMS; r.maxItems = schema["maxItems"].as<size_t>(); }
+        if (schema.containsKey("properties")) r.flags |= SchemaRule::HAS_PROPERTIES;
+
+        if (schema.containsKey("enum")) {
+            r.hasEnum = true;
+            r.firstEnum = (uint16_t)_enums.size();
+            for (JsonVariant ev : schema["enum"].as<JsonArray>()) {
+                SchemaEnumValue e;
+                if (ev.is<const char*>()) e.str = _intern(ev.as<const char*>());
+                e.isInt = ev.is<int>() || ev.is<long>();
+                if (e.isInt) e.intValue = ev.as<long>();
+                e.isDouble = ev.is<double>() || ev.is<float>();
+                if (e.isDouble) e.doubleValue = ev.as<double>();
+                e.isBool = ev.is<bool>();
+                if (e.isBool) e.boolValue = ev.as<bool>();
+                _enums.push_back(e);
+            }
+            r.enumCount = (uint16_t)(_enums.size() - r.firstEnum);
+        }
+        _rules[idx] = r;
+    }
+
+    /** Lay out the properties (and required-only names) of an object rule. */
+    void _compileChildren(uint16_t idx, JsonObject schema) {
+        uint16_t first = (uint16_t)_rules.size();
+        JsonObject properties = schema["properties"].as<JsonObject>();
+        for (JsonPair prop : properties) {
+            SchemaRule child;
+            child.name = _intern(prop.key().c_str());
+            child.parent = idx;
+            _rules.push_back(child);
+        }
+
+        // Required names resolve to a child rule; names without a property
+        // schema get a constraint-free placeholder
+        uint16_t firstRequired = (uint16_t)_required.size();
+        if (schema.containsKey("required")) {
+            for (JsonVariant req : schema["required"].as<JsonArray>()) {
+                const char* fieldName = req.as<const char*>();
+                if (!fieldName) continue;
+                uint16_t found = NO_RULE;
+                for (uint16_t c = first; c < _rules.size(); c++) {
+                    if (strcmp(name(_rules[c]), fieldName) == 0) { found = c; break; }
+                }
+                if (found == NO_RULE) {
+                    SchemaRule child;
+                    child.name = _intern(fieldName);
+                    child.parent = idx;
+                    child.flags = SchemaRule::REQUIRED_ONLY;
+                    found = (uint16_t)_rules.size();
+                    _rules.push_back(child);
+                }
+                _required.push_back(found);
+            }
+        }
+
+        _rules[idx].firstChild = first;
+        _rules[idx].childCount = (uint16_t)(_rules.size() - first);
+        _rules[idx].firstRequired = firstRequired;
+        _rules[idx].requiredCount = (uint16_t)(_required.size() - firstRequired);
+
+        // Constraints first, then recurse: nested children are appended
+        // after this object's contiguous block
+        uint16_t c = first;
+        for (JsonPair prop : properties) {
+            JsonObject propSchema = prop.value().as<JsonObject>();
+            _compileRule(c, propSchema);
+            if (_rules[c].flags & SchemaRule::HAS_PROPERTIES) _compileChildren(c, propSchema);
+            c++;
+        }
+    }
+};
+
+inline bool _enumMatches(JsonVariant value, const CompiledSchema& schema, const SchemaRule& r) {
+    for (uint16_t i = 0; i < r.enumCount; i++) {
+        const SchemaEnumValue& ev = schema.enumValue(r.firstEnum + i);
+        if (value.is<const char*>() && ev.str != CompiledSchema::NO_RULE) {
+            if (strcmp(value.as<const char*>(), schema.str(ev.str)) == 0) return true;
+        } else if (value.is<int>() && ev.isInt) {
+            if (value.as<int>() == (int)ev.intValue) return true;
+        } else if (value.is<double>() && ev.isDouble) {
+            if (value.as<double>() == ev.doubleValue) return true;
+        } else if (value.is<bool>() && ev.isBool) {
+            if (value.as<bool>() == ev.boolValue) return true;
+        }
+    }
+    return false;
+}
+
+inline String _enumListMessage(const CompiledSchema& schema, const SchemaRule& r) {
+    String msg = "must be one of [";
+    for (uint16_t i = 0; i < r.enumCount; i++) {
+        const SchemaEnumValue& ev = schema.enumValue(r.firstEnum + i);
+        if (i > 0) msg += ", ";
+        if (ev.str != CompiledSchema::NO_RULE) {
+            msg += "\"";
+            msg += schema.str(ev.str);
+            msg += "\"";
+        } else if (ev.isInt) {
+            msg += String(ev.intValue);
+        } else if (ev.isDouble) {
+            msg += String(ev.doubleValue, 2);
+        } else if (ev.isBool) {
+            msg += ev.boolValue ? "true" : "false";
+        } else {
+            msg += "?";
+        }
+    }
+    msg += "]";
+    return msg;
+}
+
+/**
+ * Scalar/array constraints shared by properties and the output root.
+ * @param enumMsg  Use the detailed "must be one of [...]" message
+ */
+inline void _checkConstraints(JsonVariant value, const CompiledSchema& schema,
+                              const SchemaRule& r, const String& field,
+                              bool enumMsg, ValidationResult& result) {
+    if (r.hasEnum && !_enumMatches(value, schema, r)) {
+        result.addError(field, enumMsg ? _enumListMessage(schema, r) : String("value not in enum"));
+    }
+
+    if ((r.flags & (SchemaRule::HAS_MINIMUM | SchemaRule::HAS_MAXIMUM)) &&
+        (value.is<int>() || value.is<long>() || value.is<float>() || value.is<double>())) {
+        double v = value.as<double>();
+        if ((r.flags & SchemaRule::HAS_MINIMUM) && v < r.minimum) {
+            result.addError(field, "must be >= " + String(r.minimum, 2));
+        }
+        if ((r.flags & SchemaRule::HAS_MAXIMUM) && v > r.maximum) {
+            result.addError(field, "must be <= " + String(r.maximum, 2));
+        }
+    }
+
+    if (value.is<const char*>()) {
+        size_t len = strlen(value.as<const char*>());
+        if ((r.flags & SchemaRule::HAS_MIN_LENGTH) && len < r.minLength) {
+            result.addError(field, "length must be >= " + String((unsigned long)r.minLength));
+        }
+        if ((r.flags & SchemaRule::HAS_MAX_LENGTH) && len > r.maxLength) {
+            result.addError(field, "length must be <= " + String((unsigned long)r.maxLength));
+        }
+    }
+
+    if (value.is<JsonArray>()) {
+        size_t len = value.as<JsonArray>().size();
+        if ((r.flags & SchemaRule::HAS_MIN_ITEMS) && len < r.minItems) {
+            result.addError(field, "must have >= " + String((unsigned long)r.minItems) + " items");
+        }
+        if ((r.flags & SchemaRule::HAS_MAX_ITEMS) && len > r.maxItems) {
+            result.addError(field, "must have <= " + String((unsigned long)r.maxItems) + " items");
+        }
+    }
+}
+
+inline void _validateCompiledObject(JsonObject args, const CompiledSchema& schema,
+                                    uint16_t idx, ValidationResult& result) {
+    const SchemaRule& obj = schema.rule(idx);
+
+    // Check required fields
+    for (uint16_t i = 0; i < obj.requiredCount; i++) {
+        uint16_t c = schema.requiredRule(obj.firstRequired + i);
+        const char* fieldName = schema.name(schema.rule(c));
+        if (!args.containsKey(fieldName) || args[fieldName].isNull()) {
+            result.addError(schema.path(c), "is required");
+        }
+    }
+
+    // Check property types and constraints
+    for (uint16_t i = 0; i < obj.childCount; i++) {
+        uint16_t c = obj.firstChild + i;
+        const SchemaRule& r = schema.rule(c);
+        if (r.flags & SchemaRule::REQUIRED_ONLY) continue;
+
+        const char* fieldName = schema.name(r);
+        if (!args.containsKey(fieldName)) continue; // Missing optional fields are fine
+        JsonVariant value = args[fieldName];
+        if (value.isNull()) continue;
+
+        if (r.type != SchemaType::Any && !validateType(value, r.type)) {
+            String msg = "must be ";
+            msg += schemaTypeName(r.type);
+            msg += ", got ";
+            msg += jsonTypeName(value);
+            result.addError(schema.path(c), msg);
+            continue; // Skip further checks on wrong type
+        }
+
+        if (r.hasEnum || (r.flags & (SchemaRule::HAS_MINIMUM | SchemaRule::HAS_MAXIMUM |
+                                     SchemaRule::HAS_MIN_LENGTH | SchemaRule::HAS_MAX_LENGTH |
+                                     SchemaRule::HAS_MIN_ITEMS | SchemaRule::HAS_MAX_ITEMS))) {
+            _checkConstraints(value, schema, r, schema.path(c), true, result);
+        }
+
+        // Recursive validation for nested objects
+        if ((r.flags & SchemaRule::HAS_PROPERTIES) && value.is<JsonObject>()) {
+            _validateCompiledObject(value.as<JsonObject>(), schema, c, result);
+        }
+    }
+}
+
+/**
+ * Validate tool arguments against a compiled schema.
+ * Produces the same errors as the JsonObject overload.
+ */
+inline ValidationResult validateArguments(JsonObject args, const CompiledSchema& schema) {
+    ValidationResult result;
+    if (schema.isCompiled()) _validateCompiledObject(args, schema, 0, result);
+    return result;
+}
+
+/**
+ * Validate any JSON value against a compiled schema (output validation).
+ * Produces the same errors as the JsonObject overload.
+ */
+inline ValidationResult validateValue(JsonVariant value, const CompiledSchema& schema) {
+    ValidationResult result;
+    if (!schema.isCompiled()) return result;
+    const SchemaRule& root = schema.rule(0);
+
+    if (root.type != SchemaType::Any) {
+        if (!validateType(value, root.type)) {
+            String msg = "must be ";
+            msg += schemaTypeName(root.type);
+            msg += ", got ";
+            msg += jsonTypeName(value);
+            result.addError("(root)", msg);
+            return result;
+        }
+        if (root.type == SchemaType::Object && value.is<JsonObject>()) {
+            _validateCompiledObject(value.as<JsonObject>(), schema, 0, result);
+            return result;
+        }
+    }
+
+    _checkConstraints(value, schema, root, String("(root)"), false, result);
+    return result;
+}
+
 } // namespace mcpd
 
 #endif // MCPD_VALIDATION_H
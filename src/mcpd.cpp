@@ -6,6 +6,8 @@
 
 #include "mcpd.h"
 
+#include <algorithm>
+
 namespace mcpd {
 
 // ════════════════════════════════════════════════════════════════════════
@@ -26,10 +28,12 @@ Server::~Server() {
 void Server::addTool(const char* name, const char* description,
                      const char* inputSchemaJson, MCPToolHandler handler) {
     _tools.emplace_back(name, description, inputSchemaJson, handler);
+    _registerTool();
 }
 
 void Server::addTool(const MCPTool& tool) {
     _tools.push_back(tool);
+    _registerTool();
 }
 
 void Server::addRichTool(const char* name, const char* description,
@@ -37,38 +41,106 @@ void Server::addRichTool(const char* name, const char* description,
     // Register as a normal tool with a wrapper handler
     _tools.emplace_back(name, description, inputSchemaJson,
         [](const JsonObject&) -> String { return "{}"; });  // placeholder
-    // Store the rich handler separately
-    _richTools.emplace_back(String(name), handler);
+    // Store the rich handler in the tool's slot
+    _registerTool().richHandler = handler;
+}
+
+ToolSlot& Server::_registerTool() {
+    size_t idx = _tools.size() - 1;
+    size_t owner = _toolTable.add(_tools);
+    // Mirror group/cache state for the new tool (the table revisions stay
+    // put so other slots are not considered refreshed)
+    ToolSlot& slot = _toolTable.slot(idx);
+    const char* name = _tools[idx].name.c_str();
+    slot.groupDisabled = _toolGroups.isToolGroupDisabled(name);
+    slot.cacheTtlMs = _cache.getToolTTL(name);
+    _compileToolSchemas(_tools[idx]);
+    _listCache.invalidate(ListKind::Tools);
+    // Duplicate names resolve to the first registration, so handlers
+    // attached to a later duplicate land on that slot
+    return _toolTable.slot(owner);
+}
+
+// Schemas are only compiled while the matching validation is enabled, so
+// servers that never validate do not pay the RAM for the rule arrays.
+void Server::_compileToolSchemas(MCPTool& tool) {
+    if (_inputValidation && !tool.compiledInputSchema.isCompiled() &&
+        !tool.inputSchemaJson.isEmpty()) {
+        tool.compiledInputSchema.compile(tool.inputSchemaJson);
+    }
+    if (_outputValidation && !tool.compiledOutputSchema.isCompiled() &&
+        !tool.outputSchemaJson.isEmpty()) {
+        tool.compiledOutputSchema.compile(tool.outputSchemaJson);
+    }
+}
+
+void Server::enableInputValidation(bool enable) {
+    _inputValidation = enable;
+    for (auto& tool : _tools) {
+        if (enable) _compileToolSchemas(tool);
+        else tool.compiledInputSchema.clear();
+    }
+}
+
+void Server::enableOutputValidation(bool enable) {
+    _outputValidation = enable;
+    for (auto& tool : _tools) {
+        if (enable) _compileToolSchemas(tool);
+        else tool.compiledOutputSchema.clear();
+    }
+}
+
+void Server::_syncToolTable() {
+    if (_toolTable.groupRevision != _toolGroups.revision()) {
+        for (size_t i = 0; i < _tools.size(); i++) {
+            _toolTable.slot(i).groupDisabled =
+                _toolGroups.isToolGroupDisabled(_tools[i].name.c_str());
+        }
+        _toolTable.groupRevision = _toolGroups.revision();
+        _listCache.invalidate(ListKind::Tools);
+    }
+    if (_toolTable.cacheRevision != _cache.revision()) {
+        for (size_t i = 0; i < _tools.size(); i++) {
+            _toolTable.slot(i).cacheTtlMs = _cache.getToolTTL(_tools[i].name.c_str());
+        }
+        _toolTable.cacheRevision = _cache.revision();
+    }
 }
 
 void Server::addResource(const char* uri, const char* name,
                          const char* description, const char* mimeType,
                          MCPResourceHandler handler) {
     _resources.emplace_back(uri, name, description, mimeType, handler);
+    _listCache.invalidate(ListKind::Resources);
 }
 
 void Server::addResource(const MCPResource& resource) {
     _resources.push_back(resource);
+    _listCache.invalidate(ListKind::Resources);
 }
 
 void Server::addResourceTemplate(const char* uriTemplate, const char* name,
                                  const char* description, const char* mimeType,
                                  MCPResourceTemplateHandler handler) {
     _resourceTemplates.emplace_back(uriTemplate, name, description, mimeType, handler);
+    _listCache.invalidate(ListKind::ResourceTemplates);
 }
 
 void Server::addResourceTemplate(const MCPResourceTemplate& tmpl) {
     _resourceTemplates.push_back(tmpl);
+    _listCache.invalidate(ListKind::ResourceTemplates);
 }
 
 void Server::addPrompt(const char* name, const char* description,
                        std::vector<MCPPromptArgument> arguments,
                        MCPPromptHandler handler) {
     _prompts.emplace_back(name, description, std::move(arguments), handler);
+    _listCache.invalidate(ListKind::Prompts);
 }
 
 void Server::addPrompt(const MCPPrompt& prompt) {
     _prompts.push_back(prompt);
+    _listCache.invalidate(ListKind::Prompts);
 }
 
 void Server::addRoot(const char* uri, const char* name) {
@@ -83,26 +155,21 @@ void Server::setEndpoint(const char* path) { _endpoint = path; }
 void Server::setMDNS(bool enabled) { _mdnsEnabled = enabled; }
 
 bool Server::enableTool(const char* name, bool enabled) {
-    // Verify tool exists
-    bool found = false;
-    for (const auto& t : _tools) {
-        if (t.name == name) { found = true; break; }
-    }
-    if (!found) return false;
+    ToolSlot* slot = _toolTable.findSlot(name, _tools);
+    if (!slot) return false;
 
-    if (enabled) {
-        _disabledTools.erase(String(name));
-    } else {
-        _disabledTools.insert(String(name));
-    }
-    notifyToolsChanged();
+    slot->enabled = enabled;
+    notifyToolsChanged();  // Also invalidates the cached tools/list
     return true;
 }
 
 bool Server::isToolEnabled(const char* name) const {
-    if (_disabledTools.find(String(name)) != _disabledTools.end()) return false;
-    if (_toolGroups.isToolGroupDisabled(name)) return false;
-    return true;
+    const ToolSlot* slot = _toolTable.findSlot(name, _tools);
+    if (slot && !slot->enabled) return false;
+    if (slot && _toolTable.groupRevision == _toolGroups.revision()) {
+        return !slot->groupDisabled;
+    }
+    return !_toolGroups.isToolGroupDisabled(name);
 }
 
 bool Server::enableToolGroup(const char* name, bool enabled) {
@@ -112,19 +179,19 @@ bool Server::enableToolGroup(const char* name, bool enabled) {
 }
 
 bool Server::removeTool(const char* name) {
-    for (auto it = _tools.begin(); it != _tools.end(); ++it) {
-        if (it->name == name) {
-            _tools.erase(it);
-            return true;
-        }
-    }
-    return false;
+    int idx = _toolTable.find(name, _tools);
+    if (idx < 0) return false;
+    _tools.erase(_tools.begin() + idx);
+    _toolTable.removeAt((size_t)idx, _tools);
+    _listCache.invalidate(ListKind::Tools);
+    return true;
 }
 
 bool Server::removeResource(const char* uri) {
     for (auto it = _resources.begin(); it != _resources.end(); ++it) {
         if (it->uri == uri) {
             _resources.erase(it);
+            _listCache.invalidate(ListKind::Resources);
             return true;
         }
     }
@@ -135,6 +202,7 @@ bool Server::removeResourceTemplate(const char* uriTemplate) {
     for (auto it = _resourceTemplates.begin(); it != _resourceTemplates.end(); ++it) {
         if (it->uriTemplate == uriTemplate) {
             _resourceTemplates.erase(it);
+            _listCache.invalidate(ListKind::ResourceTemplates);
             return true;
         }
     }
@@ -145,6 +213,7 @@ bool Server::removePrompt(const char* name) {
     for (auto it = _prompts.begin(); it != _prompts.end(); ++it) {
         if (it->name == name) {
             _prompts.erase(it);
+            _listCache.invalidate(ListKind::Prompts);
             return true;
         }
     }
@@ -162,30 +231,34 @@ bool Server::removeRoot(const char* uri) {
 }
 
 void Server::notifyToolsChanged() {
+    _listCache.invalidate(ListKind::Tools);
     JsonDocument doc;
     doc["jsonrpc"] = "2.0";
     doc["method"] = "notifications/tools/list_changed";
     String output;
     serializeJson(doc, output);
-    _pendingNotifications.push_back(output);
+    _broadcastNotification(output);
 }
 
 void Server::notifyResourcesChanged() {
+    _listCache.invalidate(ListKind::Resources);
+    _listCache.invalidate(ListKind::ResourceTemplates);
     JsonDocument doc;
     doc["jsonrpc"] = "2.0";
     doc["method"] = "notifications/resources/list_changed";
     String output;
     serializeJson(doc, output);
-    _pendingNotifications.push_back(output);
+    _broadcastNotification(output);
 }
 
 void Server::notifyPromptsChanged() {
+    _listCache.invalidate(ListKind::Prompts);
     JsonDocument doc;
     doc["jsonrpc"] = "2.0";
     doc["method"] = "notifications/prompts/list_changed";
     String output;
     serializeJson(doc, output);
-    _pendingNotifications.push_back(output);
+    _broadcastNotification(output);
 }
 
 // ════════════════════════════════════════════════════════════════════════
@@ -199,8 +272,9 @@ void Server::begin() {
     _httpServer = new WebServer(_port);
 
     // Collect headers we need to read
-    const char* headerKeys[] = { transport::HEADER_SESSION_ID };
-    _httpServer->collectHeaders(headerKeys, 1);
+    const char* headerKeys[] = { transport::HEADER_SESSION_ID, transport::HEADER_ACCEPT,
+                                 transport::HEADER_LAST_EVENT_ID, transport::HEADER_CONNECTION };
+    _httpServer->collectHeaders(headerKeys, 4);
 
     // Register MCP endpoint handlers
     _httpServer->on(_endpoint, HTTP_POST, [this]() { _handleMCPPost(); });
@@ -214,6 +288,12 @@ void Server::begin() {
     // Register Prometheus metrics endpoint
     _metrics.begin(*_httpServer);
 
+    // Deliver log messages to each session at its own level, unless the
+    // application installed its own sink
+    if (!_logging.hasSink()) {
+        _logging.setSink([this](const String& n) { _routeLogNotification(n); });
+    }
+
     _httpServer->begin();
 
     // mDNS advertisement
@@ -233,8 +313,10 @@ void Server::begin() {
     if (_wsPort > 0) {
         _wsTransport = new WebSocketTransport(_wsPort);
         _wsTransport->onMessage([this](const String& msg) -> String {
-            return _processJsonRpc(msg);
+            return _processLocal(msg);
         });
+        if (_wsDeflate) _wsTransport->enableCompression(_wsContextTakeover);
+        _wsTransport->setMaxMessageSize(_wsMaxMessage);
         _wsTransport->begin();
         if (_mdnsEnabled) {
             char wsPortStr[8];
@@ -249,12 +331,13 @@ void Server::begin() {
     if (_bleName) {
         _bleTransport = new BLETransport(_bleName, _bleMtu);
         _bleTransport->onMessage([this](const String& msg) -> String {
-            return _processJsonRpc(msg);
+            return _processLocal(msg);
         });
         _bleTransport->onConnection([this](bool connected) {
             if (connected && _onConnectCb) _onConnectCb();
             if (!connected && _onDisconnectCb) _onDisconnectCb();
         });
+        if (_bleThroughput) _bleTransport->enableThroughputMode(_bleWindow);
         _bleTransport->begin();
         Serial.printf("[mcpd] BLE transport enabled: %s\n", _bleName);
     }
@@ -269,17 +352,47 @@ void Server::loop() {
         _httpServer->handleClient();
     }
 
-    // Manage SSE connections (keepalive, prune)
-    _sseManager.loop();
+    // One readiness pass over every open connection (kept-alive HTTP, SSE,
+    // WebSocket); the transports below only touch sockets that can progress
+    _io.reset();
+    _keepAlive.registerIO(_io);
+    _sseManager.registerIO(_io);
+    if (_wsTransport) _wsTransport->registerIO(_io);
+    _io.poll();
+
+    // Requests on kept-alive connections
+    _keepAlive.loop([this](HttpConnection& conn) { _serveKeepAlive(conn); }, &_io);
 
-    // Send any pending notifications via SSE
-    if (_sseManager.hasClients(_sessionId) && !_pendingNotifications.empty()) {
-        for (const auto& notif : _pendingNotifications) {
-            _sseManager.broadcast(_sessionId, notif);
+    // Background work (cache refreshes, user tasks)
+    _scheduler.loop();
+
+    // Manage SSE connections (keepalive, prune)
+    _sseManager.loop(&_io);
+
+    // Release the streams of sessions that expired or were evicted
+    _sessionManager.pruneExpired();
+    for (const auto& ended : _sessionManager.takeEnded()) {
+        _sseManager.closeSession(ended);
+        _subscriptions.removeSubscriber(ended);
+        if (ended == _sessionId) {
+            _sessionId = "";
+            _initialized = false;
         }
-        _pendingNotifications.clear();
     }
 
+    // Resource updates held back by the coalescing window
+    _resourceUpdates.flush(millis(), [this](const String& uri) { _sendResourceUpdated(uri); });
+
+    // Send each session's pending notifications to its own SSE stream
+    _sessionManager.forEach([this](Session& session) {
+        if (!_sseManager.hasClients(session.id)) return;
+        session.touch();  // An open stream keeps the session alive
+        for (const auto& notif : session.pending) {
+            _sseManager.broadcast(session.id, notif);
+        }
+        session.pending.clear();
+    });
+
     // Send any pending sampling requests via SSE
     auto outgoing = _samplingManager.drainOutgoing();
     for (const auto& msg : outgoing) {
@@ -296,13 +409,19 @@ void Server::loop() {
         }
     }
 
+    _metrics.setSSEReplayStats(_sseManager.replayedEvents(),
+                               _sseManager.droppedEvents());
+    _metrics.setSSEQueueStats(_sseManager.queuedBytes(), _sseManager.queuedFrames(),
+                              _sseManager.shedEvents(), _sseManager.coalescedEvents(),
+                              _sseManager.slowDisconnects());
+
     // Prune expired requests
     _samplingManager.pruneExpired();
     _elicitationManager.pruneExpired();
 
     // Process WebSocket transport if enabled
     if (_wsTransport) {
-        _wsTransport->loop();
+        _wsTransport->loop(&_io);
     }
 
     // Process BLE transport if enabled
@@ -310,13 +429,12 @@ void Server::loop() {
     if (_bleTransport) {
         _bleTransport->loop();
 
-        // Forward pending notifications via BLE too
+        // Forward the session-less notifications via BLE
         if (_bleTransport->isConnected() && !_pendingNotifications.empty()) {
             for (const auto& notif : _pendingNotifications) {
                 _bleTransport->sendNotification(notif);
             }
-            // Note: don't clear here — SSE might still need them
-            // They're cleared after SSE broadcast above
+            _pendingNotifications.clear();
         }
     }
 #endif
@@ -326,23 +444,44 @@ void Server::enableWebSocket(uint16_t port) {
     _wsPort = port;
 }
 
+void Server::enableWebSocketCompression(bool contextTakeover) {
+    _wsDeflate = true;
+    _wsContextTakeover = contextTakeover;
+}
+
+void Server::setWebSocketMaxMessageSize(size_t bytes) {
+    _wsMaxMessage = bytes;
+}
+
 #ifdef ESP32
 void Server::enableBLE(const char* deviceName, uint16_t mtu) {
     _bleName = deviceName;
     _bleMtu = mtu;
 }
+
+void Server::enableBLEThroughputMode(uint8_t window) {
+    _bleThroughput = true;
+    _bleWindow = window;
+}
 #endif
 
 void Server::setRateLimit(float requestsPerSecond, size_t burstCapacity) {
     _rateLimiter.configure(requestsPerSecond, burstCapacity);
 }
 
+void Server::enableKeepAlive(size_t maxConnections, unsigned long idleTimeoutMs) {
+    _keepAlive.setMaxConnections(maxConnections);
+    _keepAlive.setIdleTimeout(idleTimeoutMs);
+    _keepAlive.setEnabled(true);
+}
+
 void Server::stop() {
     if (_httpServer) {
         _httpServer->stop();
         delete _httpServer;
         _httpServer = nullptr;
     }
+    _keepAlive.closeAll();
     if (_wsTransport) {
         _wsTransport->stop();
         delete _wsTransport;
@@ -355,6 +494,10 @@ void Server::stop() {
         _bleTransport = nullptr;
     }
 #endif
+    _sessionManager.clear();
+    for (const auto& ended : _sessionManager.takeEnded()) {
+        _subscriptions.removeSubscriber(ended);
+    }
     _initialized = false;
     _sessionId = "";
 }
@@ -364,107 +507,207 @@ void Server::stop() {
 // ════════════════════════════════════════════════════════════════════════
 
 void Server::_handleMCPPost() {
-    transport::setCORSHeaders(*_httpServer);
+    // Keep the connection: answer on the socket ourselves and serve the
+    // requests that follow on it from loop(). WebServer sends nothing.
+    if (_keepAlive.canAdopt(_httpServer->header(transport::HEADER_CONNECTION))) {
+        HttpConnection& conn = _keepAlive.adopt(_httpServer->client());
+        conn.loadRequest(*_httpServer, HTTP_POST, _endpoint);
+        _serveMCPPost(conn);
+        conn.flush();
+        return;
+    }
+    _serveMCPPost(*_httpServer);
+}
+
+void Server::_handleMCPGet() {
+    _serveMCPGet(*_httpServer);
+}
+
+void Server::_handleMCPDelete() {
+    _serveMCPDelete(*_httpServer);
+}
+
+// A request read from a kept-alive connection
+void Server::_serveKeepAlive(HttpConnection& conn) {
+    if (conn.uri() != _endpoint) {
+        conn.send(404, "text/plain", "Not found");
+        return;
+    }
+    switch (conn.method()) {
+        case HTTP_POST:
+            _serveMCPPost(conn);
+            break;
+        case HTTP_GET:
+            // The stream takes the socket over, so earlier responses must
+            // be out first
+            if (!conn.flush()) {
+                conn.send(503, transport::CONTENT_TYPE_JSON,
+                          _jsonRpcError(JsonVariant(), -32000, "Connection busy"));
+            } else if (_serveMCPGet(conn)) {
+                _keepAlive.release(conn);
+            }
+            break;
+        case HTTP_DELETE:
+            _serveMCPDelete(conn);
+            break;
+        case HTTP_OPTIONS:
+            transport::setCORSHeaders(conn);
+            conn.send(204);
+            break;
+        default:
+            conn.send(405);
+            break;
+    }
+}
+
+template <typename THttp>
+void Server::_serveMCPPost(THttp& http) {
+    transport::setCORSHeaders(http);
 
     // Authentication check
-    if (_auth.isEnabled() && !_auth.authenticate(*_httpServer)) {
-        Auth::sendUnauthorized(*_httpServer);
+    if (_auth.isEnabled() && !_auth.authenticate(http)) {
+        Auth::sendUnauthorized(http);
         return;
     }
 
     // Rate limit check
     if (_rateLimiter.isEnabled() && !_rateLimiter.tryAcquire()) {
-        _httpServer->send(429, transport::CONTENT_TYPE_JSON,
-                          _jsonRpcError(JsonVariant(), -32000, "Rate limit exceeded"));
+        http.send(429, transport::CONTENT_TYPE_JSON,
+                  _jsonRpcError(JsonVariant(), -32000, "Rate limit exceeded"));
         return;
     }
 
-    String body = _httpServer->arg("plain");
+    String body = http.arg("plain");
     if (body.isEmpty()) {
-        _httpServer->send(400, transport::CONTENT_TYPE_JSON,
-                          _jsonRpcError(JsonVariant(), -32700, "Parse error: empty body"));
+        http.send(400, transport::CONTENT_TYPE_JSON,
+                  _jsonRpcError(JsonVariant(), -32700, "Parse error: empty body"));
         return;
     }
 
-    // Check session ID for post-initialization requests
-    if (_initialized && !_sessionId.isEmpty()) {
-        String clientSession = _httpServer->header(transport::HEADER_SESSION_ID);
-        // Allow initialize requests without session ID
-        if (clientSession.length() > 0 && clientSession != _sessionId) {
-            _httpServer->send(404, transport::CONTENT_TYPE_JSON,
-                              _jsonRpcError(JsonVariant(), -32600, "Invalid session"));
+    // Route the request to its session. Requests without a session ID
+    // (initialize, or single-client setups that never echo the header)
+    // stay with the most recent one.
+    String clientSession = http.header(transport::HEADER_SESSION_ID);
+    if (clientSession.length() > 0) {
+        if (!_sessionManager.validateSession(clientSession)) {
+            http.send(404, transport::CONTENT_TYPE_JSON,
+                      _jsonRpcError(JsonVariant(), -32600, "Invalid session"));
             return;
         }
+        _sessionId = clientSession;
+        _initialized = true;
     }
 
+    // Results are streamed as a chunked response through a fixed buffer;
+    // errors, batches and notifications come back as a String instead
+    bool eventStream = _prefersEventStream(http);
+    BasicHttpChunkedSink<THttp> httpSink(http, 200,
+        eventStream ? transport::CONTENT_TYPE_SSE : transport::CONTENT_TYPE_JSON);
+    httpSink.addHeader(transport::HEADER_SESSION_ID, _sessionId);
+    SSEFrameSink sseSink(httpSink);
+    ResponseWriter writer(eventStream ? static_cast<ResponseSink&>(sseSink) : httpSink);
+
+    _responseWriter = &writer;
+    _responseStreamed = false;
     String response = _processJsonRpc(body);
+    _responseWriter = nullptr;
+
+    if (_responseStreamed) {
+        writer.end();
+        return;
+    }
 
     // For notifications (no id), return 202 Accepted
     if (response.isEmpty()) {
-        _httpServer->send(202);
+        http.send(202);
         return;
     }
 
     // Return as application/json (simple mode, no SSE needed for single responses)
     if (!_sessionId.isEmpty()) {
-        _httpServer->sendHeader(transport::HEADER_SESSION_ID, _sessionId);
+        http.sendHeader(transport::HEADER_SESSION_ID, _sessionId);
     }
-    _httpServer->send(200, transport::CONTENT_TYPE_JSON, response);
+    http.send(200, transport::CONTENT_TYPE_JSON, response);
 }
 
-void Server::_handleMCPGet() {
-    transport::setCORSHeaders(*_httpServer);
+// SSE framing is only used when the client accepts event streams but not
+// plain JSON; clients that accept both get application/json.
+template <typename THttp>
+bool Server::_prefersEventStream(THttp& http) {
+    String accept = http.header(transport::HEADER_ACCEPT);
+    return accept.indexOf(transport::CONTENT_TYPE_SSE) >= 0 &&
+           accept.indexOf(transport::CONTENT_TYPE_JSON) < 0;
+}
+
+// @return true if the socket now belongs to an SSE stream
+template <typename THttp>
+bool Server::_serveMCPGet(THttp& http) {
+    transport::setCORSHeaders(http);
 
     // Authentication check
-    if (_auth.isEnabled() && !_auth.authenticate(*_httpServer)) {
-        Auth::sendUnauthorized(*_httpServer);
-        return;
+    if (_auth.isEnabled() && !_auth.authenticate(http)) {
+        Auth::sendUnauthorized(http);
+        return false;
     }
 
+    // Validate session ID (without one, the most recent session is used)
+    String clientSession = http.header(transport::HEADER_SESSION_ID);
+    if (clientSession.length() > 0 && !_sessionManager.validateSession(clientSession)) {
+        http.send(404, transport::CONTENT_TYPE_JSON,
+                  _jsonRpcError(JsonVariant(), -32600, "Invalid session"));
+        return false;
+    }
+    String session = clientSession.length() > 0 ? clientSession : _sessionId;
+
     // Check that the client wants SSE
     // Note: on ESP32 WebServer, we need to take over the client socket
-    if (!_initialized || _sessionId.isEmpty()) {
-        _httpServer->send(400, transport::CONTENT_TYPE_JSON,
-                          _jsonRpcError(JsonVariant(), -32600, "Not initialized — call initialize first"));
-        return;
+    if (session.isEmpty() || !_sessionManager.getSession(session)) {
+        http.send(400, transport::CONTENT_TYPE_JSON,
+                  _jsonRpcError(JsonVariant(), -32600, "Not initialized — call initialize first"));
+        return false;
     }
 
-    // Validate session ID
-    String clientSession = _httpServer->header(transport::HEADER_SESSION_ID);
-    if (clientSession.length() > 0 && clientSession != _sessionId) {
-        _httpServer->send(404, transport::CONTENT_TYPE_JSON,
-                          _jsonRpcError(JsonVariant(), -32600, "Invalid session"));
-        return;
-    }
+    // Resuming after a disconnect: replay what the client has not seen
+    String lastEventHeader = http.header(transport::HEADER_LAST_EVENT_ID);
+    unsigned long lastEventId = lastEventHeader.isEmpty()
+        ? 0 : strtoul(lastEventHeader.c_str(), nullptr, 10);
 
     // Take over the raw client socket for SSE
-    WiFiClient client = _httpServer->client();
-    if (_sseManager.addClient(client, _sessionId, _endpoint)) {
+    WiFiClient client = http.client();
+    if (_sseManager.addClient(client, session, _endpoint, lastEventId)) {
         Serial.println("[mcpd] SSE stream opened");
+        _metrics.setSSEReplayStats(_sseManager.replayedEvents(),
+                                   _sseManager.droppedEvents());
         // Prevent WebServer from sending its own response
         // (addClient already sent headers)
-    } else {
-        _httpServer->send(503, transport::CONTENT_TYPE_JSON,
-                          _jsonRpcError(JsonVariant(), -32000, "Too many SSE connections"));
+        return true;
     }
+    http.send(503, transport::CONTENT_TYPE_JSON,
+              _jsonRpcError(JsonVariant(), -32000, "Too many SSE connections"));
+    return false;
 }
 
-void Server::_handleMCPDelete() {
-    transport::setCORSHeaders(*_httpServer);
+template <typename THttp>
+void Server::_serveMCPDelete(THttp& http) {
+    transport::setCORSHeaders(http);
 
     // Authentication check
-    if (_auth.isEnabled() && !_auth.authenticate(*_httpServer)) {
-        Auth::sendUnauthorized(*_httpServer);
+    if (_auth.isEnabled() && !_auth.authenticate(http)) {
+        Auth::sendUnauthorized(http);
         return;
     }
 
-    String clientSession = _httpServer->header(transport::HEADER_SESSION_ID);
-    if (clientSession == _sessionId) {
-        _initialized = false;
-        _sessionId = "";
-        _httpServer->send(200, transport::CONTENT_TYPE_JSON, "{}");
+    String clientSession = http.header(transport::HEADER_SESSION_ID);
+    if (clientSession.length() > 0 && _sessionManager.removeSession(clientSession)) {
+        _sseManager.closeSession(clientSession);
+        _subscriptions.removeSubscriber(clientSession);
+        if (clientSession == _sessionId) {
+            _initialized = false;
+            _sessionId = "";
+        }
+        http.send(200, transport::CONTENT_TYPE_JSON, "{}");
     } else {
-        _httpServer->send(404);
+        http.send(404);
     }
 }
 
@@ -473,6 +716,10 @@ void Server::_handleMCPDelete() {
 // ════════════════════════════════════════════════════════════════════════
 
 String Server::_processJsonRpc(const String& body) {
+    if (BatchScanner::isBatch(body.c_str(), body.length())) {
+        return _processBatch(body);
+    }
+
     JsonDocument doc;
     DeserializationError err = deserializeJson(doc, body);
 
@@ -481,33 +728,6 @@ String Server::_processJsonRpc(const String& body) {
                              (String("Parse error: ") + err.c_str()).c_str());
     }
 
-    // Check if it's a batch (array)
-    if (doc.is<JsonArray>()) {
-        JsonArray arr = doc.as<JsonArray>();
-        String batchResponse = "[";
-        bool first = true;
-        bool hasRequests = false;
-
-        for (JsonVariant item : arr) {
-            JsonVariant id = item["id"];
-            if (!id.isNull()) {
-                hasRequests = true;
-                if (!first) batchResponse += ",";
-                batchResponse += _dispatch(item["method"], item["params"], id);
-                first = false;
-            }
-            // Notifications (no id) are processed but don't produce responses
-            else {
-                const char* method = item["method"];
-                if (method) _dispatch(method, item["params"], JsonVariant());
-            }
-        }
-
-        if (!hasRequests) return ""; // All notifications → 202
-        batchResponse += "]";
-        return batchResponse;
-    }
-
     // Single message
     const char* method = doc["method"];
     JsonVariant id = doc["id"];
@@ -534,64 +754,227 @@ String Server::_processJsonRpc(const String& body) {
         return _jsonRpcError(id, -32600, "Invalid Request: missing method");
     }
 
-    String result = _dispatch(method, doc["params"], id);
-
     // If it's a notification (no id), return empty to trigger 202
-    if (id.isNull()) return "";
+    if (id.isNull()) {
+        ResponseWriter* writer = _responseWriter;
+        _responseWriter = nullptr;
+        _dispatch(method, doc["params"], id);
+        _responseWriter = writer;
+        return "";
+    }
+
+    String result = _dispatch(method, doc["params"], id);
 
     return result;
 }
 
+// Batches are parsed and run one item at a time. With a response writer
+// (HTTP POST) each response is written as soon as its request has run, so
+// the batch never holds more than one; otherwise responses are collected
+// into a String bounded by the batch memory budget.
+String Server::_processBatch(const String& body) {
+    BatchScanner scan(body.c_str(), body.length());
+    int count = scan.count();
+    if (count < 0) {
+        return _jsonRpcError(JsonVariant(), -32700, "Parse error: malformed batch");
+    }
+    if ((size_t)count > _maxBatchSize) {
+        String msg = String("Invalid Request: batch exceeds ") +
+                     String((unsigned long)_maxBatchSize) + " items";
+        return _jsonRpcError(JsonVariant(), -32600, msg.c_str());
+    }
+
+    ResponseWriter* writer = _responseWriter;
+    _responseWriter = nullptr;
+    _batch = BatchState();
+    _batch.active = true;
+
+    String collected;
+    bool first = true;
+    bool overBudget = false;
+    const char* item;
+    size_t len;
+    while (scan.next(item, len)) {
+        JsonDocument doc;
+        DeserializationError err = deserializeJson(doc, item, len);
+        JsonVariant id = doc["id"];
+        const char* method = doc["method"];
+        if (!method || strcmp(method, "tools/call") != 0) _batch.grantedTool = -1;
+
+        String response;
+        if (err) {
+            response = _jsonRpcError(JsonVariant(), -32700,
+                                     (String("Parse error: ") + err.c_str()).c_str());
+        } else if (id.isNull()) {
+            // Notifications (no id) are processed but don't produce responses
+            if (method) _dispatch(method, doc["params"], id);
+            continue;
+        } else if (overBudget) {
+            response = _jsonRpcError(id, -32000, "Batch memory budget exceeded");
+        } else if (writer) {
+            writer->print(first ? "[" : ",");
+            first = false;
+            _responseWriter = writer;
+            _responseStreamed = false;
+            response = _dispatch(method, doc["params"], id);
+            _responseWriter = nullptr;
+            if (!_responseStreamed) {
+                if (response.isEmpty()) response = _jsonRpcRawResult(id, "{}");
+                writer->print(response);
+            }
+            continue;
+        } else {
+            response = _dispatch(method, doc["params"], id);
+            if (collected.length() + response.length() > _batchMemoryBudget) {
+                overBudget = true;
+                response = _jsonRpcError(id, -32000, "Batch memory budget exceeded");
+            }
+        }
+
+        // Every request needs an entry, even if its handler returned nothing
+        if (response.isEmpty()) response = _jsonRpcRawResult(id, "{}");
+        if (writer) {
+            writer->print(first ? "[" : ",");
+            first = false;
+            writer->print(response);
+        } else {
+            collected += first ? "[" : ",";
+            first = false;
+            collected += response;
+        }
+    }
+
+    _batch.active = false;
+    _responseWriter = writer;
+    _responseStreamed = false;
+    if (first) return ""; // All notifications → 202
+    if (writer) {
+        writer->print("]");
+        _responseStreamed = true;
+        return "";
+    }
+    collected += "]";
+    return collected;
+}
+
+// Built-in MCP methods, sorted by name (strcmp order) for binary search.
+constexpr Server::MethodEntry Server::_builtinMethods[] = {
+    { "completion/complete",        &Server::_handleCompletionComplete },
+    { "initialize",                 &Server::_handleInitialize },
+    { "logging/setLevel",           &Server::_handleLoggingSetLevel },
+    { "notifications/cancelled",    &Server::_handleNotificationCancelled },
+    { "notifications/initialized",  &Server::_handleNotificationInitialized },
+    { "ping",                       &Server::_handlePing },
+    { "prompts/get",                &Server::_handlePromptsGet },
+    { "prompts/list",               &Server::_handlePromptsList },
+    { "resources/list",             &Server::_handleResourcesList },
+    { "resources/read",             &Server::_handleResourcesRead },
+    { "resources/subscribe",        &Server::_handleResourcesSubscribe },
+    { "resources/templates/list",   &Server::_handleResourcesTemplatesList },
+    { "resources/unsubscribe",      &Server::_handleResourcesUnsubscribe },
+    { "roots/list",                 &Server::_handleRootsList },
+    // Tasks (experimental, MCP 2025-11-25)
+    { "tasks/cancel",               &Server::_handleTasksCancel },
+    { "tasks/get",                  &Server::_handleTasksGet },
+    { "tasks/list",                 &Server::_handleTasksList },
+    { "tasks/result",               &Server::_handleTasksResult },
+    { "tools/call",                 &Server::_handleToolsCall },
+    { "tools/list",                 &Server::_handleToolsList },
+};
+
+constexpr size_t Server::_builtinMethodCount =
+    sizeof(Server::_builtinMethods) / sizeof(Server::_builtinMethods[0]);
+
+namespace {
+
+constexpr int _constexprStrcmp(const char* a, const char* b) {
+    while (*a && *a == *b) { a++; b++; }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+template <size_t N>
+constexpr bool _methodsSorted(const Server::MethodEntry (&table)[N]) {
+    for (size_t i = 1; i < N; i++) {
+        if (_constexprStrcmp(table[i - 1].name, table[i].name) >= 0) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+static_assert(_methodsSorted(Server::_builtinMethods),
+              "Server::_builtinMethods must be sorted by name with no duplicates");
+
+const Server::MethodEntry* Server::_findBuiltinMethod(const char* method) {
+    size_t lo = 0, hi = _builtinMethodCount;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = strcmp(method, _builtinMethods[mid].name);
+        if (cmp == 0) return &_builtinMethods[mid];
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return nullptr;
+}
+
+const Server::CustomMethod* Server::_findCustomMethod(const char* method) const {
+    auto it = std::lower_bound(_customMethods.begin(), _customMethods.end(), method,
+        [](const CustomMethod& cm, const char* name) { return strcmp(cm.name.c_str(), name) < 0; });
+    if (it != _customMethods.end() && it->name == method) return &*it;
+    return nullptr;
+}
+
+bool Server::addMethod(const char* method, MethodHandler handler) {
+    if (!method || !*method || !handler) return false;
+    if (_findBuiltinMethod(method)) return false;
+
+    auto it = std::lower_bound(_customMethods.begin(), _customMethods.end(), method,
+        [](const CustomMethod& cm, const char* name) { return strcmp(cm.name.c_str(), name) < 0; });
+    if (it != _customMethods.end() && it->name == method) {
+        it->handler = handler;
+    } else {
+        _customMethods.insert(it, CustomMethod{String(method), handler});
+    }
+    return true;
+}
+
+bool Server::removeMethod(const char* method) {
+    if (!method) return false;
+    const CustomMethod* cm = _findCustomMethod(method);
+    if (!cm) return false;
+    _customMethods.erase(_customMethods.begin() + (cm - _customMethods.data()));
+    return true;
+}
+
+bool Server::hasMethod(const char* method) const {
+    if (!method) return false;
+    return _findBuiltinMethod(method) || _findCustomMethod(method);
+}
+
 String Server::_dispatch(const char* method, JsonVariant params, JsonVariant id) {
     if (!method) {
         return _jsonRpcError(id, -32600, "Invalid Request");
     }
 
-    String m(method);
-
     // Record metrics for each dispatched method
-    unsigned long _dispatchStart = millis();
+    unsigned long dispatchStart = micros();
 
-    auto _recordAndReturn = [&](const String& result) -> String {
-        _metrics.recordRequest(m, millis() - _dispatchStart);
+    if (const MethodEntry* entry = _findBuiltinMethod(method)) {
+        String result = (this->*entry->handler)(params, id);
+        _metrics.recordRequestMicros(entry->name, micros() - dispatchStart);
         return result;
-    };
-
-    if (m == "initialize")       return _recordAndReturn(_handleInitialize(params, id));
-    if (m == "ping")             return _recordAndReturn(_handlePing(id));
-    if (m == "tools/list")       return _recordAndReturn(_handleToolsList(params, id));
-    if (m == "tools/call")       return _recordAndReturn(_handleToolsCall(params, id));
-    if (m == "resources/list")   return _recordAndReturn(_handleResourcesList(params, id));
-    if (m == "resources/read")   return _recordAndReturn(_handleResourcesRead(params, id));
-    if (m == "resources/templates/list") return _recordAndReturn(_handleResourcesTemplatesList(params, id));
-    if (m == "prompts/list")           return _recordAndReturn(_handlePromptsList(params, id));
-    if (m == "prompts/get")            return _recordAndReturn(_handlePromptsGet(params, id));
-    if (m == "logging/setLevel")       return _recordAndReturn(_handleLoggingSetLevel(params, id));
-    if (m == "completion/complete")     return _recordAndReturn(_handleCompletionComplete(params, id));
-    if (m == "resources/subscribe")     return _recordAndReturn(_handleResourcesSubscribe(params, id));
-    if (m == "resources/unsubscribe")   return _recordAndReturn(_handleResourcesUnsubscribe(params, id));
-    if (m == "roots/list")              return _recordAndReturn(_handleRootsList(params, id));
+    }
 
-    // Tasks (experimental, MCP 2025-11-25)
-    if (m == "tasks/get")               return _recordAndReturn(_handleTasksGet(params, id));
-    if (m == "tasks/result")            return _recordAndReturn(_handleTasksResult(params, id));
-    if (m == "tasks/list")              return _recordAndReturn(_handleTasksList(params, id));
-    if (m == "tasks/cancel")            return _recordAndReturn(_handleTasksCancel(params, id));
-
-    // notifications/initialized — no response needed
-    if (m == "notifications/initialized") { _metrics.recordRequest(m, millis() - _dispatchStart); return ""; }
-    // notifications/cancelled — cancel in-flight request
-    if (m == "notifications/cancelled") {
-        _metrics.recordRequest(m, millis() - _dispatchStart);
-        if (!params.isNull()) {
-            const char* rid = params["requestId"].as<const char*>();
-            String reqId = rid ? rid : "";
-            if (!reqId.isEmpty()) {
-                _requestTracker.cancelRequest(reqId);
-                Serial.printf("[mcpd] Request cancelled: %s\n", reqId.c_str());
-            }
+    if (const CustomMethod* custom = _findCustomMethod(method)) {
+        String result;
+        try {
+            result = _jsonRpcResult(id, custom->handler(params));
+        } catch (...) {
+            _metrics.recordError();
+            result = _jsonRpcError(id, -32603, "Internal error");
         }
-        return "";
+        _metrics.recordRequestMicros(method, micros() - dispatchStart);
+        return result;
     }
 
     _metrics.recordError();
@@ -603,16 +986,25 @@ String Server::_dispatch(const char* method, JsonVariant params, JsonVariant id)
 // ════════════════════════════════════════════════════════════════════════
 
 String Server::_handleInitialize(JsonVariant params, JsonVariant id) {
-    _sessionId = _generateSessionId();
+    String clientName = "unknown";
+    if (!params.isNull() && !params["clientInfo"].isNull()) {
+        const char* cn = params["clientInfo"]["name"].as<const char*>();
+        if (cn) clientName = cn;
+    }
+
+    // Every HTTP client gets its own session; WebSocket/BLE use the
+    // server-level state
+    if (!_localRequest) {
+        String sid = _sessionManager.createSession(clientName);
+        if (sid.isEmpty()) {
+            return _jsonRpcError(id, -32000, "Too many sessions");
+        }
+        _sessionId = sid;
+    }
     _initialized = true;
 
-    // Extract client info and call lifecycle hook
+    // Lifecycle hook
     if (_onInitializeCb) {
-        String clientName = "unknown";
-        if (!params.isNull() && !params["clientInfo"].isNull()) {
-            const char* cn = params["clientInfo"]["name"].as<const char*>();
-            if (cn) clientName = cn;
-        }
         _onInitializeCb(clientName);
     }
 
@@ -695,25 +1087,68 @@ String Server::_handleInitialize(JsonVariant params, JsonVariant id) {
         rateLimit["burstCapacity"] = (int)_rateLimiter.burstCapacity();
     }
 
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
+    return _jsonRpcResult(id, result);
 }
 
-String Server::_handlePing(JsonVariant id) {
+String Server::_handlePing(JsonVariant params, JsonVariant id) {
     return _jsonRpcResult(id, "{}");
 }
 
-String Server::_handleToolsList(JsonVariant params, JsonVariant id) {
-    JsonDocument result;
-    JsonArray tools = result["tools"].to<JsonArray>();
+// notifications/initialized — no response needed
+String Server::_handleNotificationInitialized(JsonVariant params, JsonVariant id) {
+    return "";
+}
+
+// notifications/cancelled — cancel in-flight request
+String Server::_handleNotificationCancelled(JsonVariant params, JsonVariant id) {
+    if (!params.isNull()) {
+        const char* rid = params["requestId"].as<const char*>();
+        String reqId = rid ? rid : "";
+        if (!reqId.isEmpty()) {
+            _requestTracker.cancelRequest(reqId);
+            Serial.printf("[mcpd] Request cancelled: %s\n", reqId.c_str());
+        }
+    }
+    return "";
+}
 
+// Shared by the four list methods: serve a stored page when the list has
+// not changed since it was built, otherwise build, serialize and store it
+String Server::_cachedList(ListKind kind, JsonVariant params, JsonVariant id,
+                           ListBuilder build) {
     // Cursor-based pagination
     size_t startIdx = 0;
     if (!params.isNull() && params["cursor"].is<const char*>()) {
         startIdx = (size_t)atoi(params["cursor"].as<const char*>());
     }
 
+    if (!_listCache.isEnabled()) {
+        JsonDocument result;
+        (this->*build)(result, startIdx);
+        return _jsonRpcResult(id, result);
+    }
+
+    const String* page = _listCache.find(kind, startIdx, _pageSize);
+    if (!page) {
+        JsonDocument result;
+        (this->*build)(result, startIdx);
+        String body;
+        serializeJson(result, body);
+        page = &_listCache.store(kind, startIdx, _pageSize, body);
+    }
+    _metrics.setListCacheStats(_listCache.hits(), _listCache.misses(),
+                               _listCache.bytes());
+    return _jsonRpcRawResult(id, *page);
+}
+
+String Server::_handleToolsList(JsonVariant params, JsonVariant id) {
+    _syncToolTable();  // Picks up group toggles (and invalidates) first
+    return _cachedList(ListKind::Tools, params, id, &Server::_buildToolsList);
+}
+
+void Server::_buildToolsList(JsonDocument& result, size_t startIdx) {
+    JsonArray tools = result["tools"].to<JsonArray>();
+
     size_t endIdx = _tools.size();
     if (_pageSize > 0 && (startIdx + _pageSize) < endIdx) {
         endIdx = startIdx + _pageSize;
@@ -723,21 +1158,17 @@ String Server::_handleToolsList(JsonVariant params, JsonVariant id) {
 
     for (size_t i = startIdx; i < endIdx; i++) {
         // Skip disabled tools (individually or by group)
-        if (!isToolEnabled(_tools[i].name.c_str())) continue;
+        const ToolSlot& slot = _toolTable.slot(i);
+        if (!slot.isCallable()) continue;
         JsonObject obj = tools.add<JsonObject>();
         _tools[i].toJson(obj);
 
         // Add execution.taskSupport if this tool has task support configured
-        auto tsIt = _taskToolSupport.find(_tools[i].name);
-        if (tsIt != _taskToolSupport.end() && tsIt->second != TaskSupport::Forbidden) {
+        if (slot.taskSupport != TaskSupport::Forbidden) {
             JsonObject execution = obj["execution"].to<JsonObject>();
-            execution["taskSupport"] = taskSupportToString(tsIt->second);
+            execution["taskSupport"] = taskSupportToString(slot.taskSupport);
         }
     }
-
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
 }
 
 String Server::_handleToolsCall(JsonVariant params, JsonVariant id) {
@@ -753,9 +1184,32 @@ String Server::_handleToolsCall(JsonVariant params, JsonVariant id) {
         if (pt) progressToken = pt;
     }
 
+    // Check for task-augmented request (MCP 2025-11-25)
+    bool isTaskRequest = !params["task"].isNull();
+    if (isTaskRequest && !_taskManager.isEnabled()) {
+        return _jsonRpcError(id, -32601, "Tasks not supported");
+    }
+
+    // Resolve the tool once: handlers, task support, enabled bit and cache
+    // TTL all live in its slot
+    _syncToolTable();
+    int toolIdx = _toolTable.find(toolName, _tools);
+    const ToolSlot* slot = toolIdx >= 0 ? &_toolTable.slot(toolIdx) : nullptr;
+
+    // Read-only tools in a batch run back-to-back: nothing can cancel them
+    // before the batch returns, so without a progress token they are not
+    // tracked, and a repeat call reuses the RBAC decision below
+    bool readOnlyRun = _batch.active && slot && progressToken.isEmpty() &&
+                       !isTaskRequest && _tools[toolIdx].annotations.readOnlyHint;
+    if (readOnlyRun) {
+        _batch.readOnlyCalls++;
+    } else {
+        _batch.grantedTool = -1;
+    }
+
     // Track the request for cancellation support
     String requestId;
-    if (!id.isNull()) {
+    if (!id.isNull() && !readOnlyRun) {
         if (id.is<const char*>()) {
             requestId = id.as<const char*>();
         } else {
@@ -766,15 +1220,8 @@ String Server::_handleToolsCall(JsonVariant params, JsonVariant id) {
         _requestTracker.trackRequest(requestId, progressToken);
     }
 
-    // Check for task-augmented request (MCP 2025-11-25)
-    bool isTaskRequest = !params["task"].isNull();
-    if (isTaskRequest && !_taskManager.isEnabled()) {
-        if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
-        return _jsonRpcError(id, -32601, "Tasks not supported");
-    }
-
     // Reject disabled tools (individually or by group)
-    if (!isToolEnabled(toolName)) {
+    if (slot ? !slot->isCallable() : _toolGroups.isToolGroupDisabled(toolName)) {
         if (!requestId.isEmpty()) {
             _requestTracker.completeRequest(requestId);
         }
@@ -788,290 +1235,329 @@ String Server::_handleToolsCall(JsonVariant params, JsonVariant id) {
         if (!params["_meta"].isNull() && !params["_meta"]["apiKey"].isNull()) {
             callerKey = params["_meta"]["apiKey"].as<const char*>();
         }
-        if (!_accessControl.canAccess(toolName, callerKey)) {
+        const char* key = callerKey ? callerKey : "";
+        bool granted = readOnlyRun && _batch.grantedTool == toolIdx &&
+                       _batch.grantedKey == key;
+        if (!granted) {
+            if (!_accessControl.canAccess(toolName, callerKey)) {
+                if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
+                return _jsonRpcError(id, -32603, "Access denied: insufficient permissions");
+            }
+            if (readOnlyRun) {
+                _batch.grantedTool = toolIdx;
+                _batch.grantedKey = key;
+            }
+        }
+    }
+
+    if (!slot) {
+        if (!requestId.isEmpty()) {
+            _requestTracker.completeRequest(requestId);
+        }
+        return _jsonRpcError(id, -32602,
+            (String("Tool not found: ") + toolName).c_str());
+    }
+
+    const MCPTool& tool = _tools[toolIdx];
+    JsonObject arguments = params["arguments"].as<JsonObject>();
+    unsigned long toolStartUs = micros();  // Per-tool latency histogram
+
+    // Input validation against declared schema
+    if (_inputValidation && tool.compiledInputSchema.isCompiled()) {
+        ValidationResult vr = validateArguments(arguments, tool.compiledInputSchema);
+        if (!vr.valid) {
+            _metrics.recordToolCall(toolName, ToolCallOutcome::Error, micros() - toolStartUs);
             if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
-            return _jsonRpcError(id, -32603, "Access denied: insufficient permissions");
+            return _jsonRpcError(id, -32602, vr.toString().c_str());
         }
     }
 
-    // Find the tool
-    for (const auto& tool : _tools) {
-        if (tool.name == toolName) {
-            JsonObject arguments = params["arguments"].as<JsonObject>();
+    // Handle task-augmented request
+    if (isTaskRequest) {
+        // Check tool-level task support
+        if (slot->taskSupport == TaskSupport::Forbidden) {
+            if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
+            return _jsonRpcError(id, -32601, "Tool does not support task execution");
+        }
 
-            // Input validation against declared schema
-            if (_inputValidation && !tool.inputSchemaJson.isEmpty()) {
-                JsonDocument schemaDoc;
-                DeserializationError schemaErr = deserializeJson(schemaDoc, tool.inputSchemaJson);
-                if (!schemaErr && schemaDoc.is<JsonObject>()) {
-                    ValidationResult vr = validateArguments(arguments, schemaDoc.as<JsonObject>());
-                    if (!vr.valid) {
-                        if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
-                        return _jsonRpcError(id, -32602, vr.toString().c_str());
-                    }
-                }
-            }
+        // Check for async handler
+        if (!slot->taskHandler) {
+            if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
+            return _jsonRpcError(id, -32601, "No async handler for tool");
+        }
 
-            // Handle task-augmented request
-            if (isTaskRequest) {
-                // Check tool-level task support
-                auto tsIt = _taskToolSupport.find(String(toolName));
-                TaskSupport ts = (tsIt != _taskToolSupport.end()) ? tsIt->second : TaskSupport::Forbidden;
-                if (ts == TaskSupport::Forbidden) {
-                    if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
-                    return _jsonRpcError(id, -32601, "Tool does not support task execution");
-                }
+        // Extract requested TTL
+        int64_t ttl = -1;
+        if (!params["task"]["ttl"].isNull()) {
+            ttl = (int64_t)params["task"]["ttl"].as<long>();
+        }
 
-                // Check for async handler
-                auto handlerIt = _taskToolHandlers.find(String(toolName));
-                if (handlerIt == _taskToolHandlers.end()) {
-                    if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
-                    return _jsonRpcError(id, -32601, "No async handler for tool");
-                }
+        // Create the task
+        String taskId = _taskManager.createTask(toolName, ttl);
+        MCPTask* task = _taskManager.getTask(taskId);
 
-                // Extract requested TTL
-                int64_t ttl = -1;
-                if (!params["task"]["ttl"].isNull()) {
-                    ttl = (int64_t)params["task"]["ttl"].as<long>();
-                }
+        // Before-call hook for task
+        if (_beforeToolCallHook) {
+            ToolCallContext ctx;
+            ctx.toolName = toolName;
+            ctx.args = &arguments;
+            ctx.startMs = millis();
+            ctx.durationMs = 0;
+            ctx.isError = false;
+            if (!_beforeToolCallHook(ctx)) {
+                _taskManager.cancelTask(taskId);
+                if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
+                return _jsonRpcError(id, -32600, "Tool call rejected");
+            }
+        }
 
-                // Create the task
-                String taskId = _taskManager.createTask(toolName, ttl);
-                MCPTask* task = _taskManager.getTask(taskId);
-
-                // Before-call hook for task
-                if (_beforeToolCallHook) {
-                    ToolCallContext ctx;
-                    ctx.toolName = toolName;
-                    ctx.args = &arguments;
-                    ctx.startMs = millis();
-                    ctx.durationMs = 0;
-                    ctx.isError = false;
-                    if (!_beforeToolCallHook(ctx)) {
-                        _taskManager.cancelTask(taskId);
-                        if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
-                        return _jsonRpcError(id, -32600, "Tool call rejected");
-                    }
-                }
+        // Invoke async handler
+        slot->taskHandler(taskId, params["arguments"]);
 
-                // Invoke async handler
-                handlerIt->second(taskId, params["arguments"]);
+        // Return CreateTaskResult
+        JsonDocument result;
+        JsonObject taskObj = result["task"].to<JsonObject>();
+        task->toJson(taskObj);
 
-                // Return CreateTaskResult
-                JsonDocument result;
-                JsonObject taskObj = result["task"].to<JsonObject>();
-                task->toJson(taskObj);
+        _metrics.recordToolCall(toolName, ToolCallOutcome::Task, micros() - toolStartUs);
+        if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
 
-                if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
+        return _jsonRpcResult(id, result);
+    }
 
-                String resultStr;
-                serializeJson(result, resultStr);
-                return _jsonRpcResult(id, resultStr);
+    // Check if tool requires task execution
+    if (slot->taskSupport == TaskSupport::Required) {
+        if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
+        return _jsonRpcError(id, -32601, "Tool requires task execution");
+    }
+
+    // Before-call hook: allow rejection
+    if (_beforeToolCallHook) {
+        ToolCallContext ctx;
+        ctx.toolName = toolName;
+        ctx.args = &arguments;
+        ctx.startMs = millis();
+        ctx.durationMs = 0;
+        ctx.isError = false;
+        if (!_beforeToolCallHook(ctx)) {
+            if (!requestId.isEmpty()) {
+                _requestTracker.completeRequest(requestId);
             }
+            return _jsonRpcError(id, -32600, "Tool call rejected");
+        }
+    }
 
-            // Check if tool requires task execution
-            auto tsIt = _taskToolSupport.find(String(toolName));
-            if (tsIt != _taskToolSupport.end() && tsIt->second == TaskSupport::Required) {
-                if (!requestId.isEmpty()) _requestTracker.completeRequest(requestId);
-                return _jsonRpcError(id, -32601, "Tool requires task execution");
-            }
+    unsigned long callStartMs = millis();
 
-            // Before-call hook: allow rejection
-            if (_beforeToolCallHook) {
+    // Check cache before executing
+    bool cacheable = _cache.isEnabled() && slot->cacheTtlMs > 0;
+    ArgsDigest argsKey;  // Computed once, reused for the store below
+    if (cacheable) {
+        argsKey = argsDigest(arguments);
+        String cachedResult;
+        bool cachedIsError;
+        CacheLookup hit = _cache.lookup(toolName, argsKey, cachedResult, cachedIsError);
+        if (hit == CacheLookup::HitRefresh) {
+            _scheduleCacheRefresh(toolName, argsKey, arguments);
+        }
+        if (hit != CacheLookup::Miss) {
+            // Cache hit — skip handler execution
+            if (_afterToolCallHook) {
                 ToolCallContext ctx;
                 ctx.toolName = toolName;
                 ctx.args = &arguments;
-                ctx.startMs = millis();
+                ctx.startMs = callStartMs;
                 ctx.durationMs = 0;
-                ctx.isError = false;
-                if (!_beforeToolCallHook(ctx)) {
-                    if (!requestId.isEmpty()) {
-                        _requestTracker.completeRequest(requestId);
-                    }
-                    return _jsonRpcError(id, -32600, "Tool call rejected");
-                }
+                ctx.isError = cachedIsError;
+                _afterToolCallHook(ctx);
             }
-
-            unsigned long callStartMs = millis();
-
-            // Check cache before executing
-            if (_cache.isEnabled() && _cache.isToolCached(toolName)) {
-                String argsJson;
-                { JsonDocument _tmp; _tmp.to<JsonObject>(); for (auto kv : arguments) { _tmp[kv.key()] = kv.value(); } serializeJson(_tmp, argsJson); }
-                String cachedResult;
-                bool cachedIsError;
-                if (_cache.get(toolName, argsJson, cachedResult, cachedIsError)) {
-                    // Cache hit — skip handler execution
-                    if (_afterToolCallHook) {
-                        ToolCallContext ctx;
-                        ctx.toolName = toolName;
-                        ctx.args = &arguments;
-                        ctx.startMs = callStartMs;
-                        ctx.durationMs = 0;
-                        ctx.isError = cachedIsError;
-                        _afterToolCallHook(ctx);
-                    }
-                    if (!requestId.isEmpty()) {
-                        _requestTracker.completeRequest(requestId);
-                    }
-                    return _jsonRpcResult(id, cachedResult);
-                }
+            _metrics.recordToolCall(toolName, ToolCallOutcome::CacheHit, micros() - toolStartUs);
+            if (!requestId.isEmpty()) {
+                _requestTracker.completeRequest(requestId);
             }
+            return _jsonRpcResult(id, cachedResult);
+        }
+    }
 
-            // Check if this tool has a rich handler
-            MCPRichToolHandler richHandler = nullptr;
-            for (const auto& rh : _richTools) {
-                if (rh.first == toolName) {
-                    richHandler = rh.second;
-                    break;
-                }
-            }
+    JsonDocument result;
+    bool callIsError = _executeTool(tool, *slot, arguments, result);
 
-            String resultStr;
-            bool callIsError = false;
-
-            if (richHandler) {
-                // Use rich handler for structured content
-                MCPToolResult toolResult;
-                try {
-                    toolResult = richHandler(arguments);
-                } catch (...) {
-                    toolResult = MCPToolResult::error("Internal tool error");
-                    callIsError = true;
-                }
+    // Store in cache if configured
+    if (cacheable) {
+        String resultStr;
+        serializeJson(result, resultStr);
+        _cache.put(toolName, argsKey, resultStr, callIsError);
+    }
 
-                JsonDocument result;
-                JsonObject resultObj = result.to<JsonObject>();
-                toolResult.toJson(resultObj);
-
-                // If tool has outputSchema and first content is text, include structuredContent
-                if (!tool.outputSchemaJson.isEmpty() && !toolResult.isError &&
-                    !toolResult.content.empty() && toolResult.content[0].type == MCPContent::TEXT) {
-                    JsonDocument structured;
-                    DeserializationError err = deserializeJson(structured, toolResult.content[0].text);
-                    if (!err) {
-                        // Output validation against declared outputSchema
-                        // Output validation against declared outputSchema
-                        if (_outputValidation) {
-                            JsonDocument outSchema;
-                            DeserializationError osErr = deserializeJson(outSchema, tool.outputSchemaJson);
-                            if (!osErr && outSchema.is<JsonObject>()) {
-                                ValidationResult vr = validateValue(structured.as<JsonVariant>(), outSchema.as<JsonObject>());
-                                if (!vr.valid) {
-                                    // Replace result with validation error
-                                    result.clear();
-                                    resultObj = result.to<JsonObject>();
-                                    JsonArray errContent = resultObj["content"].to<JsonArray>();
-                                    JsonObject errText = errContent.add<JsonObject>();
-                                    errText["type"] = "text";
-                                    errText["text"] = "Output validation failed: " + vr.toString();
-                                    resultObj["isError"] = true;
-                                    callIsError = true;
-                                }
-                            }
-                        }
-                        if (!callIsError) {
-                            resultObj["structuredContent"] = structured.as<JsonVariant>();
-                        }
-                    }
-                }
+    // After-call hook: logging/metrics
+    if (_afterToolCallHook) {
+        ToolCallContext ctx;
+        ctx.toolName = toolName;
+        ctx.args = &arguments;
+        ctx.startMs = callStartMs;
+        ctx.durationMs = millis() - callStartMs;
+        ctx.isError = callIsError;
+        _afterToolCallHook(ctx);
+    }
 
-                serializeJson(result, resultStr);
-                if (toolResult.isError) callIsError = true;
-            } else {
-                // Use simple handler (backward compatible)
-                String handlerResult;
-                try {
-                    handlerResult = tool.handler(arguments);
-                } catch (...) {
-                    handlerResult = "Internal tool error";
-                    callIsError = true;
-                }
+    _metrics.recordToolCall(toolName,
+                            callIsError ? ToolCallOutcome::Error : ToolCallOutcome::Ok,
+                            micros() - toolStartUs);
 
-                JsonDocument result;
-                JsonArray content = result["content"].to<JsonArray>();
-                JsonObject textContent = content.add<JsonObject>();
-                textContent["type"] = "text";
-                textContent["text"] = handlerResult;
-                if (callIsError) {
-                    result["isError"] = true;
-                }
+    // Complete request tracking
+    if (!requestId.isEmpty()) {
+        _requestTracker.completeRequest(requestId);
+    }
+
+    return _jsonRpcResult(id, result);
+}
+
+// Runs a tool's handler and builds its tools/call result (content,
+// isError, structuredContent, output validation). Returns true if the
+// result is an error.
+bool Server::_executeTool(const MCPTool& tool, const ToolSlot& slot,
+                          JsonObject arguments, JsonDocument& result) {
+    const MCPRichToolHandler& richHandler = slot.richHandler;
+    bool callIsError = false;
+
+    if (richHandler) {
+        // Use rich handler for structured content
+        MCPToolResult toolResult;
+        try {
+            toolResult = richHandler(arguments);
+        } catch (...) {
+            toolResult = MCPToolResult::error("Internal tool error");
+            callIsError = true;
+        }
 
-                // If tool has outputSchema, include structuredContent
-                if (!tool.outputSchemaJson.isEmpty() && !callIsError) {
-                    JsonDocument structured;
-                    DeserializationError err = deserializeJson(structured, handlerResult);
-                    if (!err) {
-                        // Output validation against declared outputSchema
-                        if (_outputValidation) {
-                            JsonDocument outSchema;
-                            DeserializationError osErr = deserializeJson(outSchema, tool.outputSchemaJson);
-                            if (!osErr && outSchema.is<JsonObject>()) {
-                                ValidationResult vr = validateValue(structured.as<JsonVariant>(), outSchema.as<JsonObject>());
-                                if (!vr.valid) {
-                                    // Replace result with validation error
-                                    result.clear();
-                                    content = result["content"].to<JsonArray>();
-                                    textContent = content.add<JsonObject>();
-                                    textContent["type"] = "text";
-                                    textContent["text"] = "Output validation failed: " + vr.toString();
-                                    result["isError"] = true;
-                                    callIsError = true;
-                                }
-                            }
-                        }
-                        if (!callIsError) {
-                            result["structuredContent"] = structured.as<JsonVariant>();
-                        }
+        JsonObject resultObj = result.to<JsonObject>();
+        toolResult.toJson(resultObj);
+
+        // If tool has outputSchema and first content is text, include structuredContent
+        if (!tool.outputSchemaJson.isEmpty() && !toolResult.isError &&
+            !toolResult.content.empty() && toolResult.content[0].type == MCPContent::TEXT) {
+            JsonDocument structured;
+            DeserializationError err = deserializeJson(structured, toolResult.content[0].text);
+            if (!err) {
+                // Output validation against declared outputSchema
+                if (_outputValidation && tool.compiledOutputSchema.isCompiled()) {
+                    ValidationResult vr = validateValue(structured.as<JsonVariant>(), tool.compiledOutputSchema);
+                    if (!vr.valid) {
+                        // Replace result with validation error
+                        result.clear();
+                        resultObj = result.to<JsonObject>();
+                        JsonArray errContent = resultObj["content"].to<JsonArray>();
+                        JsonObject errText = errContent.add<JsonObject>();
+                        errText["type"] = "text";
+                        errText["text"] = "Output validation failed: " + vr.toString();
+                        resultObj["isError"] = true;
+                        callIsError = true;
                     }
                 }
-
-                serializeJson(result, resultStr);
+                if (!callIsError) {
+                    resultObj["structuredContent"] = structured.as<JsonVariant>();
+                }
             }
+        }
 
-            // Store in cache if configured
-            if (_cache.isEnabled() && _cache.isToolCached(toolName)) {
-                String argsJson;
-                { JsonDocument _tmp; _tmp.to<JsonObject>(); for (auto kv : arguments) { _tmp[kv.key()] = kv.value(); } serializeJson(_tmp, argsJson); }
-                _cache.put(toolName, argsJson, resultStr, callIsError);
-            }
+        if (toolResult.isError) callIsError = true;
+    } else {
+        // Use simple handler (backward compatible)
+        String handlerResult;
+        try {
+            handlerResult = tool.handler(arguments);
+        } catch (...) {
+            handlerResult = "Internal tool error";
+            callIsError = true;
+        }
 
-            // After-call hook: logging/metrics
-            if (_afterToolCallHook) {
-                ToolCallContext ctx;
-                ctx.toolName = toolName;
-                ctx.args = &arguments;
-                ctx.startMs = callStartMs;
-                ctx.durationMs = millis() - callStartMs;
-                ctx.isError = callIsError;
-                _afterToolCallHook(ctx);
-            }
+        JsonArray content = result["content"].to<JsonArray>();
+        JsonObject textContent = content.add<JsonObject>();
+        textContent["type"] = "text";
+        textContent["text"] = handlerResult;
+        if (callIsError) {
+            result["isError"] = true;
+        }
 
-            // Complete request tracking
-            if (!requestId.isEmpty()) {
-                _requestTracker.completeRequest(requestId);
+        // If tool has outputSchema, include structuredContent
+        if (!tool.outputSchemaJson.isEmpty() && !callIsError) {
+            JsonDocument structured;
+            DeserializationError err = deserializeJson(structured, handlerResult);
+            if (!err) {
+                // Output validation against declared outputSchema
+                if (_outputValidation && tool.compiledOutputSchema.isCompiled()) {
+                    ValidationResult vr = validateValue(structured.as<JsonVariant>(), tool.compiledOutputSchema);
+                    if (!vr.valid) {
+                        // Replace result with validation error
+                        result.clear();
+                        content = result["content"].to<JsonArray>();
+                        textContent = content.add<JsonObject>();
+                        textContent["type"] = "text";
+                        textContent["text"] = "Output validation failed: " + vr.toString();
+                        result["isError"] = true;
+                        callIsError = true;
+                    }
+                }
+                if (!callIsError) {
+                    result["structuredContent"] = structured.as<JsonVariant>();
+                }
             }
-
-            return _jsonRpcResult(id, resultStr);
         }
     }
 
-    if (!requestId.isEmpty()) {
-        _requestTracker.completeRequest(requestId);
+    return callIsError;
+}
+
+// Queue a background refresh for a cached result (stale or due for
+// refresh-ahead). The cache hands out HitRefresh once per entry, so each
+// entry has at most one refresh queued however many callers hit it.
+void Server::_scheduleCacheRefresh(const char* toolName, const ArgsDigest& key,
+                                   JsonObject arguments) {
+    CacheRefresh refresh;
+    refresh.toolName = toolName;
+    refresh.key = key;
+    serializeJson(arguments, refresh.argsJson);
+    _cacheRefreshes.push_back(refresh);
+
+    if (!_scheduler.exists(CACHE_REFRESH_TASK) &&
+        _scheduler.at(millis(), [this]() { _runCacheRefreshes(); }, CACHE_REFRESH_TASK) < 0) {
+        // Scheduler full: give up, the next caller past the TTL retries
+        _cache.endRefresh(toolName, key);
+        _cacheRefreshes.pop_back();
     }
+}
 
-    return _jsonRpcError(id, -32602,
-        (String("Tool not found: ") + toolName).c_str());
+void Server::_runCacheRefreshes() {
+    std::vector<CacheRefresh> pending;
+    pending.swap(_cacheRefreshes);
+    _syncToolTable();
+
+    for (const auto& refresh : pending) {
+        const char* name = refresh.toolName.c_str();
+        int idx = _toolTable.find(name, _tools);
+        if (idx < 0 || !_toolTable.slot(idx).isCallable() ||
+            _toolTable.slot(idx).cacheTtlMs == 0) {
+            _cache.endRefresh(name, refresh.key);
+            continue;
+        }
+
+        JsonDocument argsDoc;
+        deserializeJson(argsDoc, refresh.argsJson);
+        JsonDocument result;
+        bool isError = _executeTool(_tools[idx], _toolTable.slot(idx),
+                                    argsDoc.as<JsonObject>(), result);
+        String resultStr;
+        serializeJson(result, resultStr);
+        _cache.put(name, refresh.key, resultStr, isError);
+    }
 }
 
 String Server::_handleResourcesList(JsonVariant params, JsonVariant id) {
-    JsonDocument result;
-    JsonArray resources = result["resources"].to<JsonArray>();
+    return _cachedList(ListKind::Resources, params, id, &Server::_buildResourcesList);
+}
 
-    size_t startIdx = 0;
-    if (!params.isNull() && params["cursor"].is<const char*>()) {
-        startIdx = (size_t)atoi(params["cursor"].as<const char*>());
-    }
+void Server::_buildResourcesList(JsonDocument& result, size_t startIdx) {
+    JsonArray resources = result["resources"].to<JsonArray>();
 
     size_t endIdx = _resources.size();
     if (_pageSize > 0 && (startIdx + _pageSize) < endIdx) {
@@ -1083,10 +1569,6 @@ String Server::_handleResourcesList(JsonVariant params, JsonVariant id) {
         JsonObject obj = resources.add<JsonObject>();
         _resources[i].toJson(obj);
     }
-
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
 }
 
 String Server::_handleResourcesRead(JsonVariant params, JsonVariant id) {
@@ -1106,9 +1588,7 @@ String Server::_handleResourcesRead(JsonVariant params, JsonVariant id) {
             item["mimeType"] = res.mimeType;
             item["text"] = content;
 
-            String resultStr;
-            serializeJson(result, resultStr);
-            return _jsonRpcResult(id, resultStr);
+            return _jsonRpcResult(id, result);
         }
     }
 
@@ -1125,9 +1605,7 @@ String Server::_handleResourcesRead(JsonVariant params, JsonVariant id) {
             item["mimeType"] = tmpl.mimeType;
             item["text"] = content;
 
-            String resultStr;
-            serializeJson(result, resultStr);
-            return _jsonRpcResult(id, resultStr);
+            return _jsonRpcResult(id, result);
         }
     }
 
@@ -1135,13 +1613,11 @@ String Server::_handleResourcesRead(JsonVariant params, JsonVariant id) {
 }
 
 String Server::_handleResourcesTemplatesList(JsonVariant params, JsonVariant id) {
-    JsonDocument result;
-    JsonArray templates = result["resourceTemplates"].to<JsonArray>();
+    return _cachedList(ListKind::ResourceTemplates, params, id, &Server::_buildResourcesTemplatesList);
+}
 
-    size_t startIdx = 0;
-    if (!params.isNull() && params["cursor"].is<const char*>()) {
-        startIdx = (size_t)atoi(params["cursor"].as<const char*>());
-    }
+void Server::_buildResourcesTemplatesList(JsonDocument& result, size_t startIdx) {
+    JsonArray templates = result["resourceTemplates"].to<JsonArray>();
 
     size_t endIdx = _resourceTemplates.size();
     if (_pageSize > 0 && (startIdx + _pageSize) < endIdx) {
@@ -1153,20 +1629,14 @@ String Server::_handleResourcesTemplatesList(JsonVariant params, JsonVariant id)
         JsonObject obj = templates.add<JsonObject>();
         _resourceTemplates[i].toJson(obj);
     }
-
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
 }
 
 String Server::_handlePromptsList(JsonVariant params, JsonVariant id) {
-    JsonDocument result;
-    JsonArray prompts = result["prompts"].to<JsonArray>();
+    return _cachedList(ListKind::Prompts, params, id, &Server::_buildPromptsList);
+}
 
-    size_t startIdx = 0;
-    if (!params.isNull() && params["cursor"].is<const char*>()) {
-        startIdx = (size_t)atoi(params["cursor"].as<const char*>());
-    }
+void Server::_buildPromptsList(JsonDocument& result, size_t startIdx) {
+    JsonArray prompts = result["prompts"].to<JsonArray>();
 
     size_t endIdx = _prompts.size();
     if (_pageSize > 0 && (startIdx + _pageSize) < endIdx) {
@@ -1178,10 +1648,6 @@ String Server::_handlePromptsList(JsonVariant params, JsonVariant id) {
         JsonObject obj = prompts.add<JsonObject>();
         _prompts[i].toJson(obj);
     }
-
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
 }
 
 String Server::_handlePromptsGet(JsonVariant params, JsonVariant id) {
@@ -1223,9 +1689,7 @@ String Server::_handlePromptsGet(JsonVariant params, JsonVariant id) {
                 msg.toJson(msgObj);
             }
 
-            String resultStr;
-            serializeJson(result, resultStr);
-            return _jsonRpcResult(id, resultStr);
+            return _jsonRpcResult(id, result);
         }
     }
 
@@ -1239,7 +1703,19 @@ String Server::_handleLoggingSetLevel(JsonVariant params, JsonVariant id) {
         return _jsonRpcError(id, -32602, "Missing level parameter");
     }
 
-    _logging.setLevel(logLevelFromString(level));
+    LogLevel parsed = logLevelFromString(level);
+    Session* session = _currentSession();
+    if (session) {
+        session->logLevel = parsed;
+        // The shared threshold is the most verbose level any session wants
+        LogLevel threshold = parsed;
+        _sessionManager.forEach([&threshold](Session& s) {
+            if (s.logLevel < threshold) threshold = s.logLevel;
+        });
+        _logging.setLevel(threshold);
+    } else {
+        _logging.setLevel(parsed);
+    }
     Serial.printf("[mcpd] Log level set to: %s\n", level);
 
     return _jsonRpcResult(id, "{}");
@@ -1295,9 +1771,7 @@ String Server::_handleCompletionComplete(JsonVariant params, JsonVariant id) {
     completion["total"] = values.size();
     completion["hasMore"] = hasMore;
 
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
+    return _jsonRpcResult(id, result);
 }
 
 String Server::_handleResourcesSubscribe(JsonVariant params, JsonVariant id) {
@@ -1306,8 +1780,10 @@ String Server::_handleResourcesSubscribe(JsonVariant params, JsonVariant id) {
         return _jsonRpcError(id, -32602, "Missing resource URI");
     }
 
-    // Add to subscriptions (set handles dedup)
-    _subscribedResources.insert(String(uri));
+    // Add to this session's subscriptions (idempotent)
+    if (!_subscriptions.subscribe(_sessionId, String(uri))) {
+        return _jsonRpcError(id, -32000, "Too many subscribers");
+    }
 
     return _jsonRpcResult(id, "{}");
 }
@@ -1318,14 +1794,24 @@ String Server::_handleResourcesUnsubscribe(JsonVariant params, JsonVariant id) {
         return _jsonRpcError(id, -32602, "Missing resource URI");
     }
 
-    _subscribedResources.erase(String(uri));
+    _subscriptions.unsubscribe(_sessionId, String(uri));
 
     return _jsonRpcResult(id, "{}");
 }
 
 void Server::notifyResourceUpdated(const char* uri) {
-    // Only notify if this resource is subscribed
-    if (_subscribedResources.find(String(uri)) == _subscribedResources.end()) return;
+    // Only notify if someone subscribed to this URI or a matching pattern
+    String key(uri);
+    if (!_subscriptions.match(key)) return;
+    // Inside the coalescing window: loop() sends it when the window ends
+    if (!_resourceUpdates.admit(key, millis())) return;
+    _sendResourceUpdated(key);
+}
+
+// Serialized once, then queued for each subscribed session
+void Server::_sendResourceUpdated(const String& uri) {
+    SubscriptionIndex::Mask subscribers = _subscriptions.match(uri);
+    if (!subscribers) return;
 
     JsonDocument doc;
     doc["jsonrpc"] = "2.0";
@@ -1335,7 +1821,13 @@ void Server::notifyResourceUpdated(const char* uri) {
 
     String output;
     serializeJson(doc, output);
-    _pendingNotifications.push_back(output);
+    _subscriptions.forEachSubscriber(subscribers, [&](const String& subscriber) {
+        if (subscriber.isEmpty()) {
+            _queueLocal(output);
+        } else if (Session* session = _sessionManager.getSession(subscriber)) {
+            session->queue(output);
+        }
+    });
 }
 
 String Server::_handleRootsList(JsonVariant /* params */, JsonVariant id) {
@@ -1347,9 +1839,7 @@ String Server::_handleRootsList(JsonVariant /* params */, JsonVariant id) {
         root.toJson(obj);
     }
 
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
+    return _jsonRpcResult(id, result);
 }
 
 // ════════════════════════════════════════════════════════════════════════
@@ -1362,8 +1852,9 @@ void Server::addTaskTool(const char* name, const char* description,
     // Register as a normal tool with a placeholder handler
     _tools.emplace_back(name, description, inputSchemaJson,
         [](const JsonObject&) -> String { return "{}"; });
-    _taskToolHandlers[String(name)] = handler;
-    _taskToolSupport[String(name)] = support;
+    ToolSlot& slot = _registerTool();
+    slot.taskHandler = handler;
+    slot.taskSupport = support;
 }
 
 bool Server::taskComplete(const String& taskId, const String& resultJson) {
@@ -1379,7 +1870,7 @@ bool Server::taskComplete(const String& taskId, const String& resultJson) {
             task->toJson(params);
             String output;
             serializeJson(doc, output);
-            _pendingNotifications.push_back(output);
+            _broadcastNotification(output);
         }
     }
     return ok;
@@ -1397,7 +1888,7 @@ bool Server::taskFail(const String& taskId, const String& errorMessage) {
             task->toJson(params);
             String output;
             serializeJson(doc, output);
-            _pendingNotifications.push_back(output);
+            _broadcastNotification(output);
         }
     }
     return ok;
@@ -1415,7 +1906,7 @@ bool Server::taskCancel(const String& taskId) {
             task->toJson(params);
             String output;
             serializeJson(doc, output);
-            _pendingNotifications.push_back(output);
+            _broadcastNotification(output);
         }
     }
     return ok;
@@ -1435,9 +1926,7 @@ String Server::_handleTasksGet(JsonVariant params, JsonVariant id) {
     JsonDocument result;
     JsonObject taskObj = result.to<JsonObject>(); task->toJson(taskObj);
 
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
+    return _jsonRpcResult(id, result);
 }
 
 String Server::_handleTasksResult(JsonVariant params, JsonVariant id) {
@@ -1473,9 +1962,7 @@ String Server::_handleTasksResult(JsonVariant params, JsonVariant id) {
         JsonObject relatedTask = meta["io.modelcontextprotocol/related-task"].to<JsonObject>();
         relatedTask["taskId"] = task->taskId;
 
-        String resultStr;
-        serializeJson(resultDoc, resultStr);
-        return _jsonRpcResult(id, resultStr);
+        return _jsonRpcResult(id, resultDoc);
     }
 
     return _jsonRpcResult(id, "{}");
@@ -1501,9 +1988,7 @@ String Server::_handleTasksList(JsonVariant params, JsonVariant id) {
         result["nextCursor"] = String(nextIdx);
     }
 
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
+    return _jsonRpcResult(id, result);
 }
 
 String Server::_handleTasksCancel(JsonVariant params, JsonVariant id) {
@@ -1525,9 +2010,7 @@ String Server::_handleTasksCancel(JsonVariant params, JsonVariant id) {
     JsonDocument result;
     JsonObject taskObj = result.to<JsonObject>(); task->toJson(taskObj);
 
-    String resultStr;
-    serializeJson(result, resultStr);
-    return _jsonRpcResult(id, resultStr);
+    return _jsonRpcResult(id, result);
 }
 
 // ════════════════════════════════════════════════════════════════════════
@@ -1567,7 +2050,58 @@ void Server::reportProgress(const String& progressToken, double progress,
     pn.progress = progress;
     pn.total = total;
     pn.message = message;
-    _pendingNotifications.push_back(pn.toJsonRpc());
+    _queueNotification(pn.toJsonRpc());
+}
+
+// ════════════════════════════════════════════════════════════════════════
+// Notification routing
+// ════════════════════════════════════════════════════════════════════════
+
+void Server::_queueNotification(const String& json) {
+    Session* session = _currentSession();
+    if (session) {
+        session->queue(json);
+    } else {
+        _queueLocal(json);
+    }
+}
+
+void Server::_broadcastNotification(const String& json) {
+    _queueLocal(json);
+    _sessionManager.forEach([&json](Session& s) { s.queue(json); });
+}
+
+void Server::_queueLocal(const String& json) {
+    if (_pendingNotifications.size() >= Session::MAX_PENDING) {
+        _pendingNotifications.erase(_pendingNotifications.begin());
+    }
+    _pendingNotifications.push_back(json);
+}
+
+// Log messages already passed the most verbose session threshold; each
+// session only receives the ones at or above its own level.
+void Server::_routeLogNotification(const String& json) {
+    JsonDocument doc;
+    if (deserializeJson(doc, json)) return;
+    LogLevel level = logLevelFromString(doc["params"]["level"] | "info");
+    _sessionManager.forEach([&](Session& s) {
+        if (level >= s.logLevel) s.queue(json);
+    });
+    _queueLocal(json);
+}
+
+// WebSocket and BLE carry no Mcp-Session-Id: their messages use the
+// server-level state and never create or switch sessions.
+String Server::_processLocal(const String& body) {
+    String session = _sessionId;
+    bool initialized = _initialized;
+    _sessionId = "";
+    _localRequest = true;
+    String response = _processJsonRpc(body);
+    _localRequest = false;
+    _sessionId = session;
+    _initialized = initialized;
+    return response;
 }
 
 // ════════════════════════════════════════════════════════════════════════
@@ -1575,18 +2109,61 @@ void Server::reportProgress(const String& progressToken, double progress,
 // ════════════════════════════════════════════════════════════════════════
 
 String Server::_jsonRpcResult(JsonVariant id, const String& resultJson) {
-    JsonDocument doc;
-    doc["jsonrpc"] = "2.0";
-    if (!id.isNull()) {
-        doc["id"] = id;
-    }
     // Parse result JSON and embed it
     JsonDocument resultDoc;
     deserializeJson(resultDoc, resultJson);
-    doc["result"] = resultDoc.as<JsonVariant>();
+    return _jsonRpcResult(id, resultDoc);
+}
+
+namespace {
+
+inline void _appendRaw(String& out, const char* s) { out += s; }
+inline void _appendRaw(ResponseWriter& out, const char* s) { out.print(s); }
+inline void _appendRaw(String& out, const String& s) { out += s; }
+inline void _appendRaw(ResponseWriter& out, const String& s) { out.print(s); }
+
+template <typename TWriter>
+void _appendResult(TWriter& out, const JsonDocument& result) { serializeJson(result, out); }
+template <typename TWriter>
+void _appendResult(TWriter& out, const String& serialized) { _appendRaw(out, serialized); }
+
+// {"jsonrpc":"2.0","id":<id>,"result":<result>} written straight into the
+// destination, without building an envelope document around the result
+template <typename TWriter, typename TResult>
+void _writeJsonRpcResult(TWriter& out, JsonVariant id, const TResult& result) {
+    _appendRaw(out, "{\"jsonrpc\":\"2.0\"");
+    if (!id.isNull()) {
+        _appendRaw(out, ",\"id\":");
+        serializeJson(id, out);
+    }
+    _appendRaw(out, ",\"result\":");
+    _appendResult(out, result);
+    _appendRaw(out, "}");
+}
 
+} // namespace
+
+String Server::_jsonRpcResult(JsonVariant id, const JsonDocument& result) {
+    if (_responseWriter) {
+        _writeJsonRpcResult(*_responseWriter, id, result);
+        _responseStreamed = true;
+        return String();
+    }
     String output;
-    serializeJson(doc, output);
+    _writeJsonRpcResult(output, id, result);
+    return output;
+}
+
+// Same envelope around an already-serialized result (no parse)
+String Server::_jsonRpcRawResult(JsonVariant id, const String& serializedResult) {
+    if (_responseWriter) {
+        _writeJsonRpcResult(*_responseWriter, id, serializedResult);
+        _responseStreamed = true;
+        return String();
+    }
+    String output;
+    output.reserve(serializedResult.length() + 48);
+    _writeJsonRpcResult(output, id, serializedResult);
     return output;
 }
 
@@ -1631,15 +2208,4 @@ String Server::_jsonRpcError(JsonVariant id, int code, const char* message) {
     return output;
 }
 
-String Server::_generateSessionId() {
-    // Generate a simple session ID from random bytes
-    String sid = "";
-    for (int i = 0; i < 16; i++) {
-        char hex[3];
-        snprintf(hex, sizeof(hex), "%02x", (uint8_t)random(256));
-        sid += hex;
-    }
-    return sid;
-}
-
 } // namespace mcpd
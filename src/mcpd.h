@@ -29,15 +29,22 @@
 #include "MCPCompletion.h"
 #include "MCPRoots.h"
 #include "MCPToolGroup.h"
+#include "MCPToolTable.h"
 #include "MCPContent.h"
 #include "MCPProgress.h"
 #include "MCPTransport.h"
+#include "MCPIOLoop.h"
 #include "MCPTransportSSE.h"
+#include "MCPHttpKeepAlive.h"
+#include "MCPResponseWriter.h"
+#include "MCPBatch.h"
+#include "MCPListCache.h"
 #include "MCPSampling.h"
 #include "MCPElicitation.h"
 #include "MCPTransportWS.h"
 #include "MCPRateLimit.h"
 #include "MCPSession.h"
+#include "MCPSubscriptions.h"
 #include "MCPHeap.h"
 #include "MCPAuth.h"
 #include "MCPMetrics.h"
@@ -46,7 +53,9 @@
 #include "MCPCache.h"
 #include "MCPScheduler.h"
 #include "MCPEventStore.h"
+#include "MCPTimeSeries.h"
 #include "MCPStateStore.h"
+#include "MCPStatePersistence.h"
 #include "MCPAccessControl.h"
 #include "MCPAuditLog.h"
 #include "MCPWatchdog.h"
@@ -298,6 +307,20 @@ public:
      */
     void enableWebSocket(uint16_t port = 8081);
 
+    /**
+     * Compress WebSocket messages for clients that offer permessage-deflate.
+     * Call before begin().
+     * @param contextTakeover  keep the compression window between messages
+     *        (1 KB per client); false compresses each message on its own
+     */
+    void enableWebSocketCompression(bool contextTakeover = true);
+
+    /**
+     * Largest WebSocket message accepted (default 16 KB), after fragments
+     * are joined and compressed messages inflated. Call before begin().
+     */
+    void setWebSocketMaxMessageSize(size_t bytes);
+
 #ifdef ESP32
     /**
      * Enable BLE transport alongside HTTP.
@@ -306,6 +329,16 @@ public:
      * @param mtu         Negotiated MTU size (default 512)
      */
     void enableBLE(const char* deviceName = nullptr, uint16_t mtu = 512);
+
+    /**
+     * BLE throughput mode: request 2M PHY, data length extension and a
+     * short connection interval, and send up to `window` notifications
+     * per connection event. Call before begin().
+     */
+    void enableBLEThroughputMode(uint8_t window = BLETransport::THROUGHPUT_WINDOW);
+
+    /** BLE transport (nullptr before begin() or without enableBLE()) */
+    BLETransport* bleTransport() { return _bleTransport; }
 #endif
 
     // ── Rate Limiting ──────────────────────────────────────────────────
@@ -320,6 +353,45 @@ public:
     /** Access the rate limiter for stats or manual control */
     RateLimiter& rateLimiter() { return _rateLimiter; }
 
+    static constexpr size_t DEFAULT_MAX_BATCH_SIZE = 64;
+    static constexpr size_t DEFAULT_BATCH_MEMORY_BUDGET = 8192;
+
+    /**
+     * Largest JSON-RPC batch accepted (default 64 items). A bigger batch
+     * is answered with a single -32600 error and none of it runs.
+     */
+    void setMaxBatchSize(size_t items) { _maxBatchSize = items; }
+    size_t maxBatchSize() const { return _maxBatchSize; }
+
+    /**
+     * Response bytes a batch may hold when its transport cannot stream
+     * (WebSocket, BLE; default 8 KB). Once a response would cross it, that
+     * request and the rest of the batch get a short -32000 error instead.
+     * Streamed HTTP batches write each response as it completes and only
+     * ever hold one.
+     */
+    void setBatchMemoryBudget(size_t bytes) { _batchMemoryBudget = bytes; }
+    size_t batchMemoryBudget() const { return _batchMemoryBudget; }
+
+    // ── HTTP Keep-Alive ────────────────────────────────────────────────
+
+    /**
+     * Keep HTTP/1.1 connections to the MCP endpoint open between requests
+     * (and answer pipelined requests on them) instead of one TCP connection
+     * per JSON-RPC call. Each kept socket counts against the lwIP socket
+     * limit alongside SSE streams.
+     * @param maxConnections  Sockets kept open at once
+     * @param idleTimeoutMs   Close a connection idle this long
+     */
+    void enableKeepAlive(size_t maxConnections = HttpKeepAlive::DEFAULT_MAX_CONNECTIONS,
+                         unsigned long idleTimeoutMs = HttpKeepAlive::DEFAULT_IDLE_TIMEOUT_MS);
+
+    /** Access the keep-alive pool for limits and stats */
+    HttpKeepAlive& keepAlive() { return _keepAlive; }
+
+    /** Readiness poller shared by the HTTP, SSE and WebSocket connections */
+    const IOPoller& io() const { return _io; }
+
     // ── Access Control (RBAC) ──────────────────────────────────────────
     /** Access the RBAC controller for role-based tool restrictions. */
     AccessControl& accessControl() { return _accessControl; }
@@ -341,6 +413,16 @@ public:
     /** Set session idle timeout in ms (default: 30 min, 0 = no timeout) */
     void setSessionTimeout(unsigned long timeoutMs) { _sessionManager.setIdleTimeout(timeoutMs); }
 
+    /** Resource subscriptions of every session */
+    const SubscriptionIndex& subscriptions() const { return _subscriptions; }
+
+    /**
+     * Coalesce notifyResourceUpdated() calls for the same URI: at most one
+     * resources/updated per window, the last one sent from loop() when the
+     * window ends (default 0 = every update is sent).
+     */
+    void setResourceUpdateWindow(unsigned long windowMs) { _resourceUpdates.setWindow(windowMs); }
+
     // ── Heap Monitoring ────────────────────────────────────────────────
 
     /** Access heap monitor for memory diagnostics */
@@ -356,6 +438,23 @@ public:
     /** Access the Prometheus metrics module */
     Metrics& metrics() { return _metrics; }
 
+    // ── List Cache ─────────────────────────────────────────────────────
+
+    /**
+     * Access the serialized list-response cache (tools/list, resources/list,
+     * resources/templates/list, prompts/list). Enabled by default; call
+     * listCache().setEnabled(false) to trade CPU for RAM.
+     */
+    ListCache& listCache() { return _listCache; }
+
+    // ── Scheduler ──────────────────────────────────────────────────────
+
+    /**
+     * Access the server's scheduler, run from loop(). The tool result
+     * cache uses it for background refreshes; user tasks may share it.
+     */
+    Scheduler& scheduler() { return _scheduler; }
+
     // ── Tool Call Hooks ─────────────────────────────────────────────────
 
     /**
@@ -433,7 +532,7 @@ public:
      * Invalid calls receive a JSON-RPC error (-32602) with detailed messages.
      * Disabled by default for backward compatibility.
      */
-    void enableInputValidation(bool enable = true) { _inputValidation = enable; }
+    void enableInputValidation(bool enable = true);
 
     /** Check if input validation is enabled */
     bool isInputValidationEnabled() const { return _inputValidation; }
@@ -446,7 +545,7 @@ public:
      *
      * Disabled by default. Requires enableInputValidation() pattern.
      */
-    void enableOutputValidation(bool enable = true) { _outputValidation = enable; }
+    void enableOutputValidation(bool enable = true);
 
     /** Check if output validation is enabled */
     bool isOutputValidationEnabled() const { return _outputValidation; }
@@ -477,6 +576,31 @@ public:
     String jsonRpcErrorWithData(JsonVariant id, int code, const char* message,
                                 const String& dataJson);
 
+    // ── Custom JSON-RPC Methods ────────────────────────────────────────
+
+    /**
+     * Handler for an application-defined JSON-RPC method.
+     * Receives the request params (may be null) and returns the JSON text
+     * of the "result" member. Exceptions become an Internal error (-32603).
+     */
+    using MethodHandler = std::function<String(JsonVariant params)>;
+
+    /**
+     * Register a custom JSON-RPC method, e.g. "device/reboot".
+     * Resolved by the same dispatcher as the built-in MCP methods.
+     * Re-registering a name replaces its handler.
+     * @return false if the name is empty or shadows a built-in method
+     */
+    bool addMethod(const char* method, MethodHandler handler);
+
+    /**
+     * Remove a custom JSON-RPC method. Returns true if found and removed.
+     */
+    bool removeMethod(const char* method);
+
+    /** Check whether a method (built-in or custom) is registered */
+    bool hasMethod(const char* method) const;
+
     // ── Lifecycle Hooks ────────────────────────────────────────────────
 
     using LifecycleCallback = std::function<void()>;
@@ -557,9 +681,12 @@ private:
     const char* _websiteUrl = nullptr;
     std::vector<MCPIcon> _icons;
     bool _mdnsEnabled = true;
-    std::set<String> _disabledTools;  // tools hidden from listing/calling
+    // Session of the message being processed ("" for WebSocket/BLE, which
+    // share the server-level state below). HTTP requests switch it from
+    // their Mcp-Session-Id header; per-session state lives in _sessionManager.
     String _sessionId;
     bool _initialized = false;
+    bool _localRequest = false;  // Processing a WebSocket/BLE message
     size_t _pageSize = 0;  // 0 = no pagination
 
     WebServer* _httpServer = nullptr;
@@ -571,14 +698,21 @@ private:
     SSEManager _sseManager;
     WebSocketTransport* _wsTransport = nullptr;
     uint16_t _wsPort = 0;
+    bool _wsDeflate = false;
+    bool _wsContextTakeover = true;
+    size_t _wsMaxMessage = WebSocketTransport::DEFAULT_MAX_MESSAGE_BYTES;
 
 #ifdef ESP32
     BLETransport* _bleTransport = nullptr;
     const char* _bleName = nullptr;
     uint16_t _bleMtu = 512;
+    bool _bleThroughput = false;
+    uint8_t _bleWindow = BLETransport::THROUGHPUT_WINDOW;
 #endif
 
     RateLimiter _rateLimiter;
+    HttpKeepAlive _keepAlive;
+    IOPoller _io;
     AccessControl _accessControl;
     HealthCheck _healthCheck;
     AuditLog _auditLog;
@@ -591,8 +725,17 @@ private:
     bool _outputValidation = false;
     ToolResultCache _cache;
     ToolGroupManager _toolGroups;
-    std::map<String, MCPTaskToolHandler> _taskToolHandlers;
-    std::map<String, TaskSupport> _taskToolSupport;
+    ListCache _listCache;
+    Scheduler _scheduler;
+
+    // Background cache refreshes waiting for the scheduler
+    struct CacheRefresh {
+        String toolName;
+        ArgsDigest key;
+        String argsJson;
+    };
+    std::vector<CacheRefresh> _cacheRefreshes;
+    static constexpr const char* CACHE_REFRESH_TASK = "mcpd:cache-refresh";
 
     // Lifecycle callbacks
     InitCallback _onInitializeCb;
@@ -604,27 +747,83 @@ private:
     AfterToolCallHook _afterToolCallHook;
 
     std::vector<MCPTool> _tools;
-    std::vector<std::pair<String, MCPRichToolHandler>> _richTools;  // name → handler
+    ToolTable _toolTable;  // name → slot index, parallel to _tools
     std::vector<MCPResource> _resources;
     std::vector<MCPResourceTemplate> _resourceTemplates;
     std::vector<MCPPrompt> _prompts;
     std::vector<MCPRoot> _roots;
 
-    // Pending notifications to send
+    // Active streaming output for the request being handled (HTTP POST
+    // only). Handlers that call _jsonRpcResult() with a document write
+    // through it and set _responseStreamed instead of returning a String.
+    ResponseWriter* _responseWriter = nullptr;
+    bool _responseStreamed = false;
+
+    // Batch execution. Consecutive tools/call items for readOnlyHint tools
+    // run back-to-back: they are not tracked for cancellation and reuse the
+    // RBAC decision of the previous call to the same tool with the same key.
+    size_t _maxBatchSize = DEFAULT_MAX_BATCH_SIZE;
+    size_t _batchMemoryBudget = DEFAULT_BATCH_MEMORY_BUDGET;
+    struct BatchState {
+        bool active = false;
+        int grantedTool = -1;      // Tool index RBAC last allowed, -1 if none
+        String grantedKey;
+        size_t readOnlyCalls = 0;  // Calls that took the fast path
+    };
+    BatchState _batch;
+
+    // Pending notifications for the session-less transports (BLE)
     std::vector<String> _pendingNotifications;
 
-    // Resource subscriptions: set of subscribed URIs (O(log n) lookup)
-    std::set<String> _subscribedResources;
+    // Resource subscriptions: URI/pattern → bitmask of sessions ("" = local)
+    SubscriptionIndex _subscriptions;
+    UpdateCoalescer _resourceUpdates;
+    void _sendResourceUpdated(const String& uri);
+
+    Session* _currentSession() { return _sessionManager.getSession(_sessionId); }
+    void _queueNotification(const String& json);      // Current session
+    void _broadcastNotification(const String& json);  // Every session
+    void _queueLocal(const String& json);
+    void _routeLogNotification(const String& json);
+    String _processLocal(const String& body);
 
     // ── JSON-RPC dispatch ──────────────────────────────────────────────
 
     void _handleMCPPost();
     void _handleMCPGet();
     void _handleMCPDelete();
+    void _serveKeepAlive(HttpConnection& conn);
+
+    // Shared by WebServer and kept-alive HttpConnection requests
+    template <typename THttp> void _serveMCPPost(THttp& http);
+    template <typename THttp> bool _serveMCPGet(THttp& http);
+    template <typename THttp> void _serveMCPDelete(THttp& http);
+    template <typename THttp> bool _prefersEventStream(THttp& http);
 
     String _processJsonRpc(const String& body);
+    String _processBatch(const String& body);
     String _dispatch(const char* method, JsonVariant params, JsonVariant id);
 
+    using MethodFn = String (Server::*)(JsonVariant params, JsonVariant id);
+
+    /** Built-in method table entry. The table is sorted by name. */
+    struct MethodEntry {
+        const char* name;
+        MethodFn handler;
+    };
+    static const MethodEntry _builtinMethods[];
+    static const size_t _builtinMethodCount;
+
+    /** Application-defined method, kept sorted by name in _customMethods */
+    struct CustomMethod {
+        String name;
+        MethodHandler handler;
+    };
+    std::vector<CustomMethod> _customMethods;
+
+    static const MethodEntry* _findBuiltinMethod(const char* method);
+    const CustomMethod* _findCustomMethod(const char* method) const;
+
     // ── MCP method handlers ────────────────────────────────────────────
 
     String _handleInitialize(JsonVariant params, JsonVariant id);
@@ -635,7 +834,7 @@ private:
     String _handleResourcesTemplatesList(JsonVariant params, JsonVariant id);
     String _handlePromptsList(JsonVariant params, JsonVariant id);
     String _handlePromptsGet(JsonVariant params, JsonVariant id);
-    String _handlePing(JsonVariant id);
+    String _handlePing(JsonVariant params, JsonVariant id);
     String _handleLoggingSetLevel(JsonVariant params, JsonVariant id);
     String _handleCompletionComplete(JsonVariant params, JsonVariant id);
     String _handleResourcesSubscribe(JsonVariant params, JsonVariant id);
@@ -645,12 +844,32 @@ private:
     String _handleTasksResult(JsonVariant params, JsonVariant id);
     String _handleTasksList(JsonVariant params, JsonVariant id);
     String _handleTasksCancel(JsonVariant params, JsonVariant id);
+    String _handleNotificationInitialized(JsonVariant params, JsonVariant id);
+    String _handleNotificationCancelled(JsonVariant params, JsonVariant id);
 
     // ── Helpers ────────────────────────────────────────────────────────
 
+    ToolSlot& _registerTool();
+    void _compileToolSchemas(MCPTool& tool);
+    void _syncToolTable();
+    bool _executeTool(const MCPTool& tool, const ToolSlot& slot,
+                      JsonObject arguments, JsonDocument& result);
+    void _scheduleCacheRefresh(const char* toolName, const ArgsDigest& key,
+                               JsonObject arguments);
+    void _runCacheRefreshes();
+
+    // Builds one page of a list result into `result`, starting at startIdx
+    using ListBuilder = void (Server::*)(JsonDocument& result, size_t startIdx);
+    String _cachedList(ListKind kind, JsonVariant params, JsonVariant id, ListBuilder build);
+    void _buildToolsList(JsonDocument& result, size_t startIdx);
+    void _buildResourcesList(JsonDocument& result, size_t startIdx);
+    void _buildResourcesTemplatesList(JsonDocument& result, size_t startIdx);
+    void _buildPromptsList(JsonDocument& result, size_t startIdx);
+
     String _jsonRpcResult(JsonVariant id, const String& resultJson);
+    String _jsonRpcResult(JsonVariant id, const JsonDocument& result);
+    String _jsonRpcRawResult(JsonVariant id, const String& serializedResult);
     String _jsonRpcError(JsonVariant id, int code, const char* message);
-    String _generateSessionId();
 };
 
 } // namespace mcpd
@@ -0,0 +1,179 @@
+/**
+ * mcpd — Built-in Time-Series Query Tool
+ *
+ * Provides: timeseries_query
+ * Resources: timeseries://list, timeseries://{series}
+ *
+ * Exposes a TimeSeriesStore to clients: raw points over a time window, or
+ * min/max/avg/count per bucket (from a maintained rollup when one has the
+ * requested bucket size, else computed from the stored points).
+ */
+
+#ifndef MCPD_TIME_SERIES_TOOL_H
+#define MCPD_TIME_SERIES_TOOL_H
+
+#include "../mcpd.h"
+
+namespace mcpd {
+namespace tools {
+
+class TimeSeriesTool {
+public:
+    static constexpr size_t DEFAULT_LIMIT = 200;
+    static constexpr size_t MAX_LIMIT = 1000;
+
+    static void attach(Server& server, TimeSeriesStore& store) {
+        TimeSeriesStore* ts = &store;
+
+        MCPTool query("timeseries_query",
+            "Query a sensor time series: raw points over a time window, or "
+            "min/max/avg/count per bucket when bucket_ms is given",
+            R"=({"type":"object","properties":{)="
+            R"=("series":{"type":"string","description":"Series name (see timeseries://list)"},)="
+            R"=("from_ms":{"type":"integer","description":"Window start (device millis)"},)="
+            R"=("to_ms":{"type":"integer","description":"Window end (device millis)"},)="
+            R"=("last_ms":{"type":"integer","description":"Window of this length ending at the newest point"},)="
+            R"=("bucket_ms":{"type":"integer","description":"Downsample to buckets of this size"},)="
+            R"=("limit":{"type":"integer","description":"Maximum points or buckets (default 200, max 1000)"})="
+            R"=(},"required":["series"]})=",
+            [ts](const JsonObject& args) -> String {
+                return TimeSeriesTool::query(*ts, args);
+            });
+        query.annotations.title = "Query Time Series";
+        query.markReadOnly();
+        server.addTool(query);
+
+        server.addResource("timeseries://list", "Time series",
+            "Recorded series with point counts, time range and storage use",
+            "application/json",
+            [ts]() -> String { return list(*ts); });
+
+        server.addResourceTemplate("timeseries://{series}", "Time series summary",
+            "Latest value, storage use and rollup buckets of one series",
+            "application/json",
+            [ts](const std::map<String, String>& params) -> String {
+                auto it = params.find("series");
+                const TimeSeries* s = it == params.end() ? nullptr : ts->find(it->second.c_str());
+                if (!s) return "{\"error\":\"Unknown series\"}";
+                return summary(*s);
+            });
+    }
+
+    static String query(const TimeSeriesStore& store, const JsonObject& args) {
+        const char* name = args["series"] | "";
+        const TimeSeries* s = store.find(name);
+        if (!s) return "{\"error\":\"Unknown series\"}";
+
+        uint32_t from = args["from_ms"] | 0UL;
+        uint32_t to = args["to_ms"] | (unsigned long)UINT32_MAX;
+        uint32_t last = args["last_ms"] | 0UL;
+        if (last > 0) {
+            uint32_t newest = s->lastTimestamp();
+            from = newest > last ? newest - last : 0;
+        }
+        uint32_t bucket = args["bucket_ms"] | 0UL;
+        size_t limit = args["limit"] | (unsigned long)DEFAULT_LIMIT;
+        if (limit == 0 || limit > MAX_LIMIT) limit = MAX_LIMIT;
+
+        JsonDocument doc;
+        doc["series"] = s->name().c_str();
+        doc["unit"] = s->unit().c_str();
+        bool truncated = false;
+        size_t n = 0;
+        if (bucket > 0) {
+            doc["bucket_ms"] = bucket;
+            doc["source"] = s->hasRollup(bucket) ? "rollup" : "points";
+            JsonArray buckets = doc["buckets"].to<JsonArray>();
+            s->rollup(bucket, from, to, [&](const SeriesBucket& b) {
+                if (n == limit) {
+                    truncated = true;
+                    return false;
+                }
+                JsonObject o = buckets.add<JsonObject>();
+                o["t"] = b.startMs;
+                o["min"] = b.min;
+                o["max"] = b.max;
+                o["avg"] = b.avg();
+                o["count"] = b.count;
+                n++;
+                return true;
+            });
+        } else {
+            JsonArray points = doc["points"].to<JsonArray>();
+            s->forEach(from, to, [&](uint32_t t, double v) {
+                if (n == limit) {
+                    truncated = true;
+                    return false;
+                }
+                JsonArray p = points.add<JsonArray>();
+                p.add(t);
+                p.add(v);
+                n++;
+                return true;
+            });
+        }
+        if (truncated) doc["truncated"] = true;
+        String result;
+        serializeJson(doc, result);
+        return result;
+    }
+
+    static String list(const TimeSeriesStore& store) {
+        JsonDocument doc;
+        JsonArray arr = doc["series"].to<JsonArray>();
+        for (size_t i = 0; i < store.size(); i++) {
+            const TimeSeries& s = store.at(i);
+            JsonObject o = arr.add<JsonObject>();
+            o["name"] = s.name().c_str();
+            o["unit"] = s.unit().c_str();
+            o["type"] = seriesTypeToString(s.type());
+            o["points"] = s.count();
+            o["first_ms"] = s.firstTimestamp();
+            o["last_ms"] = s.lastTimestamp();
+            o["bytes_used"] = s.bytesUsed();
+            o["capacity_bytes"] = s.capacityBytes();
+        }
+        String result;
+        serializeJson(doc, result);
+        return result;
+    }
+
+    static String summary(const TimeSeries& s) {
+        JsonDocument doc;
+        doc["name"] = s.name().c_str();
+        doc["unit"] = s.unit().c_str();
+        doc["type"] = seriesTypeToString(s.type());
+        doc["points"] = s.count();
+        doc["appended"] = s.totalAppended();
+        doc["first_ms"] = s.firstTimestamp();
+        doc["last_ms"] = s.lastTimestamp();
+        if (!s.empty()) doc["last_value"] = s.lastValue();
+        doc["bytes_used"] = s.bytesUsed();
+        doc["capacity_bytes"] = s.capacityBytes();
+        doc["bits_per_point"] = s.bitsPerPoint();
+        JsonArray rollups = doc["rollups"].to<JsonArray>();
+        for (size_t i = 0; i < s.rollupCount(); i++) {
+            uint32_t bucket = s.rollupBucketMs(i);
+            JsonObject r = rollups.add<JsonObject>();
+            r["bucket_ms"] = bucket;
+            JsonArray buckets = r["buckets"].to<JsonArray>();
+            s.rollup(bucket, 0, UINT32_MAX, [&buckets](const SeriesBucket& b) {
+                JsonObject o = buckets.add<JsonObject>();
+                o["t"] = b.startMs;
+                o["min"] = b.min;
+                o["max"] = b.max;
+                o["avg"] = b.avg();
+                o["count"] = b.count;
+                return true;
+            });
+        }
+        String result;
+        serializeJson(doc, result);
+        return result;
+    }
+};
+
+} // namespace tools
+} // namespace mcpd
+
+#endif // MCPD_TIME_SERIES_TOOL_H
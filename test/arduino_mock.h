@@ -8,6 +8,7 @@
 #ifndef ARDUINO_MOCK_H
 #define ARDUINO_MOCK_H
 
+#include <cctype>
 #include <cstdint>
 #include <cstring>
 #include <cstdio>
@@ -71,6 +72,7 @@ public:
     // Arduino String methods needed by ArduinoJson
     bool concat(const char* s) { if (s) _s += s; return true; }
     bool concat(char c) { _s += c; return true; }
+    bool concat(const char* s, unsigned int len) { if (s) _s.append(s, len); return true; }
     void remove(unsigned int index, unsigned int count = 1) {
         if (index < _s.size()) _s.erase(index, count);
     }
@@ -133,6 +135,12 @@ public:
     int toInt() const { return std::atoi(_s.c_str()); }
     float toFloat() const { return std::atof(_s.c_str()); }
     double toDouble() const { return std::strtod(_s.c_str(), nullptr); }
+    void toLowerCase() { for (auto& c : _s) c = (char)std::tolower((unsigned char)c); }
+    void trim() {
+        size_t b = _s.find_first_not_of(" \t\r\n");
+        size_t e = _s.find_last_not_of(" \t\r\n");
+        _s = b == std::string::npos ? std::string() : _s.substr(b, e - b + 1);
+    }
 
     void replace(const String& find, const String& repl) {
         size_t pos = 0;
@@ -262,7 +270,8 @@ inline void timerAlarmDisable(hw_timer_t* t) { (void)t; }
 inline void timerDetachInterrupt(hw_timer_t* t) { (void)t; }
 inline void timerEnd(hw_timer_t* t) { (void)t; }
 
-inline unsigned long micros() { return 12345000; }
+inline unsigned long& _mockMicros() { static unsigned long m = 12345000; return m; }
+inline unsigned long micros() { return _mockMicros(); }
 
 // ── Power/Sleep Mock ───────────────────────────────────────────────────
 
@@ -371,10 +380,22 @@ class WiFiClient {
 public:
     bool connected() const { return _connected; }
     operator bool() const { return _connected; }
-    int available() const { return 0; }
-    int read() { return -1; }
+    int available() const { return (int)(_incoming.length() - _readPos); }
+    int read() {
+        if (_readPos >= _incoming.length()) return -1;
+        return (uint8_t)_incoming[_readPos++];
+    }
+    int read(uint8_t* buf, size_t size) {
+        size_t n = _incoming.length() - _readPos;
+        if (n > size) n = size;
+        memcpy(buf, _incoming.c_str() + _readPos, n);
+        _readPos += n;
+        return (int)n;
+    }
     size_t write(uint8_t b) { _buffer += (char)b; return 1; }
     size_t write(const uint8_t* buf, size_t len) {
+        if (len > _writeBudget) len = _writeBudget;
+        if (_writeBudget != (size_t)-1) _writeBudget -= len;
         for (size_t i = 0; i < len; i++) _buffer += (char)buf[i];
         return len;
     }
@@ -383,14 +404,23 @@ public:
     size_t println() { _buffer += "\n"; return 1; }
     void flush() {}
     void stop() { _connected = false; }
+    int fd() const { return -1; }  // No socket: IOPoller probes available()
 
     // Test helpers
     String getBuffer() const { return _buffer; }
     void setConnected(bool c) { _connected = c; }
+    // Bytes write() accepts before returning short (simulates a full socket)
+    void setWriteBudget(size_t n) { _writeBudget = n; }
+    void clearBuffer() { _buffer = ""; }
+    // Bytes available() / read() return next (simulates data from the peer)
+    void pushIncoming(const String& data) { _incoming += data; }
 
 private:
     bool _connected = true;
     String _buffer;
+    String _incoming;
+    size_t _readPos = 0;
+    size_t _writeBudget = (size_t)-1;
 };
 
 // ── WiFiServer Mock ────────────────────────────────────────────────────
@@ -400,11 +430,29 @@ public:
     WiFiServer(uint16_t port) { (void)port; }
     void begin() {}
     void stop() {}
-    WiFiClient available() { return WiFiClient(); }
+    // Next connection queued with _queueClient(), else a disconnected client
+    WiFiClient available() {
+        WiFiClient c;
+        if (_pending.empty()) {
+            c.setConnected(false);
+        } else {
+            c = _pending.front();
+            _pending.erase(_pending.begin());
+        }
+        return c;
+    }
+
+    // Test helper
+    void _queueClient(const WiFiClient& c) { _pending.push_back(c); }
+
+private:
+    std::vector<WiFiClient> _pending;
 };
 
 // ── WebServer Mock ─────────────────────────────────────────────────────
 
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
 #define HTTP_POST   1
 #define HTTP_GET    2
 #define HTTP_DELETE 3
@@ -465,8 +513,22 @@ public:
         _responseCode = code;
         _lastContentType = contentType;
         _responseBody = body;
+        _chunkCount = 0;
+        _chunkedFinished = false;
     }
 
+    // Chunked responses: setContentLength(CONTENT_LENGTH_UNKNOWN), send(), sendContent()...
+    size_t _contentLength = 0;
+    size_t _chunkCount = 0;
+    bool _chunkedFinished = false;
+    void setContentLength(size_t len) { _contentLength = len; }
+    void sendContent(const char* data, size_t len) {
+        if (len == 0) { _chunkedFinished = true; return; }
+        _responseBody.write((const uint8_t*)data, len);
+        _chunkCount++;
+    }
+    void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+
     // Test helpers
     void _setBody(const String& body) { _body = body; }
     void _setHeader(const char* name, const String& value) { _headers[String(name)] = value; }
@@ -505,4 +567,24 @@ public:
 };
 inline TwoWire Wire;
 
+// ── Allocation Counting ────────────────────────────────────────────────
+// Define MCPD_MOCK_COUNT_ALLOCS before including this header to replace
+// the global operator new with one that counts calls. Each test binary is
+// a single translation unit, so the replacement is defined exactly once.
+
+#ifdef MCPD_MOCK_COUNT_ALLOCS
+#include <new>
+inline size_t& _mockAllocCount() { static size_t n = 0; return n; }
+void* operator new(size_t size) {
+    _mockAllocCount()++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#endif
+
 #endif // ARDUINO_MOCK_H
@@ -0,0 +1,241 @@
+/**
+ * mcpd — HTTP keep-alive benchmark
+ *
+ * Sends JSON-RPC ping requests over real loopback TCP sockets and compares
+ * one connection per request (WebServer behaviour) with a kept-alive
+ * connection, sequential and pipelined. The server side runs the mcpd
+ * handlers on the mock WebServer/WiFiClient; bytes are pumped between the
+ * socket and the mock, so the numbers include TCP setup and teardown but
+ * not WiFi latency, which only widens the gap on a device. Not part of
+ * `make test`; run with `make bench`.
+ */
+
+#include "arduino_mock.h"
+#include "mcpd.cpp"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mcpd;
+
+static const char* PING = R"({"jsonrpc":"2.0","id":7,"method":"ping"})";
+
+static int listenLoopback(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (sockaddr*)&addr, sizeof(addr));
+    listen(fd, 64);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int connectLoopback(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    connect(fd, (sockaddr*)&addr, sizeof(addr));
+    return fd;
+}
+
+static int acceptOne(int listenFd) {
+    int fd = accept(listenFd, nullptr, nullptr);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static void writeAll(int fd, const String& data) {
+    size_t off = 0;
+    while (off < data.length()) {
+        ssize_t n = write(fd, data.c_str() + off, data.length() - off);
+        if (n <= 0) return;
+        off += (size_t)n;
+    }
+}
+
+static String request(const char* connection) {
+    String body = PING;
+    return String("POST /mcp HTTP/1.1\r\nHost: bench\r\nContent-Type: application/json\r\n") +
+           "Connection: " + connection + "\r\nContent-Length: " + String((int)body.length()) +
+           "\r\n\r\n" + body;
+}
+
+// Length of the first complete response in buf, 0 if not complete yet
+static size_t responseLength(const std::string& buf) {
+    size_t head = buf.find("\r\n\r\n");
+    if (head == std::string::npos) return 0;
+    head += 4;
+    size_t cl = buf.find("Content-Length: ");
+    if (cl != std::string::npos && cl < head) {
+        size_t len = head + strtoul(buf.c_str() + cl + 16, nullptr, 10);
+        return buf.size() >= len ? len : 0;
+    }
+    size_t end = buf.find("\r\n0\r\n\r\n", head - 2);
+    return end == std::string::npos ? 0 : end + 7;
+}
+
+// Read n complete responses from the client socket
+static void readResponses(int fd, size_t n, std::string& pending) {
+    char buf[4096];
+    while (n > 0) {
+        size_t len;
+        while (n > 0 && (len = responseLength(pending)) > 0) {
+            pending.erase(0, len);
+            n--;
+        }
+        if (n == 0) break;
+        ssize_t got = read(fd, buf, sizeof(buf));
+        if (got <= 0) return;
+        pending.append(buf, (size_t)got);
+    }
+}
+
+// Move what the client sent from the server socket into the mock
+static size_t pumpIn(int fd, HttpConnection& conn) {
+    char buf[4096];
+    ssize_t got = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (got <= 0) return 0;
+    String data;
+    data.concat(buf, (unsigned)got);
+    conn._client.pushIncoming(data);
+    return (size_t)got;
+}
+
+static void pumpOut(int fd, HttpConnection& conn) {
+    writeAll(fd, conn._client.getBuffer());
+    conn._client.clearBuffer();
+}
+
+static Server* startServer(bool keepAlive) {
+    Server* s = new Server("bench");
+    s->setMDNS(false);
+    if (keepAlive) {
+        s->enableKeepAlive(1, 60000);
+        s->keepAlive().setMaxRequests(60000);
+    }
+    s->begin();
+    s->_processJsonRpc(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})");
+    return s;
+}
+
+template <typename F>
+static double usPerRequest(size_t requests, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / (double)requests;
+}
+
+// One TCP connection per request, answered by WebServer and closed
+static double benchClose(int listenFd, uint16_t port, size_t requests) {
+    Server* s = startServer(false);
+    String req = request("close");
+    double us = usPerRequest(requests, [&]() {
+        for (size_t i = 0; i < requests; i++) {
+            int client = connectLoopback(port);
+            int server = acceptOne(listenFd);
+            writeAll(client, req);
+            char buf[1024];
+            std::string in;
+            while (in.find("\r\n\r\n") == std::string::npos || in.size() < req.length()) {
+                ssize_t got = read(server, buf, sizeof(buf));
+                if (got <= 0) break;
+                in.append(buf, (size_t)got);
+            }
+            s->_httpServer->_setBody(in.substr(in.find("\r\n\r\n") + 4).c_str());
+            s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+            String body = s->_httpServer->_responseBody;
+            writeAll(server, String("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n") +
+                             "Content-Length: " + String((int)body.length()) +
+                             "\r\nConnection: close\r\n\r\n" + body);
+            close(server);
+            std::string pending;
+            readResponses(client, 1, pending);
+            close(client);
+        }
+    });
+    s->stop();
+    delete s;
+    return us;
+}
+
+// One kept-alive connection; `depth` requests in flight at a time
+static double benchKeepAlive(int listenFd, uint16_t port, size_t requests, size_t depth) {
+    Server* s = startServer(true);
+    int client = connectLoopback(port);
+    int server = acceptOne(listenFd);
+    std::string pending;
+
+    // The first request arrives through WebServer and the socket is adopted
+    s->_httpServer->_setBody(PING);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+    HttpConnection* conn = &s->_keepAlive._connections[0];
+    pumpOut(server, *conn);
+    readResponses(client, 1, pending);
+
+    String batch;
+    for (size_t i = 0; i < depth; i++) batch += request("keep-alive");
+
+    double us = usPerRequest(requests, [&]() {
+        for (size_t done = 0; done < requests; done += depth) {
+            writeAll(client, batch);
+            size_t expected = batch.length(), got = 0;
+            while (got < expected) {
+                size_t n = pumpIn(server, *conn);
+                if (n == 0) continue;
+                got += n;
+            }
+            s->loop();
+            conn = &s->_keepAlive._connections[0];
+            pumpOut(server, *conn);
+            readResponses(client, depth, pending);
+        }
+    });
+    if (s->keepAlive().reusedRequests() < requests) {
+        printf("  (warning: only %lu requests reused the connection)\n",
+               s->keepAlive().reusedRequests());
+    }
+    close(server);
+    close(client);
+    s->stop();
+    delete s;
+    return us;
+}
+
+int main() {
+    const size_t REQUESTS = 4000;
+    uint16_t port = 0;
+    int listenFd = listenLoopback(port);
+
+    double closeUs = benchClose(listenFd, port, REQUESTS);
+    double keepUs = benchKeepAlive(listenFd, port, REQUESTS, 1);
+    double pipeUs = benchKeepAlive(listenFd, port, REQUESTS, 8);
+
+    printf("\n  Streamable HTTP, %u ping requests over loopback TCP\n\n", (unsigned)REQUESTS);
+    printf("  %-24s  %12s  %12s  %8s\n", "mode", "us/request", "requests/s", "speedup");
+    printf("  %-24s  %12.1f  %12.0f  %7.1fx\n", "connection per request",
+           closeUs, 1e6 / closeUs, 1.0);
+    printf("  %-24s  %12.1f  %12.0f  %7.1fx\n", "keep-alive",
+           keepUs, 1e6 / keepUs, closeUs / keepUs);
+    printf("  %-24s  %12.1f  %12.0f  %7.1fx\n", "keep-alive, pipelined x8",
+           pipeUs, 1e6 / pipeUs, closeUs / pipeUs);
+    printf("\n");
+
+    close(listenFd);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * mcpd — Tool lookup microbenchmark
+ *
+ * Compares the linear name scan that tools/call used to do against a
+ * ToolTable lookup, for increasing tool counts. Not part of `make test`;
+ * run with `make bench`.
+ */
+
+#include "arduino_mock.h"
+#include "mcpd.cpp"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace mcpd;
+
+static volatile long _sink = 0;
+
+static int linearFind(const std::vector<MCPTool>& tools, const String& name) {
+    for (size_t i = 0; i < tools.size(); i++) {
+        if (tools[i].name == name) return (int)i;
+    }
+    return -1;
+}
+
+template <typename F>
+static double nsPerOp(size_t ops, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (double)ops;
+}
+
+int main() {
+    const size_t counts[] = {8, 16, 32, 64, 106, 256};
+    const size_t ROUNDS = 20000;
+
+    printf("\n  Tool lookup (ns per lookup, average over all names)\n\n");
+    printf("  %6s  %12s  %12s  %8s\n", "tools", "linear", "table", "speedup");
+
+    for (size_t n : counts) {
+        std::vector<MCPTool> tools;
+        tools.reserve(n);
+        ToolTable table;
+        std::vector<String> names;
+        char buf[32];
+        for (size_t i = 0; i < n; i++) {
+            snprintf(buf, sizeof(buf), "builtin_tool_%u", (unsigned)i);
+            tools.emplace_back(buf, "", "{}", [](const JsonObject&) -> String { return "{}"; });
+            table.add(tools);
+            names.push_back(buf);
+        }
+
+        size_t ops = ROUNDS * n;
+        double linear = nsPerOp(ops, [&]() {
+            for (size_t r = 0; r < ROUNDS; r++)
+                for (const auto& name : names) _sink += linearFind(tools, name);
+        });
+        double hashed = nsPerOp(ops, [&]() {
+            for (size_t r = 0; r < ROUNDS; r++)
+                for (const auto& name : names) _sink += table.find(name.c_str(), tools);
+        });
+
+        printf("  %6u  %12.1f  %12.1f  %7.1fx\n",
+               (unsigned)n, linear, hashed, hashed > 0 ? linear / hashed : 0.0);
+    }
+    printf("\n");
+    return 0;
+}
@@ -318,6 +318,8 @@ public:
     void add(const std::string& s) { auto v = add(); v = s.c_str(); }
     void add(int val) { auto v = add(); v = val; }
     void add(long val) { auto v = add(); v = val; }
+    void add(unsigned int val) { auto v = add(); v = val; }
+    void add(unsigned long val) { auto v = add(); v = val; }
     void add(float val) { auto v = add(); v = (double)val; }
     void add(double val) { auto v = add(); v = val; }
     void add(bool val) { auto v = add(); v = val; }
@@ -655,6 +657,25 @@ inline auto serializeJson(const JsonDocument& doc, S& output) ->
     return tmp.size();
 }
 
+// serializeJson for a single value (ArduinoJson 7 accepts any variant)
+template<typename S>
+inline auto serializeJson(const JsonVariant& value, S& output) ->
+    typename std::enable_if<std::is_class<S>::value && !std::is_same<S, std::string>::value, size_t>::type {
+    std::string tmp;
+    _ajson_detail::serialize(tmp, value._node);
+    for (char c : tmp) output.write((uint8_t)c);
+    return tmp.size();
+}
+
+template<typename S>
+inline auto serializeJson(const JsonObject& obj, S& output) ->
+    typename std::enable_if<std::is_class<S>::value && !std::is_same<S, std::string>::value, size_t>::type {
+    std::string tmp;
+    _ajson_detail::serialize(tmp, obj._node);
+    for (char c : tmp) output.write((uint8_t)c);
+    return tmp.size();
+}
+
 inline size_t measureJson(const JsonDocument& doc) {
     std::string tmp;
     _ajson_detail::serialize(tmp, doc._root);
@@ -810,6 +831,10 @@ inline DeserializationError deserializeJson(JsonDocument& doc, const std::string
     return deserializeJson(doc, json.c_str());
 }
 
+inline DeserializationError deserializeJson(JsonDocument& doc, const char* json, size_t len) {
+    return deserializeJson(doc, std::string(json ? json : "", json ? len : 0));
+}
+
 // Support Arduino String
 template<typename S>
 inline auto deserializeJson(JsonDocument& doc, const S& input) ->
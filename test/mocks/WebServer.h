@@ -88,7 +88,7 @@ public:
         if (_serverFd < 0) return;
 
         struct pollfd pfd = { _serverFd, POLLIN, 0 };
-        int ret = poll(&pfd, 1, 5); // 5ms timeout
+        int ret = poll(&pfd, 1, 0); // Never wait: loop() has other sockets to serve
         if (ret <= 0) return;
 
         struct sockaddr_in clientAddr;
@@ -512,6 +512,145 @@ TEST(Audit_MixedActions) {
     ASSERT_EQ(log.currentSeq(), (uint32_t)8);
 }
 
+// ── Ring, intern table and detail arena ─────────────────────────────
+
+static String repeat(size_t n, char c) {
+    String s;
+    for (size_t i = 0; i < n; i++) s += c;
+    return s;
+}
+
+TEST(Audit_RingWrapsInOrder) {
+    AuditLog log(4);
+    for (int i = 0; i < 11; i++) {
+        log.logCustom("a", "t", String(i).c_str());
+    }
+    ASSERT_EQ((int)log.count(), 4);
+    uint32_t expect = 8;
+    for (const AuditEntry& e : log.entries()) {
+        ASSERT_EQ(e.seq, expect);
+        ASSERT(e.detail == String(expect - 1));
+        expect++;
+    }
+    ASSERT_EQ(expect, (uint32_t)12);
+}
+
+TEST(Audit_ActorsAreInterned) {
+    AuditLog log(16);
+    for (int i = 0; i < 10; i++) {
+        log.logToolCall(i % 2 ? "admin" : "guest", "gpio_write");
+    }
+    ASSERT_EQ((int)log.internedNames(), 3);
+    // Every entry points at the one stored copy
+    auto all = log.entries();
+    ASSERT(all[0].actor.c_str() == all[2].actor.c_str());
+    ASSERT(all[1].target.c_str() == all[9].target.c_str());
+}
+
+TEST(Audit_InternedNamesReleasedOnEviction) {
+    AuditLog log(2);
+    log.logToolCall("one", "x");
+    log.logToolCall("two", "x");
+    log.logToolCall("three", "x");
+    log.logToolCall("four", "x");
+    ASSERT_EQ((int)log.internedNames(), 3);          // three, four, x
+    ASSERT_EQ((int)log.byActor("one").size(), 0);
+    log.clear();
+    ASSERT_EQ((int)log.internedNames(), 0);
+    log.logToolCall("five", "y");
+    ASSERT_EQ((int)log.internedNames(), 2);
+    ASSERT_STR_EQ(log.entries()[0].actor.c_str(), "five");
+}
+
+TEST(Audit_DetailArenaEvictsOldest) {
+    AuditLog log(16, 64);
+    String d = repeat(15, 'd');                               // 16 bytes with the NUL
+    for (int i = 0; i < 4; i++) log.logCustom("a", "", d.c_str());
+    ASSERT_EQ((int)log.count(), 4);
+    ASSERT_EQ((int)log.detailBytesUsed(), 64);
+    log.logCustom("a", "", d.c_str());               // Needs the oldest one's bytes
+    ASSERT_EQ((int)log.count(), 4);
+    ASSERT_EQ(log.entries()[0].seq, (uint32_t)2);
+    log.logCustom("a", "", "");                      // No detail: nothing evicted
+    ASSERT_EQ((int)log.count(), 5);
+    for (const AuditEntry& e : log.last(5)) {
+        if (e.seq != 6) ASSERT(e.detail == d);
+    }
+}
+
+TEST(Audit_DetailArenaWrapsAround) {
+    AuditLog log(64, 100);
+    for (int i = 0; i < 200; i++) {
+        String d = String("detail-") + String(i) + repeat(i % 7, '.');
+        log.logCustom("a", "", d.c_str());
+        auto newest = log.last(1)[0];
+        ASSERT(newest.detail == d);
+        ASSERT_LE((int)log.detailBytesUsed(), 100);
+    }
+    // Whatever survived is intact and in order
+    uint32_t prev = 0;
+    for (const AuditEntry& e : log.entries()) {
+        ASSERT_GT(e.seq, prev);
+        String d = String("detail-") + String(e.seq - 1) + repeat((e.seq - 1) % 7, '.');
+        ASSERT(e.detail == d);
+        prev = e.seq;
+    }
+}
+
+TEST(Audit_LongDetailTruncated) {
+    AuditLog log(4, 40);
+    String d = repeat(100, 'x');
+    log.logCustom("a", "", d.c_str());
+    ASSERT_EQ((int)log.entries()[0].detail.length(), 10);   // A quarter of the arena
+}
+
+TEST(Audit_QueryViewsIterateInPlace) {
+    AuditLog log(8);
+    log.logToolCall("admin", "gpio_write");
+    log.logAccessDenied("guest", "gpio_write", "no");
+    log.logToolCall("guest", "adc_read");
+    int n = 0;
+    for (const AuditEntry& e : log.byActor("guest")) {
+        ASSERT(e.actor == "guest");
+        n++;
+    }
+    ASSERT_EQ(n, 2);
+    ASSERT(log.byActor("nobody").empty());
+    ASSERT(log.byTarget("adc_read")[0].seq == 3);
+    auto recent = log.last(2);
+    ASSERT_EQ((int)recent.size(), 2);
+    ASSERT_EQ(recent[0].seq, (uint32_t)2);
+    ASSERT_EQ((int)log.last(50).size(), 3);
+    ASSERT_EQ((int)log.last(0).size(), 0);
+}
+
+TEST(Audit_SetDetailBytesKeepsNewest) {
+    AuditLog log(8);
+    for (int i = 0; i < 6; i++) log.logCustom("a", "t", "0123456789");
+    log.setDetailBytes(40);                          // Room for three 11-byte details
+    ASSERT_EQ((int)log.count(), 3);
+    ASSERT_EQ(log.entries()[0].seq, (uint32_t)4);
+    ASSERT(log.entries()[2].detail == "0123456789");
+    ASSERT_EQ((int)log.internedNames(), 2);
+    log.setCapacity(2);
+    ASSERT_EQ(log.entries()[0].seq, (uint32_t)5);
+    ASSERT_EQ((int)log.detailBytesUsed(), 22);
+}
+
+TEST(Audit_CopyIsIndependent) {
+    AuditLog log(4, 64);
+    for (int i = 0; i < 6; i++) log.logCustom("a", "t", "detail");
+    AuditLog copy(log);
+    log.clear();
+    ASSERT_EQ((int)copy.count(), 4);
+    ASSERT(copy.entries()[3].detail == "detail");
+    ASSERT(copy.entries()[3].actor == "a");
+    copy.logCustom("b", "", "more");
+    ASSERT_EQ(copy.last(1)[0].seq, (uint32_t)7);
+    log = copy;
+    ASSERT_EQ((int)log.internedNames(), 3);
+}
+
 // ── main ───────────────────────────────────────────────────────────────
 
 int main() {
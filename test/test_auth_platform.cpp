@@ -12,6 +12,7 @@
  *   cd native && make test_auth_platform && ./test_auth_platform
  */
 
+#define MCPD_MOCK_COUNT_ALLOCS  // Metrics render allocation test
 #include "test_framework.h"
 #include "arduino_mock.h"
 #include "../src/mcpd.h"
@@ -453,6 +454,192 @@ TEST(metrics_uptime) {
     ASSERT(up >= 0);
 }
 
+TEST(latency_histogram_buckets) {
+    LatencyHistogram h;
+    h.record(10);       // <= 50
+    h.record(50);       // <= 50 (bounds are inclusive)
+    h.record(51);       // <= 100
+    h.record(20000000); // +Inf
+    ASSERT_EQ((int)h.count(), 4);
+    ASSERT_EQ((int)h.bucketCount(0), 2);
+    ASSERT_EQ((int)h.bucketCount(1), 1);
+    ASSERT_EQ((int)h.bucketCount(LatencyHistogram::BUCKETS), 1);
+    ASSERT_EQ((long long)h.sumUs(), 20000111LL);
+}
+
+TEST(latency_histogram_quantiles) {
+    LatencyHistogram h;
+    ASSERT_EQ((int)h.quantileUs(0.5), 0);
+    for (int i = 0; i < 90; i++) h.record(800);     // (500, 1000]
+    for (int i = 0; i < 10; i++) h.record(40000);   // (25000, 50000]
+    uint32_t p50 = h.quantileUs(0.50);
+    ASSERT(p50 > 500 && p50 <= 1000);
+    uint32_t p99 = h.quantileUs(0.99);
+    ASSERT(p99 > 25000 && p99 <= 50000);
+}
+
+TEST(histogram_table_overflow_goes_to_other) {
+    HistogramTable<2> t;
+    t.at("a").record(1);
+    t.at("b").record(1);
+    t.at("c").record(1);
+    t.at("d").record(1);
+    t.at("a").record(1);
+    ASSERT_EQ((int)t.size(), 3);
+    ASSERT_EQ((int)t.find("a")->count(), 2);
+    ASSERT(t.find("c") == nullptr);
+    ASSERT_STR_EQ(t.slot(2).label, "_other");
+    ASSERT_EQ((int)t.slot(2).histogram.count(), 2);
+}
+
+TEST(histogram_table_variants_are_separate) {
+    HistogramTable<4> t;
+    t.at("tool", 0).record(5);
+    t.at("tool", 1).record(5);
+    t.at("tool", 1).record(5);
+    ASSERT_EQ((int)t.find("tool", 0)->count(), 1);
+    ASSERT_EQ((int)t.find("tool", 1)->count(), 2);
+    ASSERT(t.find("tool", 2) == nullptr);
+}
+
+TEST(metrics_method_histogram_prometheus) {
+    Metrics metrics;
+    metrics.recordRequestMicros("tools/list", 120);
+    metrics.recordRequestMicros("tools/list", 3000);
+    metrics.recordRequest("ping", 2);  // ms overload feeds the histogram too
+    ASSERT_EQ((int)metrics.methodLatency("tools/list")->count(), 2);
+    ASSERT_EQ((int)metrics.methodLatency("ping")->sumUs(), 2000);
+    String out = metrics.render();
+    ASSERT_STR_CONTAINS(out.c_str(), "# TYPE mcpd_request_duration_microseconds histogram");
+    ASSERT_STR_CONTAINS(out.c_str(),
+        "mcpd_request_duration_microseconds_bucket{method=\"tools/list\",le=\"100\"} 0");
+    ASSERT_STR_CONTAINS(out.c_str(),
+        "mcpd_request_duration_microseconds_bucket{method=\"tools/list\",le=\"250\"} 1");
+    ASSERT_STR_CONTAINS(out.c_str(),
+        "mcpd_request_duration_microseconds_bucket{method=\"tools/list\",le=\"+Inf\"} 2");
+    ASSERT_STR_CONTAINS(out.c_str(), "mcpd_request_duration_microseconds_sum{method=\"tools/list\"} 3120");
+    ASSERT_STR_CONTAINS(out.c_str(), "mcpd_request_duration_microseconds_count{method=\"tools/list\"} 2");
+    ASSERT_STR_CONTAINS(out.c_str(), "mcpd_requests_by_method_total{method=\"ping\"} 1");
+}
+
+TEST(metrics_tool_label_escaped) {
+    Metrics metrics;
+    metrics.recordToolCall("we\"ird", ToolCallOutcome::Ok, 10);
+    String out = metrics.render();
+    ASSERT_STR_CONTAINS(out.c_str(), "tool=\"we\\\"ird\",outcome=\"ok\"");
+}
+
+TEST(metrics_tool_outcomes_from_server) {
+    Server server("m", 8080);
+    server.addTool("ok_tool", "d", R"({"type":"object"})",
+        [](const JsonObject&) -> String { _mockMicros() += 700; return "fine"; });
+    server.addRichTool("bad_tool", "d", R"({"type":"object"})",
+        [](const JsonObject&) -> MCPToolResult { return MCPToolResult::error("nope"); });
+    server.cache().setToolTTL("ok_tool", 10000);
+    server.enableCache();
+
+    server._processJsonRpc(R"({"jsonrpc":"2.0","id":1,"method":"tools/call","params":{"name":"ok_tool","arguments":{}}})");
+    server._processJsonRpc(R"({"jsonrpc":"2.0","id":2,"method":"tools/call","params":{"name":"ok_tool","arguments":{}}})");
+    server._processJsonRpc(R"({"jsonrpc":"2.0","id":3,"method":"tools/call","params":{"name":"bad_tool","arguments":{}}})");
+
+    const Metrics& m = server.metrics();
+    const LatencyHistogram* ok = m.toolLatency("ok_tool", ToolCallOutcome::Ok);
+    ASSERT(ok != nullptr);
+    ASSERT_EQ((int)ok->count(), 1);
+    ASSERT_EQ((int)ok->sumUs(), 700);
+    ASSERT_EQ((int)m.toolLatency("ok_tool", ToolCallOutcome::CacheHit)->count(), 1);
+    ASSERT_EQ((int)m.toolLatency("bad_tool", ToolCallOutcome::Error)->count(), 1);
+    ASSERT(m.toolLatency("bad_tool", ToolCallOutcome::Ok) == nullptr);
+    // The method histogram sees all three calls
+    ASSERT_EQ((int)m.methodLatency("tools/call")->count(), 3);
+}
+
+TEST(metrics_task_call_outcome) {
+    Server server("m", 8080);
+    server.enableTasks();
+    server.addTaskTool("slow", "d", R"({"type":"object"})",
+        [](const String&, JsonVariant) {});
+    server._processJsonRpc(R"({"jsonrpc":"2.0","id":1,"method":"tools/call","params":{"name":"slow","arguments":{},"task":{"ttl":1000}}})");
+    ASSERT(server.metrics().toolLatency("slow", ToolCallOutcome::Task) != nullptr);
+    ASSERT(server.metrics().toolLatency("slow", ToolCallOutcome::Ok) == nullptr);
+}
+
+// Writer/sink that only counts bytes, so it never allocates itself
+struct CountingWriter {
+    size_t bytes = 0;
+    size_t write(const uint8_t*, size_t len) { bytes += len; return len; }
+};
+
+struct CountingSink : public ResponseSink {
+    size_t bytes = 0;
+    size_t chunks = 0;
+    void write(const char*, size_t len) override { bytes += len; chunks++; }
+};
+
+static void fillMetrics(Metrics& metrics) {
+    const char* methods[] = {"initialize", "tools/list", "tools/call", "resources/read", "ping"};
+    for (const char* m : methods) {
+        for (uint32_t us = 40; us < 2000000; us *= 3) metrics.recordRequestMicros(m, us);
+    }
+    metrics.recordToolCall("temperature_read", ToolCallOutcome::Ok, 900);
+    metrics.recordToolCall("temperature_read", ToolCallOutcome::CacheHit, 30);
+    metrics.recordToolCall("relay_set", ToolCallOutcome::Error, 1500);
+    metrics.recordError();
+    metrics.setSSEClients(2);
+    metrics.setListCacheStats(4, 1, 512);
+}
+
+TEST(metrics_render_does_not_allocate) {
+    Metrics metrics;
+    fillMetrics(metrics);
+    CountingWriter direct;
+    CountingSink sink;
+    ResponseWriter writer(sink);
+
+    size_t before = _mockAllocCount();
+    metrics.renderTo(direct);
+    metrics.renderTo(writer);
+    writer.end();
+    ASSERT_EQ((int)(_mockAllocCount() - before), 0);
+
+    // The hook is live: the String renderer does allocate
+    metrics.render();
+    ASSERT_GT((int)(_mockAllocCount() - before), 0);
+
+    ASSERT_GT((int)direct.bytes, 4000);
+    ASSERT_EQ((int)sink.bytes, (int)direct.bytes);
+    ASSERT_GT((int)sink.chunks, 1);
+}
+
+TEST(metrics_render_string_matches_stream) {
+    Metrics metrics;
+    fillMetrics(metrics);
+    CountingWriter direct;
+    metrics.renderTo(direct);
+    String text = metrics.render();
+    ASSERT_EQ((int)text.length(), (int)direct.bytes);
+    ASSERT_STR_CONTAINS(text.c_str(), "# TYPE mcpd_requests_total counter\nmcpd_requests_total ");
+    ASSERT_STR_CONTAINS(text.c_str(), "mcpd_errors_total 1\n\n");
+    ASSERT_STR_CONTAINS(text.c_str(), "mcpd_list_cache_bytes 512\n\n");
+    ASSERT_STR_CONTAINS(text.c_str(),
+        "mcpd_tool_call_duration_microseconds_count{tool=\"relay_set\",outcome=\"error\"} 1\n");
+}
+
+TEST(metrics_endpoint_streams_chunks) {
+    WebServer http(80);
+    Metrics metrics;
+    metrics.begin(http);
+    fillMetrics(metrics);
+    http._simulateRequest("/metrics", HTTP_GET);
+    ASSERT_EQ(http._responseCode, 200);
+    ASSERT_EQ(http._contentLength, CONTENT_LENGTH_UNKNOWN);
+    ASSERT_TRUE(http._chunkedFinished);
+    ASSERT_GT((int)http._chunkCount, 1);
+    ASSERT_STR_CONTAINS(http._lastContentType.c_str(), "text/plain; version=0.0.4");
+    ASSERT_STR_CONTAINS(http._responseBody.c_str(), "mcpd_wifi_rssi_dbm ");
+    ASSERT_EQ((int)http._responseBody.length(), (int)metrics.render().length());
+}
+
 // ═══════════════════════════════════════════════════════════════════════
 // Diagnostics Tool Tests
 // ═══════════════════════════════════════════════════════════════════════
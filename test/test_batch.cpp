@@ -0,0 +1,271 @@
+/**
+ * mcpd — JSON-RPC batch execution tests
+ *
+ * Item-by-item batch parsing, streamed batch responses, batch size and
+ * memory limits, and the read-only fast path.
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static int g_calls = 0;
+static size_t g_inFlight = 0;
+static Server* g_server = nullptr;
+
+static Server* makeServer() {
+    Server* s = new Server("batch-test");
+    s->setMDNS(false);
+    g_server = s;
+    g_calls = 0;
+    MCPTool reader("adc_read", "Read ADC", R"({"type":"object"})",
+        [](const JsonObject&) -> String {
+            g_calls++;
+            g_inFlight = g_server->_requestTracker.inFlightCount();
+            return "{\"pin\":34,\"value\":2048,\"voltage\":1.65,\"unit\":\"V\"}";
+        });
+    reader.markReadOnly();
+    s->addTool(reader);
+    s->addTool("gpio_write", "Write GPIO", R"({"type":"object"})",
+        [](const JsonObject&) -> String {
+            g_calls++;
+            g_inFlight = g_server->_requestTracker.inFlightCount();
+            return "ok";
+        });
+    return s;
+}
+
+static String call(int id, const char* tool, const char* meta = nullptr) {
+    String item = String(R"({"jsonrpc":"2.0","id":)") + String(id) +
+                  R"(,"method":"tools/call","params":{"name":")" + tool + "\"";
+    if (meta) item += String(",\"_meta\":") + meta;
+    return item + "}}";
+}
+
+static String batchOf(int n, const char* tool) {
+    String b = "[";
+    for (int i = 0; i < n; i++) {
+        if (i) b += ",";
+        b += call(i + 1, tool);
+    }
+    return b + "]";
+}
+
+static int countOf(const String& haystack, const char* needle) {
+    int n = 0;
+    for (int at = haystack.indexOf(needle); at >= 0; at = haystack.indexOf(needle, at + 1)) n++;
+    return n;
+}
+
+static void post(Server* s, const String& body) {
+    s->_httpServer->_setBody(body);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+}
+
+// ── BatchScanner ───────────────────────────────────────────────────────
+
+TEST(scanner_splits_items) {
+    String body = R"( [ {"a":"x,]}"} , [1,[2]] ,"q\"]",  42 ] )";
+    BatchScanner scan(body.c_str(), body.length());
+    ASSERT_EQ(scan.count(), 4);
+    const char* item;
+    size_t len;
+    std::vector<std::string> items;
+    while (scan.next(item, len)) items.emplace_back(item, len);
+    ASSERT_FALSE(scan.failed());
+    ASSERT_EQ((int)items.size(), 4);
+    ASSERT(items[0] == R"({"a":"x,]}"})");
+    ASSERT(items[1] == "[1,[2]]");
+    ASSERT(items[2] == R"("q\"]")");
+    ASSERT(items[3] == "42");
+}
+
+TEST(scanner_rejects_malformed) {
+    const char* bad[] = {
+        "[1,", "[1,,2]", "[,]", "[1,]", "[{]}", "[1] x", "[\"abc]", "[{\"a\":[}]",
+        "{\"id\":1}",
+    };
+    for (const char* b : bad) {
+        BatchScanner scan(b, strlen(b));
+        ASSERT_EQ(scan.count(), -1);
+    }
+    BatchScanner empty(" [ ] ", 5);
+    ASSERT_EQ(empty.count(), 0);
+}
+
+TEST(scanner_nesting_limit) {
+    String deep = "[";
+    for (size_t i = 0; i <= BatchScanner::MAX_DEPTH; i++) deep += "[";
+    for (size_t i = 0; i <= BatchScanner::MAX_DEPTH; i++) deep += "]";
+    deep += "]";
+    BatchScanner scan(deep.c_str(), deep.length());
+    ASSERT_EQ(scan.count(), -1);
+}
+
+// ── Limits ─────────────────────────────────────────────────────────────
+
+TEST(malformed_batch_is_parse_error) {
+    Server* s = makeServer();
+    String resp = s->_processJsonRpc(R"([{"jsonrpc":"2.0","id":1,"method":"ping"},)");
+    ASSERT_STR_CONTAINS(resp.c_str(), "-32700");
+    ASSERT(resp.startsWith("{"));
+    delete s;
+}
+
+TEST(bad_item_gets_its_own_parse_error) {
+    Server* s = makeServer();
+    String resp = s->_processJsonRpc(
+        R"([{"jsonrpc":"2.0","id":1,"method":"ping"},{"id":tru},{"jsonrpc":"2.0","id":3,"method":"ping"}])");
+    ASSERT(resp.startsWith("["));
+    ASSERT_STR_CONTAINS(resp.c_str(), "-32700");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"id\":1");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"id\":3");
+    delete s;
+}
+
+TEST(oversized_batch_rejected_before_running) {
+    Server* s = makeServer();
+    ASSERT_EQ((int)s->maxBatchSize(), (int)Server::DEFAULT_MAX_BATCH_SIZE);
+    s->setMaxBatchSize(4);
+    String resp = s->_processJsonRpc(batchOf(5, "gpio_write"));
+    ASSERT_STR_CONTAINS(resp.c_str(), "-32600");
+    ASSERT_STR_CONTAINS(resp.c_str(), "batch exceeds 4 items");
+    ASSERT_EQ(g_calls, 0);
+    resp = s->_processJsonRpc(batchOf(4, "gpio_write"));
+    ASSERT_EQ(g_calls, 4);
+    ASSERT_EQ(countOf(resp, "\"result\""), 4);
+    delete s;
+}
+
+TEST(memory_budget_bounds_collected_responses) {
+    Server* s = makeServer();
+    s->setBatchMemoryBudget(600);
+    String resp = s->_processJsonRpc(batchOf(20, "adc_read"));
+    int results = countOf(resp, "\"result\"");
+    int errors = countOf(resp, "Batch memory budget exceeded");
+    ASSERT_GT(results, 0);
+    ASSERT_GT(errors, 0);
+    ASSERT_EQ(results + errors, 20);
+    ASSERT_EQ(g_calls, results + 1);         // The request that crossed it ran
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"id\":20");
+    ASSERT(resp.endsWith("]"));
+    JsonDocument doc;
+    ASSERT(!deserializeJson(doc, resp));
+    ASSERT_EQ((int)doc.as<JsonArray>().size(), 20);
+    delete s;
+}
+
+// ── Streaming ──────────────────────────────────────────────────────────
+
+TEST(http_batch_streams_past_budget) {
+    Server* s = makeServer();
+    s->setBatchMemoryBudget(100);
+    s->begin();
+    post(s, batchOf(30, "adc_read"));
+    WebServer* http = s->_httpServer;
+    ASSERT_EQ(http->_responseCode, 200);
+    ASSERT_GT((int)http->_chunkCount, 1);
+    ASSERT_EQ(g_calls, 30);
+    ASSERT_STR_NOT_CONTAINS(http->_responseBody.c_str(), "budget");
+    JsonDocument doc;
+    ASSERT(!deserializeJson(doc, http->_responseBody));
+    JsonArray arr = doc.as<JsonArray>();
+    ASSERT_EQ((int)arr.size(), 30);
+    ASSERT_EQ(arr[29]["id"].as<int>(), 30);
+    s->stop();
+    delete s;
+}
+
+TEST(http_batch_mixes_streamed_and_string_responses) {
+    Server* s = makeServer();
+    s->begin();
+    post(s, String("[") + call(1, "adc_read") +
+            R"(,{"jsonrpc":"2.0","method":"notifications/initialized"},)" +
+            R"({"jsonrpc":"2.0","id":2,"method":"nope"},)" + call(3, "missing") + "]");
+    JsonDocument doc;
+    ASSERT(!deserializeJson(doc, s->_httpServer->_responseBody));
+    JsonArray arr = doc.as<JsonArray>();
+    ASSERT_EQ((int)arr.size(), 3);
+    ASSERT(!arr[0]["result"].isNull());
+    ASSERT_EQ(arr[1]["error"]["code"].as<int>(), -32601);
+    ASSERT_EQ(arr[2]["id"].as<int>(), 3);
+    s->stop();
+    delete s;
+}
+
+TEST(http_notification_batch_is_202) {
+    Server* s = makeServer();
+    s->begin();
+    post(s, R"([{"jsonrpc":"2.0","method":"notifications/initialized"}])");
+    ASSERT_EQ(s->_httpServer->_responseCode, 202);
+    ASSERT_EQ((int)s->_httpServer->_chunkCount, 0);
+    s->stop();
+    delete s;
+}
+
+// ── Read-only fast path ────────────────────────────────────────────────
+
+TEST(read_only_calls_skip_tracking) {
+    Server* s = makeServer();
+    s->_processJsonRpc(String("[") + call(1, "adc_read") + "," + call(2, "adc_read") + "]");
+    ASSERT_EQ((int)g_inFlight, 0);
+    ASSERT_EQ((int)s->_batch.readOnlyCalls, 2);
+
+    s->_processJsonRpc(String("[") + call(3, "gpio_write") + "]");
+    ASSERT_EQ((int)g_inFlight, 1);                  // Not read-only: tracked
+
+    s->_processJsonRpc(call(4, "adc_read"));
+    ASSERT_EQ((int)g_inFlight, 1);                  // Outside a batch: tracked
+
+    s->_processJsonRpc(String("[") + call(5, "adc_read", R"({"progressToken":"p"})") + "]");
+    ASSERT_EQ((int)g_inFlight, 1);                  // Progress token: tracked
+    ASSERT_EQ((int)s->_batch.readOnlyCalls, 0);
+    ASSERT_FALSE(s->_batch.active);
+    ASSERT_EQ((int)s->_requestTracker.inFlightCount(), 0);
+    delete s;
+}
+
+TEST(read_only_calls_reuse_rbac_decision) {
+    Server* s = makeServer();
+    AccessControl& ac = s->accessControl();
+    ac.addRole("viewer");
+    ac.mapKeyToRole("k1", "viewer");
+    ac.restrictTool("adc_read", {"viewer"});
+    ac.enable();
+    // The first call revokes the key; the calls that follow it in the
+    // same run keep the decision
+    MCPTool revoking("revoke_read", "Read and revoke", "{}",
+        [](const JsonObject&) -> String {
+            g_server->accessControl().unmapKey("k1");
+            return "1";
+        });
+    revoking.markReadOnly();
+    s->addTool(revoking);
+    ac.restrictTool("revoke_read", {"viewer"});
+    const char* meta = R"({"apiKey":"k1"})";
+
+    String resp = s->_processJsonRpc(String("[") + call(1, "revoke_read", meta) + "," +
+                                     call(2, "revoke_read", meta) + "]");
+    ASSERT_STR_NOT_CONTAINS(resp.c_str(), "Access denied");
+
+    ac.mapKeyToRole("k1", "viewer");
+    resp = s->_processJsonRpc(String("[") + call(1, "revoke_read", meta) + "," +
+                              call(2, "adc_read", meta) + "]");
+    ASSERT_STR_CONTAINS(resp.c_str(), "Access denied");   // Other tool: checked again
+
+    ac.mapKeyToRole("k1", "viewer");
+    resp = s->_processJsonRpc(String("[") + call(1, "revoke_read", meta) + "," +
+                              R"({"jsonrpc":"2.0","id":9,"method":"ping"},)" +
+                              call(2, "revoke_read", meta) + "]");
+    ASSERT_STR_CONTAINS(resp.c_str(), "Access denied");   // Run broken by ping
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
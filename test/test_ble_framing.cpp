@@ -0,0 +1,275 @@
+/**
+ * mcpd — BLE framing tests
+ *
+ * MTU-sized frames, windowed sending with flow control, reassembly and
+ * the throughput/latency counters, run against a loopback link.
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+#include "MCPBLEFraming.h"
+
+#include <climits>
+
+using namespace mcpd;
+
+// Link that hands every notification to a central-side reassembler
+struct Loopback : public BLELink {
+    BLEReassembler central;
+    std::vector<String> delivered;
+    std::vector<std::string> frames;
+    size_t budget = SIZE_MAX;  // Notifications accepted before refusing
+
+    bool notify(const uint8_t* data, size_t len) override {
+        if (budget == 0) return false;
+        budget--;
+        frames.emplace_back((const char*)data, len);
+        if (central.feed(data, len) == BLEReassembler::Result::Complete) {
+            delivered.push_back(String(central.message()));
+        }
+        return true;
+    }
+};
+
+// Pumps once per connection event until the queue is empty; returns the
+// time of the last event
+static unsigned long drain(BLEFramer& tx, BLELink& link, unsigned long t = 0) {
+    unsigned long last = t;
+    for (int i = 0; !tx.idle() && i < 100000; i++) {
+        if (tx.pump(link, t)) last = t;
+        t += tx.intervalUs();
+    }
+    return last;
+}
+
+static String filled(size_t n) {
+    String s;
+    for (size_t i = 0; i < n; i++) s += (char)('a' + i % 26);
+    return s;
+}
+
+static uint8_t gBle[3][600];
+
+static void frame(int slot, uint8_t header, const char* payload) {
+    gBle[slot][0] = header;
+    memcpy(gBle[slot] + 1, payload, strlen(payload));
+}
+
+// ── Framing ────────────────────────────────────────────────────────────
+
+TEST(frame_payload_follows_mtu) {
+    BLEFramer tx;
+    ASSERT_EQ((int)tx.framePayload(), 19);          // Before MTU exchange
+    tx.setMtu(185);
+    ASSERT_EQ((int)tx.framePayload(), 181);
+    tx.setMtu(10);
+    ASSERT_EQ((int)tx.mtu(), 23);
+    tx.setMtu(600);
+    ASSERT_EQ((int)tx.mtu(), 517);
+}
+
+TEST(short_message_is_single_frame) {
+    BLEFramer tx;
+    Loopback link;
+    tx.enqueue("{\"id\":1}", 0);
+    ASSERT_EQ((int)tx.pump(link, 0), 1);
+    ASSERT_EQ((int)link.frames.size(), 1);
+    ASSERT_EQ((uint8_t)link.frames[0][0], BLE_CHUNK_SINGLE);
+    ASSERT(link.delivered[0] == "{\"id\":1}");
+    ASSERT(tx.idle());
+}
+
+TEST(long_message_fills_each_frame) {
+    BLEFramer tx;
+    Loopback link;
+    tx.setMtu(185);
+    tx.setWindow(16, 7500);
+    String msg = filled(1000);
+    tx.enqueue(msg, 0);
+    drain(tx, link);
+    ASSERT_EQ((int)link.frames.size(), 6);          // ceil(1000 / 181)
+    ASSERT_EQ((uint8_t)link.frames[0][0], BLE_CHUNK_FIRST);
+    for (int i = 1; i < 5; i++) ASSERT_EQ((uint8_t)link.frames[i][0], BLE_CHUNK_CONTINUE);
+    ASSERT_EQ((uint8_t)link.frames[5][0], BLE_CHUNK_FINAL);
+    for (int i = 0; i < 5; i++) ASSERT_EQ((int)link.frames[i].size(), 182);
+    ASSERT_EQ((int)link.delivered.size(), 1);
+    ASSERT(link.delivered[0] == msg);
+}
+
+TEST(messages_delivered_in_order) {
+    BLEFramer tx;
+    Loopback link;
+    tx.setMtu(64);
+    tx.setWindow(3, 7500);
+    tx.enqueue(filled(100), 0);
+    tx.enqueue("second", 0);
+    tx.enqueue(filled(200), 0);
+    drain(tx, link);
+    ASSERT_EQ((int)link.delivered.size(), 3);
+    ASSERT(link.delivered[1] == "second");
+    ASSERT(link.delivered[2] == filled(200));
+    ASSERT_EQ((int)tx.txMessages(), 3);
+    ASSERT_EQ((int)tx.txBytes(), 306);
+}
+
+// ── Window and flow control ────────────────────────────────────────────
+
+TEST(window_limits_frames_per_event) {
+    BLEFramer tx;
+    Loopback link;
+    tx.setWindow(4, 7500);
+    tx.enqueue(filled(19 * 10), 0);
+    ASSERT_EQ((int)tx.pump(link, 0), 4);
+    ASSERT_EQ((int)tx.pump(link, 3000), 0);          // Same connection event
+    ASSERT_EQ((int)tx.pump(link, 7500), 4);
+    ASSERT_EQ((int)tx.pump(link, 15000), 2);
+    ASSERT(tx.idle());
+}
+
+TEST(refused_notification_is_retried) {
+    BLEFramer tx;
+    Loopback link;
+    tx.setWindow(4, 7500);
+    String msg = filled(19 * 6);
+    tx.enqueue(msg, 0);
+    link.budget = 2;
+    ASSERT_EQ((int)tx.pump(link, 0), 2);
+    ASSERT_EQ((int)tx.txRefused(), 1);
+    link.budget = SIZE_MAX;
+    ASSERT_EQ((int)tx.pump(link, 100), 0);           // Waits for the next event
+    drain(tx, link, 7500);
+    ASSERT_EQ((int)link.frames.size(), 6);
+    ASSERT(link.delivered[0] == msg);
+    ASSERT_EQ((int)link.central.rxDropped(), 0);
+}
+
+TEST(queue_bound_drops_new_messages) {
+    BLEFramer tx;
+    tx.setMaxQueueBytes(100);
+    ASSERT(tx.enqueue(filled(60), 0));
+    ASSERT_FALSE(tx.enqueue(filled(60), 0));
+    ASSERT_EQ((int)tx.txDropped(), 1);
+    ASSERT_EQ((int)tx.queuedBytes(), 60);
+    tx.clear();
+    ASSERT(tx.idle());
+    ASSERT_EQ((int)tx.queuedBytes(), 0);
+}
+
+TEST(latency_and_throughput_counters) {
+    BLEFramer tx;
+    Loopback link;
+    tx.setWindow(1, 20000);
+    tx.enqueue(filled(19 * 3), 0);
+    unsigned long last = drain(tx, link);
+    ASSERT_EQ((int)last, 40000);
+    ASSERT_EQ((int)tx.latencyLastUs(), 40000);
+    ASSERT_EQ((int)tx.latencyMaxUs(), 40000);
+    ASSERT_EQ((int)tx.txFrames(), 3);
+    // 57 bytes over the 40 ms the queue was busy
+    ASSERT_GE((int)tx.txBytesPerSecond(), 1424);
+    ASSERT_LE((int)tx.txBytesPerSecond(), 1426);
+    tx.enqueue("x", 100000);
+    drain(tx, link, 100000);
+    ASSERT_EQ((int)tx.latencyLastUs(), 0);
+    ASSERT_EQ((int)tx.latencyAvgUs(), 20000);
+}
+
+// ── Reassembly ─────────────────────────────────────────────────────────
+
+TEST(reassembler_rejects_out_of_sequence) {
+    BLEReassembler rx;
+    frame(0, BLE_CHUNK_CONTINUE, "abc");
+    ASSERT(rx.feed(gBle[0], 4) == BLEReassembler::Result::Dropped);
+    frame(0, 0x07, "abc");
+    ASSERT(rx.feed(gBle[0], 4) == BLEReassembler::Result::Dropped);
+    frame(0, BLE_CHUNK_FIRST, "abc");
+    ASSERT(rx.feed(gBle[0], 4) == BLEReassembler::Result::Partial);
+    frame(1, BLE_CHUNK_SINGLE, "xyz");                // Cuts the first message short
+    ASSERT(rx.feed(gBle[1], 4) == BLEReassembler::Result::Complete);
+    ASSERT_STR_EQ(rx.message(), "xyz");
+    ASSERT_EQ((int)rx.rxDropped(), 3);
+    ASSERT_EQ((int)rx.rxMessages(), 1);
+}
+
+TEST(reassembler_drops_oversized_message) {
+    BLEReassembler rx;
+    rx.reserve(8);
+    frame(0, BLE_CHUNK_FIRST, "12345");
+    frame(1, BLE_CHUNK_CONTINUE, "67890");
+    frame(2, BLE_CHUNK_FINAL, "!");
+    ASSERT(rx.feed(gBle[0], 6) == BLEReassembler::Result::Partial);
+    ASSERT(rx.feed(gBle[1], 6) == BLEReassembler::Result::Partial);
+    ASSERT(rx.feed(gBle[2], 2) == BLEReassembler::Result::Dropped);
+    frame(0, BLE_CHUNK_FIRST, "1234");
+    frame(1, BLE_CHUNK_FINAL, "5678");                // Exactly the limit
+    rx.feed(gBle[0], 5);
+    ASSERT(rx.feed(gBle[1], 5) == BLEReassembler::Result::Complete);
+    ASSERT_STR_EQ(rx.message(), "12345678");
+}
+
+TEST(reassembler_reuses_one_buffer) {
+    BLEReassembler rx;
+    rx.reserve(4096);
+    const char* buf = rx.message();
+    BLEFramer tx;
+    Loopback link;
+    tx.setMtu(100);
+    tx.setWindow(8, 7500);
+    for (int i = 0; i < 5; i++) tx.enqueue(filled(500 + i * 100), 0);
+    for (unsigned long t = 0; !tx.idle(); t += 7500) tx.pump(link, t);
+    for (const std::string& f : link.frames) {
+        if (rx.feed((const uint8_t*)f.data(), f.size()) == BLEReassembler::Result::Complete) {
+            ASSERT(rx.message() == buf);
+        }
+    }
+    ASSERT_EQ((int)rx.rxMessages(), 5);
+    ASSERT_EQ((int)rx.rxBytes(), 500 + 600 + 700 + 800 + 900);
+}
+
+// ── Throughput ─────────────────────────────────────────────────────────
+
+static unsigned long gDefaultUs = 0, gThroughputUs = 0;
+static size_t gListBytes = 0;
+
+TEST(throughput_mode_delivers_tools_list_faster) {
+    Server* s = new Server("ble-test");
+    s->setMDNS(false);
+    for (int i = 0; i < 32; i++) {
+        String name = String("sensor_") + String(i);
+        s->addTool(MCPTool(name.c_str(), "Read one sensor channel and return its value",
+            R"({"type":"object","properties":{"channel":{"type":"integer"}}})",
+            [](const JsonObject&) -> String { return "0"; }));
+    }
+    String list = s->_processJsonRpc(R"({"jsonrpc":"2.0","id":1,"method":"tools/list"})");
+    gListBytes = list.length();
+    ASSERT_GT((int)gListBytes, 4000);
+
+    // Defaults: 20-byte frames (no MTU exchange), one per 20 ms
+    BLEFramer slow;
+    Loopback a;
+    slow.enqueue(list, 0);
+    gDefaultUs = drain(slow, a);
+    ASSERT(a.delivered[0] == list);
+
+    // Throughput mode: 247-byte MTU (251-byte LL packets), 4 frames per 15 ms event
+    BLEFramer fast;
+    Loopback b;
+    fast.setMtu(247);
+    fast.setWindow(4, 15000);
+    fast.enqueue(list, 0);
+    gThroughputUs = drain(fast, b);
+    ASSERT(b.delivered[0] == list);
+    ASSERT_LE((int)(gThroughputUs * 40), (int)gDefaultUs);
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    printf("\n  tools/list (%zu bytes) over BLE: %.2f s as 20-byte frames one per 20 ms,\n"
+           "  %.3f s with a 247-byte MTU and 4 frames per 15 ms connection event\n",
+           gListBytes, gDefaultUs / 1e6, gThroughputUs / 1e6);
+    return _tests_failed > 0 ? 1 : 0;
+}
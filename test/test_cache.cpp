@@ -264,6 +264,264 @@ TEST(cache_entry_expired) {
     ASSERT_EQ((int)entry.remainingMs(), 0);
 }
 
+static ArgsDigest digestOf(const char* json) {
+    JsonDocument doc;
+    deserializeJson(doc, json);
+    return argsDigest(doc.as<JsonObject>());
+}
+
+TEST(args_digest_key_order_independent) {
+    ASSERT(digestOf("{\"a\":1,\"b\":2}") == digestOf("{\"b\":2,\"a\":1}"));
+    ASSERT(digestOf("{\"o\":{\"x\":true,\"y\":null}}") == digestOf("{\"o\":{\"y\":null,\"x\":true}}"));
+}
+
+TEST(args_digest_distinguishes_values) {
+    ASSERT(digestOf("{\"a\":1}") != digestOf("{\"a\":2}"));
+    ASSERT(digestOf("{\"a\":1}") != digestOf("{\"a\":\"1\"}"));
+    ASSERT(digestOf("{\"a\":true}") != digestOf("{\"a\":\"true\"}"));
+    ASSERT(digestOf("{\"a\":1,\"b\":2}") != digestOf("{\"a\":2,\"b\":1}"));
+    ASSERT(digestOf("{\"ab\":\"c\"}") != digestOf("{\"a\":\"bc\"}"));
+    ASSERT(digestOf("{\"a\":[1,2]}") != digestOf("{\"a\":[2,1]}"));
+    ASSERT(digestOf("{\"a\":[[1],[2]]}") != digestOf("{\"a\":[[1,2]]}"));
+    ASSERT(digestOf("{\"a\":{}}") != digestOf("{\"a\":[]}"));
+}
+
+TEST(args_digest_integral_float_matches_int) {
+    ASSERT(digestOf("{\"v\":1}") == digestOf("{\"v\":1.0}"));
+    ASSERT(digestOf("{\"v\":1}") != digestOf("{\"v\":1.5}"));
+}
+
+TEST(args_digest_missing_args_is_empty_object) {
+    JsonObject none;
+    none._node = nullptr;
+    ASSERT(argsDigest(none) == digestOf("{}"));
+    ASSERT(argsDigest(String("{}")) == digestOf("{}"));
+}
+
+TEST(args_digest_string_matches_object) {
+    ASSERT(argsDigest(String("{\"b\":2,\"a\":1}")) == digestOf("{\"a\":1,\"b\":2}"));
+    // Invalid JSON still gets a stable digest
+    ASSERT(argsDigest(String("{oops")) == argsDigest(String("{oops")));
+    ASSERT(argsDigest(String("{oops")) != argsDigest(String("{}")));
+}
+
+TEST(cache_key_order_shares_entry) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("t", 50000);
+    cache.put("t", "{\"a\":1,\"b\":2}", "v", false);
+    String result;
+    bool isError;
+    ASSERT(cache.get("t", "{\"b\":2,\"a\":1}", result, isError));
+    ASSERT(cache.get("t", digestOf("{\"b\":2,\"a\":1}"), result, isError));
+}
+
+TEST(cache_same_args_other_tool_not_shared) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("a", 50000);
+    cache.setToolTTL("b", 50000);
+    cache.put("a", "{}", "A", false);
+    String result;
+    bool isError;
+    ASSERT(!cache.get("b", "{}", result, isError));
+    ASSERT(cache.get("a", "{}", result, isError));
+    ASSERT_STR_EQ(result.c_str(), "A");
+}
+
+TEST(cache_put_same_key_replaces) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("temp", 50000);
+    cache.put("temp", "{}", "old", false);
+    cache.put("temp", "{}", "new", false);
+    ASSERT_EQ((int)cache.size(), 1);
+    String result;
+    bool isError;
+    ASSERT(cache.get("temp", "{}", result, isError));
+    ASSERT_STR_EQ(result.c_str(), "new");
+}
+
+TEST(cache_lru_eviction_keeps_recently_used) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setMaxEntries(3);
+    cache.setToolTTL("t", 500000);
+    cache.put("t", "{\"id\":1}", "v1", false);
+    cache.put("t", "{\"id\":2}", "v2", false);
+    cache.put("t", "{\"id\":3}", "v3", false);
+
+    String result;
+    bool isError;
+    ASSERT(cache.get("t", "{\"id\":1}", result, isError));  // 1 is now most recent
+
+    cache.put("t", "{\"id\":4}", "v4", false);  // evicts 2
+    ASSERT(cache.get("t", "{\"id\":1}", result, isError));
+    ASSERT(!cache.get("t", "{\"id\":2}", result, isError));
+    ASSERT(cache.get("t", "{\"id\":3}", result, isError));
+    ASSERT_EQ((int)cache.evictions(), 1);
+}
+
+TEST(cache_byte_budget_evicts) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("t", 500000);
+    // Each entry costs 1 (name) + 10 (result) = 11 bytes
+    cache.setMaxBytes(30);
+    cache.put("t", "{}", "0123456789", false);
+    cache.put("t", "[]", "0123456789", false);
+    ASSERT_EQ((int)cache.bytes(), 22);
+    cache.put("t", "\"\"", "0123456789", false);
+    ASSERT_EQ((int)cache.size(), 2);
+    ASSERT_LE((int)cache.bytes(), 30);
+
+    String result;
+    bool isError;
+    ASSERT(!cache.get("t", "{}", result, isError));  // Oldest went first
+}
+
+TEST(cache_byte_budget_rejects_oversized) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("cam", 500000);
+    cache.setMaxBytes(64);
+    cache.put("cam", "{}", String("small"), false);
+    std::string big(200, 'x');
+    cache.put("cam", "{\"hi\":1}", String(big.c_str()), false);
+    ASSERT_EQ((int)cache.size(), 1);
+    String result;
+    bool isError;
+    ASSERT(cache.get("cam", "{}", result, isError));
+}
+
+TEST(cache_set_max_bytes_shrinks) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("t", 500000);
+    cache.put("t", "{}", "0123456789", false);
+    cache.put("t", "[]", "0123456789", false);
+    cache.setMaxBytes(11);
+    ASSERT_EQ((int)cache.size(), 1);
+    ASSERT_EQ((int)cache.bytes(), 11);
+}
+
+TEST(cache_index_survives_churn) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setMaxEntries(16);
+    cache.setToolTTL("t", 500000);
+    String result;
+    bool isError;
+    // Insert/remove in patterns that exercise probe chains and backward shift
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 16; i++) {
+            cache.put("t", String("{\"k\":") + String(round * 16 + i) + "}", String(i), false);
+        }
+        for (int i = 0; i < 16; i += 2) {
+            cache.invalidate("t", String("{\"k\":") + String(round * 16 + i) + "}");
+        }
+        for (int i = 1; i < 16; i += 2) {
+            ASSERT(cache.get("t", String("{\"k\":") + String(round * 16 + i) + "}", result, isError));
+            ASSERT_STR_EQ(result.c_str(), String(i).c_str());
+        }
+    }
+    ASSERT_LE((int)cache.size(), 16);
+}
+
+TEST(cache_expired_entry_frees_slot) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("t", 100);
+    cache.put("t", "{}", "v", false);
+    _mockMillis() += 150;
+    String result;
+    bool isError;
+    ASSERT(!cache.get("t", "{}", result, isError));
+    ASSERT_EQ((int)cache.size(), 0);
+    ASSERT_EQ((int)cache.bytes(), 0);
+}
+
+TEST(cache_stats_json_has_bytes) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setMaxBytes(1024);
+    String json = cache.statsJson();
+    ASSERT_STR_CONTAINS(json.c_str(), "\"maxBytes\":1024");
+    ASSERT_STR_CONTAINS(json.c_str(), "\"bytes\":0");
+    ASSERT_STR_CONTAINS(json.c_str(), "\"evictions\":0");
+}
+
+TEST(cache_stale_while_revalidate_lookup) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("dht", 1000);
+    ASSERT(cache.setStaleWhileRevalidate("dht", 5000));
+    ArgsDigest key = argsDigest(String("{}"));
+    cache.put("dht", key, "21", false);
+
+    String result;
+    bool isError;
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::Hit);
+
+    _mockMillis() += 1500;  // Past TTL, inside stale window
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::HitRefresh);
+    ASSERT_STR_EQ(result.c_str(), "21");
+    // Later callers are coalesced onto the pending refresh
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::Hit);
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::Hit);
+    ASSERT_EQ((int)cache.refreshes(), 1);
+    ASSERT_EQ((int)cache.coalesced(), 2);
+    ASSERT_EQ((int)cache.staleHits(), 3);
+    // get() only reports fresh entries
+    ASSERT(!cache.get("dht", key, result, isError));
+
+    cache.put("dht", key, "22", false);  // Refresh lands
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::Hit);
+    ASSERT_STR_EQ(result.c_str(), "22");
+}
+
+TEST(cache_stale_window_expires) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("dht", 1000);
+    cache.setStaleWhileRevalidate("dht", 1000);
+    ArgsDigest key = argsDigest(String("{}"));
+    cache.put("dht", key, "21", false);
+    _mockMillis() += 2500;
+    String result;
+    bool isError;
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::Miss);
+    ASSERT_EQ((int)cache.size(), 0);
+}
+
+TEST(cache_refresh_ahead_lookup) {
+    ToolResultCache cache;
+    cache.setEnabled(true);
+    cache.setToolTTL("dht", 1000);
+    ASSERT(cache.setRefreshAhead("dht", 80));
+    ArgsDigest key = argsDigest(String("{}"));
+    cache.put("dht", key, "21", false);
+    String result;
+    bool isError;
+    _mockMillis() += 700;
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::Hit);
+    _mockMillis() += 100;
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::HitRefresh);
+    ASSERT_EQ((int)cache.staleHits(), 0);
+    cache.endRefresh("dht", key);  // Abandoned: next lookup may retry
+    ASSERT(cache.lookup("dht", key, result, isError) == CacheLookup::HitRefresh);
+}
+
+TEST(cache_policy_requires_ttl) {
+    ToolResultCache cache;
+    ASSERT(!cache.setStaleWhileRevalidate("nope", 1000));
+    ASSERT(!cache.setRefreshAhead("nope", 50));
+    cache.setToolTTL("t", 100);
+    cache.setRefreshAhead("t", 150);
+    ASSERT_EQ((int)cache.getToolPolicy("t")->refreshAheadPercent, 99);
+    ASSERT(cache.getToolPolicy("nope") == nullptr);
+}
+
 // ── Integration Tests: Server with Cache ────────────────────────────────
 
 TEST(server_cache_disabled_by_default) {
@@ -448,6 +706,113 @@ TEST(server_cache_with_rich_tool) {
     ASSERT_EQ(callCount, 1);
 }
 
+TEST(server_cache_hit_ignores_key_order) {
+    Server server("test");
+    int callCount = 0;
+    server.addTool("temp", "Read", R"({"type":"object"})",
+        [&](const JsonObject&) -> String { callCount++; return "22"; });
+    server.cache().setToolTTL("temp", 50000);
+    server.enableCache();
+
+    server._processJsonRpc(R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"temp","arguments":{"unit":"C","pin":4}},"id":1})");
+    server._processJsonRpc(R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"temp","arguments":{"pin":4,"unit":"C"}},"id":2})");
+    ASSERT_EQ(callCount, 1);
+
+    // Missing arguments and {} share an entry too
+    server._processJsonRpc(R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"temp"},"id":3})");
+    server._processJsonRpc(R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"temp","arguments":{}},"id":4})");
+    ASSERT_EQ(callCount, 2);
+}
+
+TEST(server_cache_invalidate_by_json_matches_call) {
+    Server server("test");
+    int callCount = 0;
+    server.addTool("temp", "Read", R"({"type":"object"})",
+        [&](const JsonObject&) -> String { callCount++; return "22"; });
+    server.cache().setToolTTL("temp", 50000);
+    server.enableCache();
+
+    String req = R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"temp","arguments":{"a":1,"b":2}},"id":1})";
+    server._processJsonRpc(req);
+    server.cache().invalidate("temp", "{\"b\":2,\"a\":1}");
+    server._processJsonRpc(req);
+    ASSERT_EQ(callCount, 2);
+}
+
+TEST(server_cache_serves_stale_and_refreshes_once) {
+    Server server("test");
+    int reads = 0;
+    server.addTool("dht_read", "Read DHT", R"({"type":"object"})",
+        [&](const JsonObject&) -> String {
+            reads++;
+            return String("{\"t\":") + String(20 + reads) + "}";
+        });
+    server.cache().setToolTTL("dht_read", 2000);
+    server.cache().setStaleWhileRevalidate("dht_read", 10000);
+    server.enableCache();
+
+    String req = R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"dht_read","arguments":{"pin":4}},"id":1})";
+    server._processJsonRpc(req);
+    ASSERT_EQ(reads, 1);
+
+    _mockMillis() += 3000;
+    // Three callers in the same loop: all get the stale value, no reads yet
+    for (int i = 0; i < 3; i++) {
+        String resp = server._processJsonRpc(req);
+        ASSERT_STR_CONTAINS(resp.c_str(), "21");
+    }
+    ASSERT_EQ(reads, 1);
+
+    server._scheduler.loop();  // One background read
+    ASSERT_EQ(reads, 2);
+    server._scheduler.loop();
+    ASSERT_EQ(reads, 2);
+
+    String resp = server._processJsonRpc(req);
+    ASSERT_STR_CONTAINS(resp.c_str(), "22");
+    ASSERT_EQ(reads, 2);
+}
+
+TEST(server_cache_refresh_ahead_keeps_hits_fresh) {
+    Server server("test");
+    int reads = 0;
+    server.addTool("dht_read", "Read DHT", R"({"type":"object"})",
+        [&](const JsonObject&) -> String { reads++; return String(reads); });
+    server.cache().setToolTTL("dht_read", 1000);
+    server.cache().setRefreshAhead("dht_read", 80);
+    server.enableCache();
+
+    String req = R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"dht_read","arguments":{}},"id":1})";
+    for (int step = 0; step < 5; step++) {
+        server._processJsonRpc(req);
+        server._scheduler.loop();
+        _mockMillis() += 850;
+    }
+    // First call plus one refresh per TTL period, never a blocking miss
+    ASSERT_EQ(reads, 5);
+    ASSERT_EQ((int)server.cache().misses(), 5);
+    ASSERT_EQ((int)server.cache().hits(), 4);
+}
+
+TEST(server_cache_refresh_dropped_for_removed_tool) {
+    Server server("test");
+    int reads = 0;
+    server.addTool("dht_read", "Read DHT", R"({"type":"object"})",
+        [&](const JsonObject&) -> String { reads++; return "x"; });
+    server.cache().setToolTTL("dht_read", 1000);
+    server.cache().setStaleWhileRevalidate("dht_read", 5000);
+    server.enableCache();
+
+    String req = R"({"jsonrpc":"2.0","method":"tools/call","params":{"name":"dht_read","arguments":{}},"id":1})";
+    server._processJsonRpc(req);
+    _mockMillis() += 1500;
+    server._processJsonRpc(req);
+    server.removeTool("dht_read");
+    server._scheduler.loop();
+    ASSERT_EQ(reads, 1);
+    ASSERT_EQ((int)server._cacheRefreshes.size(), 0);
+}
+
 // ═══════════════════════════════════════════════════════════════════════
 
 int main() {
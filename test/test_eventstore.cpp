@@ -493,6 +493,234 @@ TEST(EventStore_IsFullTransition) {
     ASSERT_TRUE(store.isFull());
 }
 
+// ── Cursors ────────────────────────────────────────────────────────────
+
+struct ByteSink {
+    std::string out;
+    size_t writes = 0;
+    size_t write(const uint8_t* data, size_t len) {
+        out.append((const char*)data, len);
+        writes++;
+        return len;
+    }
+};
+
+static void fill(EventStore& store, int n) {
+    for (int i = 0; i < n; i++) {
+        store.emit(i % 3 == 0 ? "gpio" : "temp", String(i),
+                   i % 4 == 0 ? EventSeverity::Error : EventSeverity::Info);
+    }
+}
+
+TEST(EventStore_CursorComposesFilters) {
+    EventStore store(32);
+    fill(store, 20);
+    size_t n = store.select().tag("gpio").minSeverity(EventSeverity::Error).count();
+    ASSERT_EQ((int)n, 2);                            // seq 0 and 12
+    std::vector<uint32_t> seqs;
+    store.select().tag("gpio").minSeverity(EventSeverity::Error)
+        .forEach([&seqs](const Event& e) { seqs.push_back(e.seq); return true; });
+    ASSERT_EQ((int)seqs.size(), 2);
+    ASSERT_EQ((int)seqs[1], 12);
+}
+
+TEST(EventStore_CursorForEachStopsEarly) {
+    EventStore store(32);
+    fill(store, 20);
+    int visited = 0;
+    size_t n = store.select().forEach([&visited](const Event& e) {
+        visited++;
+        return e.seq < 4;
+    });
+    ASSERT_EQ(visited, 5);
+    ASSERT_EQ((int)n, 5);
+}
+
+TEST(EventStore_CursorOffsetAndLimit) {
+    EventStore store(32);
+    fill(store, 20);
+    auto c = store.select().tag("temp").offset(2).limit(3);
+    ASSERT_EQ((int)c.count(), 3);
+    ASSERT(c.next());
+    ASSERT_EQ((int)c->seq, 4);                       // temp: 1, 2, [4, 5, 7], 8...
+    ASSERT(c.next());
+    ASSERT(c.next());
+    ASSERT_EQ((int)c.event().seq, 7);
+    ASSERT_FALSE(c.next());
+    ASSERT_FALSE(c.next());
+    c.rewind();
+    ASSERT(c.next());
+    ASSERT_EQ((int)c->seq, 4);
+}
+
+TEST(EventStore_CursorSinceSeqAcrossWrap) {
+    EventStore store(8);
+    fill(store, 30);                                 // Holds seq 22..29
+    ASSERT_EQ((int)store.select().sinceSeq(0).count(), 8);
+    ASSERT_EQ((int)store.select().sinceSeq(27).count(), 3);
+    ASSERT_EQ((int)store.select().sinceSeq(30).count(), 0);
+    ASSERT_EQ((int)store.select().sinceSeq(1000).count(), 0);
+    auto c = store.select().sinceSeq(25);
+    ASSERT(c.next());
+    ASSERT_EQ((int)c->seq, 25);
+    ASSERT(c->data == "25");
+}
+
+TEST(EventStore_CursorLastComposes) {
+    EventStore store(16);
+    fill(store, 12);
+    ASSERT_EQ((int)store.select().last(5).count(), 5);
+    ASSERT_EQ((int)store.select().last(5).tag("gpio").count(), 1);   // seq 7..11: only 9
+    ASSERT_EQ((int)store.select().tag("gpio").last(5).count(), 1);   // Order does not matter
+}
+
+TEST(EventStore_CursorReadsInPlace) {
+    EventStore store(8);
+    store.emit("t", "payload");
+    const char* stored = nullptr;
+    store.select().forEach([&stored](const Event& e) { stored = e.data.c_str(); return true; });
+    auto c = store.select();
+    ASSERT(c.next());
+    ASSERT(c->data.c_str() == stored);               // Same storage, not a copy
+}
+
+TEST(EventStore_WriteJSONMatchesToJSON) {
+    EventStore store(8);
+    store.emit("temp", "{\"v\":1}");
+    store.emit("gpio", "high", EventSeverity::Warning);
+    store.emit("temp", "[1,2]");
+    ByteSink sink;
+    size_t bytes = store.select().writeJSON(sink);
+    ASSERT_STR_EQ(sink.out.c_str(), store.toJSON(store.all()).c_str());
+    ASSERT_EQ(bytes, sink.out.size());
+    ASSERT_STR_EQ(store.toJSON().c_str(), sink.out.c_str());
+
+    ByteSink filtered;
+    store.select().tag("temp").limit(1).writeJSON(filtered);
+    ASSERT_STR_EQ(filtered.out.c_str(), store.toJSON(store.select().tag("temp").limit(1)).c_str());
+    ASSERT_STR_CONTAINS(filtered.out.c_str(), "\"data\":{\"v\":1}");
+    ASSERT_STR_NOT_CONTAINS(filtered.out.c_str(), "[1,2]");
+
+    ByteSink empty;
+    store.select().tag("none").writeJSON(empty);
+    ASSERT_STR_EQ(empty.out.c_str(), "[]");
+}
+
+// ── Tag index and severity bitmap ─────────────────────────────────────
+
+// Reference answer: filter a copy of every event
+static std::vector<uint32_t> bruteForce(const EventStore& store, const char* tag, EventSeverity min) {
+    std::vector<uint32_t> seqs;
+    for (const Event& e : store.all()) {
+        if (tag && e.tag != tag) continue;
+        if ((uint8_t)e.severity < (uint8_t)min) continue;
+        seqs.push_back(e.seq);
+    }
+    return seqs;
+}
+
+static std::vector<uint32_t> viaCursor(EventStore::Cursor c) {
+    std::vector<uint32_t> seqs;
+    c.forEach([&seqs](const Event& e) { seqs.push_back(e.seq); return true; });
+    return seqs;
+}
+
+TEST(EventStore_TagIsOneByteId) {
+    EventStore store(8);
+    store.emit("temperature", "1");
+    store.emit("temperature", "2");
+    auto events = store.all();
+    ASSERT_EQ((int)sizeof(events[0].tag), 1);
+    ASSERT(events[0].tag == events[1].tag);
+    ASSERT(events[0].tag.c_str() == events[1].tag.c_str());   // One interned copy
+    ASSERT(events[0].tag == "temperature");
+    ASSERT(events[0].tag != String("gpio"));
+}
+
+TEST(EventStore_TagChainsSurviveWraparound) {
+    EventStore store(16);
+    const char* tags[] = {"a", "b", "c", "d", "e"};
+    for (int i = 0; i < 203; i++) {
+        store.emit(tags[(i * 7) % 5], String(i), (EventSeverity)(i % 5));
+        if (i % 17 == 0 || i > 190) {
+            for (const char* t : tags) {
+                ASSERT(viaCursor(store.select().tag(t)) == bruteForce(store, t, EventSeverity::Debug));
+                ASSERT(viaCursor(store.select().tag(t).minSeverity(EventSeverity::Warning)) ==
+                       bruteForce(store, t, EventSeverity::Warning));
+            }
+        }
+    }
+    ASSERT_EQ((int)store.byTag("c").size(), (int)bruteForce(store, "c", EventSeverity::Debug).size());
+}
+
+TEST(EventStore_SeverityBitmapAcrossWords) {
+    EventStore store(100);                               // Four bitmap words, last one partial
+    for (int i = 0; i < 357; i++) {
+        // Errors are rare and clustered
+        EventSeverity sev = (i % 41 == 0 || i % 97 < 2) ? EventSeverity::Error : EventSeverity::Debug;
+        if (i % 150 == 0) sev = EventSeverity::Critical;
+        store.emit("s", String(i), sev);
+        for (uint8_t m = 0; m <= 4; m++) {
+            ASSERT(viaCursor(store.select().minSeverity((EventSeverity)m)) ==
+                   bruteForce(store, nullptr, (EventSeverity)m));
+        }
+    }
+    auto c = store.select().minSeverity(EventSeverity::Error).sinceSeq(300);
+    ASSERT(viaCursor(c).front() >= 300);
+}
+
+TEST(EventStore_EvictedTagLeavesIndex) {
+    EventStore store(4);
+    store.emit("once", "x");
+    for (int i = 0; i < 4; i++) store.emit("many", String(i));
+    ASSERT_EQ((int)store.select().tag("once").count(), 0);
+    auto tags = store.tags();
+    ASSERT_EQ((int)tags.size(), 1);
+    ASSERT(tags[0] == "many");
+    ASSERT_EQ(EventTag::find("once"), -1);                // Released with the event
+}
+
+TEST(EventStore_TagsOrderedByOldestEvent) {
+    EventStore store(4);
+    store.emit("x", "1");
+    store.emit("y", "2");
+    store.emit("x", "3");
+    store.emit("z", "4");
+    store.emit("y", "5");                                 // Evicts the first x
+    auto tags = store.tags();
+    ASSERT_EQ((int)tags.size(), 3);
+    ASSERT(tags[0] == "y");
+    ASSERT(tags[1] == "x");
+    ASSERT(tags[2] == "z");
+}
+
+TEST(EventStore_CopiedEventsKeepTheirTag) {
+    size_t before = EventTag::internedCount();
+    std::vector<Event> copies;
+    {
+        EventStore store(4);
+        store.emit("ephemeral", "1");
+        copies = store.all();
+        store.clear();
+        ASSERT_EQ((int)store.select().tag("ephemeral").count(), 0);
+    }
+    ASSERT(copies[0].tag == "ephemeral");
+    ASSERT_EQ(EventTag::internedCount(), before + 1);
+    copies.clear();
+    ASSERT_EQ(EventTag::internedCount(), before);
+}
+
+TEST(EventStore_TagTableOverflowStoresEmptyTag) {
+    EventStore store(300);
+    uint32_t overflowsBefore = EventTag::overflows();
+    size_t room = EventTag::MAX_TAGS - 1 - EventTag::internedCount();
+    for (size_t i = 0; i < room + 3; i++) store.emit(String("tag") + String((int)i), "v");
+    ASSERT_EQ((int)(EventTag::overflows() - overflowsBefore), 3);
+    ASSERT_EQ((int)store.select().tag("").count(), 3);
+    store.clear();
+    ASSERT_EQ((int)EventTag::internedCount(), (int)(EventTag::MAX_TAGS - 1 - room));
+}
+
 // ── Run all ────────────────────────────────────────────────────────────
 
 int main() {
@@ -0,0 +1,247 @@
+/**
+ * mcpd — Readiness poller / non-blocking connection loop tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static const char* UPGRADE =
+    "GET /mcp HTTP/1.1\r\nHost: esp32\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+
+// Masked client→server text frame (payloads < 126 bytes)
+static String clientFrame(const String& payload) {
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    String f;
+    f += (char)0x81;
+    f += (char)(0x80 | payload.length());
+    for (uint8_t m : mask) f += (char)m;
+    for (size_t i = 0; i < payload.length(); i++) f += (char)(payload[i] ^ mask[i % 4]);
+    return f;
+}
+
+static WSClient& connectWS(WebSocketTransport& ws, const IOPoller* io = nullptr) {
+    ws._server->_queueClient(WiFiClient());
+    ws.loop(io);
+    WSClient& c = ws._clients.back();
+    c.tcp.pushIncoming(UPGRADE);
+    ws.loop(io);
+    c.tcp.clearBuffer();
+    return c;
+}
+
+// ── IOPoller ───────────────────────────────────────────────────────────
+
+TEST(poller_reports_readable_and_hangup) {
+    IOPoller io;
+    WiFiClient quiet, data, gone;
+    data.pushIncoming("x");
+    gone.setConnected(false);
+    io.reset();
+    int a = io.add(quiet, IOPoller::READ);
+    int b = io.add(data, IOPoller::READ);
+    int c = io.add(gone, IOPoller::READ | IOPoller::WRITE);
+    ASSERT_EQ((int)io.poll(), 2);
+    ASSERT_FALSE(io.readable(a));
+    ASSERT(io.readable(b));
+    ASSERT(io.readable(c));       // Hang-up is a read event
+    ASSERT_FALSE(io.writable(c));
+}
+
+TEST(poller_write_interest) {
+    IOPoller io;
+    WiFiClient client;
+    io.reset();
+    int slot = io.add(client, IOPoller::READ | IOPoller::WRITE);
+    ASSERT_EQ((int)io.poll(), 1);
+    ASSERT(io.writable(slot));
+    ASSERT_FALSE(io.readable(slot));
+}
+
+TEST(poller_counts_idle_passes) {
+    IOPoller io;
+    WiFiClient a, b;
+    for (int i = 0; i < 3; i++) {
+        io.reset();
+        io.add(a, IOPoller::READ);
+        io.add(b, IOPoller::READ);
+        io.poll();
+    }
+    ASSERT_EQ((int)io.passes(), 3);
+    ASSERT_EQ((int)io.idlePasses(), 3);
+    b.pushIncoming("x");
+    io.reset();
+    io.add(a, IOPoller::READ);
+    io.add(b, IOPoller::READ);
+    io.poll();
+    ASSERT_EQ((int)io.idlePasses(), 3);
+    ASSERT_EQ((int)io.events(), 1);
+}
+
+TEST(poller_unregistered_and_overflow_are_ready) {
+    IOPoller io;
+    WiFiClient clients[IOPoller::MAX_ENTRIES + 1];
+    io.reset();
+    for (size_t i = 0; i < IOPoller::MAX_ENTRIES; i++) {
+        ASSERT_EQ(io.add(clients[i], IOPoller::READ), (int)i);
+    }
+    int extra = io.add(clients[IOPoller::MAX_ENTRIES], IOPoller::READ);
+    ASSERT_EQ(extra, -1);
+    io.poll();
+    ASSERT(io.readable(extra));
+    ASSERT_FALSE(io.readable(0));
+}
+
+// ── WebSocket state machine ────────────────────────────────────────────
+
+TEST(ws_handshake_across_loops) {
+    WebSocketTransport ws(8081);
+    ws.begin();
+    ws._server->_queueClient(WiFiClient());
+    ws.loop();
+    ASSERT_EQ((int)ws.clientCount(), 1);
+    WSClient& c = ws._clients[0];
+    String req = UPGRADE;
+    c.tcp.pushIncoming(req.substring(0, 40));
+    ws.loop();
+    ASSERT_FALSE(c.handshakeDone);
+    ASSERT_EQ((int)c.tcp.getBuffer().length(), 0);
+    c.tcp.pushIncoming(req.substring(40));
+    ws.loop();
+    ASSERT(c.handshakeDone);
+    String out = c.tcp.getBuffer();
+    ASSERT(out.startsWith("HTTP/1.1 101 Switching Protocols\r\n"));
+    ASSERT_STR_CONTAINS(out.c_str(), "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n");
+}
+
+TEST(ws_half_open_handshake_dropped) {
+    WebSocketTransport ws(8081);
+    ws.begin();
+    ws._server->_queueClient(WiFiClient());
+    ws.loop();
+    ws._clients[0].tcp.pushIncoming("GET /mcp HTTP/1.1\r\n");
+    ws.loop();
+    ASSERT_EQ((int)ws.clientCount(), 1);
+    _mockMillis() += WebSocketTransport::HANDSHAKE_TIMEOUT_MS + 1;
+    ws.loop();
+    ASSERT_EQ((int)ws.clientCount(), 0);
+}
+
+TEST(ws_message_answered) {
+    WebSocketTransport ws(8081);
+    ws.onMessage([](const String& msg) -> String { return String("echo:") + msg; });
+    ws.begin();
+    WSClient& c = connectWS(ws);
+    c.tcp.pushIncoming(clientFrame("hi"));
+    ws.loop();
+    String out = c.tcp.getBuffer();
+    ASSERT_EQ((int)out.length(), 2 + 7);
+    ASSERT_EQ((uint8_t)out[0], 0x81);
+    ASSERT_EQ((uint8_t)out[1], 7);
+    ASSERT(out.endsWith("echo:hi"));
+}
+
+TEST(ws_partial_write_resumes) {
+    WebSocketTransport ws(8081);
+    ws.begin();
+    WSClient& c = connectWS(ws);
+    c.tcp.setWriteBudget(3);
+    ws.broadcast("0123456789");
+    ASSERT_EQ((int)c.tcp.getBuffer().length(), 3);
+    ASSERT_EQ((int)ws.queuedBytes(), 9);
+    c.tcp.setWriteBudget((size_t)-1);
+    ws.loop();
+    ASSERT_EQ((int)ws.queuedBytes(), 0);
+    ASSERT(c.tcp.getBuffer().endsWith("0123456789"));
+}
+
+TEST(ws_slow_client_does_not_block_others) {
+    WebSocketTransport ws(8081);
+    ws.begin();
+    connectWS(ws);
+    connectWS(ws);
+    ws._clients[0].tcp.setWriteBudget(0);
+    String big;
+    for (int i = 0; i < 1000; i++) big += 'x';
+    ws.broadcast(big);
+    ASSERT_GT((int)ws._clients[0].pendingOutput(), 0);
+    ASSERT_EQ((int)ws._clients[1].pendingOutput(), 0);
+    ASSERT(ws._clients[1].tcp.getBuffer().endsWith(big));
+    for (int i = 0; i < 8; i++) ws.broadcast(big);
+    ASSERT_EQ((int)ws.slowDisconnects(), 1);
+    ws.loop();
+    ASSERT_EQ((int)ws.clientCount(), 1);
+}
+
+TEST(ws_quiet_client_not_read_when_poller_idle) {
+    WebSocketTransport ws(8081);
+    int calls = 0;
+    ws.onMessage([&](const String&) -> String { calls++; return ""; });
+    ws.begin();
+    WSClient& c = connectWS(ws);
+    IOPoller io;
+    io.reset();
+    ws.registerIO(io);
+    ASSERT_EQ((int)io.poll(), 0);
+    // Data arriving after the pass waits for the next one
+    c.tcp.pushIncoming(clientFrame("a"));
+    ws.loop(&io);
+    ASSERT_EQ(calls, 0);
+    io.reset();
+    ws.registerIO(io);
+    ASSERT_EQ((int)io.poll(), 1);
+    ws.loop(&io);
+    ASSERT_EQ(calls, 1);
+}
+
+TEST(ws_ping_once_per_idle_interval) {
+    WebSocketTransport ws(8081);
+    ws.begin();
+    WSClient& c = connectWS(ws);
+    _mockMillis() += WebSocketTransport::PING_INTERVAL_MS + 1;
+    for (int i = 0; i < 5; i++) ws.loop();
+    ASSERT_EQ((int)c.tcp.getBuffer().length(), 2);
+    ASSERT_EQ((uint8_t)c.tcp.getBuffer()[0], 0x89);
+}
+
+// ── Server integration ─────────────────────────────────────────────────
+
+TEST(server_serves_websocket_through_poller) {
+    Server* s = new Server("io");
+    s->setMDNS(false);
+    s->enableWebSocket(8081);
+    s->begin();
+    WSClient& c = connectWS(*s->_wsTransport);
+    c.tcp.pushIncoming(clientFrame(R"({"jsonrpc":"2.0","id":4,"method":"ping"})"));
+    s->loop();
+    ASSERT_STR_CONTAINS(s->_wsTransport->_clients[0].tcp.getBuffer().c_str(), "\"id\":4");
+    s->stop();
+    delete s;
+}
+
+TEST(server_idle_loop_is_idle_pass) {
+    Server* s = new Server("io");
+    s->setMDNS(false);
+    s->enableWebSocket(8081);
+    s->begin();
+    connectWS(*s->_wsTransport);
+    s->_sseManager.addClient(WiFiClient(), "s1", "/mcp");
+    s->loop();
+    s->loop();  // Writes the first SSE keepalive
+    unsigned long idle = s->io().idlePasses();
+    for (int i = 0; i < 10; i++) s->loop();
+    ASSERT_EQ((int)s->io().size(), 2);
+    ASSERT_EQ((int)(s->io().idlePasses() - idle), 10);
+    s->stop();
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -592,7 +592,7 @@ TEST(double_subscribe_is_idempotent) {
     s->_processJsonRpc(sub);
     s->_processJsonRpc(sub);
     // Should only have one subscription entry
-    ASSERT_EQ(s->_subscribedResources.size(), (size_t)1);
+    ASSERT_EQ(s->subscriptions().subscriptionCount(""), (size_t)1);
 }
 
 // ── v0.5.0 Tests: Roots ────────────────────────────────────────────────
@@ -2877,6 +2877,85 @@ TEST(remove_resource_template_nonexistent) {
     ASSERT(s->removeResourceTemplate("nope://{x}") == false);
 }
 
+// ── Method dispatch table ─────────────────────────────────────────────
+
+TEST(dispatch_builtin_methods_resolve) {
+    ASSERT(Server::_findBuiltinMethod("initialize") != nullptr);
+    ASSERT(Server::_findBuiltinMethod("tools/call") != nullptr);
+    ASSERT(Server::_findBuiltinMethod("tasks/cancel") != nullptr);
+    ASSERT(Server::_findBuiltinMethod("notifications/cancelled") != nullptr);
+    ASSERT(Server::_findBuiltinMethod("tools/") == nullptr);
+    ASSERT(Server::_findBuiltinMethod("") == nullptr);
+    ASSERT(Server::_findBuiltinMethod("zzz") == nullptr);
+}
+
+TEST(dispatch_every_builtin_resolves_to_itself) {
+    for (size_t i = 0; i < Server::_builtinMethodCount; i++) {
+        const char* name = Server::_builtinMethods[i].name;
+        ASSERT(Server::_findBuiltinMethod(name) == &Server::_builtinMethods[i]);
+    }
+}
+
+TEST(dispatch_custom_method) {
+    auto* s = makeTestServer();
+    ASSERT(s->addMethod("device/reboot", [](JsonVariant params) -> String {
+        int delay = params["delayMs"] | 0;
+        return String("{\"scheduled\":") + delay + "}";
+    }));
+    ASSERT(s->hasMethod("device/reboot"));
+    String resp = s->_processJsonRpc(R"({"jsonrpc":"2.0","id":930,"method":"device/reboot","params":{"delayMs":500}})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"id\":930");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"scheduled\":500");
+}
+
+TEST(dispatch_custom_method_cannot_shadow_builtin) {
+    auto* s = makeTestServer();
+    ASSERT(!s->addMethod("tools/list", [](JsonVariant) -> String { return "{}"; }));
+    ASSERT(!s->addMethod("", [](JsonVariant) -> String { return "{}"; }));
+    ASSERT(!s->addMethod(nullptr, [](JsonVariant) -> String { return "{}"; }));
+    ASSERT(!s->removeMethod("tools/list"));
+    ASSERT(s->hasMethod("tools/list"));
+}
+
+TEST(dispatch_custom_method_replace_and_remove) {
+    auto* s = makeTestServer();
+    s->addMethod("x/b", [](JsonVariant) -> String { return "{\"v\":1}"; });
+    s->addMethod("x/a", [](JsonVariant) -> String { return "{\"v\":0}"; });
+    s->addMethod("x/b", [](JsonVariant) -> String { return "{\"v\":2}"; });
+    ASSERT_EQ((int)s->_customMethods.size(), 2);
+    ASSERT_STR_EQ(s->_customMethods[0].name.c_str(), "x/a");
+    String resp = s->_processJsonRpc(R"({"jsonrpc":"2.0","id":931,"method":"x/b"})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"v\":2");
+    ASSERT(s->removeMethod("x/b"));
+    ASSERT(!s->removeMethod("x/b"));
+    resp = s->_processJsonRpc(R"({"jsonrpc":"2.0","id":932,"method":"x/b"})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "-32601");
+}
+
+TEST(dispatch_custom_method_exception_is_internal_error) {
+    auto* s = makeTestServer();
+    s->addMethod("x/throw", [](JsonVariant) -> String { throw 1; });
+    String resp = s->_processJsonRpc(R"({"jsonrpc":"2.0","id":933,"method":"x/throw"})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "-32603");
+}
+
+TEST(dispatch_custom_method_as_notification) {
+    auto* s = makeTestServer();
+    int calls = 0;
+    s->addMethod("x/notify", [&](JsonVariant) -> String { calls++; return "{}"; });
+    String resp = s->_processJsonRpc(R"({"jsonrpc":"2.0","method":"x/notify"})");
+    ASSERT_EQ(calls, 1);
+    ASSERT(resp.isEmpty());
+}
+
+TEST(dispatch_custom_method_in_batch) {
+    auto* s = makeTestServer();
+    s->addMethod("x/echo", [](JsonVariant p) -> String { return String("{\"n\":") + (int)(p["n"] | 0) + "}"; });
+    String resp = s->_processJsonRpc(R"([{"jsonrpc":"2.0","id":1,"method":"x/echo","params":{"n":7}},{"jsonrpc":"2.0","id":2,"method":"ping"}])");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"n\":7");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"id\":2");
+}
+
 // ── Main ───────────────────────────────────────────────────────────────
 
 int main() {
@@ -0,0 +1,327 @@
+/**
+ * mcpd — HTTP keep-alive / pipelining tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static const char* INIT = R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})";
+
+static String rpcBody(int id, const char* method) {
+    return String(R"({"jsonrpc":"2.0","id":)") + String(id) + R"(,"method":")" + method + "\"}";
+}
+
+static String request(const char* method, const String& body, const char* extraHeaders = "") {
+    return String(method) + " /mcp HTTP/1.1\r\nHost: esp32\r\nContent-Type: application/json\r\n" +
+           extraHeaders + "Content-Length: " + String((int)body.length()) + "\r\n\r\n" + body;
+}
+
+static Server* startServer() {
+    Server* s = new Server("ka");
+    s->setMDNS(false);
+    s->enableKeepAlive();
+    s->begin();
+    return s;
+}
+
+// POST initialize through WebServer; the pool adopts the socket
+static HttpConnection& adoptFirst(Server* s) {
+    s->_httpServer->_setBody(INIT);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+    return s->_keepAlive._connections.back();
+}
+
+static void stopServer(Server* s) {
+    s->stop();
+    delete s;
+}
+
+// ── Request parsing ────────────────────────────────────────────────────
+
+TEST(parse_request_line_headers_and_body) {
+    HttpConnection c{WiFiClient()};
+    c._client.pushIncoming("POST /mcp?key=a%20b&x=1 HTTP/1.1\r\nmcp-session-id:  s1 \r\n"
+                           "Content-Length: 5\r\n\r\nhello");
+    c.receive();
+    ASSERT(c.parse() == HttpConnection::Parse::Ready);
+    ASSERT_EQ(c.method(), HTTP_POST);
+    ASSERT_STR_EQ(c.uri().c_str(), "/mcp");
+    ASSERT_STR_EQ(c.header("Mcp-Session-Id").c_str(), "s1");
+    ASSERT_STR_EQ(c.arg("key").c_str(), "a b");
+    ASSERT_STR_EQ(c.arg("plain").c_str(), "hello");
+    ASSERT_FALSE(c.hasBufferedInput());
+}
+
+TEST(parse_waits_for_whole_body) {
+    HttpConnection c{WiFiClient()};
+    String req = request("POST", "{\"a\":1}");
+    c._client.pushIncoming(req.substring(0, 20));
+    c.receive();
+    ASSERT(c.parse() == HttpConnection::Parse::Incomplete);
+    c._client.pushIncoming(req.substring(20, req.length() - 2));
+    c.receive();
+    ASSERT(c.parse() == HttpConnection::Parse::Incomplete);
+    c._client.pushIncoming(req.substring(req.length() - 2));
+    c.receive();
+    ASSERT(c.parse() == HttpConnection::Parse::Ready);
+    ASSERT_STR_EQ(c.arg("plain").c_str(), "{\"a\":1}");
+}
+
+TEST(parse_pipelined_requests_in_order) {
+    HttpConnection c{WiFiClient()};
+    c._client.pushIncoming(request("POST", "one") + request("DELETE", "") + request("POST", "three"));
+    c.receive();
+    ASSERT(c.parse() == HttpConnection::Parse::Ready);
+    ASSERT_STR_EQ(c.arg("plain").c_str(), "one");
+    ASSERT(c.parse() == HttpConnection::Parse::Ready);
+    ASSERT_EQ(c.method(), HTTP_DELETE);
+    ASSERT(c.parse() == HttpConnection::Parse::Ready);
+    ASSERT_STR_EQ(c.arg("plain").c_str(), "three");
+    ASSERT(c.parse() == HttpConnection::Parse::Incomplete);
+}
+
+TEST(parse_rejects_malformed_and_oversized) {
+    HttpConnection bad{WiFiClient()};
+    bad._client.pushIncoming("garbage\r\n\r\n");
+    bad.receive();
+    ASSERT(bad.parse() == HttpConnection::Parse::Invalid);
+
+    HttpConnection chunked{WiFiClient()};
+    chunked._client.pushIncoming("POST /mcp HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+    chunked.receive();
+    ASSERT(chunked.parse() == HttpConnection::Parse::Invalid);
+
+    HttpConnection big{WiFiClient()};
+    big._client.pushIncoming("POST /mcp HTTP/1.1\r\nContent-Length: 100000\r\n\r\n");
+    big.receive();
+    ASSERT(big.parse() == HttpConnection::Parse::TooLarge);
+}
+
+TEST(connection_close_detection) {
+    HttpConnection c{WiFiClient()};
+    c._client.pushIncoming(request("POST", "a", "Connection: Close\r\n") +
+                           "POST /mcp HTTP/1.0\r\n\r\n" +
+                           "POST /mcp HTTP/1.0\r\nConnection: keep-alive\r\n\r\n" +
+                           request("POST", "b"));
+    c.receive();
+    c.parse();
+    ASSERT(c.wantsClose());
+    c.parse();
+    ASSERT(c.wantsClose());
+    c.parse();
+    ASSERT_FALSE(c.wantsClose());
+    c.parse();
+    ASSERT_FALSE(c.wantsClose());
+}
+
+// ── Responses ──────────────────────────────────────────────────────────
+
+TEST(response_has_length_and_keepalive_headers) {
+    HttpConnection c{WiFiClient()};
+    c.timeoutSec = 5;
+    c.remaining = 9;
+    c.sendHeader("Mcp-Session-Id", "s1");
+    c.send(200, "application/json", "{}");
+    ASSERT(c.flush());
+    String out = c._client.getBuffer();
+    ASSERT(out.startsWith("HTTP/1.1 200 OK\r\n"));
+    ASSERT_STR_CONTAINS(out.c_str(), "Content-Length: 2\r\n");
+    ASSERT_STR_CONTAINS(out.c_str(), "Connection: keep-alive\r\nKeep-Alive: timeout=5, max=9\r\n");
+    ASSERT_STR_CONTAINS(out.c_str(), "Mcp-Session-Id: s1\r\n");
+    ASSERT(out.endsWith("\r\n\r\n{}"));
+}
+
+TEST(chunked_response_framing) {
+    HttpConnection c{WiFiClient()};
+    c.closing = true;
+    BasicHttpChunkedSink<HttpConnection> sink(c, 200, "application/json");
+    sink.begin();
+    sink.write("hello", 5);
+    sink.write("0123456789abcdef!", 17);
+    sink.end();
+    c.flush();
+    String out = c._client.getBuffer();
+    ASSERT_STR_CONTAINS(out.c_str(), "Transfer-Encoding: chunked\r\nConnection: close\r\n");
+    ASSERT(out.endsWith("\r\n\r\n5\r\nhello\r\n11\r\n0123456789abcdef!\r\n0\r\n\r\n"));
+    // The next response is not chunked again
+    c.send(202);
+    c.flush();
+    ASSERT_STR_CONTAINS(c._client.getBuffer().c_str(), "Content-Length: 0");
+}
+
+TEST(flush_resumes_after_short_write) {
+    HttpConnection c{WiFiClient()};
+    c._client.setWriteBudget(10);
+    c.send(200, "text/plain", "0123456789");
+    ASSERT_FALSE(c.flush());
+    ASSERT_EQ((int)c._client.getBuffer().length(), 10);
+    c._client.setWriteBudget((size_t)-1);
+    ASSERT(c.flush());
+    ASSERT_EQ((int)c.pendingOutput(), 0);
+    ASSERT(c._client.getBuffer().endsWith("0123456789"));
+}
+
+// ── Server integration ─────────────────────────────────────────────────
+
+TEST(disabled_by_default) {
+    Server* s = new Server("ka");
+    s->setMDNS(false);
+    s->begin();
+    s->_httpServer->_setBody(INIT);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+    ASSERT_EQ(s->_httpServer->_responseCode, 200);
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 0);
+    stopServer(s);
+}
+
+TEST(post_socket_adopted_and_reused) {
+    Server* s = startServer();
+    HttpConnection& conn = adoptFirst(s);
+    ASSERT_EQ(s->_httpServer->_responseCode, 0);  // WebServer sent nothing
+    String first = conn._client.getBuffer();
+    ASSERT(first.startsWith("HTTP/1.1 200 OK\r\n"));
+    ASSERT_STR_CONTAINS(first.c_str(), "Connection: keep-alive");
+    ASSERT_STR_CONTAINS(first.c_str(), "protocolVersion");
+    String session = s->_sessionId;
+
+    conn._client.clearBuffer();
+    conn._client.pushIncoming(request("POST", rpcBody(2, "ping"),
+                                      (String("Mcp-Session-Id: ") + session + "\r\n").c_str()));
+    s->loop();
+    HttpConnection& again = s->_keepAlive._connections[0];
+    ASSERT_STR_CONTAINS(again._client.getBuffer().c_str(), "\"id\":2");
+    ASSERT_EQ((int)s->keepAlive().acceptedConnections(), 1);
+    ASSERT_EQ((int)s->keepAlive().reusedRequests(), 1);
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 1);
+    stopServer(s);
+}
+
+TEST(pipelined_requests_answered_in_order) {
+    Server* s = startServer();
+    HttpConnection& conn = adoptFirst(s);
+    conn._client.clearBuffer();
+    conn._client.pushIncoming(request("POST", rpcBody(11, "ping")) +
+                              request("POST", rpcBody(12, "tools/list")) +
+                              request("POST", rpcBody(13, "ping")));
+    s->loop();
+    String out = s->_keepAlive._connections[0]._client.getBuffer();
+    int a = out.indexOf("\"id\":11"), b = out.indexOf("\"id\":12"), c = out.indexOf("\"id\":13");
+    ASSERT(a >= 0 && b > a && c > b);
+    ASSERT_EQ((int)s->keepAlive().reusedRequests(), 3);
+    stopServer(s);
+}
+
+TEST(connection_close_request_not_adopted) {
+    Server* s = startServer();
+    s->_httpServer->_setHeader(transport::HEADER_CONNECTION, "close");
+    s->_httpServer->_setBody(INIT);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+    ASSERT_EQ(s->_httpServer->_responseCode, 200);
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 0);
+    stopServer(s);
+}
+
+TEST(pool_limit_falls_back_to_webserver) {
+    Server* s = startServer();
+    s->keepAlive().setMaxConnections(1);
+    adoptFirst(s);
+    s->_httpServer->_setBody(rpcBody(2, "ping"));
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+    ASSERT_EQ(s->_httpServer->_responseCode, 200);
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 1);
+    stopServer(s);
+}
+
+TEST(idle_connection_closed) {
+    Server* s = startServer();
+    s->keepAlive().setIdleTimeout(1000);
+    adoptFirst(s);
+    s->loop();
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 1);
+    _mockMillis() += 1500;
+    s->loop();
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 0);
+    ASSERT_EQ((int)s->keepAlive().idleClosed(), 1);
+    stopServer(s);
+}
+
+TEST(last_allowed_request_closes) {
+    Server* s = startServer();
+    s->keepAlive().setMaxRequests(2);
+    HttpConnection& conn = adoptFirst(s);
+    ASSERT_STR_CONTAINS(conn._client.getBuffer().c_str(), "max=1");
+    conn._client.clearBuffer();
+    conn._client.pushIncoming(request("POST", rpcBody(2, "ping")) + request("POST", rpcBody(3, "ping")));
+    s->loop();
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 0);
+    ASSERT_EQ((int)s->keepAlive().reusedRequests(), 1);  // The third is never read
+    stopServer(s);
+}
+
+TEST(client_close_header_ends_connection) {
+    Server* s = startServer();
+    HttpConnection& conn = adoptFirst(s);
+    conn._client.clearBuffer();
+    conn._client.pushIncoming(request("POST", rpcBody(2, "ping"), "Connection: close\r\n"));
+    s->loop();
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 0);
+    stopServer(s);
+}
+
+TEST(bad_request_answered_and_closed) {
+    Server* s = startServer();
+    HttpConnection& conn = adoptFirst(s);
+    conn._client.clearBuffer();
+    conn._client.pushIncoming("nonsense\r\n\r\n");
+    conn._client.setWriteBudget(0);  // Hold the answer in the output buffer
+    s->loop();
+    HttpConnection& held = s->_keepAlive._connections[0];
+    ASSERT(held.closing);
+    ASSERT(held._out.startsWith("HTTP/1.1 400 Bad Request\r\n"));
+    ASSERT_STR_CONTAINS(held._out.c_str(), "Connection: close");
+    held._client.setWriteBudget((size_t)-1);
+    s->loop();
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 0);
+    stopServer(s);
+}
+
+TEST(get_on_kept_connection_becomes_sse_stream) {
+    Server* s = startServer();
+    HttpConnection& conn = adoptFirst(s);
+    conn._client.pushIncoming("GET /mcp HTTP/1.1\r\nAccept: text/event-stream\r\n\r\n");
+    s->loop();
+    ASSERT_EQ((int)s->keepAlive().connectionCount(), 0);
+    ASSERT(s->sse().hasClients(s->_sessionId));
+    // The kept-alive socket was handed over, not closed
+    ASSERT(s->_sseManager._clients[0].isConnected());
+    stopServer(s);
+}
+
+TEST(auth_applies_to_kept_connections) {
+    Server* s = startServer();
+    s->auth().setApiKey("secret");
+    s->_httpServer->_setHeader("Authorization", "Bearer secret");
+    HttpConnection& conn = adoptFirst(s);
+    ASSERT_STR_CONTAINS(conn._client.getBuffer().c_str(), "200 OK");
+    conn._client.clearBuffer();
+    conn._client.pushIncoming(request("POST", rpcBody(2, "ping")));
+    s->loop();
+    ASSERT_STR_CONTAINS(s->_keepAlive._connections[0]._client.getBuffer().c_str(),
+                        "401 Unauthorized");
+    s->_keepAlive._connections[0]._client.clearBuffer();
+    s->_keepAlive._connections[0]._client.pushIncoming(
+        request("POST", rpcBody(3, "ping"), "X-API-Key: secret\r\n"));
+    s->loop();
+    ASSERT_STR_CONTAINS(s->_keepAlive._connections[0]._client.getBuffer().c_str(), "\"id\":3");
+    stopServer(s);
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
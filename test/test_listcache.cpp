@@ -0,0 +1,240 @@
+/**
+ * mcpd — List Response Cache tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static String request(Server& s, const char* method, const char* cursor = nullptr, int id = 1) {
+    String body = String("{\"jsonrpc\":\"2.0\",\"id\":") + String(id) +
+                  ",\"method\":\"" + method + "\"";
+    if (cursor) body += String(",\"params\":{\"cursor\":\"") + cursor + "\"}";
+    body += "}";
+    return s._processJsonRpc(body);
+}
+
+static void addTools(Server& s, int n) {
+    for (int i = 0; i < n; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "tool_%d", i);
+        s.addTool(name, "desc", R"({"type":"object"})",
+                  [](const JsonObject&) -> String { return "{}"; });
+    }
+}
+
+// ── ListCache unit ─────────────────────────────────────────────────────
+
+TEST(cache_miss_then_hit) {
+    ListCache c;
+    ASSERT(c.find(ListKind::Tools, 0, 0) == nullptr);
+    c.store(ListKind::Tools, 0, 0, "{\"tools\":[]}");
+    const String* page = c.find(ListKind::Tools, 0, 0);
+    ASSERT(page != nullptr);
+    ASSERT_STR_EQ(page->c_str(), "{\"tools\":[]}");
+    ASSERT_EQ((int)c.hits(), 1);
+    ASSERT_EQ((int)c.misses(), 1);
+}
+
+TEST(cache_keyed_by_cursor_and_page_size) {
+    ListCache c;
+    c.store(ListKind::Tools, 0, 5, "a");
+    ASSERT(c.find(ListKind::Tools, 5, 5) == nullptr);
+    ASSERT(c.find(ListKind::Tools, 0, 10) == nullptr);
+    ASSERT(c.find(ListKind::Tools, 0, 5) != nullptr);
+}
+
+TEST(cache_kinds_are_independent) {
+    ListCache c;
+    c.store(ListKind::Tools, 0, 0, "t");
+    c.store(ListKind::Prompts, 0, 0, "p");
+    c.invalidate(ListKind::Tools);
+    ASSERT(c.find(ListKind::Tools, 0, 0) == nullptr);
+    ASSERT(c.find(ListKind::Prompts, 0, 0) != nullptr);
+    ASSERT_EQ((int)c.generation(ListKind::Tools), 1);
+    ASSERT_EQ((int)c.generation(ListKind::Prompts), 0);
+}
+
+TEST(cache_invalidate_frees_pages) {
+    ListCache c;
+    c.store(ListKind::Resources, 0, 0, "0123456789");
+    ASSERT_EQ((int)c.bytes(), 10);
+    ASSERT_EQ((int)c.entries(), 1);
+    c.invalidate(ListKind::Resources);
+    ASSERT_EQ((int)c.bytes(), 0);
+    ASSERT_EQ((int)c.entries(), 0);
+    ASSERT_EQ((int)c.invalidations(), 1);
+}
+
+TEST(cache_evicts_least_recently_used) {
+    ListCache c;
+    for (size_t i = 0; i < ListCache::PAGES_PER_LIST; i++) {
+        c.store(ListKind::Tools, i, 1, "x");
+    }
+    c.find(ListKind::Tools, 0, 1);  // Touch the oldest
+    c.store(ListKind::Tools, 99, 1, "y");
+    ASSERT(c.find(ListKind::Tools, 0, 1) != nullptr);
+    ASSERT(c.find(ListKind::Tools, 1, 1) == nullptr);
+    ASSERT(c.find(ListKind::Tools, 99, 1) != nullptr);
+    ASSERT_EQ((int)c.entries(), (int)ListCache::PAGES_PER_LIST);
+}
+
+TEST(cache_disabled_stores_nothing) {
+    ListCache c;
+    c.store(ListKind::Tools, 0, 0, "a");
+    c.setEnabled(false);
+    ASSERT_EQ((int)c.entries(), 0);
+    c.store(ListKind::Tools, 0, 0, "a");
+    ASSERT(c.find(ListKind::Tools, 0, 0) == nullptr);
+    ASSERT_EQ((int)c.entries(), 0);
+}
+
+// ── Server integration ─────────────────────────────────────────────────
+
+TEST(server_repeated_tools_list_hits_cache) {
+    Server s("t");
+    addTools(s, 3);
+    String first = request(s, "tools/list", nullptr, 1);
+    String second = request(s, "tools/list", nullptr, 2);
+    ASSERT_EQ((int)s.listCache().misses(), 1);
+    ASSERT_EQ((int)s.listCache().hits(), 1);
+    ASSERT_STR_CONTAINS(second.c_str(), "\"id\":2");
+    ASSERT_STR_CONTAINS(second.c_str(), "tool_2");
+    // Only the id differs
+    first.replace("\"id\":1", "\"id\":2");
+    ASSERT_STR_EQ(first.c_str(), second.c_str());
+}
+
+TEST(server_cached_response_is_valid_json) {
+    Server s("t");
+    addTools(s, 2);
+    request(s, "tools/list");
+    String out = request(s, "tools/list");
+    JsonDocument doc;
+    ASSERT_FALSE((bool)deserializeJson(doc, out));
+    ASSERT_EQ((int)doc["result"]["tools"].as<JsonArray>().size(), 2);
+}
+
+TEST(server_add_tool_invalidates) {
+    Server s("t");
+    addTools(s, 1);
+    request(s, "tools/list");
+    s.addTool("late", "d", R"({"type":"object"})",
+              [](const JsonObject&) -> String { return "{}"; });
+    String out = request(s, "tools/list");
+    ASSERT_STR_CONTAINS(out.c_str(), "late");
+    ASSERT_EQ((int)s.listCache().hits(), 0);
+}
+
+TEST(server_remove_tool_invalidates) {
+    Server s("t");
+    addTools(s, 2);
+    request(s, "tools/list");
+    s.removeTool("tool_1");
+    String out = request(s, "tools/list");
+    ASSERT_STR_NOT_CONTAINS(out.c_str(), "tool_1");
+}
+
+TEST(server_disable_tool_invalidates) {
+    Server s("t");
+    addTools(s, 2);
+    request(s, "tools/list");
+    s.disableTool("tool_0");
+    String out = request(s, "tools/list");
+    ASSERT_STR_NOT_CONTAINS(out.c_str(), "tool_0");
+    s.enableTool("tool_0");
+    out = request(s, "tools/list");
+    ASSERT_STR_CONTAINS(out.c_str(), "tool_0");
+}
+
+TEST(server_group_toggle_through_manager_invalidates) {
+    Server s("t");
+    addTools(s, 2);
+    s.addToolToGroup("tool_1", "grp");
+    request(s, "tools/list");
+    // Direct manager access does not go through a Server mutator
+    s.toolGroups().enableGroup("grp", false);
+    String out = request(s, "tools/list");
+    ASSERT_STR_NOT_CONTAINS(out.c_str(), "tool_1");
+    ASSERT_STR_CONTAINS(out.c_str(), "tool_0");
+}
+
+TEST(server_pages_cached_separately) {
+    Server s("t");
+    addTools(s, 5);
+    s.setPageSize(2);
+    String p1 = request(s, "tools/list");
+    String p2 = request(s, "tools/list", "2");
+    ASSERT_STR_CONTAINS(p1.c_str(), "tool_1");
+    ASSERT_STR_NOT_CONTAINS(p1.c_str(), "tool_2");
+    ASSERT_STR_CONTAINS(p2.c_str(), "tool_2");
+    ASSERT_STR_CONTAINS(p2.c_str(), "\"nextCursor\":\"4\"");
+    request(s, "tools/list", "2");
+    ASSERT_EQ((int)s.listCache().hits(), 1);
+    // Changing the page size must not serve the old pages
+    s.setPageSize(0);
+    String all = request(s, "tools/list");
+    ASSERT_STR_CONTAINS(all.c_str(), "tool_4");
+    ASSERT_STR_NOT_CONTAINS(all.c_str(), "nextCursor");
+}
+
+TEST(server_resources_prompts_templates_cached) {
+    Server s("t");
+    s.addResource("res://a", "a", "d", "text/plain", []() -> String { return "x"; });
+    s.addResourceTemplate("res://{id}", "t", "d", "text/plain",
+        [](const std::map<String, String>&) -> String { return "x"; });
+    s.addPrompt("p", "d", {}, [](const std::map<String, String>&) -> std::vector<MCPPromptMessage> {
+        return {};
+    });
+    request(s, "resources/list");
+    request(s, "resources/list");
+    request(s, "resources/templates/list");
+    request(s, "resources/templates/list");
+    request(s, "prompts/list");
+    request(s, "prompts/list");
+    ASSERT_EQ((int)s.listCache().hits(), 3);
+    ASSERT_EQ((int)s.listCache().misses(), 3);
+
+    s.removeResource("res://a");
+    ASSERT_STR_NOT_CONTAINS(request(s, "resources/list").c_str(), "res://a");
+    s.removePrompt("p");
+    ASSERT_STR_NOT_CONTAINS(request(s, "prompts/list").c_str(), "\"p\"");
+}
+
+TEST(server_notify_changed_invalidates) {
+    Server s("t");
+    addTools(s, 1);
+    request(s, "tools/list");
+    s._tools[0].description = "changed in place";
+    s.notifyToolsChanged();
+    ASSERT_STR_CONTAINS(request(s, "tools/list").c_str(), "changed in place");
+}
+
+TEST(server_cache_disabled_still_correct) {
+    Server s("t");
+    s.listCache().setEnabled(false);
+    addTools(s, 2);
+    String a = request(s, "tools/list");
+    String b = request(s, "tools/list");
+    ASSERT_STR_EQ(a.c_str(), b.c_str());
+    ASSERT_EQ((int)s.listCache().hits(), 0);
+    ASSERT_EQ((int)s.listCache().entries(), 0);
+}
+
+TEST(server_cache_stats_reach_metrics) {
+    Server s("t");
+    addTools(s, 1);
+    request(s, "tools/list");
+    request(s, "tools/list");
+    ASSERT_EQ((int)s.metrics().listCacheHits(), 1);
+    ASSERT_EQ((int)s.metrics().listCacheMisses(), 1);
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+/**
+ * mcpd — Multi-session server tests
+ *
+ * Several HTTP clients initialize against one server and keep separate
+ * log levels, subscriptions, notification queues and SSE streams.
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static Server* startServer() {
+    Server* s = new Server("multi-test");
+    s->setMDNS(false);
+    for (int i = 0; i < 4; i++) {
+        String uri = String("sensor://") + String(i);
+        s->addResource(uri.c_str(), "sensor", "reading", "text/plain",
+                       []() -> String { return "1"; });
+    }
+    s->addTool("echo", "Echo", R"({"type":"object"})",
+               [](const JsonObject&) -> String { return "{\"ok\":true}"; });
+    s->begin();
+    return s;
+}
+
+static String post(Server* s, const String& session, const String& body) {
+    s->_httpServer->_setHeader(transport::HEADER_SESSION_ID, session);
+    s->_httpServer->_setBody(body);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+    return s->_httpServer->_responseBody;
+}
+
+static String initialize(Server* s, const char* client) {
+    post(s, "", String(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{"clientInfo":{"name":")") +
+                client + "\"}}}");
+    return s->_httpServer->_responseHeaders[transport::HEADER_SESSION_ID];
+}
+
+static void subscribe(Server* s, const String& session, const char* uri) {
+    post(s, session, String(R"({"jsonrpc":"2.0","id":2,"method":"resources/subscribe","params":{"uri":")") +
+                     uri + "\"}}");
+}
+
+static void openStream(Server* s, const String& session) {
+    s->_httpServer->_setHeader(transport::HEADER_SESSION_ID, session);
+    s->_httpServer->_setHeader(transport::HEADER_LAST_EVENT_ID, "");
+    s->_httpServer->_simulateRequest("/mcp", HTTP_GET);
+}
+
+static String streamOutput(Server* s, const String& session) {
+    for (auto& c : s->_sseManager._clients) {
+        if (c.sessionId == session) return c.client.getBuffer();
+    }
+    return String();
+}
+
+static size_t pendingFor(Server* s, const String& session) {
+    const Session* info = s->sessions().getSession(session);
+    return info ? info->pending.size() : 0;
+}
+
+// ── Session routing ────────────────────────────────────────────────────
+
+TEST(second_initialize_keeps_first_session) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    ASSERT_FALSE(a.isEmpty());
+    ASSERT_FALSE(b.isEmpty());
+    ASSERT(a != b);
+    ASSERT_EQ((int)s->sessions().activeCount(), 2);
+    ASSERT_STR_EQ(s->sessions().getSession(a)->clientName.c_str(), "claude");
+
+    String resp = post(s, a, R"({"jsonrpc":"2.0","id":3,"method":"tools/list"})");
+    ASSERT_EQ(s->_httpServer->_responseCode, 200);
+    ASSERT_STR_CONTAINS(resp.c_str(), "echo");
+    ASSERT_STR_EQ(s->_httpServer->_responseHeaders[transport::HEADER_SESSION_ID].c_str(), a.c_str());
+    s->stop();
+    delete s;
+}
+
+TEST(unknown_session_rejected) {
+    Server* s = startServer();
+    initialize(s, "claude");
+    post(s, "deadbeef", R"({"jsonrpc":"2.0","id":3,"method":"ping"})");
+    ASSERT_EQ(s->_httpServer->_responseCode, 404);
+    openStream(s, "deadbeef");
+    ASSERT_EQ(s->_httpServer->_responseCode, 404);
+    ASSERT_EQ((int)s->_sseManager.clientCount(), 0);
+    s->stop();
+    delete s;
+}
+
+// ── Per-session state ──────────────────────────────────────────────────
+
+TEST(resource_updates_fan_out_to_subscribers_only) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    subscribe(s, a, "sensor://0");
+    subscribe(s, b, "sensor://1");
+    ASSERT(s->subscriptions().isSubscribed(a, "sensor://0"));
+    ASSERT_FALSE(s->subscriptions().isSubscribed(b, "sensor://0"));
+    ASSERT_EQ((int)s->subscriptions().subscriptionCount(""), 0);
+
+    s->notifyResourceUpdated("sensor://0");
+    ASSERT_EQ((int)pendingFor(s, a), 1);
+    ASSERT_EQ((int)pendingFor(s, b), 0);
+
+    openStream(s, a);
+    openStream(s, b);
+    s->loop();
+    ASSERT_STR_CONTAINS(streamOutput(s, a).c_str(), "sensor://0");
+    ASSERT_STR_NOT_CONTAINS(streamOutput(s, b).c_str(), "resources/updated");
+    ASSERT_EQ((int)pendingFor(s, a), 0);
+    s->stop();
+    delete s;
+}
+
+TEST(unsubscribe_is_per_session) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    subscribe(s, a, "sensor://2");
+    subscribe(s, b, "sensor://2");
+    post(s, a, R"({"jsonrpc":"2.0","id":4,"method":"resources/unsubscribe","params":{"uri":"sensor://2"}})");
+    s->notifyResourceUpdated("sensor://2");
+    ASSERT_EQ((int)pendingFor(s, a), 0);
+    ASSERT_EQ((int)pendingFor(s, b), 1);
+    s->stop();
+    delete s;
+}
+
+TEST(list_changed_reaches_every_session) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    s->notifyToolsChanged();
+    ASSERT_EQ((int)pendingFor(s, a), 1);
+    ASSERT_EQ((int)pendingFor(s, b), 1);
+    s->stop();
+    delete s;
+}
+
+TEST(log_level_is_per_session) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    post(s, a, R"({"jsonrpc":"2.0","id":5,"method":"logging/setLevel","params":{"level":"debug"}})");
+    post(s, b, R"({"jsonrpc":"2.0","id":6,"method":"logging/setLevel","params":{"level":"error"}})");
+    ASSERT(s->sessions().getSession(a)->logLevel == LogLevel::DEBUG);
+    ASSERT(s->sessions().getSession(b)->logLevel == LogLevel::ERROR);
+    ASSERT(s->logging().getLevel() == LogLevel::DEBUG);
+
+    s->logging().info("test", "fine detail");
+    ASSERT_EQ((int)pendingFor(s, a), 1);
+    ASSERT_EQ((int)pendingFor(s, b), 0);
+    s->logging().error("test", "broken");
+    ASSERT_EQ((int)pendingFor(s, a), 2);
+    ASSERT_EQ((int)pendingFor(s, b), 1);
+    s->stop();
+    delete s;
+}
+
+TEST(progress_goes_to_calling_session) {
+    Server* s = startServer();
+    s->addTool("slow", "Reports progress", R"({"type":"object"})",
+               [s](const JsonObject&) -> String {
+                   s->reportProgress("tok", 1, 2);
+                   return "{}";
+               });
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    post(s, a, R"({"jsonrpc":"2.0","id":7,"method":"tools/call","params":{"name":"slow","arguments":{}}})");
+    ASSERT_EQ((int)pendingFor(s, a), 1);
+    ASSERT_EQ((int)pendingFor(s, b), 0);
+    s->stop();
+    delete s;
+}
+
+TEST(pending_queue_is_bounded) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    for (size_t i = 0; i < Session::MAX_PENDING + 5; i++) s->notifyToolsChanged();
+    ASSERT_EQ((int)pendingFor(s, a), (int)Session::MAX_PENDING);
+    ASSERT_EQ((int)s->_pendingNotifications.size(), (int)Session::MAX_PENDING);
+    s->stop();
+    delete s;
+}
+
+TEST(local_transport_uses_server_state) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    String resp = s->_processLocal(
+        R"({"jsonrpc":"2.0","id":8,"method":"resources/subscribe","params":{"uri":"sensor://3"}})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\"result\"");
+    ASSERT_EQ((int)s->subscriptions().subscriptionCount(""), 1);
+    ASSERT_FALSE(s->subscriptions().isSubscribed(a, "sensor://3"));
+    // A WebSocket initialize does not take a session slot
+    s->_processLocal(R"({"jsonrpc":"2.0","id":9,"method":"initialize","params":{}})");
+    ASSERT_EQ((int)s->sessions().activeCount(), 1);
+    ASSERT_STR_EQ(s->_sessionId.c_str(), a.c_str());
+    s->stop();
+    delete s;
+}
+
+// ── Session end ────────────────────────────────────────────────────────
+
+TEST(delete_ends_only_that_session) {
+    Server* s = startServer();
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    openStream(s, a);
+    openStream(s, b);
+    s->_httpServer->_setHeader(transport::HEADER_SESSION_ID, a);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_DELETE);
+    ASSERT_EQ(s->_httpServer->_responseCode, 200);
+    ASSERT_FALSE(s->_sseManager.hasClients(a));
+    ASSERT(s->_sseManager.hasClients(b));
+
+    post(s, a, R"({"jsonrpc":"2.0","id":10,"method":"ping"})");
+    ASSERT_EQ(s->_httpServer->_responseCode, 404);
+    post(s, b, R"({"jsonrpc":"2.0","id":11,"method":"ping"})");
+    ASSERT_EQ(s->_httpServer->_responseCode, 200);
+    s->stop();
+    delete s;
+}
+
+TEST(evicted_session_stream_closed) {
+    Server* s = startServer();
+    s->setMaxSessions(2);
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    openStream(s, a);
+    _mockMillis() += 1000;
+    post(s, b, R"({"jsonrpc":"2.0","id":12,"method":"ping"})");  // a is now the idlest
+    String c = initialize(s, "third");
+    ASSERT(s->sessions().getSession(a) == nullptr);
+    s->loop();
+    ASSERT_FALSE(s->_sseManager.hasClients(a));
+    ASSERT(s->sessions().getSession(c) != nullptr);
+    s->stop();
+    delete s;
+}
+
+TEST(idle_sessions_expire_but_streams_keep_alive) {
+    Server* s = startServer();
+    s->setSessionTimeout(5000);
+    String a = initialize(s, "claude");
+    String b = initialize(s, "dashboard");
+    openStream(s, a);
+    s->loop();
+    _mockMillis() += 3000;
+    s->loop();
+    _mockMillis() += 3000;
+    s->loop();
+    ASSERT(s->sessions().getSession(a) != nullptr);
+    ASSERT(s->sessions().getSession(b) == nullptr);
+    s->stop();
+    delete s;
+}
+
+// ── Load ───────────────────────────────────────────────────────────────
+
+TEST(concurrent_sessions_under_load) {
+    const int SESSIONS = 4;
+    const int ROUNDS = 100;
+    Server* s = startServer();
+    String ids[SESSIONS];
+    for (int i = 0; i < SESSIONS; i++) {
+        ids[i] = initialize(s, (String("client-") + String(i)).c_str());
+        subscribe(s, ids[i], (String("sensor://") + String(i)).c_str());
+        openStream(s, ids[i]);
+    }
+    ASSERT_EQ((int)s->sessions().activeCount(), SESSIONS);
+    ASSERT_EQ((int)s->_sseManager.clientCount(), SESSIONS);
+
+    int ok = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < SESSIONS; i++) {
+            String resp = post(s, ids[i],
+                R"({"jsonrpc":"2.0","id":20,"method":"tools/call","params":{"name":"echo","arguments":{}}})");
+            if (s->_httpServer->_responseCode == 200 && resp.indexOf("\"result\"") >= 0 &&
+                s->_httpServer->_responseHeaders[transport::HEADER_SESSION_ID] == ids[i]) {
+                ok++;
+            }
+        }
+        s->notifyResourceUpdated((String("sensor://") + String(round % SESSIONS)).c_str());
+        s->loop();
+    }
+    ASSERT_EQ(ok, SESSIONS * ROUNDS);
+
+    for (int i = 0; i < SESSIONS; i++) {
+        String out = streamOutput(s, ids[i]);
+        ASSERT_STR_CONTAINS(out.c_str(), (String("sensor://") + String(i)).c_str());
+        for (int j = 0; j < SESSIONS; j++) {
+            if (j == i) continue;
+            ASSERT_STR_NOT_CONTAINS(out.c_str(), (String("sensor://") + String(j)).c_str());
+        }
+        ASSERT_EQ((int)pendingFor(s, ids[i]), 0);
+    }
+    ASSERT_EQ((int)s->sessions().activeCount(), SESSIONS);
+    s->stop();
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * mcpd — Streaming Response Writer tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+// Sink that records every call
+struct RecordingSink : public ResponseSink {
+    int begins = 0;
+    int ends = 0;
+    std::vector<size_t> chunks;
+    std::string data;
+
+    void begin() override { begins++; }
+    void write(const char* d, size_t len) override {
+        chunks.push_back(len);
+        data.append(d, len);
+    }
+    void end() override { ends++; }
+};
+
+static Server* startServer() {
+    Server* s = new Server("stream-test");
+    s->setMDNS(false);
+    s->begin();
+    return s;
+}
+
+static void post(Server* s, const String& body, const char* accept = nullptr) {
+    s->_httpServer->_setBody(body);
+    if (accept) s->_httpServer->_setHeader(transport::HEADER_ACCEPT, accept);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+}
+
+// ── ResponseWriter ─────────────────────────────────────────────────────
+
+TEST(writer_starts_lazily) {
+    RecordingSink sink;
+    ResponseWriter w(sink);
+    ASSERT_FALSE(w.started());
+    w.print("abc");
+    ASSERT_FALSE(w.started());
+    ASSERT_EQ(sink.begins, 0);
+    w.end();
+    ASSERT_TRUE(w.started());
+    ASSERT_EQ(sink.begins, 1);
+    ASSERT_EQ(sink.ends, 1);
+    ASSERT_TRUE(sink.data == "abc");
+}
+
+TEST(writer_end_is_idempotent) {
+    RecordingSink sink;
+    ResponseWriter w(sink);
+    w.end();
+    w.end();
+    ASSERT_EQ(sink.begins, 1);
+    ASSERT_EQ(sink.ends, 1);
+    ASSERT_EQ((int)sink.chunks.size(), 0);
+}
+
+TEST(writer_chunks_bounded_by_buffer) {
+    RecordingSink sink;
+    ResponseWriter w(sink);
+    std::string big(ResponseWriter::BUFFER_SIZE * 3 + 17, 'x');
+    w.write((const uint8_t*)big.data(), big.size());
+    w.end();
+    ASSERT_EQ((int)sink.chunks.size(), 4);
+    for (size_t len : sink.chunks) ASSERT_LE(len, ResponseWriter::BUFFER_SIZE);
+    ASSERT_EQ(w.bytesWritten(), big.size());
+    ASSERT_TRUE(sink.data == big);
+}
+
+TEST(writer_byte_writes) {
+    RecordingSink sink;
+    ResponseWriter w(sink);
+    for (size_t i = 0; i < ResponseWriter::BUFFER_SIZE + 1; i++) w.write((uint8_t)'a');
+    ASSERT_EQ((int)sink.chunks.size(), 1);  // one full buffer flushed
+    w.end();
+    ASSERT_EQ((int)sink.chunks.size(), 2);
+}
+
+TEST(writer_serialize_json) {
+    RecordingSink sink;
+    ResponseWriter w(sink);
+    JsonDocument doc;
+    doc["hello"] = "world";
+    serializeJson(doc, w);
+    w.end();
+    ASSERT_TRUE(sink.data == "{\"hello\":\"world\"}");
+}
+
+// ── SSEFrameSink ───────────────────────────────────────────────────────
+
+TEST(sse_frame_sink_wraps_payload) {
+    RecordingSink inner;
+    SSEFrameSink sse(inner);
+    ResponseWriter w(sse);
+    w.print("{\"a\":1}");
+    w.end();
+    ASSERT_EQ(inner.begins, 1);
+    ASSERT_EQ(inner.ends, 1);
+    ASSERT_TRUE(inner.data == "event: message\ndata: {\"a\":1}\n\n");
+}
+
+TEST(sse_frame_sink_without_event_name) {
+    RecordingSink inner;
+    SSEFrameSink sse(inner, nullptr);
+    ResponseWriter w(sse);
+    w.print("x");
+    w.end();
+    ASSERT_TRUE(inner.data == "data: x\n\n");
+}
+
+// ── HttpChunkedSink ────────────────────────────────────────────────────
+
+TEST(http_chunked_sink) {
+    WebServer server(80);
+    String session = "";
+    HttpChunkedSink sink(server, 200, transport::CONTENT_TYPE_JSON);
+    sink.addHeader(transport::HEADER_SESSION_ID, session);
+    ResponseWriter w(sink);
+    session = "abc";  // read at begin(), not at addHeader()
+    w.print("{}");
+    w.end();
+    ASSERT_EQ(server._responseCode, 200);
+    ASSERT_EQ(server._contentLength, CONTENT_LENGTH_UNKNOWN);
+    ASSERT_TRUE(server._chunkedFinished);
+    ASSERT_STR_EQ(server._responseBody.c_str(), "{}");
+    ASSERT_STR_EQ(server._responseHeaders[transport::HEADER_SESSION_ID].c_str(), "abc");
+}
+
+// ── _jsonRpcResult ─────────────────────────────────────────────────────
+
+TEST(json_rpc_result_without_writer) {
+    Server s("t");
+    JsonDocument id;
+    id["id"] = 7;
+    JsonDocument result;
+    result["ok"] = true;
+    String out = s._jsonRpcResult(id["id"], result);
+    ASSERT_STR_CONTAINS(out.c_str(), "\"jsonrpc\":\"2.0\"");
+    ASSERT_STR_CONTAINS(out.c_str(), "\"id\":7");
+    ASSERT_STR_CONTAINS(out.c_str(), "\"result\":{\"ok\":true}");
+    JsonDocument parsed;
+    ASSERT_FALSE((bool)deserializeJson(parsed, out));
+}
+
+TEST(json_rpc_result_string_id) {
+    Server s("t");
+    JsonDocument id;
+    id["id"] = "req-1";
+    JsonDocument result;
+    result.to<JsonObject>();
+    String out = s._jsonRpcResult(id["id"], result);
+    ASSERT_STR_CONTAINS(out.c_str(), "\"id\":\"req-1\"");
+}
+
+TEST(json_rpc_result_with_writer) {
+    Server s("t");
+    RecordingSink sink;
+    ResponseWriter w(sink);
+    s._responseWriter = &w;
+    JsonDocument id;
+    id["id"] = 3;
+    JsonDocument result;
+    result["v"] = 1;
+    String out = s._jsonRpcResult(id["id"], result);
+    s._responseWriter = nullptr;
+    w.end();
+    ASSERT_TRUE(out.isEmpty());
+    ASSERT_TRUE(s._responseStreamed);
+    ASSERT_STR_CONTAINS(sink.data.c_str(), "\"id\":3");
+    ASSERT_STR_CONTAINS(sink.data.c_str(), "\"result\":{\"v\":1}");
+}
+
+// ── HTTP POST integration ──────────────────────────────────────────────
+
+TEST(post_tools_list_is_streamed_in_chunks) {
+    Server* s = startServer();
+    for (int i = 0; i < 40; i++) {
+        char name[24];
+        snprintf(name, sizeof(name), "tool_%d", i);
+        s->addTool(MCPTool(name, "A tool with a reasonably long description text",
+            R"({"type":"object","properties":{"value":{"type":"integer"}}})",
+            [](const JsonObject&) -> String { return "{}"; }));
+    }
+    post(s, R"({"jsonrpc":"2.0","id":1,"method":"tools/list"})");
+    WebServer* http = s->_httpServer;
+    ASSERT_EQ(http->_responseCode, 200);
+    ASSERT_EQ(http->_contentLength, CONTENT_LENGTH_UNKNOWN);
+    ASSERT_TRUE(http->_chunkedFinished);
+    ASSERT_GT((int)http->_chunkCount, 1);
+    ASSERT_STR_CONTAINS(http->_responseBody.c_str(), "tool_39");
+    JsonDocument parsed;
+    ASSERT_FALSE((bool)deserializeJson(parsed, http->_responseBody));
+    ASSERT_EQ((int)parsed["result"]["tools"].as<JsonArray>().size(), 40);
+    s->stop();
+    delete s;
+}
+
+TEST(post_initialize_streams_session_header) {
+    Server* s = startServer();
+    post(s, R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})");
+    WebServer* http = s->_httpServer;
+    ASSERT_TRUE(http->_chunkedFinished);
+    ASSERT_FALSE(s->_sessionId.isEmpty());
+    ASSERT_STR_EQ(http->_responseHeaders[transport::HEADER_SESSION_ID].c_str(),
+                  s->_sessionId.c_str());
+    s->stop();
+    delete s;
+}
+
+TEST(post_error_is_not_streamed) {
+    Server* s = startServer();
+    post(s, R"({"jsonrpc":"2.0","id":1,"method":"no/such"})");
+    WebServer* http = s->_httpServer;
+    ASSERT_EQ(http->_responseCode, 200);
+    ASSERT_EQ((int)http->_chunkCount, 0);
+    ASSERT_STR_CONTAINS(http->_responseBody.c_str(), "-32601");
+    s->stop();
+    delete s;
+}
+
+TEST(post_notification_returns_202) {
+    Server* s = startServer();
+    post(s, R"({"jsonrpc":"2.0","method":"ping"})");
+    ASSERT_EQ(s->_httpServer->_responseCode, 202);
+    ASSERT_EQ((int)s->_httpServer->_chunkCount, 0);
+    s->stop();
+    delete s;
+}
+
+TEST(post_batch_is_streamed) {
+    Server* s = startServer();
+    post(s, R"([{"jsonrpc":"2.0","id":1,"method":"ping"},{"jsonrpc":"2.0","id":2,"method":"ping"}])");
+    WebServer* http = s->_httpServer;
+    ASSERT_GT((int)http->_chunkCount, 0);
+    ASSERT(http->_responseBody.startsWith("[{"));
+    ASSERT_STR_CONTAINS(http->_responseBody.c_str(), "},{");
+    ASSERT_STR_CONTAINS(http->_responseBody.c_str(), "\"id\":2");
+    s->stop();
+    delete s;
+}
+
+TEST(post_event_stream_framing) {
+    Server* s = startServer();
+    post(s, R"({"jsonrpc":"2.0","id":5,"method":"ping"})", "text/event-stream");
+    WebServer* http = s->_httpServer;
+    ASSERT_STR_EQ(http->_lastContentType.c_str(), transport::CONTENT_TYPE_SSE);
+    ASSERT_STR_CONTAINS(http->_responseBody.c_str(), "event: message\ndata: {");
+    ASSERT_STR_CONTAINS(http->_responseBody.c_str(), "\"id\":5");
+    s->stop();
+    delete s;
+}
+
+TEST(post_accept_both_prefers_json) {
+    Server* s = startServer();
+    post(s, R"({"jsonrpc":"2.0","id":5,"method":"ping"})",
+         "application/json, text/event-stream");
+    ASSERT_STR_EQ(s->_httpServer->_lastContentType.c_str(), transport::CONTENT_TYPE_JSON);
+    s->stop();
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+/**
+ * mcpd — SSE outbound queue / backpressure tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static const char* UPDATED_A =
+    R"({"jsonrpc":"2.0","method":"notifications/resources/updated","params":{"uri":"sensor://a"}})";
+static const char* UPDATED_B =
+    R"({"jsonrpc":"2.0","method":"notifications/resources/updated","params":{"uri":"sensor://b"}})";
+
+static String progress(const char* token, int n) {
+    return String(R"({"jsonrpc":"2.0","method":"notifications/progress","params":{"progressToken":")") +
+           token + R"(","progress":)" + String(n) + "}}";
+}
+
+static String response(int id, size_t padding = 0) {
+    String pad;
+    for (size_t i = 0; i < padding; i++) pad += 'x';
+    return String(R"({"jsonrpc":"2.0","id":)") + String(id) + R"(,"result":{"pad":")" + pad + "\"}}";
+}
+
+// Manager with one connected client whose socket accepts nothing
+static SSEClient& stalledClient(SSEManager& mgr, const char* session = "s1") {
+    mgr.addClient(WiFiClient(), session, "/mcp");
+    SSEClient& c = mgr._clients.back();
+    c.client.clearBuffer();
+    c.client.setWriteBudget(0);
+    return c;
+}
+
+// ── Classification ─────────────────────────────────────────────────────
+
+TEST(classify_resources_updated_per_uri) {
+    String keyA, keyA2, keyB;
+    ASSERT(_sseClassify(UPDATED_A, keyA) == SSEPriority::Low);
+    _sseClassify(UPDATED_A, keyA2);
+    _sseClassify(UPDATED_B, keyB);
+    ASSERT_FALSE(keyA.isEmpty());
+    ASSERT_STR_EQ(keyA.c_str(), keyA2.c_str());
+    ASSERT(keyA != keyB);
+}
+
+TEST(classify_progress_per_token) {
+    String k1, k2, k3;
+    ASSERT(_sseClassify(progress("t1", 1), k1) == SSEPriority::Low);
+    _sseClassify(progress("t1", 2), k2);
+    _sseClassify(progress("t2", 1), k3);
+    ASSERT_STR_EQ(k1.c_str(), k2.c_str());
+    ASSERT(k1 != k3);
+}
+
+TEST(classify_other_messages) {
+    String key;
+    ASSERT(_sseClassify(R"({"jsonrpc":"2.0","method":"notifications/tools/list_changed"})", key)
+           == SSEPriority::Low);
+    ASSERT_STR_EQ(key.c_str(), "tools/list_changed");
+    ASSERT(_sseClassify(R"({"jsonrpc":"2.0","method":"notifications/message","params":{}})", key)
+           == SSEPriority::Low);
+    ASSERT(key.isEmpty());
+    ASSERT(_sseClassify(response(1), key) == SSEPriority::Normal);
+    ASSERT(_sseClassify(R"({"jsonrpc":"2.0","id":5,"method":"sampling/createMessage"})", key)
+           == SSEPriority::Normal);
+    ASSERT(_sseClassify(R"({"jsonrpc":"2.0","method":"notifications/tasks/status","params":{}})", key)
+           == SSEPriority::Normal);
+}
+
+// ── Queue draining ─────────────────────────────────────────────────────
+
+TEST(slow_client_does_not_block_others) {
+    SSEManager mgr;
+    stalledClient(mgr, "s1");
+    mgr.addClient(WiFiClient(), "s2", "/mcp");
+    mgr._clients[1].client.clearBuffer();
+    mgr.broadcast("s1", response(1));
+    mgr.broadcast("s2", response(2));
+    ASSERT_GT((int)mgr._clients[0].outboundBytes, 0);
+    ASSERT_EQ((int)mgr._clients[1].outboundBytes, 0);
+    ASSERT_STR_CONTAINS(mgr._clients[1].client.getBuffer().c_str(), "\"id\":2");
+    ASSERT_EQ((int)mgr.queuedFrames(), 1);
+}
+
+TEST(drain_writes_bounded_slices) {
+    SSEManager mgr;
+    SSEClient& c = stalledClient(mgr);
+    mgr.broadcast("s1", response(1, 1500));
+    size_t total = c.outboundBytes;
+    c.client.setWriteBudget((size_t)-1);
+    mgr.loop();
+    ASSERT_EQ((int)c.client.getBuffer().length(), (int)SSEManager::WRITE_SLICE_BYTES);
+    mgr.loop();
+    mgr.loop();
+    mgr.loop();
+    ASSERT_EQ((int)c.client.getBuffer().length(), (int)total);
+    ASSERT_FALSE(c.hasPending());
+}
+
+TEST(partial_writes_resume_in_order) {
+    SSEManager mgr;
+    SSEClient& c = stalledClient(mgr);
+    mgr.broadcast("s1", response(1));
+    mgr.broadcast("s1", response(2));
+    c.client.setWriteBudget(7);
+    mgr.loop();
+    ASSERT_EQ((int)c.client.getBuffer().length(), 7);
+    c.client.setWriteBudget((size_t)-1);
+    mgr.loop();
+    String expected = SSEClient::formatEvent("message", response(1), 1) +
+                      SSEClient::formatEvent("message", response(2), 2);
+    ASSERT_STR_EQ(c.client.getBuffer().c_str(), expected.c_str());
+}
+
+// ── Coalescing and shedding ────────────────────────────────────────────
+
+TEST(resources_updated_coalesced_per_uri) {
+    SSEManager mgr;
+    SSEClient& c = stalledClient(mgr);
+    mgr.broadcast("s1", UPDATED_A);
+    mgr.broadcast("s1", UPDATED_B);
+    mgr.broadcast("s1", UPDATED_A);
+    mgr.broadcast("s1", UPDATED_A);
+    ASSERT_EQ((int)c.outbound.size(), 2);
+    ASSERT_EQ((int)mgr.coalescedEvents(), 2);
+    c.client.setWriteBudget((size_t)-1);
+    mgr.loop();
+    String out = c.client.getBuffer();
+    // B stays first, A is sent once with the newest id
+    ASSERT(out.indexOf("sensor://b") < out.indexOf("sensor://a"));
+    ASSERT_STR_CONTAINS(out.c_str(), "id: 4\n");
+    ASSERT_STR_NOT_CONTAINS(out.c_str(), "id: 1\n");
+}
+
+TEST(high_water_sheds_low_priority_first) {
+    SSEManager mgr;
+    mgr.setHighWaterMark(400);
+    SSEClient& c = stalledClient(mgr);
+    mgr.broadcast("s1", progress("a", 1));
+    mgr.broadcast("s1", progress("b", 1));
+    mgr.broadcast("s1", progress("c", 1));
+    ASSERT_EQ((int)c.outbound.size(), 3);
+    mgr.broadcast("s1", response(7, 150));
+    ASSERT(c.isConnected());
+    ASSERT_GT((int)mgr.shedEvents(), 0);
+    ASSERT_LE((int)c.outboundBytes, 400);
+    ASSERT(c.outbound.back().frame.indexOf("\"id\":7") >= 0);
+}
+
+TEST(low_priority_dropped_when_queue_full_of_normal) {
+    SSEManager mgr;
+    mgr.setHighWaterMark(300);
+    SSEClient& c = stalledClient(mgr);
+    mgr.broadcast("s1", response(1, 150));
+    mgr.broadcast("s1", progress("t", 1));
+    ASSERT(c.isConnected());
+    ASSERT_EQ((int)c.outbound.size(), 1);
+    ASSERT_EQ((int)mgr.shedEvents(), 1);
+}
+
+TEST(slow_consumer_disconnected) {
+    SSEManager mgr;
+    mgr.setHighWaterMark(300);
+    stalledClient(mgr);
+    mgr.broadcast("s1", response(1, 150));
+    mgr.broadcast("s1", response(2, 150));
+    ASSERT_EQ((int)mgr.slowDisconnects(), 1);
+    ASSERT_FALSE(mgr.hasClients("s1"));
+    ASSERT_EQ((int)mgr.queuedBytes(), 0);
+    // The replay buffer still has both, for a Last-Event-ID reconnect
+    ASSERT_EQ((int)mgr.replayBuffer("s1")->count(), 2);
+}
+
+TEST(stalled_queue_times_out) {
+    SSEManager mgr;
+    mgr.setStallTimeout(5000);
+    stalledClient(mgr);
+    mgr.broadcast("s1", response(1));
+    mgr.loop();
+    ASSERT(mgr.hasClients("s1"));
+    _mockMillis() += 6000;
+    mgr.loop();
+    ASSERT_FALSE(mgr.hasClients("s1"));
+    ASSERT_EQ((int)mgr.slowDisconnects(), 1);
+}
+
+TEST(keepalive_is_queued_once) {
+    SSEManager mgr;
+    SSEClient& c = stalledClient(mgr);
+    _mockMillis() += SSEManager::KEEPALIVE_INTERVAL_MS;
+    mgr.loop();
+    _mockMillis() += SSEManager::KEEPALIVE_INTERVAL_MS;
+    c.lastProgressAt = millis();  // Not stalled, just slow
+    mgr.loop();
+    ASSERT_EQ((int)c.outbound.size(), 1);
+    ASSERT_STR_EQ(c.outbound.front().frame.c_str(), ": keepalive\n\n");
+}
+
+// ── Server integration ─────────────────────────────────────────────────
+
+TEST(server_exports_queue_depth) {
+    Server s("bp");
+    String sess = s.sessions().createSession("bp-client");
+    stalledClient(s._sseManager, sess.c_str());
+    s.sessions().getSession(sess)->queue(response(1, 100));
+    s.loop();
+    ASSERT_GT((int)s.metrics().sseQueuedBytes(), 100);
+    String text = s.metrics().render();
+    ASSERT_STR_CONTAINS(text.c_str(), "# TYPE mcpd_sse_queue_bytes gauge");
+    ASSERT_STR_CONTAINS(text.c_str(), "mcpd_sse_queue_events ");
+    ASSERT_STR_CONTAINS(text.c_str(), "mcpd_sse_slow_disconnects_total 0\n");
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
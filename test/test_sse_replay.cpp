@@ -0,0 +1,246 @@
+/**
+ * mcpd — SSE Resumability (Last-Event-ID replay) tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+// Collects replayed bytes
+struct Capture {
+    std::string data;
+    size_t write(const uint8_t* d, size_t len) {
+        data.append((const char*)d, len);
+        return len;
+    }
+};
+
+static String frame(unsigned long id, const char* payload) {
+    return SSEClient::formatEvent("message", payload, id);
+}
+
+static std::string lastClientOutput(SSEManager& mgr) {
+    return mgr._clients.back().client.getBuffer().c_str();
+}
+
+static Server* startServer() {
+    Server* s = new Server("replay-test");
+    s->setMDNS(false);
+    s->begin();
+    s->_httpServer->_setBody(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})");
+    s->_httpServer->_simulateRequest("/mcp", HTTP_POST);
+    return s;
+}
+
+// ── SSEReplayBuffer ────────────────────────────────────────────────────
+
+TEST(replay_buffer_replays_after_id) {
+    SSEReplayBuffer buf;
+    buf.reset("s1", 512);
+    buf.append(1, frame(1, "a"));
+    buf.append(2, frame(2, "b"));
+    buf.append(3, frame(3, "c"));
+    Capture out;
+    ASSERT_EQ((int)buf.replay(1, out), 2);
+    std::string expected = std::string(frame(2, "b").c_str()) + frame(3, "c").c_str();
+    ASSERT_TRUE(out.data == expected);
+    ASSERT_EQ((int)buf.oldestId(), 1);
+    ASSERT_EQ((int)buf.newestId(), 3);
+}
+
+TEST(replay_buffer_nothing_newer) {
+    SSEReplayBuffer buf;
+    buf.reset("s1", 256);
+    buf.append(5, frame(5, "x"));
+    Capture out;
+    ASSERT_EQ((int)buf.replay(5, out), 0);
+    ASSERT_TRUE(out.data.empty());
+}
+
+TEST(replay_buffer_drops_oldest_when_full) {
+    SSEReplayBuffer buf;
+    String f = frame(1, "0123456789");
+    size_t record = SSEReplayBuffer::RECORD_HEADER + f.length();
+    buf.reset("s1", record * 3);
+    for (unsigned long id = 1; id <= 5; id++) buf.append(id, frame(id, "0123456789"));
+    ASSERT_EQ((int)buf.count(), 3);
+    ASSERT_EQ((int)buf.dropped(), 2);
+    ASSERT_EQ((int)buf.oldestId(), 3);
+    ASSERT_EQ((int)buf.bytes(), (int)(record * 3));
+}
+
+TEST(replay_buffer_frames_survive_wraparound) {
+    SSEReplayBuffer buf;
+    buf.reset("s1", 100);  // Not a multiple of any record size
+    for (unsigned long id = 1; id <= 40; id++) {
+        buf.append(id, frame(id, id % 2 ? "odd" : "even-payload"));
+    }
+    Capture out;
+    size_t n = buf.replay(0, out);
+    ASSERT_EQ(n, buf.count());
+    std::string expected;
+    for (unsigned long id = buf.oldestId(); id <= 40; id++) {
+        expected += frame(id, id % 2 ? "odd" : "even-payload").c_str();
+    }
+    ASSERT_TRUE(out.data == expected);
+}
+
+TEST(replay_buffer_rejects_oversized_frame) {
+    SSEReplayBuffer buf;
+    buf.reset("s1", 48);
+    buf.append(1, frame(1, "ok"));
+    ASSERT_FALSE(buf.append(2, frame(2, "this payload is far too large for the arena")));
+    ASSERT_EQ((int)buf.dropped(), 1);
+    ASSERT_EQ((int)buf.count(), 1);  // Existing event kept
+}
+
+TEST(replay_buffer_reset_keeps_arena) {
+    SSEReplayBuffer buf;
+    buf.reset("s1", 128);
+    buf.append(1, frame(1, "a"));
+    buf.reset("s2", 128);
+    ASSERT_EQ((int)buf.count(), 0);
+    ASSERT_EQ((int)buf.capacity(), 128);
+    ASSERT_STR_EQ(buf.sessionId().c_str(), "s2");
+}
+
+// ── SSEManager ─────────────────────────────────────────────────────────
+
+TEST(manager_replays_missed_events_on_reconnect) {
+    SSEManager mgr;
+    WiFiClient c;
+    mgr.addClient(c, "s1", "/mcp");
+    mgr.broadcast("s1", "{\"n\":1}");
+    // Connection drops, two more notifications are sent meanwhile
+    mgr._clients[0].client.setConnected(false);
+    mgr.broadcast("s1", "{\"n\":2}");
+    mgr.broadcast("s1", "{\"n\":3}");
+
+    mgr.addClient(WiFiClient(), "s1", "/mcp", 1);
+    std::string out = lastClientOutput(mgr);
+    size_t endpoint = out.find("event: endpoint");
+    size_t second = out.find("id: 2\nevent: message\ndata: {\"n\":2}\n\n");
+    size_t third = out.find("id: 3\nevent: message\ndata: {\"n\":3}\n\n");
+    ASSERT(endpoint != std::string::npos);
+    ASSERT(second != std::string::npos && second > endpoint);
+    ASSERT(third != std::string::npos && third > second);
+    ASSERT(out.find("{\"n\":1}") == std::string::npos);
+    ASSERT_EQ((int)mgr.replayedEvents(), 2);
+    ASSERT_EQ((int)mgr._clients.back().lastEventId, 3);
+}
+
+TEST(manager_no_replay_without_last_event_id) {
+    SSEManager mgr;
+    mgr.broadcast("s1", "{\"n\":1}");
+    mgr.addClient(WiFiClient(), "s1", "/mcp");
+    ASSERT(lastClientOutput(mgr).find("{\"n\":1}") == std::string::npos);
+    ASSERT_EQ((int)mgr.replayedEvents(), 0);
+}
+
+TEST(manager_send_to_session_replays_event_name) {
+    SSEManager mgr;
+    mgr.broadcast("s1", "{}");
+    mgr.sendToSession("s1", "progress", "half");
+    mgr.addClient(WiFiClient(), "s1", "/mcp", 1);
+    ASSERT(lastClientOutput(mgr).find("id: 2\nevent: progress\ndata: half\n\n") != std::string::npos);
+    ASSERT_EQ((int)mgr.replayedEvents(), 1);
+}
+
+TEST(manager_sessions_are_separate_and_recycled) {
+    SSEManager mgr;
+    for (size_t i = 0; i <= SSEManager::REPLAY_SESSIONS; i++) {
+        String session = String("s") + String((int)i);
+        mgr.broadcast(session, "{}");
+        mgr.broadcast(session, "{}");
+    }
+    // s0 was the least recently written and gave its slot away
+    ASSERT(mgr.replayBuffer("s0") == nullptr);
+    ASSERT_EQ((int)mgr.replayBuffer("s1")->count(), 2);
+    ASSERT_EQ((int)mgr._replay.size(), (int)SSEManager::REPLAY_SESSIONS);
+    ASSERT_EQ((int)mgr.droppedEvents(), 2);
+}
+
+TEST(manager_replay_budget_zero_disables) {
+    SSEManager mgr;
+    mgr.setReplayBudget(0);
+    mgr.broadcast("s1", "{}");
+    ASSERT(mgr.replayBuffer("s1") == nullptr);
+    mgr.addClient(WiFiClient(), "s1", "/mcp", 0);
+    mgr.addClient(WiFiClient(), "s1", "/mcp", 1);
+    ASSERT_EQ((int)mgr.replayedEvents(), 0);
+}
+
+TEST(manager_clear_session) {
+    SSEManager mgr;
+    mgr.broadcast("s1", "{}");
+    mgr.clearSession("s1");
+    ASSERT(mgr.replayBuffer("s1") == nullptr);
+    mgr.broadcast("s2", "{}");  // Reuses the freed slot
+    ASSERT_EQ((int)mgr._replay.size(), 1);
+}
+
+// ── Server integration ─────────────────────────────────────────────────
+
+TEST(server_get_with_last_event_id_replays) {
+    Server* s = startServer();
+    ASSERT_FALSE(s->_sessionId.isEmpty());
+    s->_sseManager.broadcast(s->_sessionId, "{\"jsonrpc\":\"2.0\",\"method\":\"a\"}");
+    s->_sseManager.broadcast(s->_sessionId, "{\"jsonrpc\":\"2.0\",\"method\":\"b\"}");
+
+    s->_httpServer->_setHeader(transport::HEADER_SESSION_ID, s->_sessionId);
+    s->_httpServer->_setHeader(transport::HEADER_LAST_EVENT_ID, "1");
+    s->_httpServer->_simulateRequest("/mcp", HTTP_GET);
+
+    ASSERT_EQ((int)s->_sseManager.clientCount(), 1);
+    std::string out = lastClientOutput(s->_sseManager);
+    ASSERT(out.find("\"method\":\"b\"") != std::string::npos);
+    ASSERT(out.find("\"method\":\"a\"") == std::string::npos);
+    ASSERT_EQ((int)s->metrics().sseReplayedEvents(), 1);
+    ASSERT_STR_CONTAINS(s->metrics().render().c_str(), "mcpd_sse_replayed_events_total 1");
+    s->stop();
+    delete s;
+}
+
+TEST(server_garbage_last_event_id_replays_nothing) {
+    Server* s = startServer();
+    s->_sseManager.broadcast(s->_sessionId, "{}");
+    s->_httpServer->_setHeader(transport::HEADER_SESSION_ID, s->_sessionId);
+    s->_httpServer->_setHeader(transport::HEADER_LAST_EVENT_ID, "not-a-number");
+    s->_httpServer->_simulateRequest("/mcp", HTTP_GET);
+    ASSERT_EQ((int)s->_sseManager.replayedEvents(), 0);
+    s->stop();
+    delete s;
+}
+
+TEST(server_delete_forgets_history) {
+    Server* s = startServer();
+    String session = s->_sessionId;
+    s->_sseManager.broadcast(session, "{}");
+    s->_httpServer->_setHeader(transport::HEADER_SESSION_ID, session);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_DELETE);
+    ASSERT(s->_sseManager.replayBuffer(session) == nullptr);
+    s->stop();
+    delete s;
+}
+
+TEST(server_loop_reports_dropped_events) {
+    Server* s = startServer();
+    s->sse().setReplayBudget(64);
+    for (int i = 0; i < 10; i++) {
+        s->_sseManager.broadcast(s->_sessionId, "{\"jsonrpc\":\"2.0\",\"method\":\"x\"}");
+    }
+    s->loop();
+    ASSERT_GT((int)s->metrics().sseDroppedEvents(), 0);
+    ASSERT_EQ((int)s->metrics().sseDroppedEvents(), (int)s->sse().droppedEvents());
+    s->stop();
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,483 @@
+/**
+ * Tests for MCPStatePersistence — StateStore log in a flash region
+ *
+ * Runs against a file-backed region with NOR semantics (writes can only
+ * clear bits), simulated flash timings and injected torn writes.
+ */
+
+#include "test_framework.h"
+#include "MCPStatePersistence.h"
+#include <cstdio>
+#include <unistd.h>
+
+using namespace mcpd;
+
+// ── File-backed flash stand-in ─────────────────────────────────────────
+
+class FileStorage : public StateStorage {
+public:
+    unsigned long writeCostUs = 100;
+    unsigned long eraseCostUs = 20000;
+    long tearAfter = -1;                // Next write stops after this many bytes and fails
+    bool failWrites = false;
+    size_t writes = 0;
+    size_t erases = 0;
+
+    FileStorage(size_t sectorSize, size_t sectors) : _sectorSize(sectorSize), _sectors(sectors) {
+        static int n = 0;
+        snprintf(_path, sizeof(_path), "/tmp/mcpd_state_%d_%d.bin", (int)getpid(), n++);
+        _f = fopen(_path, "w+b");
+        std::vector<uint8_t> blank(sectorSize * sectors, 0xFF);
+        fwrite(blank.data(), 1, blank.size(), _f);
+        fflush(_f);
+    }
+
+    ~FileStorage() override {
+        fclose(_f);
+        remove(_path);
+    }
+
+    size_t sectorSize() const override { return _sectorSize; }
+    size_t sectorCount() const override { return _sectors; }
+
+    bool read(size_t offset, uint8_t* data, size_t len) override {
+        if (offset + len > _sectorSize * _sectors) return false;
+        fseek(_f, (long)offset, SEEK_SET);
+        return fread(data, 1, len, _f) == len;
+    }
+
+    bool write(size_t offset, const uint8_t* data, size_t len) override {
+        _mockMicros() += writeCostUs;
+        writes++;
+        if (failWrites || offset + len > _sectorSize * _sectors) return false;
+        size_t n = len;
+        bool torn = tearAfter >= 0;
+        if (torn) {
+            if ((size_t)tearAfter < n) n = (size_t)tearAfter;
+            tearAfter = -1;
+        }
+        std::vector<uint8_t> cur(n);
+        read(offset, cur.data(), n);
+        for (size_t i = 0; i < n; i++) cur[i] &= data[i];    // NOR: program clears bits
+        if (n) {
+            fseek(_f, (long)offset, SEEK_SET);
+            fwrite(cur.data(), 1, n, _f);
+            fflush(_f);
+        }
+        return !torn;
+    }
+
+    bool erase(size_t sector) override {
+        _mockMicros() += eraseCostUs;
+        erases++;
+        if (sector >= _sectors) return false;
+        std::vector<uint8_t> blank(_sectorSize, 0xFF);
+        fseek(_f, (long)(sector * _sectorSize), SEEK_SET);
+        fwrite(blank.data(), 1, blank.size(), _f);
+        fflush(_f);
+        return true;
+    }
+
+    void corrupt(size_t offset) {
+        uint8_t b;
+        read(offset, &b, 1);
+        b ^= 0x10;
+        fseek(_f, (long)offset, SEEK_SET);
+        fwrite(&b, 1, 1, _f);
+        fflush(_f);
+    }
+
+private:
+    size_t _sectorSize;
+    size_t _sectors;
+    char _path[64];
+    FILE* _f;
+};
+
+// A device: the RAM state and its persistence, lost together on power loss
+struct Device {
+    StateStore state;
+    StatePersistence persist;
+    explicit Device(FileStorage& flash) : state(0), persist(state, flash) {}
+};
+
+// ── Mounting and replay ────────────────────────────────────────────────
+
+TEST(Persist_FormatsBlankRegion) {
+    FileStorage flash(256, 4);
+    Device dev(flash);
+    ASSERT_TRUE(dev.persist.begin());
+    ASSERT_TRUE(dev.persist.mounted());
+    ASSERT_EQ((int)dev.persist.epoch(), 1);
+    ASSERT_EQ((int)dev.persist.bytesUsed(), (int)StatePersistence::HEADER_BYTES);
+    ASSERT_EQ((int)dev.persist.capacityBytes(), 512);
+    ASSERT_EQ((int)dev.state.count(), 0);
+}
+
+TEST(Persist_RejectsTooSmallRegion) {
+    FileStorage flash(16, 1);
+    Device dev(flash);
+    ASSERT_FALSE(dev.persist.begin());
+    ASSERT_EQ((int)dev.persist.loop(), 0);
+    ASSERT_FALSE(dev.persist.flush());
+}
+
+TEST(Persist_RoundTripAcrossReboot) {
+    FileStorage flash(256, 4);
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("wifi.ssid", "lab");
+        dev.state.set("sensor.offset", "-0.25");
+        dev.state.set("empty", "");
+        ASSERT_EQ((int)dev.persist.pending(), 3);
+        ASSERT_TRUE(dev.persist.flush());
+        ASSERT_EQ((int)dev.persist.pending(), 0);
+        ASSERT_FALSE(dev.state.isDirty());
+    }
+    Device dev(flash);
+    ASSERT_TRUE(dev.persist.begin());
+    ASSERT_EQ((int)dev.persist.replayed(), 3);
+    ASSERT_EQ(dev.state.get("wifi.ssid"), String("lab"));
+    ASSERT_EQ(dev.state.get("sensor.offset"), String("-0.25"));
+    ASSERT_TRUE(dev.state.has("empty"));
+    ASSERT_FALSE(dev.state.isDirty());
+    ASSERT_EQ((int)dev.persist.pending(), 0);
+}
+
+TEST(Persist_RemovalSurvivesReboot) {
+    FileStorage flash(256, 4);
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("a", "1");
+        dev.state.set("b", "2");
+        dev.persist.flush();
+        dev.state.remove("a");
+        dev.persist.flush();
+    }
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_FALSE(dev.state.has("a"));
+    ASSERT_EQ(dev.state.get("b"), String("2"));
+}
+
+TEST(Persist_RepeatedChangesCostOneRecord) {
+    FileStorage flash(256, 4);
+    Device dev(flash);
+    dev.persist.begin();
+    for (int i = 0; i < 50; i++) dev.state.set("counter", String(i).c_str());
+    ASSERT_EQ((int)dev.persist.pending(), 1);
+    dev.persist.flush();
+    ASSERT_EQ((int)dev.persist.recordsWritten(), 1);
+    ASSERT_EQ((int)flash.writes, 2);                      // Format header + one record
+}
+
+TEST(Persist_TTLKeysNotPersisted) {
+    FileStorage flash(256, 4);
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("wifi.rssi", "-67", 5000);
+        dev.state.set("boot.count", "3");
+        ASSERT_EQ((int)dev.persist.pending(), 1);
+        dev.persist.flush();
+    }
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_FALSE(dev.state.has("wifi.rssi"));
+    ASSERT_EQ(dev.state.get("boot.count"), String("3"));
+}
+
+TEST(Persist_ChangesBeforeBeginAreQueued) {
+    FileStorage flash(256, 4);
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("mode", "auto");
+        dev.persist.flush();
+    }
+    Device dev(flash);
+    dev.state.set("mode", "default");                     // Overwritten by replay
+    dev.state.set("fresh", "1");
+    dev.persist.begin();
+    ASSERT_EQ(dev.state.get("mode"), String("auto"));
+    ASSERT_EQ((int)dev.persist.pending(), 1);
+    ASSERT_TRUE(dev.state.entry("fresh")->dirty);
+    ASSERT_FALSE(dev.state.entry("mode")->dirty);
+}
+
+// ── Budget ─────────────────────────────────────────────────────────────
+
+TEST(Persist_LoopStopsAtBudget) {
+    FileStorage flash(1024, 4);
+    flash.writeCostUs = 500;
+    Device dev(flash);
+    dev.persist.begin();
+    for (int i = 0; i < 10; i++) dev.state.set((String("k") + String(i)).c_str(), "v");
+    ASSERT_EQ((int)dev.persist.loop(2000), 4);
+    ASSERT_EQ((int)dev.persist.pending(), 6);
+    ASSERT_EQ((int)dev.persist.loop(2000), 4);
+    ASSERT_EQ((int)dev.persist.loop(2000), 2);
+    ASSERT_EQ((int)dev.persist.loop(2000), 0);
+    ASSERT_FALSE(dev.state.isDirty());
+}
+
+TEST(Persist_CompactionErasesOneSectorPerLoop) {
+    FileStorage flash(256, 8);
+    Device dev(flash);
+    dev.persist.begin();
+    dev.state.set("x", "1");
+    dev.persist.flush();
+    dev.persist.compact();
+    size_t erasesBefore = flash.erases;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(dev.persist.compacting());
+        ASSERT_EQ((int)dev.persist.loop(2000), 1);        // An erase exceeds the budget alone
+    }
+    ASSERT_EQ((int)(flash.erases - erasesBefore), 4);
+    dev.persist.loop(2000);                               // Copy + commit
+    ASSERT_FALSE(dev.persist.compacting());
+    ASSERT_EQ((int)dev.persist.epoch(), 2);
+    ASSERT_EQ((int)dev.persist.activeHalf(), 1);
+}
+
+// ── Compaction ─────────────────────────────────────────────────────────
+
+TEST(Persist_CompactionKeepsLatestValues) {
+    FileStorage flash(256, 4);
+    flash.eraseCostUs = 0;
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        for (int round = 0; round < 200; round++) {
+            for (int k = 0; k < 5; k++) {
+                dev.state.set((String("sensor.") + String(k)).c_str(), String(round * 10 + k).c_str());
+            }
+            dev.persist.loop();
+        }
+        dev.persist.flush();
+        ASSERT_GT((int)dev.persist.compactions(), 5);
+        ASSERT_LE((int)dev.persist.bytesUsed(), (int)dev.persist.capacityBytes());
+        ASSERT_EQ((int)dev.persist.skipped(), 0);
+    }
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_EQ((int)dev.state.count(), 5);
+    for (int k = 0; k < 5; k++) {
+        ASSERT_EQ(dev.state.get((String("sensor.") + String(k)).c_str()), String(1990 + k));
+    }
+}
+
+TEST(Persist_ThresholdCompactsBeforeFull) {
+    FileStorage flash(256, 4);
+    flash.eraseCostUs = 0;
+    Device dev(flash);
+    dev.persist.begin();
+    dev.persist.setCompactThreshold(50);
+    size_t maxUsed = 0;
+    for (int i = 0; i < 60; i++) {
+        dev.state.set("k", String(i).c_str());
+        dev.persist.flush();
+        if (dev.persist.bytesUsed() > maxUsed) maxUsed = dev.persist.bytesUsed();
+    }
+    ASSERT_GT((int)dev.persist.compactions(), 0);
+    ASSERT_LT((int)maxUsed, 256 + 16);                    // Never ran near the 512-byte end
+}
+
+TEST(Persist_OversizedValueSkipped) {
+    FileStorage flash(64, 4);
+    Device dev(flash);
+    dev.persist.begin();
+    String big;
+    for (int i = 0; i < 200; i++) big += "x";
+    dev.state.set("big", big.c_str());
+    dev.state.set("small", "1");
+    ASSERT_TRUE(dev.persist.flush());
+    ASSERT_EQ((int)dev.persist.skipped(), 1);
+    ASSERT_TRUE(dev.state.entry("big")->dirty);
+    ASSERT_FALSE(dev.state.entry("small")->dirty);
+}
+
+// ── Power loss ─────────────────────────────────────────────────────────
+
+TEST(Persist_TornRecordRecovered) {
+    FileStorage flash(256, 4);
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("a", "1");
+        dev.state.set("b", "2");
+        dev.persist.flush();
+        dev.state.set("c", "3");
+        flash.tearAfter = 5;                              // Power fails mid-record
+        ASSERT_FALSE(dev.persist.flush());
+        ASSERT_EQ((int)dev.persist.writeErrors(), 1);
+    }
+    {
+        Device dev(flash);
+        ASSERT_TRUE(dev.persist.begin());
+        ASSERT_EQ((int)dev.persist.tornRecords(), 1);
+        ASSERT_EQ(dev.state.get("a"), String("1"));
+        ASSERT_EQ(dev.state.get("b"), String("2"));
+        ASSERT_FALSE(dev.state.has("c"));
+        ASSERT_TRUE(dev.persist.compacting());           // Torn tail is never appended to
+        dev.state.set("d", "4");
+        ASSERT_TRUE(dev.persist.flush());
+        ASSERT_EQ((int)dev.persist.epoch(), 2);
+    }
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_EQ((int)dev.persist.tornRecords(), 0);
+    ASSERT_FALSE(dev.persist.compacting());
+    ASSERT_EQ((int)dev.state.count(), 3);
+    ASSERT_EQ(dev.state.get("d"), String("4"));
+}
+
+TEST(Persist_CorruptRecordStopsReplay) {
+    FileStorage flash(256, 4);
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("first", "1");
+        dev.persist.flush();
+        dev.state.set("second", "2");
+        dev.state.set("third", "3");
+        dev.persist.flush();
+    }
+    // Records are written in key order; this byte is in the key of "second"
+    flash.corrupt(StatePersistence::HEADER_BYTES + 14 + 10);
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_EQ(dev.state.get("first"), String("1"));
+    ASSERT_FALSE(dev.state.has("second"));
+    ASSERT_EQ((int)dev.persist.tornRecords(), 1);
+}
+
+TEST(Persist_PowerLossDuringCompactionKeepsOldHalf) {
+    FileStorage flash(256, 8);
+    flash.eraseCostUs = 0;
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("a", "1");
+        dev.state.set("b", "2");
+        dev.persist.flush();
+        dev.persist.compact();
+        for (int i = 0; i < 5; i++) dev.persist.loop(0);  // Erase 4 sectors, copy one key
+        ASSERT_TRUE(dev.persist.compacting());
+    }
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_EQ((int)dev.persist.epoch(), 1);
+    ASSERT_EQ((int)dev.persist.activeHalf(), 0);
+    ASSERT_EQ(dev.state.get("a"), String("1"));
+    ASSERT_EQ(dev.state.get("b"), String("2"));
+}
+
+TEST(Persist_TornHeaderFallsBackToOldHalf) {
+    FileStorage flash(256, 4);
+    flash.eraseCostUs = 0;
+    {
+        Device dev(flash);
+        dev.persist.begin();
+        dev.state.set("a", "1");
+        dev.persist.flush();
+        dev.persist.compact();
+        while (dev.persist.compacting()) {
+            // The commit header is the last write of a compaction
+            flash.tearAfter = flash.writes == 3 ? 6 : -1;
+            dev.persist.loop(0);
+            if (dev.persist.writeErrors() > 0) break;
+        }
+        ASSERT_EQ((int)dev.persist.writeErrors(), 1);
+        ASSERT_EQ((int)flash.writes, 4);                  // Format, record, copy, header
+    }
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_EQ((int)dev.persist.epoch(), 1);
+    ASSERT_EQ((int)dev.persist.activeHalf(), 0);
+    ASSERT_EQ(dev.state.get("a"), String("1"));
+}
+
+TEST(Persist_FailedFlashKeepsKeysQueued) {
+    FileStorage flash(256, 4);
+    Device dev(flash);
+    dev.persist.begin();
+    flash.failWrites = true;
+    dev.state.set("a", "1");
+    ASSERT_FALSE(dev.persist.flush());
+    ASSERT_TRUE(dev.state.isDirty());
+    ASSERT_EQ((int)dev.persist.pending(), 1);
+    flash.failWrites = false;
+    ASSERT_TRUE(dev.persist.flush());
+    ASSERT_FALSE(dev.state.isDirty());
+    ASSERT_EQ((int)dev.persist.epoch(), 2);               // Recovered through a compaction
+}
+
+TEST(Persist_RandomPowerLossNeverLosesFlushedState) {
+    FileStorage flash(128, 6);
+    flash.eraseCostUs = 0;
+    std::map<std::string, std::string> durable;
+    uint32_t rng = 12345;
+    auto next = [&rng]() { rng = rng * 1103515245u + 12345u; return (rng >> 16) & 0x7FFF; };
+
+    for (int boot = 0; boot < 40; boot++) {
+        Device dev(flash);
+        ASSERT_TRUE(dev.persist.begin());
+        for (auto& kv : durable) {
+            ASSERT_EQ(dev.state.get(kv.first.c_str()), String(kv.second.c_str()));
+        }
+        ASSERT_EQ((int)dev.state.count(), (int)durable.size());
+
+        // Some acknowledged work, then more that a power cut interrupts
+        for (int op = 0; op < 12; op++) {
+            String key = String("k") + String((int)(next() % 6));
+            if (next() % 4 == 0) dev.state.remove(key.c_str());
+            else dev.state.set(key.c_str(), String((int)next()).c_str());
+            if (op % 3 == 2) dev.persist.loop();
+        }
+        ASSERT_TRUE(dev.persist.flush());
+        durable.clear();
+        for (const String& k : dev.state.keys()) durable[k.c_str()] = dev.state.get(k.c_str()).c_str();
+
+        // The first queued record (k0) is torn; k9 is never reached
+        dev.state.set("k0", "lost");
+        dev.state.set("k9", "lost");
+        flash.tearAfter = (long)(next() % 14);          // The record is 14 bytes
+        ASSERT_FALSE(dev.persist.flush());
+        flash.tearAfter = -1;
+    }
+    Device dev(flash);
+    dev.persist.begin();
+    ASSERT_FALSE(dev.state.has("k9"));
+    ASSERT_EQ((int)dev.state.count(), (int)durable.size());
+}
+
+TEST(Persist_StatsJSON) {
+    FileStorage flash(256, 4);
+    Device dev(flash);
+    dev.persist.begin();
+    dev.state.set("a", "1");
+    dev.persist.flush();
+    String json = dev.persist.statsJSON();
+    ASSERT_STR_CONTAINS(json.c_str(), "\"mounted\":true");
+    ASSERT_STR_CONTAINS(json.c_str(), "\"epoch\":1");
+    ASSERT_STR_CONTAINS(json.c_str(), "\"bytesUsed\":22");
+    ASSERT_STR_CONTAINS(json.c_str(), "\"records\":1");
+    ASSERT_STR_CONTAINS(json.c_str(), "\"tornRecords\":0");
+}
+
+TEST(Persist_CRC32MatchesReference) {
+    const char* s = "123456789";
+    ASSERT_EQ(StatePersistence::crc32((const uint8_t*)s, 9), 0xCBF43926u);
+    uint32_t part = StatePersistence::crc32((const uint8_t*)s, 4);
+    ASSERT_EQ(StatePersistence::crc32((const uint8_t*)s + 4, 5, part), 0xCBF43926u);
+}
+
+// ── Run all ────────────────────────────────────────────────────────────
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -152,6 +152,31 @@ TEST(StateStore_DirtyKeys) {
     ASSERT_EQ(dk[0], String("b"));
 }
 
+TEST(StateStore_ClearDirtyOneKey) {
+    StateStore store;
+    store.set("a", "1");
+    store.set("b", "2");
+    store.clearDirty("a");
+    store.clearDirty("missing");
+    auto dk = store.dirtyKeys();
+    ASSERT_EQ((int)dk.size(), 1);
+    ASSERT_EQ(dk[0], String("b"));
+}
+
+TEST(StateStore_EntryPeeksWithoutAccess) {
+    StateStore store;
+    store.set("a", "1", 5000);
+    const StateEntry* e = store.entry("a");
+    ASSERT_TRUE(e != nullptr);
+    unsigned long access = e->lastAccess;
+    store.entry("a");
+    ASSERT_EQ(e->lastAccess, access);
+    ASSERT_EQ(e->value, String("1"));
+    ASSERT_EQ((int)e->ttlMs, 5000);
+    ASSERT_TRUE(store.entry("missing") == nullptr);
+    ASSERT_TRUE(store.entry(nullptr) == nullptr);
+}
+
 // ── Change Listeners ───────────────────────────────────────────────────
 
 TEST(StateStore_OnChangeNew) {
@@ -0,0 +1,236 @@
+/**
+ * mcpd — Resource subscription index / update coalescing tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static String rpc(Server& s, const char* method, const char* uri, int id = 1) {
+    return s._processJsonRpc(String(R"({"jsonrpc":"2.0","id":)") + String(id) +
+                             R"(,"method":")" + method + R"(","params":{"uri":")" + uri + "\"}}");
+}
+
+static String initialize(Server& s) {
+    s._processJsonRpc(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})");
+    return s._sessionId;
+}
+
+static size_t pendingFor(Server& s, const String& session) {
+    const Session* info = s.sessions().getSession(session);
+    return info ? info->pending.size() : 0;
+}
+
+// ── Template matching ──────────────────────────────────────────────────
+
+TEST(template_match_literal_and_variables) {
+    ASSERT(uriTemplateMatches("sensor://{id}/reading", "sensor://t1/reading"));
+    ASSERT(uriTemplateMatches("dev://{d}/ch/{c}", "dev://pump/ch/3"));
+    ASSERT(uriTemplateMatches("log://{name}", "log://a/b"));
+    ASSERT(uriTemplateMatches("plain://x", "plain://x"));
+    ASSERT_FALSE(uriTemplateMatches("sensor://{id}/reading", "sensor://t1/other"));
+    ASSERT_FALSE(uriTemplateMatches("sensor://{id}/reading", "sensor:///reading"));
+    ASSERT_FALSE(uriTemplateMatches("sensor://{id}/reading", "sensor://t1/reading/x"));
+    ASSERT_FALSE(uriTemplateMatches("plain://x", "plain://xy"));
+}
+
+TEST(template_match_agrees_with_resource_template) {
+    const char* tpls[] = {"sensor://{id}/reading", "dev://{d}/ch/{c}", "log://{name}"};
+    const char* uris[] = {"sensor://t1/reading", "sensor://t1/x", "dev://a/ch/1",
+                          "dev://a/cx/1", "log://x", "log://", "sensor://a/b/reading"};
+    for (const char* tpl : tpls) {
+        MCPResourceTemplate t(tpl, "t", "d", "text/plain", nullptr);
+        for (const char* uri : uris) {
+            std::map<String, String> params;
+            ASSERT_EQ(uriTemplateMatches(tpl, uri), t.match(uri, params));
+        }
+    }
+}
+
+// ── SubscriptionIndex ──────────────────────────────────────────────────
+
+TEST(index_masks_per_subscriber) {
+    SubscriptionIndex idx;
+    ASSERT(idx.subscribe("a", "sensor://1"));
+    ASSERT(idx.subscribe("b", "sensor://1"));
+    ASSERT(idx.subscribe("b", "sensor://2"));
+    ASSERT(idx.subscribe("b", "sensor://2"));  // Idempotent
+    ASSERT_EQ((int)idx.subscriberCount(), 2);
+    ASSERT_EQ((int)idx.uriCount(), 2);
+    ASSERT_EQ((int)idx.subscriptionCount("b"), 2);
+
+    std::vector<String> hit;
+    idx.forEachSubscriber(idx.match("sensor://1"), [&](const String& s) { hit.push_back(s); });
+    ASSERT_EQ((int)hit.size(), 2);
+    ASSERT(idx.isSubscribed("b", "sensor://2"));
+    ASSERT_FALSE(idx.isSubscribed("a", "sensor://2"));
+    ASSERT_EQ((int)idx.match("sensor://3"), 0);
+}
+
+TEST(index_patterns_match_concrete_uris) {
+    SubscriptionIndex idx;
+    idx.subscribe("a", "sensor://{id}/reading");
+    idx.subscribe("b", "sensor://t1/reading");
+    ASSERT_EQ((int)idx.patternCount(), 1);
+    ASSERT(idx.isSubscribed("a", "sensor://t7/reading"));
+    ASSERT_FALSE(idx.isSubscribed("b", "sensor://t7/reading"));
+    int n = 0;
+    idx.forEachSubscriber(idx.match("sensor://t1/reading"), [&](const String&) { n++; });
+    ASSERT_EQ(n, 2);
+}
+
+TEST(index_unsubscribe_frees_slot) {
+    SubscriptionIndex idx;
+    idx.subscribe("a", "x://1");
+    idx.subscribe("a", "x://{n}");
+    ASSERT(idx.unsubscribe("a", "x://1"));
+    ASSERT_EQ((int)idx.subscriberCount(), 1);
+    ASSERT_FALSE(idx.unsubscribe("a", "x://1"));
+    ASSERT(idx.unsubscribe("a", "x://{n}"));
+    ASSERT_EQ((int)idx.subscriberCount(), 0);
+    ASSERT_EQ((int)idx.uriCount(), 0);
+    ASSERT_EQ((int)idx.patternCount(), 0);
+}
+
+TEST(index_remove_subscriber_keeps_others) {
+    SubscriptionIndex idx;
+    idx.subscribe("a", "x://1");
+    idx.subscribe("b", "x://1");
+    idx.subscribe("a", "x://{n}");
+    idx.removeSubscriber("a");
+    ASSERT_FALSE(idx.isSubscribed("a", "x://1"));
+    ASSERT(idx.isSubscribed("b", "x://1"));
+    ASSERT_EQ((int)idx.patternCount(), 0);
+    ASSERT_EQ((int)idx.subscriberCount(), 1);
+}
+
+TEST(index_full_rejects_new_subscriber) {
+    SubscriptionIndex idx;
+    for (size_t i = 0; i < SubscriptionIndex::MAX_SUBSCRIBERS; i++) {
+        ASSERT(idx.subscribe(String("s") + String((int)i), "x://1"));
+    }
+    ASSERT_FALSE(idx.subscribe("late", "x://1"));
+    ASSERT(idx.subscribe("s0", "x://2"));  // Existing subscribers still can
+    idx.removeSubscriber("s3");
+    ASSERT(idx.subscribe("late", "x://1"));
+}
+
+// ── UpdateCoalescer ────────────────────────────────────────────────────
+
+TEST(coalescer_disabled_admits_everything) {
+    UpdateCoalescer c;
+    ASSERT(c.admit("x://1", 0));
+    ASSERT(c.admit("x://1", 1));
+    ASSERT_EQ((int)c.pending(), 0);
+}
+
+TEST(coalescer_folds_updates_inside_window) {
+    UpdateCoalescer c;
+    c.setWindow(100);
+    ASSERT(c.admit("x://1", 1000));
+    ASSERT_FALSE(c.admit("x://1", 1010));
+    ASSERT_FALSE(c.admit("x://1", 1050));
+    ASSERT(c.admit("x://2", 1050));  // Other URIs are independent
+    ASSERT_EQ((int)c.pending(), 1);
+    ASSERT_EQ((int)c.coalesced(), 1);
+
+    std::vector<String> sent;
+    auto send = [&](const String& uri) { sent.push_back(uri); };
+    ASSERT_EQ((int)c.flush(1090, send), 0);
+    ASSERT_EQ((int)c.flush(1100, send), 1);
+    ASSERT_STR_EQ(sent[0].c_str(), "x://1");
+    // The flushed update starts a new window
+    ASSERT_FALSE(c.admit("x://1", 1150));
+    ASSERT_EQ((int)c.flush(1200, send), 1);
+    ASSERT_EQ((int)sent.size(), 2);
+}
+
+TEST(coalescer_forgets_idle_uris) {
+    UpdateCoalescer c;
+    c.setWindow(100);
+    c.admit("x://1", 0);
+    c.flush(200, [](const String&) {});
+    ASSERT(c.admit("x://1", 201));  // No stale window left behind
+}
+
+// ── Server integration ─────────────────────────────────────────────────
+
+TEST(server_pattern_subscription_receives_updates) {
+    Server s("subs");
+    String a = initialize(s);
+    rpc(s, "resources/subscribe", "sensor://{id}/reading");
+    String b = initialize(s);
+    rpc(s, "resources/subscribe", "sensor://t2/reading");
+
+    s.notifyResourceUpdated("sensor://t1/reading");
+    ASSERT_EQ((int)pendingFor(s, a), 1);
+    ASSERT_EQ((int)pendingFor(s, b), 0);
+    s.notifyResourceUpdated("sensor://t2/reading");
+    ASSERT_EQ((int)pendingFor(s, a), 2);
+    ASSERT_EQ((int)pendingFor(s, b), 1);
+    ASSERT_STR_EQ(s.sessions().getSession(a)->pending[1].c_str(),
+                  s.sessions().getSession(b)->pending[0].c_str());
+}
+
+TEST(server_coalesces_high_rate_updates) {
+    Server s("subs");
+    s.setResourceUpdateWindow(500);
+    String a = initialize(s);
+    rpc(s, "resources/subscribe", "sensor://fast");
+    // 10 Hz for one second
+    for (int i = 0; i < 10; i++) {
+        s.notifyResourceUpdated("sensor://fast");
+        _mockMillis() += 100;
+        s.loop();
+    }
+    size_t sent = pendingFor(s, a);
+    ASSERT_GE((int)sent, 2);
+    ASSERT_LE((int)sent, 3);
+    ASSERT_GT((int)s._resourceUpdates.coalesced(), 0);
+    // The last update is not lost
+    _mockMillis() += 600;
+    s.loop();
+    ASSERT_EQ((int)s._resourceUpdates.pending(), 0);
+}
+
+TEST(server_unsubscribed_uri_not_tracked) {
+    Server s("subs");
+    s.setResourceUpdateWindow(500);
+    s.notifyResourceUpdated("sensor://nobody");
+    ASSERT_EQ((int)s._resourceUpdates.pending(), 0);
+    ASSERT_EQ((int)s._pendingNotifications.size(), 0);
+}
+
+TEST(server_session_end_releases_subscriber) {
+    Server* s = new Server("subs");
+    s->setMDNS(false);
+    s->begin();
+    String a = initialize(*s);
+    rpc(*s, "resources/subscribe", "sensor://1");
+    ASSERT_EQ((int)s->subscriptions().subscriberCount(), 1);
+    s->_httpServer->_setHeader(transport::HEADER_SESSION_ID, a);
+    s->_httpServer->_simulateRequest("/mcp", HTTP_DELETE);
+    ASSERT_EQ((int)s->subscriptions().subscriberCount(), 0);
+    s->stop();
+    delete s;
+}
+
+TEST(server_too_many_subscribers) {
+    Server s("subs");
+    s.setMaxSessions(0);
+    for (size_t i = 0; i < SubscriptionIndex::MAX_SUBSCRIBERS; i++) {
+        initialize(s);
+        ASSERT_STR_CONTAINS(rpc(s, "resources/subscribe", "x://1").c_str(), "\"result\"");
+    }
+    initialize(s);
+    ASSERT_STR_CONTAINS(rpc(s, "resources/subscribe", "x://1").c_str(), "Too many subscribers");
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+/**
+ * mcpd — Time-series store tests
+ *
+ * Delta-of-delta and XOR encoding round trips, block eviction, rollups,
+ * downsampling queries and the timeseries_query tool and resources.
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+#include "tools/MCPTimeSeriesTool.h"
+
+using namespace mcpd;
+
+struct Point {
+    uint32_t ts;
+    double value;
+};
+
+static std::vector<Point> points(const TimeSeries& s, uint32_t from = 0, uint32_t to = UINT32_MAX) {
+    std::vector<Point> out;
+    s.forEach(from, to, [&out](uint32_t ts, double v) {
+        out.push_back(Point{ts, v});
+        return true;
+    });
+    return out;
+}
+
+// Deterministic sensor-like signal: slow drift plus small noise
+static float reading(int i) {
+    uint32_t h = (uint32_t)i * 2654435761u;
+    return 21.5f + (float)(i % 600) / 200.0f + (float)((h >> 16) % 8) * 0.0625f;
+}
+
+static size_t gDayPoints = 0;
+static size_t gDayBytes = 0;
+static float gBitsPerPoint = 0;
+
+// ── Encoding ───────────────────────────────────────────────────────────
+
+TEST(float_round_trip_is_exact) {
+    TimeSeries s("temp", 4096);
+    for (int i = 0; i < 500; i++) s.append(1000 + i * 1000, reading(i));
+    auto got = points(s);
+    ASSERT_EQ((int)got.size(), 500);
+    for (int i = 0; i < 500; i++) {
+        ASSERT_EQ(got[i].ts, (uint32_t)(1000 + i * 1000));
+        ASSERT(got[i].value == (double)reading(i));
+    }
+}
+
+TEST(special_floats_round_trip) {
+    TimeSeries s("odd", 1024);
+    const float values[] = {0.0f, -0.0f, 1e-38f, -3.4e38f, 3.4e38f, 1.0f, 1.0f, -1.0f, 0.1f, 12345.678f};
+    uint32_t t = 0;
+    for (float v : values) s.append(t += 7, v);
+    auto got = points(s);
+    ASSERT_EQ((int)got.size(), 10);
+    for (int i = 0; i < 10; i++) {
+        float f = (float)got[i].value;
+        ASSERT(memcmp(&f, &values[i], sizeof(f)) == 0);
+    }
+}
+
+TEST(irregular_timestamps_round_trip) {
+    TimeSeries s("jitter", 4096);
+    uint32_t t = 5;
+    std::vector<uint32_t> stamps;
+    for (int i = 0; i < 300; i++) {
+        // Jitter, a few long gaps and repeated timestamps
+        t += (i % 50 == 0) ? 3600000u : (i % 7 == 0 ? 0u : 990u + (uint32_t)(i * 37) % 25);
+        stamps.push_back(t);
+        s.append(t, i);
+    }
+    auto got = points(s);
+    ASSERT_EQ((int)got.size(), 300);
+    for (int i = 0; i < 300; i++) ASSERT_EQ(got[i].ts, stamps[i]);
+}
+
+TEST(int_series_round_trip) {
+    TimeSeries s("adc", 1024, SeriesType::Int, "raw");
+    const int32_t values[] = {2048, 2049, 2047, 2047, 4095, 0, -100000, 2000000000, -2000000000, 7};
+    for (int i = 0; i < 10; i++) s.append(i * 100, values[i]);
+    auto got = points(s);
+    ASSERT_EQ((int)got.size(), 10);
+    for (int i = 0; i < 10; i++) ASSERT_EQ((int32_t)got[i].value, values[i]);
+    s.append(1000, 2.6);
+    ASSERT_EQ((int)s.lastValue(), 3);                  // Int series round
+}
+
+TEST(steady_stream_compresses) {
+    TimeSeries s("flat", 4096);
+    for (int i = 0; i < 1000; i++) s.append(i * 1000, 20.0f);
+    ASSERT_EQ((int)s.count(), 1000);
+    ASSERT_LE((int)s.bytesUsed(), 300);                // ~2 bits per point
+    ASSERT_LE((int)(s.bitsPerPoint() * 10), 25);
+}
+
+TEST(out_of_order_point_dropped) {
+    TimeSeries s("t", 1024);
+    ASSERT(s.append(5000, 1));
+    ASSERT(s.append(5000, 2));                          // Same time is fine
+    ASSERT_FALSE(s.append(4999, 3));
+    ASSERT_EQ((int)s.outOfOrder(), 1);
+    ASSERT_EQ((int)s.count(), 2);
+    ASSERT_EQ((int)s.lastValue(), 2);
+}
+
+// ── Capacity ───────────────────────────────────────────────────────────
+
+TEST(full_series_drops_oldest_block) {
+    TimeSeries s("t", 512);                             // Four blocks
+    for (int i = 0; i < 5000; i++) s.append(i * 1000, reading(i));
+    ASSERT_LE((int)s.bytesUsed(), 512);
+    ASSERT_GT((int)s.count(), 100);
+    ASSERT_EQ((int)s.totalAppended(), 5000);
+    auto got = points(s);
+    ASSERT_EQ(got.size(), s.count());
+    ASSERT_EQ(got.back().ts, (uint32_t)4999000);
+    ASSERT_EQ(got.front().ts, s.firstTimestamp());
+    int first = (int)(got.front().ts / 1000);
+    for (size_t i = 0; i < got.size(); i++) ASSERT(got[i].value == (double)reading(first + (int)i));
+}
+
+TEST(day_of_1hz_readings_fits) {
+    // A 0.1-degree sensor drifting slowly, sampled at 1 Hz with a little
+    // scheduling jitter
+    TimeSeries s("temp", 64 * 1024);
+    for (int i = 0; i < 86400; i++) {
+        float v = 20.0f + (float)((i / 37) % 50) * 0.1f;
+        s.append(i * 1000 + (i % 10 == 0 ? 1 : 0), v);
+    }
+    gDayPoints = s.count();
+    gDayBytes = s.bytesUsed();
+    gBitsPerPoint = s.bitsPerPoint();
+    ASSERT_EQ((int)s.count(), 86400);                  // Nothing evicted
+    ASSERT_EQ(s.firstTimestamp(), (uint32_t)1);
+}
+
+// ── Queries and rollups ────────────────────────────────────────────────
+
+TEST(window_query_and_early_stop) {
+    TimeSeries s("t", 4096);
+    for (int i = 0; i < 1000; i++) s.append(i * 1000, i);
+    auto got = points(s, 10000, 19500);
+    ASSERT_EQ((int)got.size(), 10);
+    ASSERT_EQ(got[0].ts, (uint32_t)10000);
+    int visited = 0;
+    size_t n = s.forEach(0, UINT32_MAX, [&visited](uint32_t, double) { return ++visited < 3; });
+    ASSERT_EQ((int)n, 3);
+    ASSERT_EQ((int)points(s, 2000000, 3000000).size(), 0);
+}
+
+TEST(rollup_matches_points) {
+    TimeSeries s("t", 64 * 1024);
+    s.addRollup(60000, 60);
+    for (int i = 0; i < 600; i++) s.append(i * 1000, reading(i));
+    ASSERT(s.hasRollup(60000));
+    ASSERT_FALSE(s.hasRollup(30000));
+
+    std::vector<SeriesBucket> kept, computed;
+    s.rollup(60000, 0, UINT32_MAX, [&kept](const SeriesBucket& b) { kept.push_back(b); return true; });
+    s.rollup(30000, 0, UINT32_MAX, [&computed](const SeriesBucket& b) { computed.push_back(b); return true; });
+    ASSERT_EQ((int)kept.size(), 10);
+    ASSERT_EQ((int)computed.size(), 20);
+    for (int m = 0; m < 10; m++) {
+        const SeriesBucket& a = computed[m * 2];
+        const SeriesBucket& b = computed[m * 2 + 1];
+        ASSERT_EQ(kept[m].startMs, (uint32_t)(m * 60000));
+        ASSERT_EQ((int)kept[m].count, 60);
+        ASSERT(kept[m].min == (a.min < b.min ? a.min : b.min));
+        ASSERT(kept[m].max == (a.max > b.max ? a.max : b.max));
+        double avg = (a.sum + b.sum) / 60.0;
+        ASSERT(fabs(kept[m].avg() - avg) < 1e-6);
+    }
+}
+
+TEST(rollup_outlives_points_and_skips_gaps) {
+    TimeSeries s("t", 256);                             // Two blocks of points
+    s.addRollup(3600000, 24);
+    for (int h = 0; h < 30; h++) {
+        if (h == 10 || h == 11) continue;               // Device was off
+        for (int i = 0; i < 60; i++) s.append(h * 3600000 + i * 60000, h);
+    }
+    ASSERT_LT((int)s.count(), 28 * 60);
+    ASSERT_GT(s.firstTimestamp(), (uint32_t)12 * 3600000);   // Raw points are gone...
+    std::vector<SeriesBucket> hours;
+    s.rollup(3600000, 0, UINT32_MAX, [&hours](const SeriesBucket& b) { hours.push_back(b); return true; });
+    ASSERT_EQ((int)hours.size(), 22);                  // ...the hours 6..29 are not (10, 11 empty)
+    ASSERT_EQ(hours[0].startMs, (uint32_t)6 * 3600000);
+    ASSERT_EQ((int)hours[0].avg(), 6);
+    ASSERT_EQ((int)hours[4].avg(), 12);
+    ASSERT_EQ((int)hours.back().count, 60);
+}
+
+// ── MCP tool and resources ─────────────────────────────────────────────
+
+static Server* makeServer(TimeSeriesStore& store) {
+    Server* s = new Server("ts-test");
+    s->setMDNS(false);
+    tools::TimeSeriesTool::attach(*s, store);
+    return s;
+}
+
+static String call(Server* s, const char* args) {
+    return s->_processJsonRpc(String(R"({"jsonrpc":"2.0","id":1,"method":"tools/call","params":{"name":"timeseries_query","arguments":)") +
+                              args + "}}");
+}
+
+TEST(tool_returns_points_and_buckets) {
+    TimeSeriesStore store;
+    TimeSeries& t = store.add("temperature", 8192, SeriesType::Float, "C");
+    t.addRollup(60000, 10);
+    for (int i = 0; i < 300; i++) store.append("temperature", i * 1000, 20.0 + (i / 60));
+    Server* s = makeServer(store);
+
+    String resp = call(s, R"({"series":"temperature","last_ms":2000})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "[297000,24]");
+    ASSERT_STR_CONTAINS(resp.c_str(), "[299000,24]");
+    ASSERT_STR_NOT_CONTAINS(resp.c_str(), "296000");
+
+    resp = call(s, R"({"series":"temperature","bucket_ms":60000})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "rollup");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\\\"t\\\":240000");
+    ASSERT_STR_CONTAINS(resp.c_str(), "\\\"count\\\":60");
+
+    resp = call(s, R"({"series":"temperature","bucket_ms":120000,"limit":2})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "points");         // Computed from points
+    ASSERT_STR_CONTAINS(resp.c_str(), "truncated");
+
+    resp = call(s, R"({"series":"pressure"})");
+    ASSERT_STR_CONTAINS(resp.c_str(), "Unknown series");
+    delete s;
+}
+
+TEST(resources_list_and_summarize_series) {
+    TimeSeriesStore store;
+    store.add("humidity", 1024, SeriesType::Float, "%").addRollup(60000, 5);
+    store.add("adc", 1024, SeriesType::Int);
+    ASSERT(&store.add("adc") == store.find("adc"));   // add() returns the existing series
+    store.record("humidity", 40.5);
+    ASSERT_FALSE(store.record("missing", 1));
+    Server* s = makeServer(store);
+
+    String list = s->_processJsonRpc(R"({"jsonrpc":"2.0","id":1,"method":"resources/read","params":{"uri":"timeseries://list"}})");
+    ASSERT_STR_CONTAINS(list.c_str(), "humidity");
+    ASSERT_STR_CONTAINS(list.c_str(), "adc");
+
+    String one = s->_processJsonRpc(R"({"jsonrpc":"2.0","id":2,"method":"resources/read","params":{"uri":"timeseries://humidity"}})");
+    ASSERT_STR_CONTAINS(one.c_str(), "last_value");
+    ASSERT_STR_CONTAINS(one.c_str(), "40.5");
+    ASSERT_STR_CONTAINS(one.c_str(), "bucket_ms");
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    printf("\n  86400 1 Hz float readings: %zu bytes (%.1f bits/point) vs ~%zu KB as EventStore Strings\n",
+           gDayBytes, gBitsPerPoint, gDayPoints * 80 / 1024);
+    return _tests_failed > 0 ? 1 : 0;
+}
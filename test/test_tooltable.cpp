@@ -0,0 +1,236 @@
+/**
+ * mcpd — Tool Table tests
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+using namespace mcpd;
+
+static String callTool(Server& s, const char* name) {
+    String req = String("{\"jsonrpc\":\"2.0\",\"method\":\"tools/call\",\"params\":{\"name\":\"")
+               + name + "\",\"arguments\":{}},\"id\":1}";
+    return s._processJsonRpc(req);
+}
+
+static void addNamedTool(std::vector<MCPTool>& tools, ToolTable& table, const char* name) {
+    tools.emplace_back(name, "", "{}", [](const JsonObject&) -> String { return "{}"; });
+    table.add(tools);
+}
+
+// ── Unit Tests: ToolTable ──────────────────────────────────────────────
+
+TEST(tooltable_hash_is_stable) {
+    ASSERT_EQ(toolNameHash("gpio_read"), toolNameHash("gpio_read"));
+    ASSERT_NE(toolNameHash("gpio_read"), toolNameHash("gpio_write"));
+    ASSERT_EQ(toolNameHash(""), toolNameHash(nullptr));
+}
+
+TEST(tooltable_empty_find) {
+    std::vector<MCPTool> tools;
+    ToolTable table;
+    ASSERT_EQ(table.find("anything", tools), -1);
+    ASSERT_EQ(table.find(nullptr, tools), -1);
+    ASSERT_EQ((int)table.size(), 0);
+}
+
+TEST(tooltable_add_and_find) {
+    std::vector<MCPTool> tools;
+    ToolTable table;
+    addNamedTool(tools, table, "a");
+    addNamedTool(tools, table, "b");
+    addNamedTool(tools, table, "c");
+    ASSERT_EQ(table.find("a", tools), 0);
+    ASSERT_EQ(table.find("b", tools), 1);
+    ASSERT_EQ(table.find("c", tools), 2);
+    ASSERT_EQ(table.find("d", tools), -1);
+    ASSERT_EQ(table.slot(1).hash, toolNameHash("b"));
+}
+
+TEST(tooltable_grows_past_load_factor) {
+    std::vector<MCPTool> tools;
+    tools.reserve(300);
+    ToolTable table;
+    char name[16];
+    for (int i = 0; i < 300; i++) {
+        snprintf(name, sizeof(name), "tool_%d", i);
+        addNamedTool(tools, table, name);
+    }
+    ASSERT_EQ((int)table.size(), 300);
+    ASSERT_GE(table.capacity() * 3, table.size() * 4);
+    for (int i = 0; i < 300; i++) {
+        snprintf(name, sizeof(name), "tool_%d", i);
+        ASSERT_EQ(table.find(name, tools), i);
+    }
+}
+
+TEST(tooltable_duplicate_keeps_first) {
+    std::vector<MCPTool> tools;
+    ToolTable table;
+    addNamedTool(tools, table, "dup");
+    tools.emplace_back("dup", "", "{}", [](const JsonObject&) -> String { return "{}"; });
+    size_t owner = table.add(tools);
+    ASSERT_EQ((int)owner, 0);
+    ASSERT_EQ(table.find("dup", tools), 0);
+    ASSERT_EQ((int)table.size(), 2);
+}
+
+TEST(tooltable_remove_reindexes) {
+    std::vector<MCPTool> tools;
+    ToolTable table;
+    addNamedTool(tools, table, "a");
+    addNamedTool(tools, table, "b");
+    addNamedTool(tools, table, "c");
+    tools.erase(tools.begin());
+    table.removeAt(0, tools);
+    ASSERT_EQ(table.find("a", tools), -1);
+    ASSERT_EQ(table.find("b", tools), 0);
+    ASSERT_EQ(table.find("c", tools), 1);
+}
+
+TEST(tooltable_remove_promotes_duplicate) {
+    std::vector<MCPTool> tools;
+    ToolTable table;
+    addNamedTool(tools, table, "x");
+    addNamedTool(tools, table, "x");
+    tools.erase(tools.begin());
+    table.removeAt(0, tools);
+    ASSERT_EQ(table.find("x", tools), 0);
+}
+
+TEST(tooltable_slot_is_callable) {
+    ToolSlot slot;
+    ASSERT_TRUE(slot.isCallable());
+    slot.groupDisabled = true;
+    ASSERT_FALSE(slot.isCallable());
+    slot.groupDisabled = false;
+    slot.enabled = false;
+    ASSERT_FALSE(slot.isCallable());
+}
+
+// ── Revision counters ──────────────────────────────────────────────────
+
+TEST(toolgroup_revision_bumps_on_change) {
+    ToolGroupManager groups;
+    uint32_t r0 = groups.revision();
+    groups.addToolToGroup("t", "g");
+    uint32_t r1 = groups.revision();
+    ASSERT_NE(r0, r1);
+    groups.enableGroup("g", true);  // no-op
+    ASSERT_EQ(groups.revision(), r1);
+    groups.disableGroup("g");
+    ASSERT_NE(groups.revision(), r1);
+}
+
+TEST(cache_revision_bumps_on_ttl_change) {
+    ToolResultCache cache;
+    uint32_t r0 = cache.revision();
+    cache.setToolTTL("t", 1000);
+    ASSERT_NE(cache.revision(), r0);
+}
+
+// ── Server integration ─────────────────────────────────────────────────
+
+TEST(server_call_resolves_through_table) {
+    Server s("test");
+    int aCalls = 0, bCalls = 0;
+    s.addTool("a", "", "{}", [&](const JsonObject&) -> String { aCalls++; return "{}"; });
+    s.addTool("b", "", "{}", [&](const JsonObject&) -> String { bCalls++; return "{}"; });
+    callTool(s, "b");
+    callTool(s, "b");
+    callTool(s, "a");
+    ASSERT_EQ(aCalls, 1);
+    ASSERT_EQ(bCalls, 2);
+    ASSERT_EQ((int)s._toolTable.size(), 2);
+}
+
+TEST(server_unknown_tool_not_found) {
+    Server s("test");
+    s.addTool("a", "", "{}", [](const JsonObject&) -> String { return "{}"; });
+    String resp = callTool(s, "missing");
+    ASSERT_STR_CONTAINS(resp.c_str(), "Tool not found: missing");
+}
+
+TEST(server_rich_handler_in_slot) {
+    Server s("test");
+    s.addRichTool("rich", "", "{}", [](const JsonObject&) -> MCPToolResult {
+        return MCPToolResult::text("from-rich");
+    });
+    ASSERT_TRUE((bool)s._toolTable.slot(0).richHandler);
+    String resp = callTool(s, "rich");
+    ASSERT_STR_CONTAINS(resp.c_str(), "from-rich");
+}
+
+TEST(server_task_support_in_slot) {
+    Server s("test");
+    s.addTaskTool("slow", "", "{}", [](const String&, JsonVariant) {},
+                  TaskSupport::Required);
+    const ToolSlot* slot = s._toolTable.findSlot("slow", s._tools);
+    ASSERT_TRUE(slot != nullptr);
+    ASSERT_TRUE(slot->taskSupport == TaskSupport::Required);
+    ASSERT_TRUE((bool)slot->taskHandler);
+    String resp = callTool(s, "slow");
+    ASSERT_STR_CONTAINS(resp.c_str(), "requires task execution");
+}
+
+TEST(server_disable_updates_slot) {
+    Server s("test");
+    s.addTool("t", "", "{}", [](const JsonObject&) -> String { return "{}"; });
+    ASSERT_TRUE(s.disableTool("t"));
+    ASSERT_FALSE(s._toolTable.slot(0).enabled);
+    ASSERT_STR_CONTAINS(callTool(s, "t").c_str(), "Tool not found");
+    ASSERT_TRUE(s.enableTool("t"));
+    ASSERT_STR_NOT_CONTAINS(callTool(s, "t").c_str(), "error");
+}
+
+TEST(server_group_change_via_manager_is_seen) {
+    Server s("test");
+    s.addTool("t", "", "{}", [](const JsonObject&) -> String { return "{}"; });
+    s.toolGroups().addToolToGroup("t", "g");
+    s.toolGroups().disableGroup("g");  // bypasses Server::enableToolGroup
+    ASSERT_FALSE(s.isToolEnabled("t"));
+    ASSERT_STR_CONTAINS(callTool(s, "t").c_str(), "Tool not found");
+    s.toolGroups().enableGroup("g");
+    ASSERT_TRUE(s.isToolEnabled("t"));
+}
+
+TEST(server_tool_added_to_disabled_group_later) {
+    Server s("test");
+    s.toolGroups().addToolToGroup("late", "g");
+    s.toolGroups().disableGroup("g");
+    s.addTool("late", "", "{}", [](const JsonObject&) -> String { return "{}"; });
+    ASSERT_TRUE(s._toolTable.slot(0).groupDisabled);
+    ASSERT_FALSE(s.isToolEnabled("late"));
+}
+
+TEST(server_cache_ttl_mirrored_into_slot) {
+    Server s("test");
+    int calls = 0;
+    s.addTool("t", "", "{}", [&](const JsonObject&) -> String { calls++; return "{}"; });
+    s.enableCache();
+    s.cache().setToolTTL("t", 60000);
+    callTool(s, "t");
+    ASSERT_EQ((int)s._toolTable.slot(0).cacheTtlMs, 60000);
+    callTool(s, "t");
+    ASSERT_EQ(calls, 1);
+}
+
+TEST(server_remove_tool_keeps_others_resolvable) {
+    Server s("test");
+    s.addTool("a", "", "{}", [](const JsonObject&) -> String { return "{\"v\":\"a\"}"; });
+    s.addRichTool("b", "", "{}", [](const JsonObject&) -> MCPToolResult {
+        return MCPToolResult::text("rich-b");
+    });
+    ASSERT_TRUE(s.removeTool("a"));
+    ASSERT_FALSE(s.removeTool("a"));
+    ASSERT_STR_CONTAINS(callTool(s, "b").c_str(), "rich-b");
+    ASSERT_STR_CONTAINS(callTool(s, "a").c_str(), "Tool not found");
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
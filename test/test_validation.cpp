@@ -829,6 +829,147 @@ TEST(server_output_validation_no_outputschema_skips) {
     ASSERT_STR_CONTAINS(r.c_str(), "anything goes");
 }
 
+// ═══════════════════════════════════════════════════════════════════════
+// CompiledSchema — must report exactly what the JsonObject path reports
+// ═══════════════════════════════════════════════════════════════════════
+
+static bool sameArgumentsResult(const char* schemaJson, const char* argsJson) {
+    JsonDocument schemaDoc;
+    deserializeJson(schemaDoc, schemaJson);
+    JsonDocument argsDoc;
+    deserializeJson(argsDoc, argsJson);
+    CompiledSchema compiled;
+    compiled.compile(schemaJson);
+    ValidationResult a = validateArguments(argsDoc.as<JsonObject>(), schemaDoc.as<JsonObject>());
+    ValidationResult b = validateArguments(argsDoc.as<JsonObject>(), compiled);
+    return a.valid == b.valid && a.toString() == b.toString();
+}
+
+static bool sameValueResult(const char* schemaJson, const char* valueJson) {
+    JsonDocument schemaDoc;
+    deserializeJson(schemaDoc, schemaJson);
+    JsonDocument valueDoc;
+    deserializeJson(valueDoc, valueJson);
+    CompiledSchema compiled;
+    compiled.compile(schemaJson);
+    ValidationResult a = validateValue(valueDoc.as<JsonVariant>(), schemaDoc.as<JsonObject>());
+    ValidationResult b = validateValue(valueDoc.as<JsonVariant>(), compiled);
+    return a.valid == b.valid && a.toString() == b.toString();
+}
+
+static const char* kSensorSchema = R"({"type":"object","properties":{
+    "pin":{"type":"integer","minimum":0,"maximum":39},
+    "mode":{"type":"string","enum":["input","output","pullup"]},
+    "label":{"type":"string","minLength":2,"maxLength":8},
+    "samples":{"type":"array","minItems":1,"maxItems":3},
+    "gain":{"type":"number","enum":[1,2,4]},
+    "config":{"type":"object","properties":{
+        "rate":{"type":"integer","minimum":1},
+        "filter":{"type":"object","properties":{"kind":{"type":"string","enum":["lp","hp"]}},"required":["kind"]}
+    },"required":["rate","unit"]}
+},"required":["pin","mode","token"]})";
+
+TEST(compiled_schema_compile) {
+    CompiledSchema schema;
+    ASSERT_FALSE(schema.isCompiled());
+    ASSERT_TRUE(schema.compile(kSensorSchema));
+    ASSERT_TRUE(schema.isCompiled());
+    ASSERT_EQ(schema.rule(0).type, SchemaType::Object);
+    // root + 6 properties + "token" + config's 2 + "unit" + filter's 1
+    ASSERT_EQ((int)schema.ruleCount(), 12);
+    ASSERT_GT(schema.memoryUsage(), (size_t)0);
+}
+
+TEST(compiled_schema_rejects_invalid_json) {
+    CompiledSchema schema;
+    ASSERT_FALSE(schema.compile("not json"));
+    ASSERT_FALSE(schema.isCompiled());
+    ASSERT_FALSE(schema.compile("[1,2]"));
+    ASSERT_FALSE(schema.compile(""));
+    ValidationResult vr = validateArguments(JsonObject(), schema);
+    ASSERT_TRUE(vr.valid);
+}
+
+TEST(compiled_schema_clear) {
+    CompiledSchema schema;
+    schema.compile(kSensorSchema);
+    schema.clear();
+    ASSERT_FALSE(schema.isCompiled());
+    ASSERT_EQ((int)schema.memoryUsage(), 0);
+}
+
+TEST(compiled_schema_nested_path) {
+    CompiledSchema schema;
+    schema.compile(kSensorSchema);
+    JsonDocument args;
+    deserializeJson(args, R"({"pin":1,"mode":"input","token":"t","config":{"rate":0,"unit":"s","filter":{}}})");
+    ValidationResult vr = validateArguments(args.as<JsonObject>(), schema);
+    ASSERT_FALSE(vr.valid);
+    ASSERT_STR_EQ(vr.errors[0].field.c_str(), "config.rate");
+    ASSERT_STR_EQ(vr.errors[1].field.c_str(), "config.filter.kind");
+}
+
+TEST(compiled_schema_parity_valid) {
+    ASSERT_TRUE(sameArgumentsResult(kSensorSchema,
+        R"({"pin":4,"mode":"output","token":"x","label":"led","samples":[1],"gain":2,"config":{"rate":5,"unit":"ms","filter":{"kind":"lp"}}})"));
+}
+
+TEST(compiled_schema_parity_required) {
+    ASSERT_TRUE(sameArgumentsResult(kSensorSchema, R"({})"));
+    ASSERT_TRUE(sameArgumentsResult(kSensorSchema, R"({"pin":null,"mode":"input"})"));
+}
+
+TEST(compiled_schema_parity_types) {
+    ASSERT_TRUE(sameArgumentsResult(kSensorSchema,
+        R"({"pin":"4","mode":3,"token":1,"label":true,"samples":{},"gain":"x","config":[]})"));
+}
+
+TEST(compiled_schema_parity_constraints) {
+    ASSERT_TRUE(sameArgumentsResult(kSensorSchema,
+        R"({"pin":40,"mode":"analog","token":"x","label":"a","samples":[],"gain":3})"));
+    ASSERT_TRUE(sameArgumentsResult(kSensorSchema,
+        R"({"pin":-1,"mode":"input","token":"x","label":"too-long-label","samples":[1,2,3,4]})"));
+}
+
+TEST(compiled_schema_parity_nested) {
+    ASSERT_TRUE(sameArgumentsResult(kSensorSchema,
+        R"({"pin":1,"mode":"input","token":"t","config":{"rate":"fast","filter":{"kind":"bp"}}})"));
+}
+
+TEST(compiled_schema_parity_value) {
+    ASSERT_TRUE(sameValueResult(R"({"type":"object","properties":{"t":{"type":"number"}},"required":["t"]})", R"({"t":"hot"})"));
+    ASSERT_TRUE(sameValueResult(R"({"type":"object","required":["t"]})", R"({})"));
+    ASSERT_TRUE(sameValueResult(R"({"type":"string","minLength":3})", R"("ab")"));
+    ASSERT_TRUE(sameValueResult(R"({"type":"number","minimum":0,"maximum":10})", R"(11)"));
+    ASSERT_TRUE(sameValueResult(R"({"enum":["a","b"]})", R"("c")"));
+    ASSERT_TRUE(sameValueResult(R"({"type":"array","maxItems":1})", R"([1,2])"));
+    ASSERT_TRUE(sameValueResult(R"({"type":"integer"})", R"(1.5)"));
+    ASSERT_TRUE(sameValueResult(R"({"type":"object"})", R"([])"));
+}
+
+TEST(server_compiles_schema_only_when_validating) {
+    Server s("test");
+    s.addTool("t", "", R"({"type":"object","properties":{"x":{"type":"integer"}}})",
+              [](const JsonObject&) -> String { return "{}"; });
+    ASSERT_FALSE(s._tools[0].compiledInputSchema.isCompiled());
+    s.enableInputValidation();
+    ASSERT_TRUE(s._tools[0].compiledInputSchema.isCompiled());
+    s.addTool("u", "", R"({"type":"object"})", [](const JsonObject&) -> String { return "{}"; });
+    ASSERT_TRUE(s._tools[1].compiledInputSchema.isCompiled());
+    s.enableInputValidation(false);
+    ASSERT_FALSE(s._tools[0].compiledInputSchema.isCompiled());
+}
+
+TEST(server_compiles_output_schema) {
+    Server s("test");
+    s.enableOutputValidation();
+    MCPTool tool("o", "", "{}", [](const JsonObject&) -> String { return "{}"; });
+    tool.setOutputSchema(R"({"type":"object"})");
+    s.addTool(tool);
+    ASSERT_TRUE(s._tools[0].compiledOutputSchema.isCompiled());
+    ASSERT_FALSE(s._tools[0].compiledInputSchema.isCompiled());
+}
+
 // ═══════════════════════════════════════════════════════════════════════
 
 int main() {
@@ -0,0 +1,413 @@
+/**
+ * mcpd — WebSocket permessage-deflate tests
+ *
+ * Compressed frames are checked against zlib as the reference inflater,
+ * and zlib-compressed client messages against DeflateDecoder. Compression
+ * ratios on real mcpd responses are printed.
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+#include "../src/tools/MCPGPIOTool.h"
+
+#include <zlib.h>
+
+using namespace mcpd;
+
+static String upgrade(const char* extensions = nullptr) {
+    String req = "GET /mcp HTTP/1.1\r\nHost: esp32\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n";
+    if (extensions) req += String("Sec-WebSocket-Extensions: ") + extensions + "\r\n";
+    return req + "\r\n";
+}
+
+// Masked client→server frame
+static String clientFrame(const String& payload, uint8_t first = 0x81) {
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    String f;
+    f += (char)first;
+    size_t len = payload.length();
+    if (len < 126) {
+        f += (char)(0x80 | len);
+    } else {
+        f += (char)(0x80 | 126);
+        f += (char)(len >> 8);
+        f += (char)(len & 0xFF);
+    }
+    for (uint8_t m : mask) f += (char)m;
+    for (size_t i = 0; i < len; i++) f += (char)(payload[i] ^ mask[i % 4]);
+    return f;
+}
+
+// Next server→client frame in buf (unmasked); false when none is left
+static bool nextFrame(const String& buf, size_t& pos, uint8_t& first, String& payload) {
+    if (pos + 2 > buf.length()) return false;
+    first = (uint8_t)buf[pos];
+    size_t len = (uint8_t)buf[pos + 1] & 0x7F;
+    pos += 2;
+    if (len == 126) {
+        len = ((size_t)(uint8_t)buf[pos] << 8) | (uint8_t)buf[pos + 1];
+        pos += 2;
+    }
+    payload = buf.substring(pos, pos + len);
+    pos += len;
+    return true;
+}
+
+static WSClient& connect(WebSocketTransport& ws, const char* extensions, String* response = nullptr) {
+    ws._server->_queueClient(WiFiClient());
+    ws.loop();
+    WSClient& c = ws._clients.back();
+    c.tcp.pushIncoming(upgrade(extensions));
+    ws.loop();
+    if (response) *response = c.tcp.getBuffer();
+    c.tcp.clearBuffer();
+    return c;
+}
+
+/** zlib raw inflater; one stream spans messages, as with context takeover */
+struct RefInflater {
+    z_stream z;
+    explicit RefInflater(int windowBits = 15) {
+        memset(&z, 0, sizeof(z));
+        inflateInit2(&z, -windowBits);
+    }
+    ~RefInflater() { inflateEnd(&z); }
+
+    bool message(const String& payload, String& out) {
+        std::string in(payload.c_str(), payload.length());
+        in.append("\x00\x00\xff\xff", 4);
+        z.next_in = (Bytef*)in.data();
+        z.avail_in = (uInt)in.size();
+        out = String();
+        char buf[4096];
+        while (z.avail_in > 0) {
+            z.next_out = (Bytef*)buf;
+            z.avail_out = sizeof(buf);
+            int rc = inflate(&z, Z_SYNC_FLUSH);
+            if (rc != Z_OK && rc != Z_BUF_ERROR) return false;
+            out.concat(buf, (unsigned)(sizeof(buf) - z.avail_out));
+            if (rc == Z_BUF_ERROR && z.avail_out != 0) return false;
+        }
+        return true;
+    }
+};
+
+/** zlib raw deflate of one message, sync-flushed with the tail stripped */
+static String refDeflate(const String& data, int level = Z_DEFAULT_COMPRESSION,
+                         int strategy = Z_DEFAULT_STRATEGY) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    deflateInit2(&z, level, Z_DEFLATED, -15, 8, strategy);
+    std::string out(data.length() + 64, '\0');
+    z.next_in = (Bytef*)data.c_str();
+    z.avail_in = (uInt)data.length();
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = (uInt)out.size();
+    deflate(&z, Z_SYNC_FLUSH);
+    out.resize(out.size() - z.avail_out - 4);
+    deflateEnd(&z);
+    return String(out);
+}
+
+static String repeatedJson(int n) {
+    String s = "[";
+    for (int i = 0; i < n; i++) {
+        if (i) s += ",";
+        s += String("{\"topic\":\"home/sensor/") + (i % 4) + "/temperature\",\"payload\":\"" +
+             (20 + i % 7) + "." + (i % 10) + "\",\"qos\":1,\"retained\":false}";
+    }
+    return s + "]";
+}
+
+// ── DeflateEncoder ─────────────────────────────────────────────────────
+
+TEST(encoder_output_inflates_with_zlib) {
+    const String inputs[] = {
+        repeatedJson(20),
+        String("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"),
+        repeatedJson(200),  // Matches up to 258 bytes, far past the window
+    };
+    for (const String& in : inputs) {
+        DeflateEncoder enc;
+        String z, out;
+        ASSERT(enc.compress((const uint8_t*)in.c_str(), in.length(), z));
+        ASSERT_LE((int)z.length(), (int)in.length() / 3);
+        RefInflater ref;
+        ASSERT(ref.message(z, out));
+        ASSERT(out == in);
+    }
+}
+
+TEST(encoder_incompressible_returns_false) {
+    DeflateEncoder enc;
+    String in;
+    uint32_t x = 1;
+    for (int i = 0; i < 200; i++) {
+        x = x * 1103515245 + 12345;
+        in += (char)(x >> 16);
+    }
+    String z;
+    ASSERT_FALSE(enc.compress((const uint8_t*)in.c_str(), in.length(), z));
+    ASSERT_EQ((int)z.length(), 0);
+    ASSERT_EQ((int)enc.historyBytes(), 0);
+}
+
+TEST(encoder_context_takeover_reuses_window) {
+    DeflateEncoder enc(10, true);
+    String msg = R"({"jsonrpc":"2.0","id":12,"result":{"content":[{"type":"text","text":"{\"pin\":4,\"value\":1}"}]}})";
+    String z1, z2, out;
+    ASSERT(enc.compress((const uint8_t*)msg.c_str(), msg.length(), z1));
+    ASSERT(enc.compress((const uint8_t*)msg.c_str(), msg.length(), z2));
+    ASSERT_LE((int)z2.length(), 12);
+    ASSERT_LE((int)enc.historyBytes(), 1024);
+    RefInflater ref;
+    ASSERT(ref.message(z1, out));
+    ASSERT(out == msg);
+    ASSERT(ref.message(z2, out));
+    ASSERT(out == msg);
+}
+
+TEST(encoder_without_context_takeover_is_independent) {
+    DeflateEncoder enc(10, false);
+    String msg = repeatedJson(10);
+    String z1, z2, out;
+    ASSERT(enc.compress((const uint8_t*)msg.c_str(), msg.length(), z1));
+    ASSERT(enc.compress((const uint8_t*)msg.c_str(), msg.length(), z2));
+    ASSERT(z1 == z2);
+    ASSERT_EQ((int)enc.historyBytes(), 0);
+    RefInflater ref;
+    ASSERT(ref.message(z2, out));
+    ASSERT(out == msg);
+}
+
+TEST(encoder_respects_small_window) {
+    // A 512-byte zlib window rejects any distance beyond it
+    DeflateEncoder enc(9, true);
+    RefInflater ref(9);
+    for (int i = 0; i < 5; i++) {
+        String msg = repeatedJson(15 + i);
+        String z, out;
+        ASSERT(enc.compress((const uint8_t*)msg.c_str(), msg.length(), z));
+        ASSERT(ref.message(z, out));
+        ASSERT(out == msg);
+    }
+    ASSERT_EQ((int)enc.historyBytes(), 512);
+}
+
+// ── DeflateDecoder ─────────────────────────────────────────────────────
+
+TEST(decoder_reads_zlib_stored_fixed_and_dynamic) {
+    String msg = repeatedJson(30);
+    String streams[] = {
+        refDeflate(msg, 0),                      // Stored blocks
+        refDeflate(msg, 6, Z_FIXED),             // Fixed Huffman
+        refDeflate(msg, 9),                      // Dynamic Huffman
+        refDeflate(msg, 1, Z_HUFFMAN_ONLY),      // Literals only
+    };
+    DeflateDecoder dec;
+    for (const String& z : streams) {
+        String out;
+        ASSERT(dec.inflate((const uint8_t*)z.c_str(), z.length(), out, 16384));
+        ASSERT(out == msg);
+    }
+}
+
+TEST(decoder_rejects_corrupt_and_oversized) {
+    String msg = repeatedJson(30);
+    String z = refDeflate(msg, 9);
+    DeflateDecoder dec;
+    String out;
+    ASSERT_FALSE(dec.inflate((const uint8_t*)z.c_str(), z.length(), out, msg.length() - 1));
+    const uint8_t reserved[] = {0x07};  // BTYPE 11
+    ASSERT_FALSE(dec.inflate(reserved, sizeof(reserved), out, 16384));
+    String cut = z.substring(0, z.length() / 2);
+    ASSERT_FALSE(dec.inflate((const uint8_t*)cut.c_str(), cut.length(), out, 16384));
+}
+
+// ── Negotiation ────────────────────────────────────────────────────────
+
+TEST(handshake_accepts_deflate_offer) {
+    WebSocketTransport ws(8081);
+    ws.enableCompression();
+    ws.begin();
+    String resp;
+    WSClient& c = connect(ws, "permessage-deflate; client_max_window_bits", &resp);
+    ASSERT(c.deflate);
+    ASSERT_STR_CONTAINS(resp.c_str(),
+        "Sec-WebSocket-Extensions: permessage-deflate; server_max_window_bits=10; "
+        "client_no_context_takeover\r\n");
+    ASSERT(c.encoder.contextTakeover());
+}
+
+TEST(handshake_without_offer_or_when_disabled) {
+    WebSocketTransport on(8081), off(8082);
+    on.enableCompression();
+    on.begin();
+    off.begin();
+    String resp;
+    WSClient& a = connect(on, nullptr, &resp);
+    ASSERT_FALSE(a.deflate);
+    ASSERT_STR_NOT_CONTAINS(resp.c_str(), "Sec-WebSocket-Extensions");
+    WSClient& b = connect(off, "permessage-deflate", &resp);
+    ASSERT_FALSE(b.deflate);
+    ASSERT_STR_NOT_CONTAINS(resp.c_str(), "Sec-WebSocket-Extensions");
+}
+
+TEST(handshake_offer_parameters) {
+    WebSocketTransport ws(8081);
+    ws.enableCompression();
+    ws.begin();
+    String resp;
+    WSClient& a = connect(ws, "permessage-deflate; server_no_context_takeover; server_max_window_bits=9", &resp);
+    ASSERT_STR_CONTAINS(resp.c_str(),
+        "permessage-deflate; server_max_window_bits=9; client_no_context_takeover; "
+        "server_no_context_takeover\r\n");
+    ASSERT_EQ((int)a.encoder.windowBits(), 9);
+    ASSERT_FALSE(a.encoder.contextTakeover());
+
+    // Unknown or duplicate parameters decline that offer; the next one is used
+    WSClient& b = connect(ws, "permessage-deflate; x_unknown, permessage-deflate; "
+                              "server_max_window_bits=7, PerMessage-Deflate", &resp);
+    ASSERT(b.deflate);
+    ASSERT_STR_CONTAINS(resp.c_str(), "server_max_window_bits=10;");
+    WSClient& c = connect(ws, "permessage-deflate; server_no_context_takeover; server_no_context_takeover", &resp);
+    ASSERT_FALSE(c.deflate);
+}
+
+TEST(handshake_context_takeover_toggle) {
+    WebSocketTransport ws(8081);
+    ws.enableCompression(false);
+    ws.begin();
+    String resp;
+    WSClient& c = connect(ws, "permessage-deflate", &resp);
+    ASSERT_STR_CONTAINS(resp.c_str(), "; server_no_context_takeover\r\n");
+    ASSERT_FALSE(c.encoder.contextTakeover());
+}
+
+// ── Frames ─────────────────────────────────────────────────────────────
+
+TEST(compressed_frames_set_rsv1_and_inflate) {
+    WebSocketTransport ws(8081);
+    ws.enableCompression();
+    ws.begin();
+    WSClient& c = connect(ws, "permessage-deflate");
+    String big = repeatedJson(12);
+    ws.broadcast(big);
+    ws.broadcast(big);
+    ws.broadcast("{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{}}");  // Below MIN_COMPRESS_BYTES
+
+    RefInflater ref;
+    String buf = c.tcp.getBuffer(), payload, out;
+    size_t pos = 0;
+    uint8_t first;
+    ASSERT(nextFrame(buf, pos, first, payload));
+    ASSERT_EQ((int)first, 0xC1);
+    ASSERT(ref.message(payload, out));
+    ASSERT(out == big);
+    ASSERT(nextFrame(buf, pos, first, payload));
+    ASSERT_EQ((int)first, 0xC1);
+    ASSERT(ref.message(payload, out));
+    ASSERT(out == big);
+    ASSERT(nextFrame(buf, pos, first, payload));
+    ASSERT_EQ((int)first, 0x81);
+    ASSERT_STR_CONTAINS(payload.c_str(), "\"id\":1");
+
+    ASSERT_EQ((int)ws.compressedMessages(), 2);
+    ASSERT_EQ((int)ws.compressionInputBytes(), 2 * (int)big.length());
+    ASSERT_LE((int)ws.compressionOutputBytes(), (int)big.length() / 4);
+}
+
+TEST(incoming_compressed_message_is_inflated) {
+    WebSocketTransport ws(8081);
+    String got;
+    ws.onMessage([&](const String& msg) -> String { got = msg; return ""; });
+    ws.enableCompression();
+    ws.begin();
+    WSClient& c = connect(ws, "permessage-deflate");
+    String msg = R"({"jsonrpc":"2.0","id":3,"method":"tools/call","params":{"name":"digital_read","arguments":{"pin":4}}})";
+    c.tcp.pushIncoming(clientFrame(refDeflate(msg), 0xC1));
+    ws.loop();
+    ASSERT(got == msg);
+    ASSERT(c.connected());
+}
+
+TEST(rsv1_without_deflate_closes) {
+    WebSocketTransport ws(8081);
+    int calls = 0;
+    ws.onMessage([&](const String&) -> String { calls++; return ""; });
+    ws.begin();
+    WSClient& c = connect(ws, nullptr);
+    c.tcp.pushIncoming(clientFrame(refDeflate("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"ping\"}"), 0xC1));
+    ws.loop();
+    ASSERT_EQ(calls, 0);
+    ASSERT_FALSE(c.connected());
+}
+
+// ── Real responses ─────────────────────────────────────────────────────
+
+static std::string _ratioReport;  // Printed after the test lines
+
+TEST(server_compression_ratio_on_mcpd_responses) {
+    Server* s = new Server("deflate");
+    s->setMDNS(false);
+    s->enableWebSocket(8081);
+    s->enableWebSocketCompression();
+    tools::GPIOTool::attach(*s);
+    for (int i = 0; i < 24; i++) {
+        String name = String("sensor_") + i + "_read";
+        s->addTool(name.c_str(), "Read the latest value of a sensor channel",
+            R"({"type":"object","properties":{"channel":{"type":"integer","description":"Channel number","minimum":0,"maximum":7},"unit":{"type":"string","enum":["C","F","K"],"description":"Output unit"}},"required":["channel"]})",
+            [](const JsonObject&) -> String { return "{}"; });
+    }
+    s->addTool("mqtt_messages", "Read buffered MQTT messages", R"({"type":"object","properties":{}})",
+        [](const JsonObject&) -> String { return repeatedJson(30); });
+    s->begin();
+    WSClient& c = connect(*s->_wsTransport, "permessage-deflate; client_max_window_bits");
+
+    const char* requests[] = {
+        R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{"protocolVersion":"2025-03-26","capabilities":{},"clientInfo":{"name":"t","version":"1"}}})",
+        R"({"jsonrpc":"2.0","id":2,"method":"tools/list"})",
+        R"({"jsonrpc":"2.0","id":3,"method":"tools/call","params":{"name":"mqtt_messages","arguments":{}}})",
+        R"({"jsonrpc":"2.0","id":4,"method":"tools/call","params":{"name":"mqtt_messages","arguments":{}}})",
+    };
+    const char* labels[] = {"initialize", "tools/list", "mqtt_messages", "mqtt_messages again"};
+    RefInflater ref;
+    size_t firstDump = 0;
+    for (int i = 0; i < 4; i++) {
+        c.tcp.clearBuffer();
+        c.tcp.pushIncoming(clientFrame(requests[i]));
+        s->loop();
+        String buf = c.tcp.getBuffer(), payload, out;
+        size_t pos = 0;
+        uint8_t first;
+        ASSERT(nextFrame(buf, pos, first, payload));
+        ASSERT_EQ((int)first, 0xC1);
+        ASSERT(ref.message(payload, out));
+        String id = String("\"id\":") + (i + 1);
+        ASSERT_STR_CONTAINS(out.c_str(), id.c_str());
+        char line[96];
+        snprintf(line, sizeof(line), "    %-20s %6u -> %5u bytes  (%.1fx)\n", labels[i],
+                 (unsigned)out.length(), (unsigned)payload.length(),
+                 (double)out.length() / payload.length());
+        _ratioReport += line;
+        if (i == 1) ASSERT_GE((int)out.length(), 5 * (int)payload.length());
+        if (i == 2) {
+            ASSERT_GE((int)out.length(), 5 * (int)payload.length());
+            firstDump = payload.length();
+        }
+        if (i == 3) ASSERT_LE((int)payload.length(), (int)firstDump);
+    }
+    s->stop();
+    delete s;
+}
+
+int main() {
+    printf("\n  permessage-deflate, %u-byte window:\n%s", 1u << WebSocketTransport::DEFLATE_WINDOW_BITS,
+           _ratioReport.c_str());
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+/**
+ * mcpd — Incremental WebSocket frame parser tests
+ *
+ * Frames split across reads, fragmentation, message size limits and the
+ * close codes sent for protocol violations.
+ */
+
+#include "arduino_mock.h"
+#include "test_framework.h"
+
+// Include mcpd implementation
+#include "mcpd.cpp"
+
+#include <zlib.h>
+
+using namespace mcpd;
+
+static const char* UPGRADE =
+    "GET /mcp HTTP/1.1\r\nHost: esp32\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n"
+    "Sec-WebSocket-Extensions: permessage-deflate\r\n\r\n";
+
+// Client→server frame; masked unless told otherwise
+static String frame(uint8_t first, const String& payload, bool masked = true, bool len64 = false) {
+    const uint8_t mask[4] = {0xA1, 0x07, 0x3C, 0x5E};
+    String f;
+    f += (char)first;
+    uint8_t m = masked ? 0x80 : 0;
+    size_t len = payload.length();
+    if (len64) {
+        f += (char)(m | 127);
+        for (int i = 7; i >= 0; i--) f += (char)(((uint64_t)len >> (i * 8)) & 0xFF);
+    } else if (len < 126) {
+        f += (char)(m | len);
+    } else {
+        f += (char)(m | 126);
+        f += (char)(len >> 8);
+        f += (char)(len & 0xFF);
+    }
+    if (masked) for (uint8_t b : mask) f += (char)b;
+    for (size_t i = 0; i < len; i++) f += (char)(masked ? payload[i] ^ mask[i % 4] : payload[i]);
+    return f;
+}
+
+static String text(const String& payload) { return frame(0x81, payload); }
+
+struct Fixture {
+    WebSocketTransport ws{8081};
+    std::vector<String> received;
+
+    explicit Fixture(bool deflate = false) {
+        ws.onMessage([this](const String& msg) -> String {
+            received.push_back(msg);
+            return "";
+        });
+        if (deflate) ws.enableCompression();
+        ws.begin();
+        ws._server->_queueClient(WiFiClient());
+        ws.loop();
+        client().tcp.pushIncoming(UPGRADE);
+        ws.loop();
+        client().tcp.clearBuffer();
+    }
+
+    WSClient& client() { return ws._clients.back(); }
+
+    void send(const String& bytes) {
+        client().tcp.pushIncoming(bytes);
+        ws.loop();
+    }
+
+    // Status code of the close frame the server sent last, 0 if none
+    int closeCode() {
+        String out = client().tcp.getBuffer();
+        if (out.length() < 4 || (uint8_t)out[out.length() - 4] != 0x88) return 0;
+        return ((uint8_t)out[out.length() - 2] << 8) | (uint8_t)out[out.length() - 1];
+    }
+};
+
+static String filled(size_t n) {
+    String s;
+    s.reserve(n);
+    for (size_t i = 0; i < n; i++) s += (char)('a' + i % 26);
+    return s;
+}
+
+// ── Incremental parsing ────────────────────────────────────────────────
+
+TEST(frame_split_byte_by_byte) {
+    Fixture f;
+    String bytes = text(R"({"jsonrpc":"2.0","id":1,"method":"ping"})");
+    for (size_t i = 0; i < bytes.length(); i++) {
+        f.send(bytes.substring(i, i + 1));
+        ASSERT_EQ((int)f.received.size(), i + 1 == bytes.length() ? 1 : 0);
+    }
+    ASSERT(f.received[0] == R"({"jsonrpc":"2.0","id":1,"method":"ping"})");
+}
+
+TEST(several_frames_in_one_read) {
+    Fixture f;
+    f.send(text("one") + text("two") + text("three"));
+    ASSERT_EQ((int)f.received.size(), 3);
+    ASSERT(f.received[2] == "three");
+}
+
+TEST(extended_lengths) {
+    Fixture f;
+    f.ws.setMaxMessageSize(100000);
+    String mid = filled(300), big = filled(70000);
+    f.send(text(mid));
+    f.send(frame(0x81, big, true, true));
+    ASSERT_EQ((int)f.received.size(), 2);
+    ASSERT(f.received[0] == mid);
+    ASSERT(f.received[1] == big);
+}
+
+TEST(payload_buffer_sized_from_header) {
+    Fixture f;
+    f.ws.setMaxMessageSize(65536);
+    String payload = filled(40000);
+    String bytes = text(payload);
+    f.send(bytes.substring(0, 100));
+    WSReceiver& rx = f.client().rx;
+    ASSERT(rx.inPayload);
+    ASSERT_EQ((int)rx.message.size(), 40000);   // Allocated once, read into in place
+    const uint8_t* data = rx.message.data();
+    size_t off = 100;
+    for (; off + 1460 < bytes.length(); off += 1460) f.send(bytes.substring(off, off + 1460));
+    ASSERT(rx.message.data() == data);              // No reallocation while reading
+    f.send(bytes.substring(off));
+    ASSERT_EQ((int)f.received.size(), 1);
+    ASSERT(f.received[0] == payload);
+    ASSERT_LE((int)f.client().rx.message.capacity(), (int)WebSocketTransport::RX_RETAIN_BYTES);
+}
+
+// ── Fragmentation ──────────────────────────────────────────────────────
+
+TEST(fragmented_message_with_interleaved_ping) {
+    Fixture f;
+    f.send(frame(0x01, "{\"jsonrpc\":"));            // Text, FIN=0
+    f.send(frame(0x89, "hb"));                       // Ping between fragments
+    f.send(frame(0x00, "\"2.0\",\"id\":"));          // Continuation
+    ASSERT_EQ((int)f.received.size(), 0);
+    f.send(frame(0x80, "7,\"method\":\"ping\"}"));   // Continuation, FIN=1
+    ASSERT_EQ((int)f.received.size(), 1);
+    ASSERT(f.received[0] == R"({"jsonrpc":"2.0","id":7,"method":"ping"})");
+    String out = f.client().tcp.getBuffer();
+    ASSERT_EQ((uint8_t)out[0], 0x8A);
+    ASSERT_EQ((int)out[1], 2);
+    ASSERT(out.substring(2, 4) == "hb");
+}
+
+TEST(fragmented_compressed_message) {
+    Fixture f(true);
+    String msg = filled(600);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    deflateInit2(&z, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    std::string out(1024, '\0');
+    z.next_in = (Bytef*)msg.c_str();
+    z.avail_in = msg.length();
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = out.size();
+    deflate(&z, Z_SYNC_FLUSH);
+    out.resize(out.size() - z.avail_out - 4);
+    deflateEnd(&z);
+    String zdata(out);
+    size_t half = zdata.length() / 2;
+    f.send(frame(0x41, zdata.substring(0, half)));    // RSV1 on the first fragment only
+    f.send(frame(0x80, zdata.substring(half)));
+    ASSERT_EQ((int)f.received.size(), 1);
+    ASSERT(f.received[0] == msg);
+}
+
+// ── Limits and close codes ─────────────────────────────────────────────
+
+TEST(message_too_big_closes_1009) {
+    Fixture f;
+    f.ws.setMaxMessageSize(1000);
+    f.send(text(filled(1001)));
+    ASSERT_EQ(f.closeCode(), 1009);
+    ASSERT_FALSE(f.client().connected());
+
+    Fixture g;
+    g.ws.setMaxMessageSize(1000);
+    g.send(frame(0x01, filled(600)));
+    ASSERT(g.client().connected());
+    g.send(frame(0x80, filled(600)));                // Fragments add up past the limit
+    ASSERT_EQ(g.closeCode(), 1009);
+    ASSERT_EQ((int)g.received.size(), 0);
+}
+
+TEST(protocol_errors_close_1002) {
+    const String bad[] = {
+        frame(0x81, "x", false),                     // Unmasked client frame
+        frame(0x80, "x"),                            // Continuation with nothing to continue
+        frame(0x83, "x"),                            // Reserved opcode
+        frame(0x09, "x"),                            // Fragmented ping
+        frame(0xA1, "x"),                            // RSV2
+        frame(0xC1, "x"),                            // RSV1 without permessage-deflate
+        frame(0x89, filled(126)),                    // Control payload over 125 bytes
+        frame(0x01, "a") + frame(0x81, "b"),         // New message inside a fragmented one
+    };
+    for (const String& bytes : bad) {
+        Fixture f;
+        f.send(bytes);
+        ASSERT_EQ(f.closeCode(), 1002);
+        ASSERT_FALSE(f.client().connected());
+        ASSERT_EQ((int)f.ws.protocolErrors(), 1);
+        ASSERT_EQ((int)f.received.size(), 0);
+    }
+}
+
+TEST(binary_message_closes_1003) {
+    Fixture f;
+    f.send(frame(0x82, "\x01\x02"));
+    ASSERT_EQ(f.closeCode(), 1003);
+}
+
+TEST(invalid_utf8_closes_1007) {
+    Fixture f;
+    f.send(text("caf\xC3"));                          // Truncated sequence
+    ASSERT_EQ(f.closeCode(), 1007);
+
+    Fixture g(true);
+    g.send(frame(0xC1, "\xFF\xFF\xFF"));              // Does not inflate
+    ASSERT_EQ(g.closeCode(), 1007);
+}
+
+TEST(utf8_validation) {
+    auto ok = [](const char* s) {
+        return WebSocketTransport::_validUtf8((const uint8_t*)s, strlen(s));
+    };
+    ASSERT(ok("plain ascii"));
+    ASSERT(ok("Gr\xC3\xBC\xC3\x9F" "e \xE2\x82\xAC \xF0\x9F\x98\x80"));  // Grüße € 😀
+    ASSERT_FALSE(ok("\xC0\xAF"));                     // Overlong '/'
+    ASSERT_FALSE(ok("\xED\xA0\x80"));                 // UTF-16 surrogate
+    ASSERT_FALSE(ok("\xF4\x90\x80\x80"));             // Above U+10FFFF
+    ASSERT_FALSE(ok("\x80"));                         // Stray continuation byte
+}
+
+TEST(close_echoes_peer_code) {
+    Fixture f;
+    String code;
+    code += (char)0x03;
+    code += (char)0xE9;                               // 1001 going away
+    f.send(frame(0x88, code + "bye"));
+    ASSERT_EQ(f.closeCode(), 1001);
+    ASSERT_FALSE(f.client().connected());
+    ASSERT_EQ((int)f.ws.protocolErrors(), 0);
+
+    Fixture g;
+    g.send(frame(0x88, ""));
+    String out = g.client().tcp.getBuffer();
+    ASSERT_EQ((int)out.length(), 2);
+    ASSERT_EQ((uint8_t)out[0], 0x88);
+
+    Fixture h;
+    String invalid;
+    invalid += (char)0x03;
+    invalid += (char)0xE7;                            // 999
+    h.send(frame(0x88, invalid));
+    ASSERT_EQ(h.closeCode(), 1002);
+}
+
+TEST(server_applies_max_message_size) {
+    Server* s = new Server("frames");
+    s->setMDNS(false);
+    s->enableWebSocket(8081);
+    s->setWebSocketMaxMessageSize(32768);
+    s->begin();
+    ASSERT_EQ((int)s->_wsTransport->maxMessageSize(), 32768);
+    s->stop();
+    delete s;
+}
+
+int main() {
+    TEST_SUMMARY();
+    return _tests_failed > 0 ? 1 : 0;
+}